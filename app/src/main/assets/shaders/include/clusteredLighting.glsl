@@ -0,0 +1,70 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+// Clustered forward lighting, needs GLSL ES 3.00 and the FrameData block of uniforms.glsl.
+// The light lists are bound by MyClusteredLighting.
+precision highp float;
+precision highp int;
+precision highp usampler2D;
+
+// must match myClusteredLighting.h
+#define CLUSTER_GRID_X              16
+#define CLUSTER_GRID_Z              24
+#define LIGHT_INDEX_TEXTURE_WIDTH   1024u
+#define LIGHTS_PER_TEXTURE_ROW      512u
+#define AMBIENT_LIGHT               0.15
+
+uniform     sampler2D  lightData;   // per light: view position and radius, color and intensity
+uniform     usampler2D clusterGrid; // per froxel: offset and count in lightIndices
+uniform     usampler2D lightIndices;
+
+// light reaching the fragment from the lights of its froxel
+vec3 ComputeClusteredLighting()
+{
+    // view-space position from the fragment's window coordinates and depth
+    vec4 ndcPosition    = vec4(gl_FragCoord.xy / viewportSize.xy * 2.0 - 1.0,
+                               gl_FragCoord.z * 2.0 - 1.0, 1.0);
+    vec4 viewPosition   = inverseProjection * ndcPosition;
+    vec3 position       = viewPosition.xyz / viewPosition.w;
+
+    // meshes carry no normals yet, faceted ones get their face normal from the derivatives
+    vec3 normal         = normalize(cross(dFdx(position), dFdy(position)));
+
+    ivec2 tile          = ivec2(gl_FragCoord.xy * tileScale.xy);
+    int slice           = clamp(int(log(-position.z) * sliceParams.x + sliceParams.y),
+                                0, CLUSTER_GRID_Z - 1);
+    uvec2 cluster       = texelFetch(clusterGrid,
+                                     ivec2(tile.y * CLUSTER_GRID_X + tile.x, slice), 0).xy;
+
+    vec3 light          = vec3(AMBIENT_LIGHT);
+    for (uint i = 0u; i < cluster.y; i++) {
+        uint listIndex  = cluster.x + i;
+        uint lightIndex = texelFetch(lightIndices, ivec2(listIndex % LIGHT_INDEX_TEXTURE_WIDTH,
+                                                         listIndex / LIGHT_INDEX_TEXTURE_WIDTH), 0).x;
+        ivec2 texel     = ivec2(2u * (lightIndex % LIGHTS_PER_TEXTURE_ROW),
+                                lightIndex / LIGHTS_PER_TEXTURE_ROW);
+        vec4 positionRadius = texelFetch(lightData, texel, 0);
+        vec4 colorIntensity = texelFetch(lightData, texel + ivec2(1, 0), 0);
+
+        // Lambert with a falloff that reaches zero at the light's radius
+        vec3 toLight    = positionRadius.xyz - position;
+        float distanceSquared = dot(toLight, toLight);
+        float falloff   = max(1.0 - distanceSquared / (positionRadius.w * positionRadius.w), 0.0);
+        float diffuse   = max(dot(normal, toLight * inversesqrt(distanceSquared)), 0.0);
+        light           += colorIntensity.rgb * (colorIntensity.w * diffuse * falloff * falloff);
+    }
+    return light;
+}
@@ -0,0 +1,40 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+// Spellings that differ between GLSL ES 1.00 and 3.00. The shader front end puts #version
+// and a 0/1 #define for the stage and for every feature in front of each shader.
+#if __VERSION__ >= 300
+#if VERTEX_SHADER
+#define ATTRIBUTE   in
+#define VARYING     out
+#else
+#define VARYING     in
+#endif
+#define TEXTURE_2D  texture
+#else
+#define ATTRIBUTE   attribute
+#define VARYING     varying
+#define TEXTURE_2D  texture2D
+#endif
+
+#if FRAGMENT_SHADER
+precision mediump float; // required in GLSL 100
+#if __VERSION__ >= 300
+out vec4 outputColor;
+#else
+#define outputColor gl_FragColor
+#endif
+#endif
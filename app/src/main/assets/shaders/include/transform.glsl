@@ -0,0 +1,44 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+// vertex position in clip space, shared by every vertex shader so that the depth prepass
+// and the color pass compute exactly the same depth
+ATTRIBUTE   vec3 vertexPosition;
+#if INSTANCING
+ATTRIBUTE   mat4 instanceMat;       // per-instance model matrix, the camera is in FrameData
+#endif
+#if QUANTIZED_VERTICES
+// positions arrive as normalized shorts, mapped back to the bounds of their static batch
+uniform     vec3 positionScale;
+uniform     vec3 positionOffset;
+#endif
+
+// depth must match exactly between the prepass and the color pass
+invariant gl_Position;
+
+vec4 TransformPosition()
+{
+#if QUANTIZED_VERTICES
+    vec4 position   = vec4(vertexPosition * positionScale + positionOffset, 1.0);
+#else
+    vec4 position   = vec4(vertexPosition, 1.0);
+#endif
+#if INSTANCING
+    return projectionMat * (viewMat * (instanceMat * position));
+#else
+    return mvpMat * position;
+#endif
+}
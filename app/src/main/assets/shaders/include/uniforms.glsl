@@ -0,0 +1,35 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+// camera uniforms, members are highp so that both stages declare them identically
+#if UNIFORM_BUFFERS
+// per-frame block, must match FrameUniforms in myUniformBuffers.h
+layout(std140) uniform FrameData {
+    highp mat4  viewMat;
+    highp mat4  projectionMat;
+    highp mat4  inverseProjection;
+    highp vec4  viewportSize;
+    highp vec4  tileScale;      // froxel tiles per pixel
+    highp vec4  sliceParams;    // froxel slice = log(depth) * x + y
+};
+
+// per-draw block, must match DrawUniforms in myUniformBuffers.h
+layout(std140) uniform DrawData {
+    highp mat4  mvpMat;
+};
+#else
+uniform highp mat4 mvpMat;
+#endif
@@ -20,11 +20,15 @@ import android.app.Activity;
 import android.content.res.AssetManager;
 import android.opengl.GLSurfaceView;
 import android.os.Bundle;
+import android.view.Menu;
+import android.view.MenuItem;
 
 public class CubeActivity extends Activity{
     private GLSurfaceView mGLView = null;
     private native void CreateObjectNative(AssetManager assetManager, String pathToInternalDir);
     private native void DeleteObjectNative();
+    private native void SetDepthPrepassNative(boolean enabled);
+    private native void SetOverdrawViewNative(boolean enabled);
     GestureClass mGestureObject;
 
     @Override
@@ -79,6 +83,33 @@ public class CubeActivity extends Activity{
 
     }
 
+    @Override
+    public boolean onCreateOptionsMenu(Menu menu) {
+        getMenuInflater().inflate(R.menu.cube_menu, menu);
+        return true;
+    }
+
+    @Override
+    public boolean onOptionsItemSelected(MenuItem item) {
+
+        // both items are checkboxes, the native side only needs the new state
+        boolean enabled = !item.isChecked();
+        switch (item.getItemId()) {
+            case R.id.depth_prepass:
+                SetDepthPrepassNative(enabled);
+                break;
+            case R.id.overdraw_view:
+                SetOverdrawViewNative(enabled);
+                break;
+            default:
+                return super.onOptionsItemSelected(item);
+        }
+        item.setChecked(enabled);
+        if (mGLView != null) {
+            ((MyGLSurfaceView) mGLView).requestRenderIfNeeded();
+        }
+        return true;
+    }
 
     /**
      * load libCubeNative.so since it has all the native functions
@@ -32,6 +32,8 @@ public class GestureClass {
     private native void ScrollNative(float distanceX, float distanceY, float positionX, float positionY);
     private native void ScaleNative(float scaleFactor);
     private native void MoveNative(float distanceX, float distanceY);
+    private native void TouchDownNative();
+    private native void TouchUpNative();
 
     public GestureClass(Activity activity) {
 
@@ -60,6 +62,8 @@ public class GestureClass {
 
             switch (action) {
                 case MotionEvent.ACTION_DOWN: {
+                    // stop the model if it is still moving after a fling
+                    TouchDownNative();
                     break;
                 }
 
@@ -84,6 +88,8 @@ public class GestureClass {
 
                 case MotionEvent.ACTION_UP: {
                     mTwoFingerPointerId = INVALID_POINTER_ID;
+                    // last finger lifted, model keeps moving with the drag's velocity
+                    TouchUpNative();
                     break;
                 }
 
@@ -110,6 +116,9 @@ public class GestureClass {
                     break;
                 }
             }
+
+            // GL surface renders on demand, ask for a frame if the gesture changed the scene
+            ((MyGLSurfaceView) v).requestRenderIfNeeded();
             return true;
         }
     };
@@ -16,9 +16,15 @@
 
 package com.anandmuralidhar.cubeandroid;
 
+import android.content.Context;
 import android.opengl.GLSurfaceView;
+import android.os.Build;
+import android.os.PowerManager;
+import android.os.SystemClock;
 import android.util.Log;
 
+import java.lang.reflect.Method;
+
 import javax.microedition.khronos.egl.EGLConfig;
 import javax.microedition.khronos.opengles.GL10;
 
@@ -27,6 +33,61 @@ class MyGLRenderer implements GLSurfaceView.Renderer {
     private native void DrawFrameNative();
     private native void SurfaceCreatedNative();
     private native void SurfaceChangedNative(int width, int height);
+    private native void SetThermalHeadroomNative(float headroom);
+    private MyGLSurfaceView mGLView;
+
+    // PowerManager.getThermalHeadroom is rate limited, so poll it at most this often
+    private static final long THERMAL_POLL_INTERVAL_MS = 1000;
+    // seconds ahead that the thermal headroom is forecast for
+    private static final int THERMAL_FORECAST_SECONDS = 10;
+    private PowerManager mPowerManager = null;
+    private Method mGetThermalHeadroom = null;
+    private long mLastThermalPollMs = 0;
+
+    public MyGLRenderer(MyGLSurfaceView glView) {
+
+        mGLView = glView;
+
+        // getThermalHeadroom arrived in API 30, we build against 23 so look it up at runtime
+        if (Build.VERSION.SDK_INT >= 30) {
+            try {
+                mPowerManager = (PowerManager) glView.getContext().getSystemService(
+                        Context.POWER_SERVICE);
+                mGetThermalHeadroom = PowerManager.class.getMethod("getThermalHeadroom",
+                        int.class);
+            } catch (NoSuchMethodException e) {
+                Log.d("MyGLRenderer", "getThermalHeadroom not available");
+            }
+        }
+
+    }
+
+    /**
+     * Pass the forecast thermal headroom to native code, where 1 means severe throttling
+     */
+    private void PollThermalHeadroom() {
+
+        long currentTimeMs = SystemClock.elapsedRealtime();
+        if (mGetThermalHeadroom == null || mPowerManager == null ||
+                currentTimeMs - mLastThermalPollMs < THERMAL_POLL_INTERVAL_MS) {
+            return;
+        }
+        mLastThermalPollMs = currentTimeMs;
+
+        float headroom = -1;
+        try {
+            headroom = (Float) mGetThermalHeadroom.invoke(mPowerManager,
+                    THERMAL_FORECAST_SECONDS);
+        } catch (Exception e) {
+            mGetThermalHeadroom = null;
+        }
+        // NaN when the device has no thermal model or was polled too soon
+        if (Float.isNaN(headroom)) {
+            headroom = -1;
+        }
+        SetThermalHeadroomNative(headroom);
+
+    }
 
 
     public void onSurfaceCreated(GL10 gl, EGLConfig config) {
@@ -42,8 +103,12 @@ class MyGLRenderer implements GLSurfaceView.Renderer {
 
         // called to draw the current frame
         // call the rendering functions in native
+        PollThermalHeadroom();
         DrawFrameNative();
 
+        // keep drawing while native code has an animation running
+        mGLView.requestRenderIfNeeded();
+
     }
 
     public void onSurfaceChanged(GL10 unused, int width, int height) {
@@ -25,6 +25,7 @@ import android.view.SurfaceHolder;
 class MyGLSurfaceView extends GLSurfaceView {
 
     private MyGLRenderer mRenderer;
+    private native boolean IsRedrawNeededNative();
 
     public MyGLSurfaceView(Context context, AttributeSet attrs) {
         super(context, attrs);
@@ -34,12 +35,17 @@ class MyGLSurfaceView extends GLSurfaceView {
             // create the highest possible context on a phone
             setEGLContextClientVersion(2);
 
+            // keep the context while paused where the device allows it, otherwise native
+            // code restores its GL objects in onSurfaceCreated
+            setPreserveEGLContextOnPause(true);
+
             // set our custom Renderer for drawing on the created SurfaceView
-            mRenderer = new MyGLRenderer();
+            mRenderer = new MyGLRenderer(this);
             setRenderer(mRenderer);
 
-            // calls onDrawFrame(...) continuously
-            setRenderMode(GLSurfaceView.RENDERMODE_CONTINUOUSLY);
+            // calls onDrawFrame(...) only when requestRender() is called
+            // native code tells us if the scene changed since the last frame
+            setRenderMode(GLSurfaceView.RENDERMODE_WHEN_DIRTY);
 
         } catch (Exception e) {
 
@@ -50,4 +56,16 @@ class MyGLSurfaceView extends GLSurfaceView {
 
     }
 
+    /**
+     * request a new frame only if a gesture, animation, or GL init changed the scene
+     * safe to call from both the UI thread and the GL thread
+     */
+    public void requestRenderIfNeeded() {
+
+        if (IsRedrawNeededNative()) {
+            requestRender();
+        }
+
+    }
+
 }
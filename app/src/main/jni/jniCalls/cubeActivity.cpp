@@ -55,6 +55,28 @@ Java_com_anandmuralidhar_cubeandroid_CubeActivity_DeleteObjectNative(JNIEnv *env
     gHelperObject = NULL;
 }
 
+JNIEXPORT void JNICALL
+Java_com_anandmuralidhar_cubeandroid_CubeActivity_SetDepthPrepassNative(JNIEnv *env,
+                                                                                jobject instance,
+                                                                                jboolean enabled) {
+
+    if (gCubeObject == NULL) {
+        return;
+    }
+    gCubeObject->SetDepthPrepass(enabled == JNI_TRUE);
+}
+
+JNIEXPORT void JNICALL
+Java_com_anandmuralidhar_cubeandroid_CubeActivity_SetOverdrawViewNative(JNIEnv *env,
+                                                                                jobject instance,
+                                                                                jboolean enabled) {
+
+    if (gCubeObject == NULL) {
+        return;
+    }
+    gCubeObject->SetOverdrawView(enabled == JNI_TRUE);
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -92,6 +92,32 @@ Java_com_anandmuralidhar_cubeandroid_GestureClass_MoveNative(JNIEnv *env, jobjec
 
 }
 
+/**
+ * Finger placed on screen - stops a fling that is in progress
+ */
+JNIEXPORT void JNICALL
+Java_com_anandmuralidhar_cubeandroid_GestureClass_TouchDownNative(JNIEnv *env, jobject instance) {
+
+    if (gCubeObject == NULL) {
+        return;
+    }
+    gCubeObject->TouchDownAction();
+
+}
+
+/**
+ * All fingers lifted - model continues to move with the velocity of the drag
+ */
+JNIEXPORT void JNICALL
+Java_com_anandmuralidhar_cubeandroid_GestureClass_TouchUpNative(JNIEnv *env, jobject instance) {
+
+    if (gCubeObject == NULL) {
+        return;
+    }
+    gCubeObject->TouchUpAction();
+
+}
+
 #ifdef __cplusplus
 }
 #endif
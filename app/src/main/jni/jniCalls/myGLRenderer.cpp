@@ -59,6 +59,18 @@ Java_com_anandmuralidhar_cubeandroid_MyGLRenderer_SurfaceChangedNative(JNIEnv *e
 
 }
 
+JNIEXPORT void JNICALL
+Java_com_anandmuralidhar_cubeandroid_MyGLRenderer_SetThermalHeadroomNative(JNIEnv *env,
+                                                                               jobject instance,
+                                                                               jfloat headroom) {
+
+    if (gCubeObject == NULL) {
+        return;
+    }
+    gCubeObject->SetThermalHeadroom(headroom);
+
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,43 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include <jni.h>
+#include "myCube.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern MyCube *gCubeObject;
+
+/**
+ * Scene or camera changed, or an animation is running, since the last frame was drawn
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_anandmuralidhar_cubeandroid_MyGLSurfaceView_IsRedrawNeededNative(JNIEnv *env,
+                                                                          jobject instance) {
+
+    if (gCubeObject == NULL) {
+        return JNI_FALSE;
+    }
+    return gCubeObject->IsRedrawNeeded() ? JNI_TRUE : JNI_FALSE;
+
+}
+
+#ifdef __cplusplus
+}
+#endif
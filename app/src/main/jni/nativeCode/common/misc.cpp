@@ -15,6 +15,7 @@
  */
 
 #include "misc.h"
+#include <time.h>
 
 /**
  * Strip out the path and return just the filename
@@ -44,4 +45,14 @@ void PrintGLMMat4(glm::mat4 testMat) {
     MyLOGD("%f %f %f %f", testMat[0][2],testMat[1][2],testMat[2][2],testMat[3][2]);
     MyLOGD("%f %f %f %f", testMat[0][3],testMat[1][3],testMat[2][3],testMat[3][3]);
 
-}
\ No newline at end of file
+}
+
+/**
+ * Time in milliseconds from a clock that is not affected by changes to wall-clock time
+ */
+double GetMonotonicTimeMs() {
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000. + now.tv_nsec / 1000000.;
+}
@@ -24,5 +24,6 @@
 
 std::string GetFileName(std::string fileName);
 void PrintGLMMat4(glm::mat4 testMat);
+double GetMonotonicTimeMs();
 
 #endif //MISC_H
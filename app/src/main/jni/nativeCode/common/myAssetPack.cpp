@@ -0,0 +1,283 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+
+#include "myAssetPack.h"
+#include "myLZ4.h"
+#include <string.h>
+
+#define FNV32_OFFSET    2166136261u
+#define FNV32_PRIME     16777619u
+#define FNV64_OFFSET    14695981039346656037ull
+#define FNV64_PRIME     1099511628211ull
+
+/**
+ * FNV-1a of the name, the index is sorted and bucketed by it
+ */
+uint32_t HashAssetName(const char * name, size_t length) {
+
+    uint32_t hash = FNV32_OFFSET;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ (uint8_t) name[i]) * FNV32_PRIME;
+    }
+    return hash;
+}
+
+/**
+ * 64-bit FNV-1a of the contents, used by the packer to find duplicate assets
+ */
+uint64_t HashAssetContent(const uint8_t * data, size_t size) {
+
+    uint64_t hash = FNV64_OFFSET;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ data[i]) * FNV64_PRIME;
+    }
+    return hash;
+}
+
+static uint32_t GetBucket(uint32_t hash, uint32_t bucketBits) {
+
+    return bucketBits ? hash >> (32 - bucketBits) : 0;
+}
+
+// true if count items of itemSize at offset lie within size bytes
+static bool IsInRange(uint64_t offset, uint64_t count, uint64_t itemSize, uint64_t size) {
+
+    return offset <= size && count * itemSize <= size - offset;
+}
+
+MyAssetPack::MyAssetPack() {
+
+    data = NULL;
+    header = NULL;
+    buckets = NULL;
+    entries = NULL;
+    blocks = NULL;
+    names = NULL;
+}
+
+/**
+ * Use the pack of size bytes at data, which has to stay where it is until the pack is no
+ * longer read. Returns false with the reason in error if it is not a valid pack.
+ */
+bool MyAssetPack::Open(const uint8_t * data, size_t size, std::string & error) {
+
+    this->data = NULL;
+    header = NULL;
+    if (((uintptr_t) data & 3) != 0) {
+        error = "pack is not 4-byte aligned";
+        return false;
+    }
+    if (size < sizeof(AssetPackHeader)) {
+        error = "pack is too small";
+        return false;
+    }
+    const AssetPackHeader * newHeader = (const AssetPackHeader *) data;
+    if (memcmp(newHeader->magic, ASSET_PACK_MAGIC, ASSET_PACK_MAGIC_SIZE) != 0) {
+        error = "not an asset pack";
+        return false;
+    }
+    if (newHeader->version != ASSET_PACK_VERSION) {
+        error = "unsupported pack version";
+        return false;
+    }
+    if (newHeader->fileSize != size) {
+        error = "truncated pack";
+        return false;
+    }
+    if (newHeader->bucketBits > ASSET_PACK_MAX_BUCKET_BITS || newHeader->blockSize == 0 ||
+        newHeader->nameSize == 0) {
+        error = "invalid pack header";
+        return false;
+    }
+    uint32_t bucketCount = (1u << newHeader->bucketBits) + 1;
+    if ((newHeader->bucketOffset & 3) != 0 || (newHeader->entryOffset & 3) != 0 ||
+        (newHeader->blockOffset & 3) != 0 ||
+        !IsInRange(newHeader->bucketOffset, bucketCount, sizeof(uint32_t), size) ||
+        !IsInRange(newHeader->entryOffset, newHeader->entryCount, sizeof(AssetPackEntry),
+                   size) ||
+        !IsInRange(newHeader->blockOffset, newHeader->blockCount, sizeof(AssetPackBlock),
+                   size) ||
+        !IsInRange(newHeader->nameOffset, newHeader->nameSize, 1, size)) {
+        error = "pack index is out of range";
+        return false;
+    }
+
+    this->data = data;
+    header = newHeader;
+    buckets = (const uint32_t *) (data + header->bucketOffset);
+    entries = (const AssetPackEntry *) (data + header->entryOffset);
+    blocks = (const AssetPackBlock *) (data + header->blockOffset);
+    names = (const char *) (data + header->nameOffset);
+
+    bool valid = names[header->nameSize - 1] == 0 && buckets[0] == 0 &&
+                 buckets[bucketCount - 1] == header->entryCount;
+    for (uint32_t bucket = 0; valid && bucket + 1 < bucketCount; bucket++) {
+        valid = buckets[bucket] <= buckets[bucket + 1];
+    }
+    if (!valid) {
+        error = "invalid pack buckets";
+    }
+    for (uint32_t entry = 0; valid && entry < header->entryCount; entry++) {
+        valid = CheckEntry(entry, error);
+    }
+    if (!valid) {
+        header = NULL;
+        this->data = NULL;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * An entry is valid if it is in its place in the index and its name and data lie in the
+ * pack, entries before it were already checked
+ */
+bool MyAssetPack::CheckEntry(int entry, std::string & error) const {
+
+    const AssetPackEntry & e = entries[entry];
+    error = "invalid pack entry: ";
+    if ((uint64_t) e.nameOffset + e.nameLength >= header->nameSize ||
+        names[e.nameOffset + e.nameLength] != 0) {
+        error += "name out of range";
+        return false;
+    }
+    if (HashAssetName(names + e.nameOffset, e.nameLength) != e.nameHash) {
+        error += "wrong name hash";
+        return false;
+    }
+    uint32_t bucket = GetBucket(e.nameHash, header->bucketBits);
+    if ((entry > 0 && entries[entry - 1].nameHash > e.nameHash) ||
+        (uint32_t) entry < buckets[bucket] || (uint32_t) entry >= buckets[bucket + 1]) {
+        error += "not in hash order";
+        return false;
+    }
+    if (!IsInRange(e.dataOffset, e.storedSize, 1, header->fileSize)) {
+        error += "data out of range";
+        return false;
+    }
+
+    if (e.compression == ASSET_COMPRESSION_NONE) {
+        if (e.storedSize != e.size || e.blockCount != 0 ||
+            e.dataOffset % ASSET_PACK_ALIGNMENT != 0) {
+            error += "invalid stored data";
+            return false;
+        }
+        return true;
+    }
+    if (e.compression != ASSET_COMPRESSION_LZ4) {
+        error += "unknown compression";
+        return false;
+    }
+    uint64_t blockCount = ((uint64_t) e.size + header->blockSize - 1) / header->blockSize;
+    if (e.blockCount != blockCount ||
+        !IsInRange(e.firstBlock, e.blockCount, 1, header->blockCount)) {
+        error += "blocks out of range";
+        return false;
+    }
+    for (uint32_t block = e.firstBlock; block < e.firstBlock + e.blockCount; block++) {
+        if (!IsInRange(blocks[block].offset, blocks[block].storedSize, 1, e.storedSize)) {
+            error += "block out of range";
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Index of the entry with this name, or ASSET_PACK_NO_ENTRY
+ */
+int MyAssetPack::FindEntry(const char * name) const {
+
+    if (!header) {
+        return ASSET_PACK_NO_ENTRY;
+    }
+    size_t length = strlen(name);
+    uint32_t hash = HashAssetName(name, length);
+    uint32_t bucket = GetBucket(hash, header->bucketBits);
+    for (uint32_t entry = buckets[bucket]; entry < buckets[bucket + 1]; entry++) {
+        const AssetPackEntry & e = entries[entry];
+        if (e.nameHash == hash && e.nameLength == length &&
+            memcmp(names + e.nameOffset, name, length) == 0) {
+            return (int) entry;
+        }
+    }
+    return ASSET_PACK_NO_ENTRY;
+}
+
+const char * MyAssetPack::GetEntryName(int entry) const {
+
+    return names + entries[entry].nameOffset;
+}
+
+/**
+ * Contents of an uncompressed entry in place, ASSET_PACK_ALIGNMENT aligned relative to the
+ * start of the pack. NULL if the entry is compressed.
+ */
+const uint8_t * MyAssetPack::GetStoredData(int entry) const {
+
+    const AssetPackEntry & e = entries[entry];
+    if (e.compression != ASSET_COMPRESSION_NONE) {
+        return NULL;
+    }
+    return data + e.dataOffset;
+}
+
+int MyAssetPack::GetBlockCount(int entry) const {
+
+    return (int) entries[entry].blockCount;
+}
+
+/**
+ * Decompress blocks firstBlock up to endBlock of a compressed entry. Output holds the whole
+ * entry and each block goes to its own place in it, so calls for different blocks may run
+ * at the same time.
+ */
+bool MyAssetPack::DecompressBlocks(int entry, int firstBlock, int endBlock,
+                                   uint8_t * output) const {
+
+    const AssetPackEntry & e = entries[entry];
+    if (e.compression != ASSET_COMPRESSION_LZ4 || firstBlock < 0 ||
+        endBlock > (int) e.blockCount) {
+        return false;
+    }
+    const uint8_t * stored = data + e.dataOffset;
+    for (int block = firstBlock; block < endBlock; block++) {
+        const AssetPackBlock & b = blocks[e.firstBlock + block];
+        size_t offset = (size_t) block * header->blockSize;
+        size_t size = e.size - offset < header->blockSize ? e.size - offset : header->blockSize;
+        if (!LZ4Decompress(stored + b.offset, b.storedSize, output + offset, size)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Copy or decompress the contents of an entry into output
+ */
+bool MyAssetPack::ReadEntry(int entry, std::vector<uint8_t> & output) const {
+
+    const AssetPackEntry & e = entries[entry];
+    output.resize(e.size);
+    if (e.compression == ASSET_COMPRESSION_NONE) {
+        if (e.size) {
+            memcpy(output.data(), data + e.dataOffset, e.size);
+        }
+        return true;
+    }
+    return DecompressBlocks(entry, 0, (int) e.blockCount, output.data());
+}
@@ -0,0 +1,124 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+
+#ifndef MY_ASSET_PACK_H
+#define MY_ASSET_PACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#define ASSET_PACK_MAGIC        "CUBEPACK"
+#define ASSET_PACK_MAGIC_SIZE   8
+// packs of another version are rejected, the layout below changes only with it
+#define ASSET_PACK_VERSION      1
+// compressed entries are split into blocks of this size so they decompress in parallel
+#define ASSET_PACK_BLOCK_SIZE   (64 * 1024)
+// entries stored uncompressed start at a multiple of this in the pack, so that they can be
+// used in place, by SIMD loads or as GL upload sources
+#define ASSET_PACK_ALIGNMENT    64
+#define ASSET_PACK_MAX_BUCKET_BITS  20
+#define ASSET_PACK_NO_ENTRY     -1
+
+enum AssetCompression {
+    ASSET_COMPRESSION_NONE  = 0,
+    ASSET_COMPRESSION_LZ4   = 1
+};
+
+/*
+ * Layout of a pack, all fields are little-endian 32-bit words so that a pack mapped at a
+ * 4-byte aligned address is read in place. Offsets are from the start of the pack, which
+ * keeps packs under 4 GB.
+ */
+struct AssetPackHeader {
+    char        magic[ASSET_PACK_MAGIC_SIZE];
+    uint32_t    version;
+    uint32_t    fileSize;
+    uint32_t    entryCount;
+    uint32_t    bucketBits;     // lookup buckets by the top bits of the name hash
+    uint32_t    bucketOffset;   // (1 << bucketBits) + 1 entry indices
+    uint32_t    entryOffset;    // entries, sorted by name hash
+    uint32_t    blockOffset;    // blocks of the compressed entries
+    uint32_t    blockCount;
+    uint32_t    nameOffset;     // entry names, each followed by a 0
+    uint32_t    nameSize;
+    uint32_t    blockSize;      // decompressed size of every block but an entry's last
+    uint32_t    reserved[3];
+};
+
+struct AssetPackEntry {
+    uint32_t    nameHash;
+    uint32_t    nameOffset;     // in the names
+    uint32_t    nameLength;
+    uint32_t    compression;
+    uint32_t    dataOffset;     // entries with the same contents share their data
+    uint32_t    storedSize;
+    uint32_t    size;
+    uint32_t    firstBlock;     // blockCount blocks from here if compressed
+    uint32_t    blockCount;
+    uint32_t    contentHash[2]; // low and high words of HashAssetContent
+    uint32_t    reserved;
+};
+
+struct AssetPackBlock {
+    uint32_t    offset;         // from the entry's dataOffset
+    uint32_t    storedSize;
+};
+
+uint32_t    HashAssetName(const char * name, size_t length);
+uint64_t    HashAssetContent(const uint8_t * data, size_t size);
+
+/**
+ * Reads assets from a pack: one file holding many assets behind an index sorted by the
+ * hash of their names. A name is found in its bucket of the index, which holds one or two
+ * entries on average, so lookups do not depend on the number of assets.
+ *
+ * The pack is used where it lies, normally mapped from the APK. Entries stored
+ * uncompressed are handed out in place, LZ4 compressed ones are decompressed a block at a
+ * time, which lets the blocks of a large entry go to several threads. Open checks every
+ * offset of the index, so a truncated or corrupt pack is rejected rather than read out of
+ * bounds, and a corrupt block fails to decompress.
+ *
+ * Packs are made by tools/assetPacker.
+ */
+class MyAssetPack {
+public:
+    MyAssetPack();
+    bool    Open(const uint8_t * data, size_t size, std::string & error);
+    bool    IsOpen() const { return header != NULL; }
+    int     GetEntryCount() const { return header ? (int) header->entryCount : 0; }
+    int     FindEntry(const char * name) const;
+    const AssetPackEntry & GetEntry(int entry) const { return entries[entry]; }
+    const char *    GetEntryName(int entry) const;
+    const uint8_t * GetStoredData(int entry) const;
+    int     GetBlockCount(int entry) const;
+    bool    DecompressBlocks(int entry, int firstBlock, int endBlock, uint8_t * output) const;
+    bool    ReadEntry(int entry, std::vector<uint8_t> & output) const;
+
+private:
+    bool    CheckEntry(int entry, std::string & error) const;
+
+    const uint8_t *         data;
+    const AssetPackHeader * header;
+    const uint32_t *        buckets;
+    const AssetPackEntry *  entries;
+    const AssetPackBlock *  blocks;
+    const char *            names;
+};
+
+#endif //MY_ASSET_PACK_H
@@ -0,0 +1,390 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include "myClusteredLighting.h"
+#include "mySIMD.h"
+#include "misc.h"
+#include "myLogger.h"
+#include <math.h>
+#include <string.h>
+
+MyClusteredLighting::MyClusteredLighting() {
+
+    inverseProjectionMat = glm::mat4(1.0f);
+    tanHalfFovX = tanHalfFovY = 1;
+    memset(sliceDepth, 0, sizeof(sliceDepth));
+    sliceScale = sliceBias = 0;
+    memset(clusterMinX, 0, sizeof(clusterMinX));
+    memset(clusterMaxX, 0, sizeof(clusterMaxX));
+    memset(clusterMinY, 0, sizeof(clusterMinY));
+    memset(clusterMaxY, 0, sizeof(clusterMaxY));
+    memset(sliceDroppedLights, 0, sizeof(sliceDroppedLights));
+
+    clusterLightCounts.resize(CLUSTER_COUNT);
+    clusterLightScratch.resize(CLUSTER_COUNT * CLUSTER_MAX_LIGHTS);
+    clusterGrid.resize(2 * CLUSTER_COUNT);
+
+    resources = NULL;
+    clusterTexture = lightIndexTexture = lightTexture = GPU_NULL_HANDLE;
+    lightIndexTextureRows = lightTextureRows = 0;
+    memset(&stats, 0, sizeof(stats));
+}
+
+MyClusteredLighting::~MyClusteredLighting() {
+
+    if (resources) {
+        resources->Destroy(clusterTexture);
+        resources->Destroy(lightIndexTexture);
+        resources->Destroy(lightTexture);
+    }
+}
+
+/**
+ * Build the froxel grid from a perspective projection, called when the aspect ratio changes.
+ * Slices are spaced exponentially in depth so that froxels stay roughly cube-shaped.
+ */
+void MyClusteredLighting::SetProjection(const glm::mat4 & projectionMat, float nearPlane,
+                                        float farPlane) {
+
+    inverseProjectionMat = glm::inverse(projectionMat);
+    tanHalfFovX = 1.0f / projectionMat[0][0];
+    tanHalfFovY = 1.0f / projectionMat[1][1];
+
+    float maxDepth = fminf(farPlane, CLUSTER_MAX_DEPTH);
+    float logRatio = logf(maxDepth / nearPlane);
+    for (int slice = 0; slice <= CLUSTER_GRID_Z; slice++) {
+        sliceDepth[slice] = nearPlane * expf(logRatio * slice / CLUSTER_GRID_Z);
+    }
+    sliceDepth[CLUSTER_GRID_Z] = farPlane;
+    sliceScale = CLUSTER_GRID_Z / logRatio;
+    sliceBias = -CLUSTER_GRID_Z * logf(nearPlane) / logRatio;
+
+    // a froxel's x extent at depth d is its tile's NDC range times d * tanHalfFovX, so its
+    // bounds come from the slice's near or far depth depending on the sign
+    for (int slice = 0; slice < CLUSTER_GRID_Z; slice++) {
+        float nearDepth = sliceDepth[slice], farDepth = sliceDepth[slice + 1];
+        for (int x = 0; x < CLUSTER_GRID_X; x++) {
+            float ndcMin = 2.0f * x / CLUSTER_GRID_X - 1, ndcMax = 2.0f * (x + 1) / CLUSTER_GRID_X - 1;
+            clusterMinX[slice][x] = ndcMin * tanHalfFovX * (ndcMin < 0 ? farDepth : nearDepth);
+            clusterMaxX[slice][x] = ndcMax * tanHalfFovX * (ndcMax > 0 ? farDepth : nearDepth);
+        }
+        for (int y = 0; y < CLUSTER_GRID_Y; y++) {
+            float ndcMin = 2.0f * y / CLUSTER_GRID_Y - 1, ndcMax = 2.0f * (y + 1) / CLUSTER_GRID_Y - 1;
+            clusterMinY[slice][y] = ndcMin * tanHalfFovY * (ndcMin < 0 ? farDepth : nearDepth);
+            clusterMaxY[slice][y] = ndcMax * tanHalfFovY * (ndcMax > 0 ? farDepth : nearDepth);
+        }
+    }
+}
+
+void MyClusteredLighting::SetLights(const std::vector<PointLight> & lights) {
+
+    this->lights = lights;
+    size_t paddedCount = (lights.size() + 3) & ~3;
+    lightX.assign(paddedCount, 0);
+    lightY.assign(paddedCount, 0);
+    // padding lights sit behind the camera with no radius so that they never overlap a slice
+    lightDepth.assign(paddedCount, -1);
+    lightRadius.assign(paddedCount, 0);
+    tileMinX.resize(paddedCount);
+    tileMaxX.resize(paddedCount);
+    tileMinY.resize(paddedCount);
+    tileMaxY.resize(paddedCount);
+    lightData.resize(2 * lights.size());
+}
+
+/**
+ * Lowest and highest NDC coordinate of a view-space interval [minV, maxV] seen between
+ * depths nearDepth and farDepth, scaled by the tangent of the half field of view
+ */
+static void ProjectInterval(float minV, float maxV, float nearDepth, float farDepth,
+                            float tanHalfFov, float & ndcMin, float & ndcMax) {
+
+    ndcMin = minV / (tanHalfFov * (minV < 0 ? nearDepth : farDepth));
+    ndcMax = maxV / (tanHalfFov * (maxV > 0 ? nearDepth : farDepth));
+}
+
+static int16_t NDCToTile(float ndc, int gridSize) {
+
+    int tile = (int) floorf((ndc * 0.5f + 0.5f) * gridSize);
+    return (int16_t) glm::clamp(tile, -1, gridSize);
+}
+
+/**
+ * Transform the lights into view space and find the froxels that each of them reaches.
+ * Slices are independent, so each job fills the light lists of its own slices.
+ */
+void MyClusteredLighting::AssignLights(MyJobSystem * jobSystem, const glm::mat4 & viewMat) {
+
+    double startTimeMs = GetMonotonicTimeMs();
+    int lightCount = (int) lights.size();
+    float nearPlane = sliceDepth[0];
+
+    for (int i = 0; i < lightCount; i++) {
+        const PointLight & light = lights[i];
+        glm::vec3 viewPosition = glm::vec3(viewMat * glm::vec4(light.position, 1.0f));
+        lightX[i] = viewPosition.x;
+        lightY[i] = viewPosition.y;
+        lightDepth[i] = -viewPosition.z;
+        lightRadius[i] = light.radius;
+        lightData[2 * i] = glm::vec4(viewPosition, light.radius);
+        lightData[2 * i + 1] = glm::vec4(light.color, light.intensity);
+
+        // conservative tile bounds from the light's view-space box; lights that cross the
+        // near plane may cover any tile
+        float nearDepth = lightDepth[i] - light.radius, farDepth = lightDepth[i] + light.radius;
+        if (nearDepth <= nearPlane) {
+            tileMinX[i] = tileMinY[i] = 0;
+            tileMaxX[i] = CLUSTER_GRID_X - 1;
+            tileMaxY[i] = CLUSTER_GRID_Y - 1;
+            continue;
+        }
+        float ndcMin, ndcMax;
+        ProjectInterval(lightX[i] - light.radius, lightX[i] + light.radius, nearDepth, farDepth,
+                        tanHalfFovX, ndcMin, ndcMax);
+        tileMinX[i] = glm::max(NDCToTile(ndcMin, CLUSTER_GRID_X), (int16_t) 0);
+        tileMaxX[i] = glm::min(NDCToTile(ndcMax, CLUSTER_GRID_X), (int16_t) (CLUSTER_GRID_X - 1));
+        ProjectInterval(lightY[i] - light.radius, lightY[i] + light.radius, nearDepth, farDepth,
+                        tanHalfFovY, ndcMin, ndcMax);
+        tileMinY[i] = glm::max(NDCToTile(ndcMin, CLUSTER_GRID_Y), (int16_t) 0);
+        tileMaxY[i] = glm::min(NDCToTile(ndcMax, CLUSTER_GRID_Y), (int16_t) (CLUSTER_GRID_Y - 1));
+    }
+
+    if (jobSystem) {
+        jobSystem->ParallelFor(AssignJob, this, CLUSTER_GRID_Z, 1);
+    } else {
+        AssignJob(this, 0, CLUSTER_GRID_Z);
+    }
+
+    // pack the lists in cluster order, each cluster's texel holds its offset and count
+    memset(&stats, 0, sizeof(stats));
+    lightIndices.clear();
+    for (int cluster = 0; cluster < CLUSTER_COUNT; cluster++) {
+        int count = clusterLightCounts[cluster];
+        clusterGrid[2 * cluster] = (uint32_t) lightIndices.size();
+        clusterGrid[2 * cluster + 1] = (uint32_t) count;
+        if (count) {
+            const uint16_t * list = &clusterLightScratch[cluster * CLUSTER_MAX_LIGHTS];
+            lightIndices.insert(lightIndices.end(), list, list + count);
+            stats.nonEmptyClusters++;
+            stats.maxLightsPerCluster = glm::max(stats.maxLightsPerCluster, count);
+        }
+    }
+    for (int slice = 0; slice < CLUSTER_GRID_Z; slice++) {
+        stats.droppedLights += sliceDroppedLights[slice];
+    }
+    stats.lightCount = lightCount;
+    stats.lightIndexCount = (int) lightIndices.size();
+    stats.assignTimeMs = GetMonotonicTimeMs() - startTimeMs;
+}
+
+void MyClusteredLighting::AssignJob(void * data, int begin, int end) {
+
+    MyClusteredLighting * lighting = (MyClusteredLighting *) data;
+    for (int slice = begin; slice < end; slice++) {
+        lighting->AssignSlice(slice, lighting->sliceDroppedLights[slice]);
+    }
+}
+
+/**
+ * Four lights at a time are tested against the slice's depth range, then each light that
+ * overlaps it is tested against four froxels of a tile row at a time
+ */
+void MyClusteredLighting::AssignSlice(int slice, int & droppedLights) {
+
+    droppedLights = 0;
+    uint16_t * counts = &clusterLightCounts[slice * CLUSTER_GRID_X * CLUSTER_GRID_Y];
+    memset(counts, 0, CLUSTER_GRID_X * CLUSTER_GRID_Y * sizeof(uint16_t));
+
+    float nearDepth = sliceDepth[slice], farDepth = sliceDepth[slice + 1];
+    Float4 sliceNear = Splat4(nearDepth), sliceFar = Splat4(farDepth);
+    uint32_t overlaps[4];
+
+    for (size_t group = 0; group < lightDepth.size(); group += 4) {
+        Float4 depth = Load4(&lightDepth[group]);
+        Float4 radius = Load4(&lightRadius[group]);
+        Mask4 overlap = And4(Less4(Sub4(depth, radius), sliceFar),
+                             Less4(sliceNear, Add4(depth, radius)));
+        if (!AnyTrue4(overlap)) {
+            continue;
+        }
+        StoreMask4(overlaps, overlap);
+
+        for (int lane = 0; lane < 4; lane++) {
+            int light = (int) group + lane;
+            if (!overlaps[lane] || tileMinX[light] > tileMaxX[light] ||
+                tileMinY[light] > tileMaxY[light]) {
+                continue;
+            }
+
+            // squared distance from the light to a froxel's box, one axis at a time
+            float lightDepthValue = lightDepth[light];
+            float dz = fmaxf(nearDepth - lightDepthValue, 0) + fmaxf(lightDepthValue - farDepth, 0);
+            float radiusSquared = lightRadius[light] * lightRadius[light];
+            float remaining = radiusSquared - dz * dz;
+            Float4 centerX = Splat4(lightX[light]);
+            Float4 zero = Splat4(0);
+
+            for (int y = tileMinY[light]; y <= tileMaxY[light]; y++) {
+                float dy = fmaxf(clusterMinY[slice][y] - lightY[light], 0) +
+                           fmaxf(lightY[light] - clusterMaxY[slice][y], 0);
+                float remainingRow = remaining - dy * dy;
+                if (remainingRow < 0) {
+                    continue;
+                }
+                Float4 limit = Splat4(remainingRow);
+                uint16_t * rowCounts = counts + y * CLUSTER_GRID_X;
+                int rowCluster = (slice * CLUSTER_GRID_Y + y) * CLUSTER_GRID_X;
+
+                for (int x = tileMinX[light] & ~3; x <= tileMaxX[light]; x += 4) {
+                    Float4 dx = Add4(Max4(Sub4(Load4(&clusterMinX[slice][x]), centerX), zero),
+                                     Max4(Sub4(centerX, Load4(&clusterMaxX[slice][x])), zero));
+                    Mask4 inside = Less4(Mul4(dx, dx), limit);
+                    if (!AnyTrue4(inside)) {
+                        continue;
+                    }
+                    uint32_t hits[4];
+                    StoreMask4(hits, inside);
+                    for (int i = 0; i < 4; i++) {
+                        int tileX = x + i;
+                        if (!hits[i] || tileX < tileMinX[light] || tileX > tileMaxX[light]) {
+                            continue;
+                        }
+                        if (rowCounts[tileX] == CLUSTER_MAX_LIGHTS) {
+                            droppedLights++;
+                            continue;
+                        }
+                        int cluster = rowCluster + tileX;
+                        clusterLightScratch[cluster * CLUSTER_MAX_LIGHTS + rowCounts[tileX]++] =
+                                (uint16_t) light;
+                    }
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Allocate the textures, needs the GL context. Integer and 32-bit float textures cannot be
+ * filtered, and texelFetch does not need it anyway. Every frame rewrites the textures, so
+ * resources keeps no copies and restores them at their last size.
+ */
+void MyClusteredLighting::CreateGLTextures(MyGPUResources * resources) {
+
+    this->resources = resources;
+    GPUTextureDesc desc;
+    desc.minFilter = desc.magFilter = GL_NEAREST;
+    desc.wrap = GL_CLAMP_TO_EDGE;
+
+    desc.internalFormat = GL_RG32UI;
+    desc.format = GL_RG_INTEGER;
+    desc.type = GL_UNSIGNED_INT;
+    desc.width = CLUSTER_GRID_X * CLUSTER_GRID_Y;
+    desc.height = CLUSTER_GRID_Z;
+    clusterTexture = resources->CreateTexture(desc, NULL, false);
+
+    // the lists get their height in the first Upload
+    desc.internalFormat = GL_R16UI;
+    desc.format = GL_RED_INTEGER;
+    desc.type = GL_UNSIGNED_SHORT;
+    desc.width = LIGHT_INDEX_TEXTURE_WIDTH;
+    desc.height = 0;
+    lightIndexTexture = resources->CreateTexture(desc, NULL, false);
+
+    desc.internalFormat = GL_RGBA32F;
+    desc.format = GL_RGBA;
+    desc.type = GL_FLOAT;
+    desc.width = LIGHT_TEXTURE_WIDTH;
+    lightTexture = resources->CreateTexture(desc, NULL, false);
+
+    lightIndexTextureRows = lightTextureRows = 0;
+    CheckGLError("MyClusteredLighting::CreateGLTextures");
+}
+
+/**
+ * Point the lighting samplers of a program that includes the clustered lighting shader at
+ * their texture units. Sampler uniforms are program state, so this is needed once per
+ * program and again when a lost context brought the program back.
+ */
+void MyClusteredLighting::SetProgram(GLuint programID) {
+
+    glUseProgram(programID);
+    glUniform1i(glGetUniformLocation(programID, "lightData"), LIGHT_TEXTURE_UNIT);
+    glUniform1i(glGetUniformLocation(programID, "clusterGrid"), CLUSTER_TEXTURE_UNIT);
+    glUniform1i(glGetUniformLocation(programID, "lightIndices"), LIGHT_INDEX_TEXTURE_UNIT);
+    glUseProgram(0);
+    CheckGLError("MyClusteredLighting::SetProgram");
+}
+
+/**
+ * Copy this frame's cluster grid, light lists and lights to their textures, growing the
+ * texture height when the lists no longer fit
+ */
+void MyClusteredLighting::Upload() {
+
+    glBindTexture(GL_TEXTURE_2D, resources->GetName(clusterTexture));
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, CLUSTER_GRID_X * CLUSTER_GRID_Y, CLUSTER_GRID_Z,
+                    GL_RG_INTEGER, GL_UNSIGNED_INT, &clusterGrid[0]);
+
+    int rows = glm::max(1, (int) (lightIndices.size() + LIGHT_INDEX_TEXTURE_WIDTH - 1) /
+                           LIGHT_INDEX_TEXTURE_WIDTH);
+    lightIndices.resize(rows * LIGHT_INDEX_TEXTURE_WIDTH, 0);
+    if (rows > lightIndexTextureRows) {
+        resources->TexImage(lightIndexTexture, LIGHT_INDEX_TEXTURE_WIDTH, rows, &lightIndices[0]);
+        lightIndexTextureRows = rows;
+    } else {
+        glBindTexture(GL_TEXTURE_2D, resources->GetName(lightIndexTexture));
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, LIGHT_INDEX_TEXTURE_WIDTH, rows, GL_RED_INTEGER,
+                        GL_UNSIGNED_SHORT, &lightIndices[0]);
+    }
+
+    rows = glm::max(1, (int) (lightData.size() + LIGHT_TEXTURE_WIDTH - 1) / LIGHT_TEXTURE_WIDTH);
+    lightData.resize(rows * LIGHT_TEXTURE_WIDTH, glm::vec4(0));
+    if (rows > lightTextureRows) {
+        resources->TexImage(lightTexture, LIGHT_TEXTURE_WIDTH, rows, &lightData[0]);
+        lightTextureRows = rows;
+    } else {
+        glBindTexture(GL_TEXTURE_2D, resources->GetName(lightTexture));
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, LIGHT_TEXTURE_WIDTH, rows, GL_RGBA, GL_FLOAT,
+                        &lightData[0]);
+    }
+    lightData.resize(2 * lights.size());
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    CheckGLError("MyClusteredLighting::Upload");
+}
+
+/**
+ * Bind the textures and fill the froxel parameters of the frame uniforms, viewport is the
+ * size being rendered to
+ */
+void MyClusteredLighting::Bind(int viewportWidth, int viewportHeight,
+                               FrameUniforms & frameUniforms) {
+
+    glActiveTexture(GL_TEXTURE0 + LIGHT_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, resources->GetName(lightTexture));
+    glActiveTexture(GL_TEXTURE0 + CLUSTER_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, resources->GetName(clusterTexture));
+    glActiveTexture(GL_TEXTURE0 + LIGHT_INDEX_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, resources->GetName(lightIndexTexture));
+    glActiveTexture(GL_TEXTURE0);
+
+    frameUniforms.inverseProjectionMat = inverseProjectionMat;
+    frameUniforms.viewportSize = glm::vec4(viewportWidth, viewportHeight, 0, 0);
+    frameUniforms.tileScale = glm::vec4((float) CLUSTER_GRID_X / viewportWidth,
+                                        (float) CLUSTER_GRID_Y / viewportHeight, 0, 0);
+    frameUniforms.sliceParams = glm::vec4(sliceScale, sliceBias, 0, 0);
+    CheckGLError("MyClusteredLighting::Bind");
+}
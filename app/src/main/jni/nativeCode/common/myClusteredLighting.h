@@ -0,0 +1,120 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#ifndef MY_CLUSTERED_LIGHTING_H
+#define MY_CLUSTERED_LIGHTING_H
+
+#include "myGLFunctions.h"
+#include "myGLM.h"
+#include "myGPUResources.h"
+#include "myJobSystem.h"
+#include "myUniformBuffers.h"
+#include <stdint.h>
+#include <vector>
+
+// froxel grid: screen tiles times exponentially spaced depth slices, must match the shader
+#define CLUSTER_GRID_X          16
+#define CLUSTER_GRID_Y          9
+#define CLUSTER_GRID_Z          24
+#define CLUSTER_COUNT           (CLUSTER_GRID_X * CLUSTER_GRID_Y * CLUSTER_GRID_Z)
+// slices stop at this depth, the last one extends to the far plane
+#define CLUSTER_MAX_DEPTH       100.0f
+// lights beyond this many in one cluster are dropped and counted in the stats
+#define CLUSTER_MAX_LIGHTS      128
+// width of the light and light index textures in texels, each light takes 2 texels
+#define LIGHT_TEXTURE_WIDTH     1024
+#define LIGHT_INDEX_TEXTURE_WIDTH   1024
+// texture units used by the lighting textures, unit 0 is left for materials
+#define LIGHT_TEXTURE_UNIT          1
+#define CLUSTER_TEXTURE_UNIT        2
+#define LIGHT_INDEX_TEXTURE_UNIT    3
+
+struct PointLight {
+    glm::vec3   position;   // world space
+    float       radius;     // no light reaches beyond this distance
+    glm::vec3   color;
+    float       intensity;
+};
+
+struct ClusteredLightingStats {
+    int     lightCount;
+    int     lightIndexCount;    // sum of the clusters' light counts
+    int     nonEmptyClusters;
+    int     maxLightsPerCluster;
+    int     droppedLights;      // over CLUSTER_MAX_LIGHTS
+    double  assignTimeMs;
+};
+
+/**
+ * Clustered forward lighting: the view frustum is split into froxels, every frame the CPU
+ * finds the lights that reach each froxel and uploads the lists as textures, and the
+ * fragment shader loops only over the lights of its own froxel.
+ *
+ * Needs GLES 3 for float and integer textures read with texelFetch, the froxel parameters
+ * reach the shader through the FrameData uniform block.
+ */
+class MyClusteredLighting {
+public:
+    MyClusteredLighting();
+    ~MyClusteredLighting();
+    void    SetProjection(const glm::mat4 & projectionMat, float nearPlane, float farPlane);
+    void    SetLights(const std::vector<PointLight> & lights);
+    void    AssignLights(MyJobSystem * jobSystem, const glm::mat4 & viewMat);
+
+    void    CreateGLTextures(MyGPUResources * resources);
+    void    SetProgram(GLuint programID);
+    void    Upload();
+    void    Bind(int viewportWidth, int viewportHeight, FrameUniforms & frameUniforms);
+    const ClusteredLightingStats & GetStats() const { return stats; }
+
+private:
+    static void AssignJob(void * data, int begin, int end);
+    void    AssignSlice(int slice, int & droppedLights);
+
+    // view frustum
+    glm::mat4   inverseProjectionMat;
+    float       tanHalfFovX, tanHalfFovY;
+    float       sliceDepth[CLUSTER_GRID_Z + 1];
+    float       sliceScale, sliceBias; // slice = log(depth) * sliceScale + sliceBias
+
+    // view-space bounds of each froxel's x and y extent, per slice and tile column or row
+    float   clusterMinX[CLUSTER_GRID_Z][CLUSTER_GRID_X], clusterMaxX[CLUSTER_GRID_Z][CLUSTER_GRID_X];
+    float   clusterMinY[CLUSTER_GRID_Z][CLUSTER_GRID_Y], clusterMaxY[CLUSTER_GRID_Z][CLUSTER_GRID_Y];
+
+    std::vector<PointLight> lights;
+    // view-space lights as structure-of-arrays padded to a multiple of 4, depth is -z
+    std::vector<float>  lightX, lightY, lightDepth, lightRadius;
+    std::vector<int16_t> tileMinX, tileMaxX, tileMinY, tileMaxY; // conservative screen bounds
+
+    // each job writes only its own slices' lists, then they are packed in cluster order
+    std::vector<uint16_t>   clusterLightCounts;
+    std::vector<uint16_t>   clusterLightScratch; // CLUSTER_MAX_LIGHTS per cluster
+    int     sliceDroppedLights[CLUSTER_GRID_Z];
+
+    // texture contents: (offset, count) per cluster, packed light indices, and 2 texels
+    // per light, view-space position and radius then color and intensity
+    std::vector<uint32_t>   clusterGrid;
+    std::vector<uint16_t>   lightIndices;
+    std::vector<glm::vec4>  lightData;
+
+    MyGPUResources * resources;
+    GPUHandle clusterTexture, lightIndexTexture, lightTexture;
+    int     lightIndexTextureRows, lightTextureRows;
+
+    ClusteredLightingStats stats;
+};
+
+#endif //MY_CLUSTERED_LIGHTING_H
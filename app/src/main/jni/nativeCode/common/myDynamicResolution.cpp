@@ -0,0 +1,301 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include "myDynamicResolution.h"
+#include "myShader.h"
+#include "myLogger.h"
+#include "myGLM.h"
+#include <math.h>
+#include <string.h>
+
+MyDynamicResolution::MyDynamicResolution(float targetFrameTimeMs, float minScale) {
+
+    this->targetFrameTimeMs = targetFrameTimeMs;
+    this->minScale = minScale;
+    maxScale = 1.0f;
+    vsyncLimited = false;
+    scale = pendingScale = 1.0f;
+    smoothedFrameTimeMs = 0;
+    framesSinceChange = framesOnTarget = 0;
+    probeFrames = DYNRES_PROBE_FRAMES;
+    probeFromScale = 0;
+    windowWidth = windowHeight = renderWidth = renderHeight = 0;
+    samples = maxSamples = 0;
+    sceneTarget = resolvedTarget = -1;
+    resources = NULL;
+    upscaleProgram = quadBuffer = GPU_NULL_HANDLE;
+    positionAttribute = 0;
+    textureLocation = uvScaleLocation = uvMaxLocation = -1;
+    ResetStats();
+}
+
+MyDynamicResolution::~MyDynamicResolution() {
+
+    if (resources) {
+        resources->Destroy(upscaleProgram);
+        resources->Destroy(quadBuffer);
+    }
+}
+
+void MyDynamicResolution::ResetStats() {
+
+    memset(&stats, 0, sizeof(stats));
+    stats.minScale = stats.maxScale = scale;
+}
+
+/**
+ * Query MSAA support, or load the upscale program on GLES 2. Needs the GL context.
+ */
+void MyDynamicResolution::Init(MyGPUResources * resources) {
+
+    this->resources = resources;
+    if (IsGLES3Supported()) {
+        glGetIntegerv(GL_MAX_SAMPLES, &maxSamples);
+        return;
+    }
+
+    upscaleProgram = resources->LoadProgram("shaders/upscale.vsh", "shaders/upscale.fsh");
+    GetUpscaleLocations();
+
+    // full-screen quad as a triangle strip
+    const GLfloat quad[] = {-1, -1, 1, -1, -1, 1, 1, 1};
+    quadBuffer = resources->CreateBuffer(GL_ARRAY_BUFFER, GL_STATIC_DRAW, true);
+    resources->BufferData(quadBuffer, sizeof(quad), quad);
+    CheckGLError("MyDynamicResolution::Init");
+}
+
+void MyDynamicResolution::GetUpscaleLocations() {
+
+    GLuint upscaleProgramID = resources->GetName(upscaleProgram);
+    positionAttribute = GetAttributeLocation(upscaleProgramID, "vertexPosition");
+    textureLocation = GetUniformLocation(upscaleProgramID, "sceneTexture");
+    uvScaleLocation = GetUniformLocation(upscaleProgramID, "uvScale");
+    uvMaxLocation = GetUniformLocation(upscaleProgramID, "uvMax");
+}
+
+/**
+ * Called once resources restored the upscale program and quad in a new context, the
+ * targets are the render graph's
+ */
+void MyDynamicResolution::RestoreGLObjects() {
+
+    if (upscaleProgram) {
+        GetUpscaleLocations();
+    }
+}
+
+/**
+ * Called when the surface changes, the size of the target follows from the next frame
+ */
+void MyDynamicResolution::SetWindowSize(int width, int height) {
+
+    windowWidth = width;
+    windowHeight = height;
+    UpdateRenderSize();
+}
+
+void MyDynamicResolution::SetTargetFrameTime(float targetFrameTimeMs) {
+
+    this->targetFrameTimeMs = targetFrameTimeMs;
+}
+
+/**
+ * Upper limit for the scale, lowered by the quality governor when it trades resolution
+ * for frame time. Takes effect at the next BeginFrame.
+ */
+void MyDynamicResolution::SetMaxScale(float maxScale) {
+
+    this->maxScale = glm::clamp(maxScale, minScale, 1.0f);
+    pendingScale = glm::min(pendingScale, this->maxScale);
+}
+
+/**
+ * Number of MSAA samples, clamped to what the driver supports. Multisampled targets need
+ * GLES 3, so GLES 2 always renders without MSAA.
+ */
+void MyDynamicResolution::SetSamples(int samples) {
+
+    this->samples = glm::clamp(samples, 0, (int) maxSamples);
+}
+
+void MyDynamicResolution::UpdateRenderSize() {
+
+    // keep at least one pixel, and the window's aspect ratio so the camera needs no change
+    renderWidth = glm::max(1, (int) (windowWidth * scale + 0.5f));
+    renderHeight = glm::max(1, (int) (windowHeight * scale + 0.5f));
+}
+
+/**
+ * Feed the time taken by the last frame. Scale follows the smoothed time: it drops as soon
+ * as frames are over the target and rises only once they are well under it.
+ */
+void MyDynamicResolution::AddFrameTime(float frameTimeMs) {
+
+    if (smoothedFrameTimeMs == 0) {
+        smoothedFrameTimeMs = frameTimeMs;
+    } else {
+        smoothedFrameTimeMs += DYNRES_SMOOTHING * (frameTimeMs - smoothedFrameTimeMs);
+    }
+    stats.smoothedFrameTimeMs = smoothedFrameTimeMs;
+
+    framesSinceChange++;
+    if (framesSinceChange < DYNRES_SETTLE_FRAMES) {
+        return;
+    }
+
+    // pixel cost grows with the square of the scale
+    float newScale = scale;
+    if (smoothedFrameTimeMs > targetFrameTimeMs) {
+        if (probeFromScale > 0) {
+            // the probe missed a refresh, go back and wait longer before the next one
+            newScale = probeFromScale;
+            probeFrames = glm::min(2 * probeFrames, DYNRES_MAX_PROBE_FRAMES);
+        } else {
+            newScale = scale * sqrtf(targetFrameTimeMs / smoothedFrameTimeMs);
+            newScale = glm::max(newScale, scale - DYNRES_MAX_STEP_DOWN);
+            probeFrames = DYNRES_PROBE_FRAMES;
+        }
+        probeFromScale = 0;
+        framesOnTarget = 0;
+    } else if (!vsyncLimited && smoothedFrameTimeMs < DYNRES_RAISE_THRESHOLD * targetFrameTimeMs) {
+        newScale = scale * sqrtf(DYNRES_RAISE_THRESHOLD * targetFrameTimeMs / smoothedFrameTimeMs);
+        newScale = glm::min(newScale, scale + DYNRES_MAX_STEP_UP);
+    } else if (vsyncLimited && scale < maxScale) {
+        probeFromScale = 0;
+        if (++framesOnTarget >= probeFrames) {
+            probeFromScale = scale;
+            newScale = scale + DYNRES_SCALE_QUANTUM;
+            framesOnTarget = 0;
+        }
+    }
+
+    // round toward the current scale so that a step smaller than a quantum is no step
+    if (newScale < scale) {
+        newScale = ceilf(newScale / DYNRES_SCALE_QUANTUM - 0.001f) * DYNRES_SCALE_QUANTUM;
+        newScale = glm::min(newScale, scale - DYNRES_SCALE_QUANTUM);
+    } else {
+        newScale = floorf(newScale / DYNRES_SCALE_QUANTUM + 0.001f) * DYNRES_SCALE_QUANTUM;
+    }
+    newScale = glm::clamp(newScale, minScale, maxScale);
+    if (newScale != scale) {
+        pendingScale = newScale;
+    }
+}
+
+/**
+ * Apply a pending scale change, call before declaring the frame's passes
+ */
+void MyDynamicResolution::BeginFrame() {
+
+    if (pendingScale != scale) {
+        scale = pendingScale;
+        UpdateRenderSize();
+        framesSinceChange = framesOnTarget = 0;
+        stats.scaleChanges++;
+    }
+
+    stats.frames++;
+    stats.scaleSum += scale;
+    stats.minScale = glm::min(stats.minScale, scale);
+    stats.maxScale = glm::max(stats.maxScale, scale);
+    int bin = glm::min((int) (scale * DYNRES_HISTOGRAM_BINS), DYNRES_HISTOGRAM_BINS - 1);
+    stats.framesAtScale[bin]++;
+}
+
+/**
+ * Add the passes that take the scene's window-sized target to the window: an MSAA resolve
+ * if it is multisampled, then the upscale. The scene pass draws into the lower-left
+ * render width by render height. The window's depth is not used by any of them, the upscale
+ * declares it so that it is invalidated rather than loaded and stored.
+ */
+void MyDynamicResolution::AddPasses(MyRenderGraph & graph, int sceneColor, int window,
+                                    int windowDepth) {
+
+    sceneTarget = resolvedTarget = sceneColor;
+    // a multisample resolve cannot scale and the window's format may differ from ours,
+    // so resolve into a single-sampled target first
+    if (samples > 0) {
+        resolvedTarget = graph.CreateTarget("resolved color",
+                                            RenderTargetDesc(windowWidth, windowHeight,
+                                                             GL_RGBA8));
+        int resolve = graph.AddPass("resolve", ResolvePass, this);
+        graph.Read(resolve, sceneColor);
+        graph.Write(resolve, resolvedTarget, RENDER_LOAD_DONT_CARE);
+    }
+    // both passes cover their whole target, so nothing needs loading
+    int upscale = graph.AddPass("upscale", UpscalePass, this);
+    graph.Read(upscale, resolvedTarget);
+    graph.Write(upscale, window, RENDER_LOAD_DONT_CARE);
+    graph.Write(upscale, windowDepth, RENDER_LOAD_DONT_CARE, RENDER_STORE_DONT_CARE);
+}
+
+void MyDynamicResolution::ResolvePass(void * data, MyRenderGraph & graph, int pass) {
+
+    MyDynamicResolution * self = (MyDynamicResolution *) data;
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, graph.GetFramebuffer(self->sceneTarget));
+    glBlitFramebuffer(0, 0, self->renderWidth, self->renderHeight, 0, 0, self->renderWidth,
+                      self->renderHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+}
+
+void MyDynamicResolution::UpscalePass(void * data, MyRenderGraph & graph, int pass) {
+
+    MyDynamicResolution * self = (MyDynamicResolution *) data;
+    self->Upscale(graph.GetFramebuffer(self->resolvedTarget),
+                  graph.GetTexture(self->resolvedTarget));
+}
+
+/**
+ * Scale the rendered part of the target to the window, which is bound
+ */
+void MyDynamicResolution::Upscale(GLuint framebuffer, GLuint texture) {
+
+    if (IsGLES3Supported()) {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        if (renderWidth == windowWidth && renderHeight == windowHeight) {
+            glBlitFramebuffer(0, 0, windowWidth, windowHeight, 0, 0, windowWidth, windowHeight,
+                              GL_COLOR_BUFFER_BIT, GL_NEAREST);
+            return;
+        }
+        // linear filtering at the far edges of the source would blend in the pixels beyond
+        // them, so the last row and column are left out at the cost of a slight stretch
+        glBlitFramebuffer(0, 0, glm::max(1, renderWidth - 1), glm::max(1, renderHeight - 1),
+                          0, 0, windowWidth, windowHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+        return;
+    }
+
+    glDisable(GL_DEPTH_TEST);
+
+    glUseProgram(resources->GetName(upscaleProgram));
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glUniform1i(textureLocation, 0);
+    // map the quad onto the rendered corner, and stop half a texel short of its far edges
+    // so that filtering never blends in pixels outside it
+    glUniform2f(uvScaleLocation, (float) renderWidth / windowWidth,
+                (float) renderHeight / windowHeight);
+    glUniform2f(uvMaxLocation, (renderWidth - 0.5f) / windowWidth,
+                (renderHeight - 0.5f) / windowHeight);
+
+    glBindBuffer(GL_ARRAY_BUFFER, resources->GetName(quadBuffer));
+    glEnableVertexAttribArray(positionAttribute);
+    glVertexAttribPointer(positionAttribute, 2, GL_FLOAT, GL_FALSE, 0, 0);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    glDisableVertexAttribArray(positionAttribute);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glEnable(GL_DEPTH_TEST);
+}
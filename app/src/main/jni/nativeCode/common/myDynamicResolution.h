@@ -0,0 +1,114 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#ifndef MY_DYNAMIC_RESOLUTION_H
+#define MY_DYNAMIC_RESOLUTION_H
+
+#include "myGLFunctions.h"
+#include "myGPUResources.h"
+#include "myRenderGraph.h"
+
+// weight of the newest frame time in the moving average
+#define DYNRES_SMOOTHING        0.1f
+// frames to wait after a scale change before judging the new scale
+#define DYNRES_SETTLE_FRAMES    30
+// resolution is raised only once frames are this much faster than the target, so that a
+// scale that just fits is kept instead of oscillating around it
+#define DYNRES_RAISE_THRESHOLD  0.8f
+// largest scale change per step, lowering is quicker than raising
+#define DYNRES_MAX_STEP_DOWN    0.15f
+#define DYNRES_MAX_STEP_UP      0.05f
+// scales are rounded down to a multiple of this
+#define DYNRES_SCALE_QUANTUM    (1.0f / 32)
+// with vsync-limited frame times, try a higher scale after this many frames on target,
+// doubling the wait up to the maximum each time a try fails
+#define DYNRES_PROBE_FRAMES     120
+#define DYNRES_MAX_PROBE_FRAMES 1920
+// bins of the scale histogram, each covers 1 / DYNRES_HISTOGRAM_BINS of the range 0 to 1
+#define DYNRES_HISTOGRAM_BINS   10
+
+struct DynamicResolutionStats {
+    int     frames;         // since the last ResetStats
+    int     scaleChanges;
+    float   minScale, maxScale;
+    float   scaleSum;       // divide by frames for the average
+    float   smoothedFrameTimeMs;
+    int     framesAtScale[DYNRES_HISTOGRAM_BINS];
+};
+
+/**
+ * Renders the scene into an offscreen target whose size follows the frame time, then
+ * upscales it to the window. The scale applies to width and height alike, so the shaded
+ * pixel count goes with its square.
+ *
+ * The render graph allocates the target at window size and smaller scales use its
+ * lower-left corner, so changing the scale never reallocates. At scale 1 without MSAA the
+ * scene is drawn straight to the window. With MSAA, on GLES 3 only, a multisampled target
+ * is resolved first.
+ */
+class MyDynamicResolution {
+public:
+    MyDynamicResolution(float targetFrameTimeMs, float minScale);
+    ~MyDynamicResolution();
+    void    Init(MyGPUResources * resources);
+    void    RestoreGLObjects();
+    void    SetWindowSize(int width, int height);
+    void    SetVsyncLimited(bool vsyncLimited) { this->vsyncLimited = vsyncLimited; }
+    void    SetTargetFrameTime(float targetFrameTimeMs);
+    void    SetMaxScale(float maxScale);
+    void    SetSamples(int samples);
+    int     GetSamples() const { return samples; }
+    void    AddFrameTime(float frameTimeMs);
+    void    BeginFrame();
+    bool    IsRenderingOffscreen() const { return scale < 1.0f || samples > 0; }
+    void    AddPasses(MyRenderGraph & graph, int sceneColor, int window, int windowDepth);
+    float   GetScale() const { return scale; }
+    int     GetRenderWidth() const { return renderWidth; }
+    int     GetRenderHeight() const { return renderHeight; }
+    const DynamicResolutionStats & GetStats() const { return stats; }
+    void    ResetStats();
+
+private:
+    static void ResolvePass(void * data, MyRenderGraph & graph, int pass);
+    static void UpscalePass(void * data, MyRenderGraph & graph, int pass);
+    void    GetUpscaleLocations();
+    void    UpdateRenderSize();
+    void    Upscale(GLuint framebuffer, GLuint texture);
+
+    float   targetFrameTimeMs, minScale, maxScale;
+    // vsync-limited times never show headroom below the refresh interval, so the scale is
+    // raised by periodically probing instead
+    bool    vsyncLimited;
+    float   scale, pendingScale; // pendingScale is applied at the next BeginFrame
+    float   smoothedFrameTimeMs;
+    int     framesSinceChange, framesOnTarget;
+    int     probeFrames;
+    float   probeFromScale; // scale before an unconfirmed probe, 0 if there is none
+
+    int     windowWidth, windowHeight;
+    int     renderWidth, renderHeight;
+    GLint   samples, maxSamples;
+    int     sceneTarget, resolvedTarget; // in the graph of this frame, the same without MSAA
+    // GLES 2 has no glBlitFramebuffer, so the target is drawn as a textured quad
+    MyGPUResources * resources;
+    GPUHandle upscaleProgram, quadBuffer;
+    GLuint  positionAttribute;
+    GLint   textureLocation, uvScaleLocation, uvMaxLocation;
+
+    DynamicResolutionStats stats;
+};
+
+#endif //MY_DYNAMIC_RESOLUTION_H
@@ -26,7 +26,7 @@ MyGLCamera::MyGLCamera(
         float farPlaneDistance) {
 
     // camera position is fixed
-    glm::vec3 cameraPosition = glm::vec3(0, 0, zPosition);
+    cameraPosition = glm::vec3(0, 0, zPosition);
     viewMat = glm::lookAt(cameraPosition,        // Camera location in World Space
                           glm::vec3(0, 0, -1),   // direction in which camera it is pointed
                           glm::vec3(0, 1, 0));   // camera is pointing up
@@ -35,13 +35,9 @@ MyGLCamera::MyGLCamera(
     this->farPlaneDistance = farPlaneDistance;
     this->FOV       = FOV;
 
-    // 6DOF describing model's position
-    deltaX = deltaY = deltaZ = 0;                  // translations
-    modelQuaternion = glm::quat(glm::vec3(0,0,0)); // rotation
-
-    modelMat        = glm::mat4(1.0f);
-    translateMat    = glm::mat4(1.0f);
-    rotateMat       = glm::mat4(1.0f);
+    // 6DOF describing model's position: MyTransform starts at origin with no rotation
+    projectionMat = glm::mat4(1.0f);
+    projectionViewMat = viewMat;
     mvpMat = glm::mat4(1.0f); // projection is not known -> initialize MVP to identity
 }
 
@@ -50,7 +46,6 @@ MyGLCamera::MyGLCamera(
  */
 void MyGLCamera::SetAspectRatio(float aspect) {
 
-    glm::mat4 projectionMat;
     projectionMat = glm::perspective(FOV * float(M_PI / 180), // camera's field-of-view
                                      aspect,                  // camera's aspect ratio
                                      nearPlaneDistance,       // distance to the near plane
@@ -60,40 +55,47 @@ void MyGLCamera::SetAspectRatio(float aspect) {
 
 }
 
-/**
- * Model's position has 6 degrees-of-freedom: 3 for x-y-z locations and
- * 3 for alpha-beta-gamma Euler angles
- * Convert euler angles to quaternion and update MVP
- */
-void MyGLCamera::SetModelPosition(std::vector<float> modelPosition) {
-
-    deltaX = modelPosition[0];
-    deltaY = modelPosition[1];
-    deltaZ = modelPosition[2];
-    float pitchAngle = modelPosition[3];
-    float yawAngle   = modelPosition[4];
-    float rollAngle  = modelPosition[5];
+void MyGLCamera::SetModelTransform(const MyTransform & transform) {
 
-    modelQuaternion = glm::quat(glm::vec3(pitchAngle, yawAngle, rollAngle));
-    rotateMat = glm::toMat4(modelQuaternion);
+    modelTransform = transform;
     ComputeMVPMatrix();
 }
 
 
 /**
- * Compute the translation matrix from x-y-z position and rotation matrix from
- * quaternion describing the rotation
+ * Expand the model's quaternion and x-y-z position into a 3x4 affine matrix,
  * MVP = Projection * View * (Translation * Rotation)
  */
 void MyGLCamera::ComputeMVPMatrix() {
 
-    translateMat = glm::mat4(1, 0, 0, 0,                  // col0
-                             0, 1, 0, 0,	              // col1
-                             0, 0, 1, 0,	              // col2
-                             deltaX, deltaY, deltaZ, 1);  // col3
+    mvpMat = MultiplyAffine(projectionViewMat, modelTransform.ToAffine());
+}
+
+/**
+ * Distance from the camera to the model's origin, used to pick the model's level of detail
+ */
+float MyGLCamera::GetModelDistance() const {
 
-    modelMat    = translateMat * rotateMat;
-    mvpMat = projectionViewMat * modelMat;
+    return glm::length(modelTransform.translation - cameraPosition);
+}
+
+/**
+ * Distance of a point from the camera along the view direction, 0 at the camera and 1 at
+ * the far plane. Used to sort draws front to back.
+ */
+float MyGLCamera::GetNormalizedViewDepth(glm::vec3 modelSpacePoint) const {
+
+    // w of the projected point is its depth in view space
+    float viewDepth = (mvpMat * glm::vec4(modelSpacePoint, 1.0f)).w;
+    return glm::clamp(viewDepth / farPlaneDistance, 0.0f, 1.0f);
+}
+
+/**
+ * Camera's location in the model's own coordinates, used for culling in model space
+ */
+glm::vec3 MyGLCamera::GetCameraPositionInModelSpace() const {
+
+    return modelTransform.InverseTransformPoint(cameraPosition);
 }
 
 /**
@@ -101,15 +103,15 @@ void MyGLCamera::ComputeMVPMatrix() {
  */
 void MyGLCamera::ScaleModel(float scaleFactor) {
 
-    deltaZ += SCALE_TO_Z_TRANSLATION * (scaleFactor - 1);
+    modelTransform.translation.z += SCALE_TO_Z_TRANSLATION * (scaleFactor - 1);
     ComputeMVPMatrix();
 }
 
 /**
  * Finger drag movements are converted to rotation of model by deriving a
- * quaternion from the drag movement
+ * quaternion from the drag movement. The applied rotation is returned.
  */
-void MyGLCamera::RotateModel(float distanceX, float distanceY,
+glm::quat MyGLCamera::RotateModel(float distanceX, float distanceY,
                              float endPositionX, float endPositionY) {
 
     // algo in brief---
@@ -145,8 +147,17 @@ void MyGLCamera::RotateModel(float distanceX, float distanceY,
     float rotationAngle = TRANSLATION_TO_ANGLE*acos(dotProduct);
 
     // compute quat using above
-    modelQuaternion = glm::angleAxis(rotationAngle, rotationAxis);
-    rotateMat = glm::toMat4(modelQuaternion)*rotateMat;
+    glm::quat rotation = glm::angleAxis(rotationAngle, rotationAxis);
+    RotateModelBy(rotation);
+    return rotation;
+}
+
+/**
+ * Apply an additional rotation to the model, e.g., from a fling
+ */
+void MyGLCamera::RotateModelBy(glm::quat rotation) {
+
+    modelTransform.Rotate(rotation);
 
     ComputeMVPMatrix();
 }
@@ -156,7 +167,7 @@ void MyGLCamera::RotateModel(float distanceX, float distanceY,
  */
 void MyGLCamera::TranslateModel(float distanceX, float distanceY) {
 
-    deltaX += XY_TRANSLATION_FACTOR * distanceX;
-    deltaY += XY_TRANSLATION_FACTOR * distanceY;
+    modelTransform.Translate(glm::vec3(XY_TRANSLATION_FACTOR * distanceX,
+                                       XY_TRANSLATION_FACTOR * distanceY, 0));
     ComputeMVPMatrix();
 }
\ No newline at end of file
@@ -18,8 +18,8 @@
 #ifndef GLCAMERA_H
 #define GLCAMERA_H
 
-#include <vector>
 #include "misc.h"
+#include "myTransform.h"
 
 // sensitivity coefficients for translating gestures to model's movements
 #define SCALE_TO_Z_TRANSLATION  20
@@ -34,10 +34,22 @@ public:
             float nearPlaneDistance = 1.0f, // as large as possible
             float farPlaneDistance = 2000.0f // as small as possible
     );
-    void        SetModelPosition(std::vector<float> modelPosition);
+    void        SetModelTransform(const MyTransform & transform);
     void        SetAspectRatio(float aspect);
     glm::mat4   GetMVP(){ return mvpMat; }
-    void        RotateModel(float distanceX, float distanceY, float endPositionX, float endPositionY);
+    glm::mat4   GetProjectionView() const { return projectionViewMat; }
+    glm::mat4   GetProjection() const { return projectionMat; }
+    glm::mat4   GetView() const { return viewMat; }
+    float       GetNearPlaneDistance() const { return nearPlaneDistance; }
+    float       GetFarPlaneDistance() const { return farPlaneDistance; }
+    const MyTransform & GetModelTransform() const { return modelTransform; }
+    glm::vec3   GetCameraPosition() const { return cameraPosition; }
+    float       GetFOV() const { return FOV; }
+    float       GetModelDistance() const;
+    float       GetNormalizedViewDepth(glm::vec3 modelSpacePoint) const;
+    glm::vec3   GetCameraPositionInModelSpace() const;
+    glm::quat   RotateModel(float distanceX, float distanceY, float endPositionX, float endPositionY);
+    void        RotateModelBy(glm::quat rotation);
     void        ScaleModel(float scaleFactor);
     void        TranslateModel(float distanceX, float distanceY);
 
@@ -46,16 +58,15 @@ private:
 
     float       FOV;
     float       nearPlaneDistance, farPlaneDistance;
+    glm::vec3   cameraPosition;
 
-    glm::mat4   projectionViewMat;
-    glm::mat4   rotateMat, translateMat;
-    glm::mat4   modelMat;
     glm::mat4   viewMat;
+    glm::mat4   projectionMat;
+    glm::mat4   projectionViewMat;
     glm::mat4   mvpMat;     // ModelViewProjection: obtained by multiplying Projection, View, & Model
 
     // six degrees-of-freedom of the model contained in a quaternion and x-y-z coordinates
-    glm::quat   modelQuaternion;
-    float       deltaX, deltaY, deltaZ;
+    MyTransform modelTransform;
 };
 
 #endif //GLCAMERA_H
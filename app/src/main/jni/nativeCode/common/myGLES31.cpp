@@ -0,0 +1,64 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include "myGLES31.h"
+#include "myLogger.h"
+#include <EGL/egl.h>
+#include <stdlib.h>
+
+static bool isGLES31Supported = false;
+
+#ifndef GL_ES_VERSION_3_1
+void (GL_APIENTRY * glDispatchCompute) (GLuint, GLuint, GLuint) = NULL;
+void (GL_APIENTRY * glMemoryBarrier) (GLbitfield) = NULL;
+void (GL_APIENTRY * glDrawElementsIndirect) (GLenum, GLenum, const void *) = NULL;
+#endif
+
+/**
+ * Check the context version and fetch the GLES 3.1 functions. Call after gl3stubInit succeeds.
+ */
+bool MyGLES31Init() {
+
+    isGLES31Supported = false;
+
+    // version string is "OpenGL ES 3.x ..."
+    const char * versionStr = (const char *) glGetString(GL_VERSION);
+    const char * version = versionStr ? strstr(versionStr, "OpenGL ES 3.") : NULL;
+    if (!version || atoi(version + strlen("OpenGL ES 3.")) < 1) {
+        return false;
+    }
+
+#ifndef GL_ES_VERSION_3_1
+    glDispatchCompute = (void (GL_APIENTRY *) (GLuint, GLuint, GLuint))
+            eglGetProcAddress("glDispatchCompute");
+    glMemoryBarrier = (void (GL_APIENTRY *) (GLbitfield))
+            eglGetProcAddress("glMemoryBarrier");
+    glDrawElementsIndirect = (void (GL_APIENTRY *) (GLenum, GLenum, const void *))
+            eglGetProcAddress("glDrawElementsIndirect");
+    if (!glDispatchCompute || !glMemoryBarrier || !glDrawElementsIndirect) {
+        MyLOGW("GLES 3.1 context is missing compute or indirect draw functions");
+        return false;
+    }
+#endif
+
+    isGLES31Supported = true;
+    return true;
+}
+
+bool IsGLES31Supported() {
+
+    return isGLES31Supported;
+}
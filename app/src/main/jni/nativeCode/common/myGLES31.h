@@ -0,0 +1,41 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#ifndef MY_GLES31_H
+#define MY_GLES31_H
+
+#include "myGLFunctions.h"
+
+// we build against API 19 headers, so the GLES 3.1 entry points we use are fetched at runtime
+// like gl3stub does for GLES 3.0
+#ifndef GL_ES_VERSION_3_1
+#define GL_COMPUTE_SHADER               0x91B9
+#define GL_SHADER_STORAGE_BUFFER        0x90D2
+#define GL_DRAW_INDIRECT_BUFFER         0x8F3F
+#define GL_SHADER_STORAGE_BARRIER_BIT   0x00002000
+#define GL_COMMAND_BARRIER_BIT          0x00000040
+
+extern void (GL_APIENTRY * glDispatchCompute) (GLuint numGroupsX, GLuint numGroupsY,
+                                               GLuint numGroupsZ);
+extern void (GL_APIENTRY * glMemoryBarrier) (GLbitfield barriers);
+extern void (GL_APIENTRY * glDrawElementsIndirect) (GLenum mode, GLenum type,
+                                                    const void * indirect);
+#endif
+
+bool    MyGLES31Init();
+bool    IsGLES31Supported();
+
+#endif //MY_GLES31_H
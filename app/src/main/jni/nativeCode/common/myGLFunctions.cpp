@@ -17,6 +17,20 @@
 #include "myGLFunctions.h"
 #include <sstream>
 #include "myLogger.h"
+#include "misc.h"
+#include "myGLES31.h"
+#include <EGL/egl.h>
+
+#ifndef NDEBUG
+static void InitGLDebugOutput();
+#endif
+
+static bool isGLES3Supported = false;
+
+// GLES 2 drivers may offer glInvalidateFramebuffer's predecessor as an extension
+typedef void (GL_APIENTRY * DiscardFramebufferProc) (GLenum target, GLsizei count,
+                                                     const GLenum * attachments);
+static DiscardFramebufferProc discardFramebuffer = NULL;
 
 /**
  * Basic initializations for GL.
@@ -35,26 +49,68 @@ void MyGLInits() {
 
     // check if the device supports GLES 3 or GLES 2
     const char* versionStr = (const char*)glGetString(GL_VERSION);
-    if (strstr(versionStr, "OpenGL ES 3.") && gl3stubInit()) {
+    isGLES3Supported = strstr(versionStr, "OpenGL ES 3.") && gl3stubInit();
+    if (isGLES3Supported) {
         MyLOGD("Device supports GLES 3");
+        if (MyGLES31Init()) {
+            MyLOGD("Device supports GLES 3.1 compute and indirect draws");
+        }
     } else {
         MyLOGD("Device supports GLES 2");
+        const char * extensionsStr = (const char *) glGetString(GL_EXTENSIONS);
+        if (extensionsStr && strstr(extensionsStr, "GL_EXT_discard_framebuffer")) {
+            discardFramebuffer = (DiscardFramebufferProc)
+                    eglGetProcAddress("glDiscardFramebufferEXT");
+        }
     }
 
+#ifndef NDEBUG
+    InitGLDebugOutput();
+#endif
     CheckGLError("MyGLInits");
 }
 
 /**
- * Checks for OpenGL errors.
+ * True once MyGLInits has loaded the GLES 3.0 functions
  */
-void CheckGLError(std::string funcName){
+bool IsGLES3Supported() {
 
-    GLenum err = glGetError();
-    if (err == GL_NO_ERROR) {
-        return;
-    } else {
-        MyLOGF("[FAIL GL] %s", funcName.c_str());
+    return isGLES3Supported;
+}
+
+/**
+ * Tell the driver that the bound framebuffer's attachments will not be read again, so a
+ * tiled GPU neither writes them back to memory nor loads them for the next pass. The
+ * window's attachments are GL_COLOR, GL_DEPTH and GL_STENCIL. Returns false if neither
+ * GLES 3 nor EXT_discard_framebuffer is available.
+ */
+bool InvalidateFramebuffer(GLsizei count, const GLenum * attachments) {
+
+    if (isGLES3Supported) {
+        glInvalidateFramebuffer(GL_FRAMEBUFFER, count, attachments);
+        return true;
     }
+    if (discardFramebuffer) {
+        discardFramebuffer(GL_FRAMEBUFFER, count, attachments);
+        return true;
+    }
+    return false;
+}
+
+#ifndef NDEBUG
+
+// set once the driver reports errors through the KHR_debug callback
+static bool         isDebugOutputEnabled = false;
+// call site of the most recent CheckGLError, errors reported by callback occurred after it
+static const char * lastCheckFile = "MyGLInits";
+static int          lastCheckLine = 0;
+static std::string  lastCheckFunction = "MyGLInits";
+static unsigned int frameCount = 0;
+
+/**
+ * Log a human-readable description of a GL error code
+ */
+static void LogGLError(GLenum err) {
 
     switch(err) {
 
@@ -83,3 +139,95 @@ void CheckGLError(std::string funcName){
             break;
     }
 }
+
+#ifdef GL_KHR_debug
+/**
+ * Called by the driver from inside the offending GL call since output is synchronous.
+ * A breakpoint here gives the exact call stack, the log names the last checked call site.
+ */
+static void GL_APIENTRY GLDebugCallback(GLenum source, GLenum type, GLuint id,
+                                        GLenum severity, GLsizei length,
+                                        const GLchar *message, const void *userParam) {
+
+    if (severity == GL_DEBUG_SEVERITY_NOTIFICATION_KHR) {
+        return;
+    }
+
+    if (type == GL_DEBUG_TYPE_ERROR_KHR) {
+        MyLOGF("[FAIL GL] after %s (%s:%d): %s", lastCheckFunction.c_str(),
+               GetFileName(lastCheckFile).c_str(), lastCheckLine, message);
+    } else {
+        MyLOGW("[GL debug] after %s (%s:%d): %s", lastCheckFunction.c_str(),
+               GetFileName(lastCheckFile).c_str(), lastCheckLine, message);
+    }
+}
+#endif
+
+/**
+ * Install a KHR_debug message callback if the driver supports it,
+ * otherwise CheckGLError falls back to sampled glGetError polling
+ */
+static void InitGLDebugOutput() {
+
+    isDebugOutputEnabled = false;
+
+#ifdef GL_KHR_debug
+    const char* extensionsStr = (const char*)glGetString(GL_EXTENSIONS);
+    if (extensionsStr == NULL || strstr(extensionsStr, "GL_KHR_debug") == NULL) {
+        MyLOGD("KHR_debug not supported, polling glGetError every %d frames",
+               GL_ERROR_POLL_INTERVAL);
+        return;
+    }
+
+    PFNGLDEBUGMESSAGECALLBACKKHRPROC debugMessageCallback =
+            (PFNGLDEBUGMESSAGECALLBACKKHRPROC) eglGetProcAddress("glDebugMessageCallbackKHR");
+    if (debugMessageCallback == NULL) {
+        MyLOGD("glDebugMessageCallbackKHR not found, polling glGetError every %d frames",
+               GL_ERROR_POLL_INTERVAL);
+        return;
+    }
+
+    // synchronous output makes the callback run on this thread inside the failing call
+    glEnable(GL_DEBUG_OUTPUT_KHR);
+    glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS_KHR);
+    debugMessageCallback(GLDebugCallback, NULL);
+    isDebugOutputEnabled = true;
+    MyLOGD("Installed KHR_debug message callback");
+#endif
+}
+
+/**
+ * Debug builds only: advance the frame counter used to sample glGetError
+ */
+void MyGLDebugNewFrame() {
+
+    frameCount++;
+}
+
+/**
+ * Debug builds only: checks for OpenGL errors.
+ * With KHR_debug the driver reports errors through the callback, so we just record the
+ * call site. Without it glGetError is polled on every GL_ERROR_POLL_INTERVAL-th frame.
+ */
+void CheckGLErrorAt(std::string funcName, const char * fileName, int lineNumber){
+
+    lastCheckFunction = funcName;
+    lastCheckFile = fileName;
+    lastCheckLine = lineNumber;
+
+    if (isDebugOutputEnabled || frameCount % GL_ERROR_POLL_INTERVAL != 0) {
+        return;
+    }
+
+    GLenum err = glGetError();
+    if (err == GL_NO_ERROR) {
+        return;
+    } else {
+        MyLOGF("[FAIL GL] %s (%s:%d)", funcName.c_str(), GetFileName(fileName).c_str(),
+               lineNumber);
+    }
+
+    LogGLError(err);
+}
+
+#endif // NDEBUG
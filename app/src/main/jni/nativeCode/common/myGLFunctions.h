@@ -23,7 +23,21 @@
 #include <stdio.h>
 #include <string>
 
+// when KHR_debug is unavailable, debug builds poll glGetError once every these many frames
+#define GL_ERROR_POLL_INTERVAL  30
+
 void MyGLInits();
-void CheckGLError(std::string functionName);
+bool IsGLES3Supported();
+bool InvalidateFramebuffer(GLsizei count, const GLenum * attachments);
+
+// GL error checks are compiled out of release builds so that frames never pay for polling
+#ifdef NDEBUG
+#define CheckGLError(functionName)
+#define MyGLDebugNewFrame()
+#else
+#define CheckGLError(functionName) CheckGLErrorAt(functionName, __FILE__, __LINE__)
+void CheckGLErrorAt(std::string functionName, const char * fileName, int lineNumber);
+void MyGLDebugNewFrame();
+#endif
 
 #endif //MY_GL_FUNCTIONS_H
@@ -0,0 +1,224 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include "myGPUCuller.h"
+#include "myMeshlet.h"
+#include "myShader.h"
+#include "myLogger.h"
+
+// SSBO binding points used by meshletCull.csh
+#define MESHLET_BUFFER_BINDING  0
+#define OBJECT_BUFFER_BINDING   1
+#define COMMAND_BUFFER_BINDING  2
+
+MyGPUCuller::MyGPUCuller() {
+
+    resources = NULL;
+    cullProgram = GPU_NULL_HANDLE;
+    meshletBuffer = objectBuffer = commandBuffer = GPU_NULL_HANDLE;
+    vertexArray = 0;
+    objectSphere = glm::vec4(0);
+}
+
+MyGPUCuller::~MyGPUCuller() {
+
+    if (resources) {
+        resources->Destroy(cullProgram);
+        resources->Destroy(meshletBuffer);
+        resources->Destroy(objectBuffer);
+        resources->Destroy(commandBuffer);
+    }
+    if (vertexArray) {
+        glDeleteVertexArrays(1, &vertexArray);
+    }
+}
+
+/**
+ * Compile the culling shader, needs a GLES 3.1 context
+ */
+bool MyGPUCuller::Init(MyGPUResources * resources, std::string computeShaderFilename) {
+
+    if (!IsGLES31Supported()) {
+        return false;
+    }
+
+    this->resources = resources;
+    cullProgram = resources->LoadComputeProgram(computeShaderFilename);
+    if (!cullProgram) {
+        return false;
+    }
+    GetUniformLocations();
+
+    // meshlets are kept for a lost context, the GPU rewrites the others every frame
+    meshletBuffer = resources->CreateBuffer(GL_SHADER_STORAGE_BUFFER, GL_STATIC_DRAW, true);
+    objectBuffer = resources->CreateBuffer(GL_SHADER_STORAGE_BUFFER, GL_DYNAMIC_DRAW, false);
+    commandBuffer = resources->CreateBuffer(GL_SHADER_STORAGE_BUFFER, GL_DYNAMIC_DRAW, false);
+
+    CheckGLError("MyGPUCuller::Init");
+    return true;
+}
+
+void MyGPUCuller::GetUniformLocations() {
+
+    GLuint cullProgramID = resources->GetName(cullProgram);
+    frustumPlanesLocation   = GetUniformLocation(cullProgramID, "frustumPlanes");
+    cameraPositionLocation  = GetUniformLocation(cullProgramID, "cameraPosition");
+    firstMeshletLocation    = GetUniformLocation(cullProgramID, "firstMeshlet");
+    meshletCountLocation    = GetUniformLocation(cullProgramID, "meshletCount");
+    backfaceCullingLocation = GetUniformLocation(cullProgramID, "backfaceCulling");
+}
+
+/**
+ * Upload the meshlets of all LODs and capture the mesh's buffers in a vertex array.
+ * lodFirstIndex is where each LOD starts in indexBuffer, which holds GLushort indices.
+ */
+void MyGPUCuller::SetGeometry(const MyMesh & mesh, const std::vector<GLint> & lodFirstIndex,
+                              GLuint vertexBuffer, GLuint vertexAttribute,
+                              GLuint colorBuffer, GLuint colorAttribute, GLuint indexBuffer) {
+
+    SetMeshlets(mesh, lodFirstIndex);
+    resources->BufferData(objectBuffer, sizeof(GPUObject), NULL);
+    resources->BufferData(commandBuffer, lodFirstMeshlet.back() * sizeof(GPUDrawCommand),
+                          NULL);
+    CreateVertexArray(vertexBuffer, vertexAttribute, colorBuffer, colorAttribute, indexBuffer);
+
+    MyLOGD("GPU culling %d meshlets in %d LODs", (int) lodFirstMeshlet.back(),
+           (int) mesh.lods.size());
+    CheckGLError("MyGPUCuller::SetGeometry");
+}
+
+/**
+ * Upload the meshlets again once LODs moved in the index buffer
+ */
+void MyGPUCuller::SetMeshlets(const MyMesh & mesh, const std::vector<GLint> & lodFirstIndex) {
+
+    std::vector<GPUMeshlet> meshlets;
+    lodFirstMeshlet.clear();
+    for (size_t level = 0; level < mesh.lods.size(); level++) {
+        lodFirstMeshlet.push_back((GLuint) meshlets.size());
+        const std::vector<MyMeshlet> & lodMeshlets = mesh.lods[level].meshlets;
+        for (size_t i = 0; i < lodMeshlets.size(); i++) {
+            GPUMeshlet meshlet;
+            meshlet.sphere      = glm::vec4(lodMeshlets[i].center, lodMeshlets[i].radius);
+            meshlet.cone        = glm::vec4(lodMeshlets[i].coneAxis, lodMeshlets[i].coneCutoff);
+            meshlet.firstIndex  = (GLuint) lodFirstIndex[level] + lodMeshlets[i].firstIndex;
+            meshlet.indexCount  = 3 * lodMeshlets[i].triangleCount;
+            meshlet.objectIndex = 0;
+            meshlet.padding     = 0;
+            meshlets.push_back(meshlet);
+        }
+    }
+    lodFirstMeshlet.push_back((GLuint) meshlets.size());
+    objectSphere = glm::vec4(mesh.boundsCenter, mesh.boundsRadius);
+
+    resources->BufferData(meshletBuffer, meshlets.size() * sizeof(GPUMeshlet),
+                          meshlets.empty() ? NULL : &meshlets[0]);
+}
+
+/**
+ * Called once resources restored the program and buffers in a new context. The program
+ * may have been rebuilt from source, so its uniforms are looked up again, and vertex
+ * arrays are not managed by resources, so the mesh's buffers are captured in a new one.
+ * The old array died with its context and is dropped without deleting it.
+ */
+void MyGPUCuller::RestoreGLObjects(GLuint vertexBuffer, GLuint vertexAttribute,
+                                   GLuint colorBuffer, GLuint colorAttribute,
+                                   GLuint indexBuffer) {
+
+    GetUniformLocations();
+    CreateVertexArray(vertexBuffer, vertexAttribute, colorBuffer, colorAttribute, indexBuffer);
+}
+
+/**
+ * Capture the mesh's buffers in a new vertex array
+ */
+void MyGPUCuller::CreateVertexArray(GLuint vertexBuffer, GLuint vertexAttribute,
+                                    GLuint colorBuffer, GLuint colorAttribute,
+                                    GLuint indexBuffer) {
+
+    glGenVertexArrays(1, &vertexArray);
+    glBindVertexArray(vertexArray);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    glEnableVertexAttribArray(vertexAttribute);
+    glVertexAttribPointer(vertexAttribute, 3, GL_FLOAT, GL_FALSE, 0, 0);
+    glBindBuffer(GL_ARRAY_BUFFER, colorBuffer);
+    glEnableVertexAttribArray(colorAttribute);
+    glVertexAttribPointer(colorAttribute, 3, GL_FLOAT, GL_FALSE, 0, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    CheckGLError("MyGPUCuller::CreateVertexArray");
+}
+
+/**
+ * Dispatch the culling shader over the meshlets of one LOD, planes are in world space
+ */
+void MyGPUCuller::Cull(int level, const MyTransform & modelTransform,
+                       const glm::mat4 & projectionViewMat, glm::vec3 cameraPosition,
+                       bool backfaceCulling) {
+
+    GPUObject object;
+    object.model = modelTransform.ToAffine();
+    object.sphere = objectSphere;
+    resources->BufferSubData(objectBuffer, 0, sizeof(GPUObject), &object);
+
+    glm::vec4 planes[6];
+    ExtractFrustumPlanes(projectionViewMat, planes);
+    GLuint meshletCount = lodFirstMeshlet[level + 1] - lodFirstMeshlet[level];
+
+    glUseProgram(resources->GetName(cullProgram));
+    glUniform4fv(frustumPlanesLocation, 6, (const GLfloat *) planes);
+    glUniform3fv(cameraPositionLocation, 1, (const GLfloat *) &cameraPosition);
+    glUniform1ui(firstMeshletLocation, lodFirstMeshlet[level]);
+    glUniform1ui(meshletCountLocation, meshletCount);
+    glUniform1i(backfaceCullingLocation, backfaceCulling ? 1 : 0);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MESHLET_BUFFER_BINDING,
+                     resources->GetName(meshletBuffer));
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, OBJECT_BUFFER_BINDING,
+                     resources->GetName(objectBuffer));
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMAND_BUFFER_BINDING,
+                     resources->GetName(commandBuffer));
+    glDispatchCompute((meshletCount + GPU_CULL_GROUP_SIZE - 1) / GPU_CULL_GROUP_SIZE, 1, 1);
+
+    // the draws below read the commands as indirect arguments
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+    CheckGLError("MyGPUCuller::Cull");
+}
+
+/**
+ * Issue one indirect draw per meshlet of the level, culled meshlets have a zero count
+ */
+void MyGPUCuller::Draw(int level, GLuint programID, GLint mvpLocation,
+                       const glm::mat4 & mvpMat) {
+
+    glUseProgram(programID);
+    // -1 when the program reads the matrix from a uniform block bound by the caller
+    if (mvpLocation != -1) {
+        glUniformMatrix4fv(mvpLocation, 1, GL_FALSE, (const GLfloat *) &mvpMat);
+    }
+    glBindVertexArray(vertexArray);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, resources->GetName(commandBuffer));
+
+    for (GLuint i = lodFirstMeshlet[level]; i < lodFirstMeshlet[level + 1]; i++) {
+        glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_SHORT,
+                               (const void *) (i * sizeof(GPUDrawCommand)));
+    }
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    glBindVertexArray(0);
+    CheckGLError("MyGPUCuller::Draw");
+}
@@ -0,0 +1,92 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#ifndef MY_GPU_CULLER_H
+#define MY_GPU_CULLER_H
+
+#include "myGLES31.h"
+#include "myGPUResources.h"
+#include "myMesh.h"
+#include "myTransform.h"
+#include <string>
+
+// has to match local_size_x in meshletCull.csh
+#define GPU_CULL_GROUP_SIZE 64
+
+// layouts of the std430 structs in meshletCull.csh
+struct GPUMeshlet {
+    glm::vec4   sphere;
+    glm::vec4   cone;
+    GLuint      firstIndex;
+    GLuint      indexCount;
+    GLuint      objectIndex;
+    GLuint      padding;
+};
+
+struct GPUObject {
+    MyAffine3x4 model;
+    glm::vec4   sphere;
+};
+
+// DrawElementsIndirectCommand of GLES 3.1
+struct GPUDrawCommand {
+    GLuint      count;
+    GLuint      instanceCount;
+    GLuint      firstIndex;
+    GLint       baseVertex;
+    GLuint      reservedMustBeZero;
+};
+
+/**
+ * Culls meshlets in a compute shader that writes one indirect draw command per meshlet.
+ * Commands stay on the GPU: culled meshlets are drawn with a zero count, so the CPU
+ * never waits on the culling results. Needs GLES 3.1.
+ */
+class MyGPUCuller {
+public:
+    MyGPUCuller();
+    ~MyGPUCuller();
+    bool    Init(MyGPUResources * resources, std::string computeShaderFilename);
+    void    SetGeometry(const MyMesh & mesh, const std::vector<GLint> & lodFirstIndex,
+                        GLuint vertexBuffer, GLuint vertexAttribute,
+                        GLuint colorBuffer, GLuint colorAttribute, GLuint indexBuffer);
+    void    SetMeshlets(const MyMesh & mesh, const std::vector<GLint> & lodFirstIndex);
+    void    RestoreGLObjects(GLuint vertexBuffer, GLuint vertexAttribute,
+                             GLuint colorBuffer, GLuint colorAttribute, GLuint indexBuffer);
+    void    Cull(int level, const MyTransform & modelTransform,
+                 const glm::mat4 & projectionViewMat, glm::vec3 cameraPosition,
+                 bool backfaceCulling);
+    void    Draw(int level, GLuint programID, GLint mvpLocation, const glm::mat4 & mvpMat);
+
+private:
+    void    GetUniformLocations();
+    void    CreateVertexArray(GLuint vertexBuffer, GLuint vertexAttribute,
+                              GLuint colorBuffer, GLuint colorAttribute, GLuint indexBuffer);
+
+    MyGPUResources * resources;
+    GPUHandle cullProgram;
+    GLint   frustumPlanesLocation, cameraPositionLocation;
+    GLint   firstMeshletLocation, meshletCountLocation, backfaceCullingLocation;
+
+    GPUHandle meshletBuffer, objectBuffer, commandBuffer;
+    GLuint  vertexArray;    // indirect draws cannot source from the default vertex array
+    glm::vec4 objectSphere;
+
+    // meshlets of LOD i are [lodFirstMeshlet[i], lodFirstMeshlet[i + 1])
+    std::vector<GLuint> lodFirstMeshlet;
+};
+
+#endif //MY_GPU_CULLER_H
@@ -0,0 +1,603 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+
+#include "myGPUResources.h"
+#include "myGLES31.h"
+#include "myShader.h"
+#include "myLogger.h"
+#include "misc.h"
+#include <string.h>
+
+/**
+ * Bytes per texel of an uncompressed format and type, packed types hold a whole texel
+ */
+static GLsizei GetTexelSize(GLenum format, GLenum type) {
+
+    int components;
+    switch (format) {
+        case GL_RED:
+        case GL_RED_INTEGER:
+        case GL_ALPHA:
+        case GL_LUMINANCE:
+        case GL_DEPTH_COMPONENT:
+            components = 1;
+            break;
+        case GL_RG:
+        case GL_RG_INTEGER:
+        case GL_LUMINANCE_ALPHA:
+            components = 2;
+            break;
+        case GL_RGB:
+        case GL_RGB_INTEGER:
+            components = 3;
+            break;
+        default:
+            components = 4;
+            break;
+    }
+    switch (type) {
+        case GL_UNSIGNED_BYTE:
+        case GL_BYTE:
+            return components;
+        case GL_UNSIGNED_SHORT:
+        case GL_SHORT:
+        case GL_HALF_FLOAT:
+            return 2 * components;
+        case GL_UNSIGNED_INT:
+        case GL_INT:
+        case GL_FLOAT:
+            return 4 * components;
+        case GL_UNSIGNED_SHORT_5_6_5:
+        case GL_UNSIGNED_SHORT_4_4_4_4:
+        case GL_UNSIGNED_SHORT_5_5_5_1:
+            return 2;
+        default:
+            return 4;
+    }
+}
+
+/**
+ * Size of an image as glTexImage2D reads it, rows are padded to the default unpack
+ * alignment of 4
+ */
+static size_t GetImageSize(const GPUTextureDesc & desc) {
+
+    size_t rowSize = (desc.width * GetTexelSize(desc.format, desc.type) + 3) & ~(size_t) 3;
+    return rowSize * desc.height;
+}
+
+MyGPUResources::MyGPUResources() {
+
+    context = EGL_NO_CONTEXT;
+    sentinelBuffer = 0;
+    programsFromBinary = programsFromSource = failedPrograms = 0;
+    restoreTimeMs = 0;
+}
+
+MyGPUResources::~MyGPUResources() {
+
+    // names of a lost context may have been reused by the current one
+    if (IsContextLost()) {
+        return;
+    }
+    for (size_t i = 0; i < resources.size(); i++) {
+        if (resources[i].type != RESOURCE_FREE) {
+            Destroy((resources[i].generation << GPU_HANDLE_INDEX_BITS) | (GPUHandle) i);
+        }
+    }
+    glDeleteBuffers(1, &sentinelBuffer);
+}
+
+/**
+ * Remember the current context, call once it exists and before creating any resource
+ */
+void MyGPUResources::CreateGLObjects() {
+
+    context = eglGetCurrentContext();
+    glGenBuffers(1, &sentinelBuffer);
+    // a name is only a buffer once it has been bound
+    glBindBuffer(GL_ARRAY_BUFFER, sentinelBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+GPUHandle MyGPUResources::Allocate(ResourceType type) {
+
+    uint32_t index;
+    if (!freeSlots.empty()) {
+        index = freeSlots.back();
+        freeSlots.pop_back();
+    } else {
+        if (resources.size() > GPU_HANDLE_INDEX_MASK) {
+            MyLOGE("Out of GPU resource handles");
+            return GPU_NULL_HANDLE;
+        }
+        index = (uint32_t) resources.size();
+        resources.push_back(Resource());
+        resources[index].generation = 1;
+    }
+    Resource & resource = resources[index];
+    resource.type = type;
+    resource.name = 0;
+    resource.keepContents = false;
+    resource.size = 0;
+    resource.binaryFormat = 0;
+    return (resource.generation << GPU_HANDLE_INDEX_BITS) | index;
+}
+
+MyGPUResources::Resource * MyGPUResources::Lookup(GPUHandle handle, ResourceType type) {
+
+    uint32_t index = handle & GPU_HANDLE_INDEX_MASK;
+    if (handle == GPU_NULL_HANDLE || index >= resources.size()) {
+        return NULL;
+    }
+    Resource & resource = resources[index];
+    if (resource.generation != handle >> GPU_HANDLE_INDEX_BITS ||
+        (resource.type != type && type != RESOURCE_FREE) || resource.type == RESOURCE_FREE) {
+        return NULL;
+    }
+    return &resource;
+}
+
+bool MyGPUResources::IsValid(GPUHandle handle) const {
+
+    return GetName(handle) != 0;
+}
+
+/**
+ * GL name of a live resource, 0 for a destroyed one or a program that failed to restore
+ */
+GLuint MyGPUResources::GetName(GPUHandle handle) const {
+
+    uint32_t index = handle & GPU_HANDLE_INDEX_MASK;
+    if (index >= resources.size()) {
+        return 0;
+    }
+    const Resource & resource = resources[index];
+    if (resource.generation != handle >> GPU_HANDLE_INDEX_BITS ||
+        resource.type == RESOURCE_FREE) {
+        return 0;
+    }
+    return resource.name;
+}
+
+GPUHandle MyGPUResources::CreateBuffer(GLenum target, GLenum usage, bool keepContents) {
+
+    GPUHandle handle = Allocate(RESOURCE_BUFFER);
+    Resource * resource = Lookup(handle, RESOURCE_BUFFER);
+    if (!resource) {
+        return GPU_NULL_HANDLE;
+    }
+    resource->target = target;
+    resource->usage = usage;
+    resource->keepContents = keepContents;
+    glGenBuffers(1, &resource->name);
+    return handle;
+}
+
+/**
+ * (Re)allocate the buffer's storage, data may be NULL
+ */
+void MyGPUResources::BufferData(GPUHandle handle, GLsizeiptr size, const void * data) {
+
+    Resource * resource = Lookup(handle, RESOURCE_BUFFER);
+    if (!resource) {
+        return;
+    }
+    glBindBuffer(resource->target, resource->name);
+    glBufferData(resource->target, size, data, resource->usage);
+    glBindBuffer(resource->target, 0);
+    resource->size = size;
+    if (resource->keepContents) {
+        if (data) {
+            resource->contents.assign((const char *) data, (const char *) data + size);
+        } else {
+            resource->contents.assign(size, 0);
+        }
+    }
+}
+
+void MyGPUResources::BufferSubData(GPUHandle handle, GLintptr offset, GLsizeiptr size,
+                                   const void * data) {
+
+    Resource * resource = Lookup(handle, RESOURCE_BUFFER);
+    if (!resource || offset + size > resource->size) {
+        return;
+    }
+    glBindBuffer(resource->target, resource->name);
+    glBufferSubData(resource->target, offset, size, data);
+    glBindBuffer(resource->target, 0);
+    if (resource->keepContents) {
+        memcpy(&resource->contents[offset], data, size);
+    }
+}
+
+/**
+ * Bind the texture and specify its image, with its sampling parameters for a new one
+ */
+void MyGPUResources::UploadTexture(const Resource & resource, const void * data,
+                                   bool setParameters) const {
+
+    const GPUTextureDesc & desc = resource.texture;
+    glBindTexture(GL_TEXTURE_2D, resource.name);
+    if (setParameters) {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, desc.minFilter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, desc.magFilter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, desc.wrap);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, desc.wrap);
+    }
+    glTexImage2D(GL_TEXTURE_2D, 0, desc.internalFormat, desc.width, desc.height, 0, desc.format,
+                 desc.type, data);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+/**
+ * A 2D texture without mipmaps, data may be NULL
+ */
+GPUHandle MyGPUResources::CreateTexture(const GPUTextureDesc & desc, const void * data,
+                                        bool keepContents) {
+
+    GPUHandle handle = Allocate(RESOURCE_TEXTURE);
+    Resource * resource = Lookup(handle, RESOURCE_TEXTURE);
+    if (!resource) {
+        return GPU_NULL_HANDLE;
+    }
+    resource->texture = desc;
+    resource->keepContents = keepContents;
+    glGenTextures(1, &resource->name);
+    UploadTexture(*resource, data, true);
+    if (keepContents) {
+        if (data) {
+            resource->contents.assign((const char *) data,
+                                      (const char *) data + GetImageSize(desc));
+        } else {
+            resource->contents.assign(GetImageSize(desc), 0);
+        }
+    }
+    return handle;
+}
+
+/**
+ * Respecify the texture's image at a new size, keeping its format and parameters
+ */
+void MyGPUResources::TexImage(GPUHandle handle, GLsizei width, GLsizei height,
+                              const void * data) {
+
+    Resource * resource = Lookup(handle, RESOURCE_TEXTURE);
+    if (!resource) {
+        return;
+    }
+    resource->texture.width = width;
+    resource->texture.height = height;
+    UploadTexture(*resource, data, false);
+    if (resource->keepContents) {
+        size_t size = GetImageSize(resource->texture);
+        if (data) {
+            resource->contents.assign((const char *) data, (const char *) data + size);
+        } else {
+            resource->contents.assign(size, 0);
+        }
+    }
+}
+
+/**
+ * Compile and link the resource's sources, returns the program or 0
+ */
+GLuint MyGPUResources::BuildProgram(const Resource & resource) const {
+
+    if (!resource.computeSource.empty()) {
+        GLuint computeShaderID;
+        if (!CompileShader(computeShaderID, GL_COMPUTE_SHADER, resource.computeSource)) {
+            return 0;
+        }
+        GLuint programID = glCreateProgram();
+        glAttachShader(programID, computeShaderID);
+        glProgramParameteri(programID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glLinkProgram(programID);
+        glDeleteShader(computeShaderID);
+        GLint result = GL_FALSE;
+        glGetProgramiv(programID, GL_LINK_STATUS, &result);
+        if (!result) {
+            MyLOGE("Error in linking compute shader");
+            glDeleteProgram(programID);
+            return 0;
+        }
+        return programID;
+    }
+
+    GLuint vertexShaderID = 0, fragmentShaderID = 0;
+    if (!CompileShader(vertexShaderID, GL_VERTEX_SHADER, resource.vertexSource) ||
+        !CompileShader(fragmentShaderID, GL_FRAGMENT_SHADER, resource.fragmentSource)) {
+        glDeleteShader(vertexShaderID);
+        glDeleteShader(fragmentShaderID);
+        return 0;
+    }
+    GLuint programID = glCreateProgram();
+    for (size_t i = 0; i < resource.attributes.size(); i++) {
+        glBindAttribLocation(programID, resource.attributes[i].second,
+                             resource.attributes[i].first.c_str());
+    }
+    // LinkProgram deletes the shaders, and the program if linking fails
+    if (!LinkProgram(programID, vertexShaderID, fragmentShaderID)) {
+        return 0;
+    }
+    return programID;
+}
+
+/**
+ * Keep the linked program's binary, which restores much faster than compiling.
+ * Binaries need GLES 3, GLES 2 programs are always rebuilt from their sources.
+ */
+void MyGPUResources::SaveProgramBinary(Resource & resource) {
+
+    resource.binary.clear();
+    if (!IsGLES3Supported()) {
+        return;
+    }
+    GLint length = 0;
+    glGetProgramiv(resource.name, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+    resource.binary.resize(length);
+    GLsizei written = 0;
+    glGetProgramBinary(resource.name, length, &written, &resource.binaryFormat,
+                       &resource.binary[0]);
+    resource.binary.resize(written);
+}
+
+/**
+ * Create the program from its binary, false if there is none or the driver rejects it
+ */
+bool MyGPUResources::LoadProgramBinary(Resource & resource) {
+
+    if (resource.binary.empty()) {
+        return false;
+    }
+    GLuint programID = glCreateProgram();
+    glProgramBinary(programID, resource.binaryFormat, &resource.binary[0],
+                    (GLsizei) resource.binary.size());
+    GLint result = GL_FALSE;
+    glGetProgramiv(programID, GL_LINK_STATUS, &result);
+    if (!result) {
+        glDeleteProgram(programID);
+        return false;
+    }
+    resource.name = programID;
+    return true;
+}
+
+GPUHandle MyGPUResources::CreateProgram(const std::string & vertexSource,
+                                        const std::string & fragmentSource,
+                                        const AttributeBindings & attributes) {
+
+    GPUHandle handle = Allocate(RESOURCE_PROGRAM);
+    Resource * resource = Lookup(handle, RESOURCE_PROGRAM);
+    if (!resource) {
+        return GPU_NULL_HANDLE;
+    }
+    resource->vertexSource = vertexSource;
+    resource->fragmentSource = fragmentSource;
+    resource->attributes = attributes;
+    resource->name = BuildProgram(*resource);
+    if (!resource->name) {
+        Destroy(handle);
+        return GPU_NULL_HANDLE;
+    }
+    SaveProgramBinary(*resource);
+    return handle;
+}
+
+GPUHandle MyGPUResources::CreateComputeProgram(const std::string & computeSource) {
+
+    GPUHandle handle = Allocate(RESOURCE_PROGRAM);
+    Resource * resource = Lookup(handle, RESOURCE_PROGRAM);
+    if (!resource) {
+        return GPU_NULL_HANDLE;
+    }
+    resource->computeSource = computeSource;
+    resource->name = BuildProgram(*resource);
+    if (!resource->name) {
+        Destroy(handle);
+        return GPU_NULL_HANDLE;
+    }
+    SaveProgramBinary(*resource);
+    return handle;
+}
+
+/**
+ * Read the vertex & fragment shaders, compile and link them
+ */
+GPUHandle MyGPUResources::LoadProgram(std::string vertexShaderFilename,
+                                      std::string fragmentShaderFilename) {
+
+    std::string vertexShaderCode, fragmentShaderCode;
+    if (!ReadShaderCode(vertexShaderCode, vertexShaderFilename) ||
+        !ReadShaderCode(fragmentShaderCode, fragmentShaderFilename)) {
+        MyLOGE("Error in reading %s or %s", vertexShaderFilename.c_str(),
+               fragmentShaderFilename.c_str());
+        return GPU_NULL_HANDLE;
+    }
+    return CreateProgram(vertexShaderCode, fragmentShaderCode);
+}
+
+GPUHandle MyGPUResources::LoadComputeProgram(std::string computeShaderFilename) {
+
+    std::string computeShaderCode;
+    if (!ReadShaderCode(computeShaderCode, computeShaderFilename)) {
+        MyLOGE("Error in reading %s", computeShaderFilename.c_str());
+        return GPU_NULL_HANDLE;
+    }
+    return CreateComputeProgram(computeShaderCode);
+}
+
+/**
+ * The program has to be linked in a context that shares objects with the current one and
+ * must not be deleted by the caller afterwards
+ */
+GPUHandle MyGPUResources::AdoptProgram(GLuint programID, const std::string & vertexSource,
+                                       const std::string & fragmentSource,
+                                       const AttributeBindings & attributes) {
+
+    GPUHandle handle = Allocate(RESOURCE_PROGRAM);
+    Resource * resource = Lookup(handle, RESOURCE_PROGRAM);
+    if (!resource) {
+        return GPU_NULL_HANDLE;
+    }
+    resource->vertexSource = vertexSource;
+    resource->fragmentSource = fragmentSource;
+    resource->attributes = attributes;
+    resource->name = programID;
+    SaveProgramBinary(*resource);
+    return handle;
+}
+
+/**
+ * Delete the GL object and free the slot, the handle and its copies turn invalid
+ */
+void MyGPUResources::Destroy(GPUHandle handle) {
+
+    Resource * resource = Lookup(handle, RESOURCE_FREE);
+    if (!resource) {
+        return;
+    }
+    if (resource->name) {
+        switch (resource->type) {
+            case RESOURCE_BUFFER:
+                glDeleteBuffers(1, &resource->name);
+                break;
+            case RESOURCE_TEXTURE:
+                glDeleteTextures(1, &resource->name);
+                break;
+            default:
+                glDeleteProgram(resource->name);
+                break;
+        }
+    }
+
+    uint32_t generation = resource->generation + 1;
+    *resource = Resource();
+    resource->type = RESOURCE_FREE;
+    resource->generation = generation;
+    // a slot whose generation would wrap is retired, so old handles stay invalid
+    if (generation <= GPU_HANDLE_MAX_GENERATION) {
+        freeSlots.push_back(handle & GPU_HANDLE_INDEX_MASK);
+    }
+}
+
+/**
+ * True when the current context is not the one the resources were created in, e.g. when
+ * onSurfaceCreated comes after the app was paused without preserving the context
+ */
+bool MyGPUResources::IsContextLost() const {
+
+    return eglGetCurrentContext() != context || !glIsBuffer(sentinelBuffer);
+}
+
+/**
+ * Recreate every resource in the current context. Names change, the handles stay valid.
+ * Programs come back from their binaries when the driver accepts them and are compiled
+ * from source otherwise. Per-program state like uniform values and block bindings is
+ * not part of a binary, owners set it again.
+ */
+void MyGPUResources::Restore() {
+
+    double startTimeMs = GetMonotonicTimeMs();
+    CreateGLObjects();
+
+    std::vector<uint32_t> buffers, textures;
+    for (size_t i = 0; i < resources.size(); i++) {
+        if (resources[i].type == RESOURCE_BUFFER) {
+            buffers.push_back((uint32_t) i);
+        } else if (resources[i].type == RESOURCE_TEXTURE) {
+            textures.push_back((uint32_t) i);
+        }
+    }
+
+    std::vector<GLuint> names(buffers.size() + textures.size());
+    if (!buffers.empty()) {
+        glGenBuffers((GLsizei) buffers.size(), &names[0]);
+    }
+    for (size_t i = 0; i < buffers.size(); i++) {
+        Resource & resource = resources[buffers[i]];
+        resource.name = names[i];
+        glBindBuffer(resource.target, resource.name);
+        if (resource.size > 0) {
+            glBufferData(resource.target, resource.size,
+                         resource.contents.empty() ? NULL : &resource.contents[0],
+                         resource.usage);
+        }
+        glBindBuffer(resource.target, 0);
+    }
+
+    if (!textures.empty()) {
+        glGenTextures((GLsizei) textures.size(), &names[buffers.size()]);
+    }
+    for (size_t i = 0; i < textures.size(); i++) {
+        Resource & resource = resources[textures[i]];
+        resource.name = names[buffers.size() + i];
+        UploadTexture(resource, resource.contents.empty() ? NULL : &resource.contents[0], true);
+    }
+
+    programsFromBinary = programsFromSource = failedPrograms = 0;
+    for (size_t i = 0; i < resources.size(); i++) {
+        Resource & resource = resources[i];
+        if (resource.type != RESOURCE_PROGRAM) {
+            continue;
+        }
+        if (LoadProgramBinary(resource)) {
+            programsFromBinary++;
+            continue;
+        }
+        // no binary on GLES 2, or the driver no longer accepts it
+        resource.name = BuildProgram(resource);
+        if (resource.name) {
+            SaveProgramBinary(resource);
+            programsFromSource++;
+        } else {
+            MyLOGE("Cannot restore program %d", (int) i);
+            failedPrograms++;
+        }
+    }
+
+    restoreTimeMs = GetMonotonicTimeMs() - startTimeMs;
+    MyLOGI("Restored %d buffers, %d textures, %d programs (%d from binaries) in %.1f ms",
+           (int) buffers.size(), (int) textures.size(), programsFromBinary + programsFromSource,
+           programsFromBinary, restoreTimeMs);
+    CheckGLError("MyGPUResources::Restore");
+}
+
+GPUResourceStats MyGPUResources::GetStats() const {
+
+    GPUResourceStats stats;
+    stats.buffers = stats.textures = stats.programs = 0;
+    stats.contentBytes = stats.sourceBytes = stats.binaryBytes = 0;
+    for (size_t i = 0; i < resources.size(); i++) {
+        const Resource & resource = resources[i];
+        stats.buffers += resource.type == RESOURCE_BUFFER;
+        stats.textures += resource.type == RESOURCE_TEXTURE;
+        stats.programs += resource.type == RESOURCE_PROGRAM;
+        stats.contentBytes += resource.contents.size();
+        stats.sourceBytes += resource.vertexSource.size() + resource.fragmentSource.size() +
+                             resource.computeSource.size();
+        stats.binaryBytes += resource.binary.size();
+    }
+    stats.programsFromBinary = programsFromBinary;
+    stats.programsFromSource = programsFromSource;
+    stats.failedPrograms = failedPrograms;
+    stats.restoreTimeMs = restoreTimeMs;
+    return stats;
+}
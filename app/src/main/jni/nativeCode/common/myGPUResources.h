@@ -0,0 +1,146 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+
+#ifndef MY_GPU_RESOURCES_H
+#define MY_GPU_RESOURCES_H
+
+#include "myGLFunctions.h"
+#include <EGL/egl.h>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+// a handle is a slot index in the low bits and the slot's generation in the high bits, so
+// a handle kept after Destroy never resolves to the object that reused its slot
+typedef uint32_t GPUHandle;
+#define GPU_NULL_HANDLE         0
+#define GPU_HANDLE_INDEX_BITS   20
+#define GPU_HANDLE_INDEX_MASK   ((1u << GPU_HANDLE_INDEX_BITS) - 1)
+#define GPU_HANDLE_MAX_GENERATION ((1u << (32 - GPU_HANDLE_INDEX_BITS)) - 1)
+
+// attribute names bound to fixed locations before a program is linked
+typedef std::vector<std::pair<std::string, GLuint> > AttributeBindings;
+
+struct GPUTextureDesc {
+    GLenum  internalFormat, format, type;
+    GLsizei width, height;
+    GLint   minFilter, magFilter, wrap;
+};
+
+struct GPUResourceStats {
+    int     buffers, textures, programs;
+    size_t  contentBytes;   // CPU copies of buffer and texture contents
+    size_t  sourceBytes;    // shader sources kept to rebuild programs
+    size_t  binaryBytes;    // program binaries, GLES 3 only
+    // of the last Restore
+    int     programsFromBinary, programsFromSource, failedPrograms;
+    double  restoreTimeMs;
+};
+
+/**
+ * Owns the GL buffers, textures and programs that have to outlive the GL context. Android
+ * destroys the context when the app goes to the background, so everything needed to build
+ * an object again is kept on the CPU: its size and format, a copy of its contents unless
+ * the owner refills it, and a program's sources and, on GLES 3, its binary. Restore then
+ * recreates all of them in one pass with a single glGen call per kind.
+ *
+ * Owners keep handles and look the GL name up when they bind, names change on Restore.
+ * Objects that only make sense in one context, like framebuffers, vertex arrays, queries
+ * and fences, are not managed here and are rebuilt by their owners.
+ */
+class MyGPUResources {
+public:
+    MyGPUResources();
+    ~MyGPUResources();
+    void    CreateGLObjects();
+
+    // with keepContents a copy of the data is kept for Restore, otherwise the buffer
+    // comes back with undefined contents of the same size for the owner to refill
+    GPUHandle CreateBuffer(GLenum target, GLenum usage, bool keepContents);
+    void    BufferData(GPUHandle handle, GLsizeiptr size, const void * data);
+    void    BufferSubData(GPUHandle handle, GLintptr offset, GLsizeiptr size, const void * data);
+
+    GPUHandle CreateTexture(const GPUTextureDesc & desc, const void * data, bool keepContents);
+    void    TexImage(GPUHandle handle, GLsizei width, GLsizei height, const void * data);
+
+    GPUHandle CreateProgram(const std::string & vertexSource, const std::string & fragmentSource,
+                            const AttributeBindings & attributes = AttributeBindings());
+    GPUHandle CreateComputeProgram(const std::string & computeSource);
+    GPUHandle LoadProgram(std::string vertexShaderFilename, std::string fragmentShaderFilename);
+    GPUHandle LoadComputeProgram(std::string computeShaderFilename);
+    // take over a program linked elsewhere, e.g. on the shader cache's thread
+    GPUHandle AdoptProgram(GLuint programID, const std::string & vertexSource,
+                           const std::string & fragmentSource,
+                           const AttributeBindings & attributes);
+
+    void    Destroy(GPUHandle handle);
+    bool    IsValid(GPUHandle handle) const;
+    GLuint  GetName(GPUHandle handle) const;
+
+    bool    IsContextLost() const;
+    void    Restore();
+    GPUResourceStats GetStats() const;
+
+private:
+    enum ResourceType {
+        RESOURCE_FREE,
+        RESOURCE_BUFFER,
+        RESOURCE_TEXTURE,
+        RESOURCE_PROGRAM
+    };
+
+    struct Resource {
+        ResourceType    type;
+        uint32_t        generation;
+        GLuint          name;       // 0 for a program that failed to restore
+        bool            keepContents;
+        std::vector<char> contents;
+
+        // buffers
+        GLenum          target, usage;
+        GLsizeiptr      size;
+        // textures
+        GPUTextureDesc  texture;
+        // programs, either a vertex and fragment shader or a compute shader
+        std::string     vertexSource, fragmentSource, computeSource;
+        AttributeBindings attributes;
+        GLenum          binaryFormat;
+        std::vector<char> binary;
+    };
+
+    GPUHandle   Allocate(ResourceType type);
+    Resource *  Lookup(GPUHandle handle, ResourceType type);
+    GLuint      BuildProgram(const Resource & resource) const;
+    void        SaveProgramBinary(Resource & resource);
+    bool        LoadProgramBinary(Resource & resource);
+    void        UploadTexture(const Resource & resource, const void * data,
+                              bool setParameters) const;
+
+    std::vector<Resource>   resources;
+    std::vector<uint32_t>   freeSlots;
+
+    // the context the names belong to, and a buffer of it whose name a new context does
+    // not know, in case the new context was created at the same address
+    EGLContext  context;
+    GLuint      sentinelBuffer;
+
+    int         programsFromBinary, programsFromSource, failedPrograms;
+    double      restoreTimeMs;
+};
+
+#endif //MY_GPU_RESOURCES_H
@@ -0,0 +1,163 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include "myGPUTimer.h"
+#include "myLogger.h"
+#include <EGL/egl.h>
+#include <string.h>
+
+typedef void (GL_APIENTRY * GenQueriesProc) (GLsizei n, GLuint * ids);
+typedef void (GL_APIENTRY * DeleteQueriesProc) (GLsizei n, const GLuint * ids);
+typedef void (GL_APIENTRY * BeginQueryProc) (GLenum target, GLuint id);
+typedef void (GL_APIENTRY * EndQueryProc) (GLenum target);
+typedef void (GL_APIENTRY * GetQueryObjectuivProc) (GLuint id, GLenum pname, GLuint * params);
+typedef void (GL_APIENTRY * GetQueryObjectui64vProc) (GLuint id, GLenum pname,
+                                                      GLuint64 * params);
+
+static GenQueriesProc           genQueries = NULL;
+static DeleteQueriesProc        deleteQueries = NULL;
+static BeginQueryProc           beginQuery = NULL;
+static EndQueryProc             endQuery = NULL;
+static GetQueryObjectuivProc    getQueryObjectuiv = NULL;
+static GetQueryObjectui64vProc  getQueryObjectui64v = NULL;
+
+MyGPUTimer::MyGPUTimer() {
+
+    isSupported = false;
+    memset(queries, 0, sizeof(queries));
+    oldestQuery = pendingQueries = 0;
+    queryActive = false;
+    hasNewResult = false;
+    latestTimeMs = 0;
+}
+
+MyGPUTimer::~MyGPUTimer() {
+
+    if (isSupported) {
+        deleteQueries(GPU_TIMER_QUERIES, queries);
+    }
+}
+
+/**
+ * Fetch the extension's functions and create the queries, needs the GL context.
+ * Returns false if the driver cannot time GPU work.
+ */
+bool MyGPUTimer::Init() {
+
+    isSupported = false;
+    oldestQuery = pendingQueries = 0;
+    queryActive = false;
+
+    const char * extensionsStr = (const char *) glGetString(GL_EXTENSIONS);
+    if (extensionsStr == NULL || strstr(extensionsStr, "GL_EXT_disjoint_timer_query") == NULL) {
+        MyLOGD("EXT_disjoint_timer_query not supported, GPU frame time is unavailable");
+        return false;
+    }
+
+    genQueries = (GenQueriesProc) eglGetProcAddress("glGenQueriesEXT");
+    deleteQueries = (DeleteQueriesProc) eglGetProcAddress("glDeleteQueriesEXT");
+    beginQuery = (BeginQueryProc) eglGetProcAddress("glBeginQueryEXT");
+    endQuery = (EndQueryProc) eglGetProcAddress("glEndQueryEXT");
+    getQueryObjectuiv = (GetQueryObjectuivProc) eglGetProcAddress("glGetQueryObjectuivEXT");
+    getQueryObjectui64v = (GetQueryObjectui64vProc)
+            eglGetProcAddress("glGetQueryObjectui64vEXT");
+    if (!genQueries || !deleteQueries || !beginQuery || !endQuery || !getQueryObjectuiv ||
+        !getQueryObjectui64v) {
+        MyLOGW("EXT_disjoint_timer_query is advertised but its functions are missing");
+        return false;
+    }
+
+    genQueries(GPU_TIMER_QUERIES, queries);
+    // clear a stale disjoint flag so that the first results are not thrown away
+    GLint disjoint;
+    glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+    isSupported = true;
+    CheckGLError("MyGPUTimer::Init");
+    return true;
+}
+
+/**
+ * Start timing the GPU commands of this frame. If every query is still in flight the
+ * frame is not timed, rather than stalling until the oldest one is done.
+ */
+void MyGPUTimer::BeginFrame() {
+
+    if (!isSupported) {
+        return;
+    }
+
+    CollectResults();
+    if (pendingQueries == GPU_TIMER_QUERIES) {
+        return;
+    }
+    int query = (oldestQuery + pendingQueries) % GPU_TIMER_QUERIES;
+    beginQuery(GL_TIME_ELAPSED_EXT, queries[query]);
+    queryActive = true;
+}
+
+void MyGPUTimer::EndFrame() {
+
+    if (!queryActive) {
+        return;
+    }
+    endQuery(GL_TIME_ELAPSED_EXT);
+    pendingQueries++;
+    queryActive = false;
+}
+
+/**
+ * Read every query that has finished, oldest first. Results are dropped if the GPU
+ * reported a disjoint event, e.g. a frequency change, since they may be meaningless.
+ */
+void MyGPUTimer::CollectResults() {
+
+    while (pendingQueries > 0) {
+        GLuint available = 0;
+        getQueryObjectuiv(queries[oldestQuery], GL_QUERY_RESULT_AVAILABLE_EXT, &available);
+        if (!available) {
+            break;
+        }
+        GLuint64 elapsedNs = 0;
+        getQueryObjectui64v(queries[oldestQuery], GL_QUERY_RESULT_EXT, &elapsedNs);
+        oldestQuery = (oldestQuery + 1) % GPU_TIMER_QUERIES;
+        pendingQueries--;
+
+        GLint disjoint = 0;
+        glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+        if (!disjoint) {
+            latestTimeMs = elapsedNs / 1.0e6f;
+            hasNewResult = true;
+        }
+    }
+}
+
+/**
+ * Returns true and the GPU time of the most recently completed frame if one has completed
+ * since the last call
+ */
+bool MyGPUTimer::GetLatestTimeMs(float & timeMs) {
+
+    if (!isSupported) {
+        return false;
+    }
+    CollectResults();
+    if (!hasNewResult) {
+        return false;
+    }
+    timeMs = latestTimeMs;
+    hasNewResult = false;
+    return true;
+}
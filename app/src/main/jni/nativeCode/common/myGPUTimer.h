@@ -0,0 +1,63 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#ifndef MY_GPU_TIMER_H
+#define MY_GPU_TIMER_H
+
+#include "myGLFunctions.h"
+
+// frames whose timer queries may be in flight at once, results are read this many frames late
+#define GPU_TIMER_QUERIES   4
+
+// EXT_disjoint_timer_query is not in the API 19 headers, its functions are fetched at runtime
+#ifndef GL_TIME_ELAPSED_EXT
+#define GL_TIME_ELAPSED_EXT             0x88BF
+#endif
+#ifndef GL_QUERY_RESULT_EXT
+#define GL_QUERY_RESULT_EXT             0x8866
+#define GL_QUERY_RESULT_AVAILABLE_EXT   0x8867
+#endif
+#ifndef GL_GPU_DISJOINT_EXT
+#define GL_GPU_DISJOINT_EXT             0x8FBB
+#endif
+
+/**
+ * Measures how long the GPU spends on each frame with EXT_disjoint_timer_query.
+ * Queries are polled, never waited on, so a result arrives a few frames after its frame.
+ */
+class MyGPUTimer {
+public:
+    MyGPUTimer();
+    ~MyGPUTimer();
+    bool    Init();
+    bool    IsSupported() const { return isSupported; }
+    void    BeginFrame();
+    void    EndFrame();
+    bool    GetLatestTimeMs(float & timeMs);
+
+private:
+    void    CollectResults();
+
+    bool    isSupported;
+    GLuint  queries[GPU_TIMER_QUERIES];
+    int     oldestQuery, pendingQueries;
+    bool    queryActive;    // BeginFrame started a query that EndFrame has to end
+
+    bool    hasNewResult;
+    float   latestTimeMs;
+};
+
+#endif //MY_GPU_TIMER_H
@@ -16,7 +16,9 @@
 
 #include "myJNIHelper.h"
 #include "misc.h"
+#include "myJobSystem.h"
 #include <android/asset_manager_jni.h>
+#include <atomic>
 
 MyJNIHelper::MyJNIHelper(JNIEnv *env, jobject obj, jobject assetManager, jstring pathToInternalDir) {
 
@@ -32,13 +34,43 @@ MyJNIHelper::MyJNIHelper(JNIEnv *env, jobject obj, jobject assetManager, jstring
 
     //mutex for thread safety
     pthread_mutex_init(&threadMutex, NULL );
+
+    OpenAssetPack();
 }
 
 MyJNIHelper::~MyJNIHelper()
 {
+    if (packAsset) {
+        AAsset_close(packAsset);
+    }
     pthread_mutex_destroy( &threadMutex);
 }
 
+/**
+ * Map the asset pack if the APK has one, it is optional so its absence is not an error
+ */
+void MyJNIHelper::OpenAssetPack() {
+
+    packAsset = AAssetManager_open(apkAssetManager, ASSET_PACK_NAME, AASSET_MODE_BUFFER);
+    if (packAsset == NULL) {
+        MyLOGI("No asset pack, reading assets from their files");
+        return;
+    }
+    if (AAsset_isAllocated(packAsset)) {
+        MyLOGI("Asset pack is compressed in the APK and was copied");
+    }
+    const uint8_t *data = (const uint8_t *) AAsset_getBuffer(packAsset);
+    std::string error;
+    if (data == NULL ||
+        !assetPack.Open(data, (size_t) AAsset_getLength(packAsset), error)) {
+        MyLOGE("Cannot open asset pack: %s", data ? error.c_str() : "not mapped");
+        AAsset_close(packAsset);
+        packAsset = NULL;
+        return;
+    }
+    MyLOGI("Asset pack has %d assets", assetPack.GetEntryCount());
+}
+
 /**
  * Search for a file in assets, extract it, save it in internal storage, and return the new path
  */
@@ -92,3 +124,106 @@ bool MyJNIHelper::ExtractAssetReturnFilename(std::string assetName, std::string
     return result;
 
 }
+
+/**
+ * Open an asset and map its contents without copying them, the data stays valid until
+ * CloseAsset. Only assets stored uncompressed in the APK are mapped, others are inflated
+ * into a buffer by the asset manager.
+ */
+AAsset *MyJNIHelper::OpenAssetBuffer(const char *assetName, const uint8_t **data,
+                                     size_t *size) {
+
+    pthread_mutex_lock( &threadMutex);
+
+    AAsset* asset = AAssetManager_open(apkAssetManager, assetName, AASSET_MODE_BUFFER);
+    if (asset != NULL)
+    {
+        *data = (const uint8_t *) AAsset_getBuffer(asset);
+        *size = (size_t) AAsset_getLength(asset);
+        if (*data == NULL)
+        {
+            MyLOGE("Could not map asset: %s", assetName);
+            AAsset_close(asset);
+            asset = NULL;
+        }
+        else if (AAsset_isAllocated(asset))
+        {
+            MyLOGI("Asset is compressed in the APK and was copied: %s", assetName);
+        }
+    }
+    else
+    {
+        MyLOGE("Asset not found: %s", assetName);
+    }
+
+    pthread_mutex_unlock( &threadMutex);
+    return asset;
+}
+
+void MyJNIHelper::CloseAsset(AAsset *asset) {
+
+    pthread_mutex_lock( &threadMutex);
+    AAsset_close(asset);
+    pthread_mutex_unlock( &threadMutex);
+}
+
+/**
+ * Contents of an asset that is stored uncompressed in the pack, valid as long as the
+ * helper. NULL if it is not in the pack or compressed there, see ReadPackedAsset.
+ */
+const uint8_t *MyJNIHelper::FindPackedAsset(const char *assetName, size_t *size) const {
+
+    int entry = assetPack.FindEntry(assetName);
+    if (entry == ASSET_PACK_NO_ENTRY) {
+        return NULL;
+    }
+    *size = assetPack.GetEntry(entry).size;
+    return assetPack.GetStoredData(entry);
+}
+
+struct PackedAssetJob {
+    const MyAssetPack * pack;
+    int     entry;
+    uint8_t * output;
+    std::atomic<int> failedBlocks;
+};
+
+static void DecompressPackedAsset(void * data, int begin, int end) {
+
+    PackedAssetJob * job = (PackedAssetJob *) data;
+    if (!job->pack->DecompressBlocks(job->entry, begin, end, job->output)) {
+        job->failedBlocks += end - begin;
+    }
+}
+
+/**
+ * Copy an asset from the pack into buffer, decompressing it if needed. The blocks of a
+ * large asset are decompressed on the job system's workers if one is given. Returns false
+ * if the asset is not in the pack or is corrupt.
+ */
+bool MyJNIHelper::ReadPackedAsset(const char *assetName, std::vector<uint8_t> &buffer,
+                                  MyJobSystem *jobSystem) const {
+
+    int entry = assetPack.FindEntry(assetName);
+    if (entry == ASSET_PACK_NO_ENTRY) {
+        return false;
+    }
+    int blockCount = assetPack.GetBlockCount(entry);
+    bool result;
+    if (jobSystem == NULL || blockCount < 2) {
+        result = assetPack.ReadEntry(entry, buffer);
+    } else {
+        buffer.resize(assetPack.GetEntry(entry).size);
+        PackedAssetJob job;
+        job.pack = &assetPack;
+        job.entry = entry;
+        job.output = buffer.data();
+        job.failedBlocks = 0;
+        jobSystem->ParallelFor(DecompressPackedAsset, &job, blockCount, 1);
+        result = job.failedBlocks == 0;
+    }
+    if (!result) {
+        MyLOGE("Corrupt asset in pack: %s", assetName);
+    }
+    return result;
+}
@@ -18,12 +18,19 @@
 #define MY_JNI_HELPER_H
 
 #include "myLogger.h"
+#include "myAssetPack.h"
 #include <android_native_app_glue.h>
 #include <pthread.h>
 #include <string>
 #include <jni.h>
 #include <vector>
 
+// assets may be packed into this one asset by tools/assetPacker, it has to be stored
+// uncompressed in the APK to be mapped; assets not in it are read from their own files
+#define ASSET_PACK_NAME "assets.pack"
+
+class MyJobSystem;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -34,6 +41,10 @@ private:
     mutable pthread_mutex_t threadMutex;
     std::string apkInternalPath;
     AAssetManager *apkAssetManager;
+    AAsset *packAsset; // mapped for as long as the helper lives, NULL without a pack
+    MyAssetPack assetPack;
+
+    void OpenAssetPack();
 
 public:
     MyJNIHelper(JNIEnv *env, jobject obj, jobject assetManager, jstring pathToInternalDir);
@@ -46,6 +57,17 @@ public:
                                     bool checkIfFileIsAvailable = false);
 
     bool ReadFileFromAssetsToBuffer(const char *filename, std::vector<uint8_t> *bufferRef);
+
+    AAsset *OpenAssetBuffer(const char *assetName, const uint8_t **data, size_t *size);
+
+    void CloseAsset(AAsset *asset);
+
+    const uint8_t *FindPackedAsset(const char *assetName, size_t *size) const;
+
+    bool ReadPackedAsset(const char *assetName, std::vector<uint8_t> &buffer,
+                         MyJobSystem *jobSystem = NULL) const;
+
+    std::string GetInternalPath() const { return apkInternalPath; }
 };
 
 extern MyJNIHelper *gHelperObject;
@@ -0,0 +1,475 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include "myJobSystem.h"
+#include "myLogger.h"
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+JobCounter::JobCounter() {
+
+    pending.store(0);
+    pthread_mutex_init(&continuationMutex, NULL);
+}
+
+JobCounter::~JobCounter() {
+
+    pthread_mutex_destroy(&continuationMutex);
+}
+
+JobDeque::JobDeque() {
+
+    top.store(0);
+    bottom.store(0);
+    for (int i = 0; i < JOB_DEQUE_SIZE; i++) {
+        jobs[i].store(NULL, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * Add a job at the bottom, returns false if the deque is full
+ */
+bool JobDeque::Push(Job * job) {
+
+    long b = bottom.load(std::memory_order_relaxed);
+    long t = top.load(std::memory_order_acquire);
+    if (b - t >= JOB_DEQUE_SIZE) {
+        return false;
+    }
+    jobs[b & (JOB_DEQUE_SIZE - 1)].store(job, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom.store(b + 1, std::memory_order_relaxed);
+    return true;
+}
+
+/**
+ * Take the most recently pushed job, races with thieves only for the last job
+ */
+Job * JobDeque::Pop() {
+
+    long b = bottom.load(std::memory_order_relaxed) - 1;
+    bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    long t = top.load(std::memory_order_relaxed);
+
+    if (t > b) {
+        // deque was empty
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return NULL;
+    }
+
+    Job * job = jobs[b & (JOB_DEQUE_SIZE - 1)].load(std::memory_order_relaxed);
+    if (t == b) {
+        // last job, a thief may be taking it too
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                         std::memory_order_relaxed)) {
+            job = NULL;
+        }
+        bottom.store(b + 1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+/**
+ * Take the oldest job, called by threads other than the owner
+ */
+Job * JobDeque::Steal() {
+
+    long t = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    long b = bottom.load(std::memory_order_acquire);
+
+    if (t >= b) {
+        return NULL;
+    }
+
+    Job * job = jobs[t & (JOB_DEQUE_SIZE - 1)].load(std::memory_order_relaxed);
+    if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                     std::memory_order_relaxed)) {
+        return NULL;
+    }
+    return job;
+}
+
+/**
+ * Big cores are the ones with the highest max frequency, on symmetric CPUs this is all cores
+ */
+int MyJobSystem::CountBigCores() {
+
+    int numCores = (int) sysconf(_SC_NPROCESSORS_CONF);
+    std::vector<long> maxFrequencies(numCores, 0);
+    long highestFrequency = 0;
+
+    for (int i = 0; i < numCores; i++) {
+        char path[128];
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpufreq/cpuinfo_max_freq", i);
+        FILE * file = fopen(path, "r");
+        if (file) {
+            if (fscanf(file, "%ld", &maxFrequencies[i]) != 1) {
+                maxFrequencies[i] = 0;
+            }
+            fclose(file);
+        }
+        if (maxFrequencies[i] > highestFrequency) {
+            highestFrequency = maxFrequencies[i];
+        }
+    }
+
+    if (highestFrequency == 0) {
+        // cpufreq is not readable, assume all online cores are equal
+        int numOnline = (int) sysconf(_SC_NPROCESSORS_ONLN);
+        return numOnline > 0 ? numOnline : 1;
+    }
+
+    int numBigCores = 0;
+    for (int i = 0; i < numCores; i++) {
+        if (maxFrequencies[i] == highestFrequency) {
+            numBigCores++;
+        }
+    }
+    return numBigCores;
+}
+
+MyJobSystem::MyJobSystem(int numWorkers) {
+
+    if (numWorkers < 0) {
+        // the thread that waits on jobs also runs them, so it takes one of the big cores
+        numWorkers = CountBigCores() - 1;
+    }
+
+    quit.store(false);
+    queuedJobs.store(0);
+    sleepingWorkers.store(0);
+    pthread_mutex_init(&sleepMutex, NULL);
+    pthread_cond_init(&sleepCondition, NULL);
+    pthread_key_create(&threadKey, NULL);
+    pthread_mutex_init(&externalMutex, NULL);
+    mainThread.store(pthread_self());
+
+    for (int i = 0; i <= numWorkers + 1; i++) {
+        ThreadState * state = new ThreadState();
+        state->jobSystem = this;
+        state->index = i <= numWorkers ? i : JOB_EXTERNAL_THREAD;
+        for (int j = 0; j < JOB_POOL_SIZE; j++) {
+            state->jobPool[j].finished.store(true, std::memory_order_relaxed);
+        }
+        state->nextPoolJob = 0;
+        state->randomSeed = (unsigned int) (i + 1) * 2654435761u;
+        if (i <= numWorkers) {
+            threadStates.push_back(state);
+        } else {
+            externalState = state;
+        }
+    }
+
+    // start workers only after all states exist since they steal from each other
+    for (int i = 1; i <= numWorkers; i++) {
+        pthread_create(&threadStates[i]->thread, NULL, WorkerLoop, threadStates[i]);
+    }
+    MyLOGD("Job system started with %d worker threads", numWorkers);
+}
+
+MyJobSystem::~MyJobSystem() {
+
+    quit.store(true);
+    pthread_mutex_lock(&sleepMutex);
+    pthread_cond_broadcast(&sleepCondition);
+    pthread_mutex_unlock(&sleepMutex);
+
+    for (size_t i = 1; i < threadStates.size(); i++) {
+        pthread_join(threadStates[i]->thread, NULL);
+    }
+    for (size_t i = 0; i < threadStates.size(); i++) {
+        delete threadStates[i];
+    }
+    delete externalState;
+
+    pthread_mutex_destroy(&externalMutex);
+    pthread_key_delete(threadKey);
+    pthread_cond_destroy(&sleepCondition);
+    pthread_mutex_destroy(&sleepMutex);
+}
+
+/**
+ * Make the calling thread the one that owns index 0, by default it is the thread that
+ * created the job system. Call it before the thread submits work, while the previous main
+ * thread submits none.
+ */
+void MyJobSystem::RegisterMainThread() {
+
+    mainThread.store(pthread_self());
+}
+
+/**
+ * Workers return their own index and the main thread 0, any other thread
+ * JOB_EXTERNAL_THREAD
+ */
+int MyJobSystem::GetThreadIndex() const {
+
+    ThreadState * state = (ThreadState *) pthread_getspecific(threadKey);
+    if (state) {
+        return state->index;
+    }
+    return pthread_equal(pthread_self(), mainThread.load()) ? 0 : JOB_EXTERNAL_THREAD;
+}
+
+/**
+ * State owned by the calling thread, or the shared one of external threads which has to be
+ * used under externalMutex
+ */
+MyJobSystem::ThreadState * MyJobSystem::GetThreadState() {
+
+    int index = GetThreadIndex();
+    return index == JOB_EXTERNAL_THREAD ? externalState : threadStates[index];
+}
+
+/**
+ * Jobs live in a per-thread ring of JOB_POOL_SIZE. Slots whose job is still queued, waiting
+ * on a dependency or running are skipped, and when all of them are the caller runs queued
+ * jobs until one finishes, so a burst of submissions never overwrites a job.
+ */
+Job * MyJobSystem::AllocateJob() {
+
+    ThreadState * state = GetThreadState();
+    while (true) {
+        if (state == externalState) {
+            pthread_mutex_lock(&externalMutex);
+        }
+        Job * job = NULL;
+        for (int i = 0; i < JOB_POOL_SIZE && job == NULL; i++) {
+            Job * slot = &state->jobPool[state->nextPoolJob & (JOB_POOL_SIZE - 1)];
+            state->nextPoolJob++;
+            if (slot->finished.load(std::memory_order_acquire)) {
+                slot->finished.store(false, std::memory_order_relaxed);
+                job = slot;
+            }
+        }
+        if (state == externalState) {
+            pthread_mutex_unlock(&externalMutex);
+        }
+        if (job) {
+            return job;
+        }
+        if (!RunQueuedJob(state)) {
+            sched_yield();
+        }
+    }
+}
+
+/**
+ * Queue a job on the calling thread's deque and wake a sleeping worker
+ */
+void MyJobSystem::PushJob(Job * job) {
+
+    ThreadState * state = GetThreadState();
+    if (state == externalState) {
+        pthread_mutex_lock(&externalMutex);
+    }
+    bool pushed = state->deque.Push(job);
+    if (state == externalState) {
+        pthread_mutex_unlock(&externalMutex);
+    }
+    if (!pushed) {
+        // deque is full, run the job right away instead of failing
+        Execute(job);
+        return;
+    }
+
+    queuedJobs.fetch_add(1);
+    if (sleepingWorkers.load() > 0) {
+        pthread_mutex_lock(&sleepMutex);
+        pthread_cond_signal(&sleepCondition);
+        pthread_mutex_unlock(&sleepMutex);
+    }
+}
+
+/**
+ * Schedule function(data, begin, end). If dependency is given the job starts after it is done.
+ */
+void MyJobSystem::Submit(JobFunction function, void * data, int begin, int end,
+                         JobCounter * counter, JobCounter * dependency) {
+
+    Job * job = AllocateJob();
+    job->function = function;
+    job->data = data;
+    job->begin = begin;
+    job->end = end;
+    job->counter = counter;
+    if (counter) {
+        counter->pending.fetch_add(1);
+    }
+
+    if (dependency) {
+        pthread_mutex_lock(&dependency->continuationMutex);
+        if (!dependency->IsDone()) {
+            dependency->continuations.push_back(job);
+            pthread_mutex_unlock(&dependency->continuationMutex);
+            return;
+        }
+        pthread_mutex_unlock(&dependency->continuationMutex);
+    }
+    PushJob(job);
+}
+
+/**
+ * Run a job and release the jobs waiting on its counter if it was the last one
+ */
+void MyJobSystem::Execute(Job * job) {
+
+    job->function(job->data, job->begin, job->end);
+
+    JobCounter * counter = job->counter;
+    job->finished.store(true, std::memory_order_release);
+    if (counter == NULL) {
+        return;
+    }
+
+    // decrement under the lock so that Wait cannot return and destroy the counter
+    // while we still hold its mutex
+    std::vector<Job *> readyJobs;
+    pthread_mutex_lock(&counter->continuationMutex);
+    if (counter->pending.fetch_sub(1) == 1) {
+        readyJobs.swap(counter->continuations);
+    }
+    pthread_mutex_unlock(&counter->continuationMutex);
+
+    for (size_t i = 0; i < readyJobs.size(); i++) {
+        PushJob(readyJobs[i]);
+    }
+}
+
+Job * MyJobSystem::PopJob(ThreadState * state) {
+
+    if (state != externalState) {
+        return state->deque.Pop();
+    }
+    pthread_mutex_lock(&externalMutex);
+    Job * job = state->deque.Pop();
+    pthread_mutex_unlock(&externalMutex);
+    return job;
+}
+
+/**
+ * Pop from our own deque first, otherwise try to steal from a random victim, the external
+ * threads' deque included
+ */
+Job * MyJobSystem::FindJob(ThreadState * state) {
+
+    Job * job = PopJob(state);
+    if (job) {
+        return job;
+    }
+
+    int numVictims = (int) threadStates.size() + 1;
+    if (state == externalState) {
+        pthread_mutex_lock(&externalMutex);
+    }
+    state->randomSeed = state->randomSeed * 1103515245u + 12345u;
+    int start = (int) ((state->randomSeed >> 16) % numVictims);
+    if (state == externalState) {
+        pthread_mutex_unlock(&externalMutex);
+    }
+    for (int i = 0; i < numVictims; i++) {
+        int victim = (start + i) % numVictims;
+        ThreadState * victimState = victim < (int) threadStates.size() ? threadStates[victim]
+                                                                       : externalState;
+        if (victimState == state) {
+            continue;
+        }
+        job = victimState->deque.Steal();
+        if (job) {
+            return job;
+        }
+    }
+    return NULL;
+}
+
+void * MyJobSystem::WorkerLoop(void * arg) {
+
+    ThreadState * state = (ThreadState *) arg;
+    MyJobSystem * jobSystem = state->jobSystem;
+    pthread_setspecific(jobSystem->threadKey, state);
+
+    while (!jobSystem->quit.load()) {
+
+        if (jobSystem->RunQueuedJob(state)) {
+            continue;
+        }
+
+        // nothing to run: sleep until Submit queues more work
+        pthread_mutex_lock(&jobSystem->sleepMutex);
+        jobSystem->sleepingWorkers.fetch_add(1);
+        while (jobSystem->queuedJobs.load() <= 0 && !jobSystem->quit.load()) {
+            pthread_cond_wait(&jobSystem->sleepCondition, &jobSystem->sleepMutex);
+        }
+        jobSystem->sleepingWorkers.fetch_sub(1);
+        pthread_mutex_unlock(&jobSystem->sleepMutex);
+    }
+    return NULL;
+}
+
+/**
+ * Run one job from our deque or a stolen one, returns false if there was none
+ */
+bool MyJobSystem::RunQueuedJob(ThreadState * state) {
+
+    Job * job = FindJob(state);
+    if (job == NULL) {
+        return false;
+    }
+    queuedJobs.fetch_sub(1);
+    Execute(job);
+    return true;
+}
+
+/**
+ * Block until counter reaches zero, the calling thread runs jobs meanwhile
+ */
+void MyJobSystem::Wait(JobCounter * counter) {
+
+    ThreadState * state = GetThreadState();
+    while (!counter->IsDone()) {
+        if (!RunQueuedJob(state)) {
+            sched_yield();
+        }
+    }
+
+    // the last job may still be releasing the counter's mutex
+    pthread_mutex_lock(&counter->continuationMutex);
+    pthread_mutex_unlock(&counter->continuationMutex);
+}
+
+/**
+ * Split [0, count) into batches, run them on all threads, and return when all are done
+ */
+void MyJobSystem::ParallelFor(JobFunction function, void * data, int count, int batchSize) {
+
+    if (count <= 0) {
+        return;
+    }
+    if (batchSize < 1) {
+        batchSize = 1;
+    }
+
+    JobCounter counter;
+    for (int begin = 0; begin < count; begin += batchSize) {
+        int end = begin + batchSize < count ? begin + batchSize : count;
+        Submit(function, data, begin, end, &counter);
+    }
+    Wait(&counter);
+}
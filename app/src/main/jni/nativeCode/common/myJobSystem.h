@@ -0,0 +1,130 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#ifndef MY_JOB_SYSTEM_H
+#define MY_JOB_SYSTEM_H
+
+#include <pthread.h>
+#include <atomic>
+#include <vector>
+
+// max jobs that a thread can have queued or in flight, both must be powers of 2; a thread
+// that submits more runs queued jobs until a slot of its pool is free again
+#define JOB_DEQUE_SIZE  4096
+#define JOB_POOL_SIZE   4096
+// GetThreadIndex of threads that are neither workers nor the main thread
+#define JOB_EXTERNAL_THREAD -1
+
+// a job processes items [begin, end) of whatever data it is handed
+typedef void (*JobFunction)(void * data, int begin, int end);
+
+struct Job;
+
+/**
+ * Tracks a group of jobs. Jobs that depend on the group are started once it reaches zero.
+ * A counter must not be reused before the jobs it tracks have finished.
+ */
+class JobCounter {
+public:
+    JobCounter();
+    ~JobCounter();
+    bool    IsDone() const { return pending.load(std::memory_order_acquire) == 0; }
+
+private:
+    friend class MyJobSystem;
+    std::atomic<int>    pending;
+    pthread_mutex_t     continuationMutex;
+    std::vector<Job *>  continuations;
+};
+
+struct Job {
+    JobFunction function;
+    void *      data;
+    int         begin, end;
+    JobCounter* counter;     // decremented when the job finishes, can be NULL
+    std::atomic<bool> finished; // the pool slot may be reused
+};
+
+/**
+ * Chase-Lev work-stealing deque. Only the owning thread calls Push and Pop,
+ * any thread can call Steal.
+ */
+class JobDeque {
+public:
+    JobDeque();
+    bool    Push(Job * job);
+    Job *   Pop();
+    Job *   Steal();
+
+private:
+    std::atomic<long>   top, bottom;
+    std::atomic<Job *>  jobs[JOB_DEQUE_SIZE];
+};
+
+class MyJobSystem {
+public:
+    MyJobSystem(int numWorkers = -1); // -1 picks one worker per big core besides the caller
+    ~MyJobSystem();
+    void    Submit(JobFunction function, void * data, int begin, int end,
+                   JobCounter * counter, JobCounter * dependency = NULL);
+    void    Wait(JobCounter * counter);
+    void    ParallelFor(JobFunction function, void * data, int count, int batchSize);
+    void    RegisterMainThread();
+    int     GetNumThreads() const { return (int) threadStates.size(); }
+    int     GetThreadIndex() const;
+
+    static int CountBigCores();
+
+private:
+    // per-thread state, padded to keep neighbouring deques off each other's cache lines
+    struct ThreadState {
+        MyJobSystem *   jobSystem;
+        int             index;
+        pthread_t       thread;
+        JobDeque        deque;
+        Job             jobPool[JOB_POOL_SIZE];
+        unsigned int    nextPoolJob;
+        unsigned int    randomSeed;
+        char            padding[64];
+    };
+
+    static void *   WorkerLoop(void * arg);
+    ThreadState *   GetThreadState();
+    Job *   AllocateJob();
+    bool    RunQueuedJob(ThreadState * state);
+    void    PushJob(Job * job);
+    Job *   PopJob(ThreadState * state);
+    Job *   FindJob(ThreadState * state);
+    void    Execute(Job * job);
+
+    // index 0 belongs to the thread that submits frame work, workers use 1..N
+    std::vector<ThreadState *>  threadStates;
+    pthread_key_t       threadKey;
+    std::atomic<pthread_t> mainThread;
+    // any other thread allocates and queues its jobs here, one thread at a time since the
+    // deque has a single owner end
+    ThreadState *       externalState;
+    pthread_mutex_t     externalMutex;
+    std::atomic<bool>   quit;
+
+    // sleeping workers are woken by Submit
+    std::atomic<int>    queuedJobs;
+    std::atomic<int>    sleepingWorkers;
+    pthread_mutex_t     sleepMutex;
+    pthread_cond_t      sleepCondition;
+};
+
+#endif //MY_JOB_SYSTEM_H
@@ -0,0 +1,289 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+
+#include "myKTX.h"
+#include <algorithm>
+#include <string.h>
+
+#define KTX_IDENTIFIER_SIZE     12
+#define KTX1_HEADER_SIZE        64
+#define KTX1_ENDIANNESS         0x04030201
+#define KTX2_HEADER_SIZE        80
+#define KTX2_LEVEL_INDEX_SIZE   24
+
+static const uint8_t ktx1Identifier[KTX_IDENTIFIER_SIZE] = {
+        0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n'
+};
+static const uint8_t ktx2Identifier[KTX_IDENTIFIER_SIZE] = {
+        0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'
+};
+
+// ASTC block sizes in the order of their GL and Vulkan enums
+static const int astcBlockSizes[][2] = {
+        {4, 4}, {5, 4}, {5, 5}, {6, 5}, {6, 6}, {8, 5}, {8, 6}, {8, 8},
+        {10, 5}, {10, 6}, {10, 8}, {10, 10}, {12, 10}, {12, 12}
+};
+#define ASTC_BLOCK_SIZE_COUNT   14
+
+static std::vector<TextureFormatInfo> CreateFormatTable() {
+
+    TextureFormatInfo formats[] = {
+            {GL_RGBA8, VK_FORMAT_R8G8B8A8_UNORM, 1, 1, 4, false, TEXTURE_CODEC_NONE},
+            {GL_SRGB8_ALPHA8, VK_FORMAT_R8G8B8A8_SRGB, 1, 1, 4, true, TEXTURE_CODEC_NONE},
+            {GL_ETC1_RGB8_OES, 0, 4, 4, 8, false, TEXTURE_CODEC_ETC1},
+            {GL_COMPRESSED_RGB8_ETC2, 147, 4, 4, 8, false, TEXTURE_CODEC_ETC2_RGB},
+            {GL_COMPRESSED_SRGB8_ETC2, 148, 4, 4, 8, true, TEXTURE_CODEC_ETC2_RGB},
+            {GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2, 149, 4, 4, 8, false,
+                    TEXTURE_CODEC_ETC2_RGB_A1},
+            {GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2, 150, 4, 4, 8, true,
+                    TEXTURE_CODEC_ETC2_RGB_A1},
+            {GL_COMPRESSED_RGBA8_ETC2_EAC, 151, 4, 4, 16, false, TEXTURE_CODEC_ETC2_RGBA},
+            {GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC, 152, 4, 4, 16, true, TEXTURE_CODEC_ETC2_RGBA},
+            {GL_COMPRESSED_R11_EAC, 153, 4, 4, 8, false, TEXTURE_CODEC_EAC_R11},
+            {GL_COMPRESSED_RG11_EAC, 155, 4, 4, 16, false, TEXTURE_CODEC_EAC_RG11},
+    };
+    std::vector<TextureFormatInfo> table(formats, formats + sizeof(formats) / sizeof(formats[0]));
+    for (int i = 0; i < ASTC_BLOCK_SIZE_COUNT; i++) {
+        TextureFormatInfo astc = {(GLenum) (GL_COMPRESSED_RGBA_ASTC_4x4_KHR + i),
+                                  (uint32_t) (VK_FORMAT_ASTC_4x4_UNORM_BLOCK + 2 * i),
+                                  astcBlockSizes[i][0], astcBlockSizes[i][1], 16, false,
+                                  TEXTURE_CODEC_ASTC};
+        table.push_back(astc);
+        astc.glFormat = (GLenum) (GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4_KHR + i);
+        astc.vkFormat++;
+        astc.srgb = true;
+        table.push_back(astc);
+    }
+    return table;
+}
+
+static const std::vector<TextureFormatInfo> & GetFormatTable() {
+
+    static const std::vector<TextureFormatInfo> table = CreateFormatTable();
+    return table;
+}
+
+const TextureFormatInfo * FindTextureFormat(GLenum glFormat) {
+
+    const std::vector<TextureFormatInfo> & table = GetFormatTable();
+    for (unsigned int i = 0; i < table.size(); i++) {
+        if (table[i].glFormat == glFormat) {
+            return &table[i];
+        }
+    }
+    return NULL;
+}
+
+static const TextureFormatInfo * FindVulkanFormat(uint32_t vkFormat) {
+
+    const std::vector<TextureFormatInfo> & table = GetFormatTable();
+    for (unsigned int i = 0; i < table.size(); i++) {
+        if (vkFormat && table[i].vkFormat == vkFormat) {
+            return &table[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Bytes of a level, partial blocks at the edges count as whole ones
+ */
+size_t GetLevelSize(const TextureFormatInfo & format, int width, int height) {
+
+    size_t blocksX = (width + format.blockWidth - 1) / format.blockWidth;
+    size_t blocksY = (height + format.blockHeight - 1) / format.blockHeight;
+    return blocksX * blocksY * format.blockBytes;
+}
+
+// files are little-endian like every device we run on, and not necessarily aligned
+static uint32_t ReadUint32(const uint8_t * data) {
+
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+static uint64_t ReadUint64(const uint8_t * data) {
+
+    uint64_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+/**
+ * Checked before the levels are allocated: a chain may not go on past the 1x1 level,
+ * floor(log2(max(width, height))) + 1 levels in all
+ */
+static bool CheckSize(const KTXImage & image, uint32_t levelCount, std::string & error) {
+
+    if (image.width <= 0 || image.height <= 0 || image.width > 16384 ||
+        image.height > 16384) {
+        error = "unsupported texture size";
+        return false;
+    }
+    uint32_t fullChainLevels = 1;
+    while ((std::max(image.width, image.height) >> fullChainLevels) > 0) {
+        fullChainLevels++;
+    }
+    if (levelCount > fullChainLevels) {
+        error = "too many mip levels";
+        return false;
+    }
+    return true;
+}
+
+static void SetLevelSize(KTXImage & image, int level) {
+
+    image.levels[level].width = image.width >> level > 1 ? image.width >> level : 1;
+    image.levels[level].height = image.height >> level > 1 ? image.height >> level : 1;
+}
+
+/**
+ * KTX 1: a GL header, key/value data, then each level's size followed by its data padded
+ * to 4 bytes
+ */
+static bool ParseKTX1(const uint8_t * data, size_t size, KTXImage & image,
+                      std::string & error) {
+
+    if (size < KTX1_HEADER_SIZE) {
+        error = "truncated header";
+        return false;
+    }
+    const uint8_t * header = data + KTX_IDENTIFIER_SIZE;
+    if (ReadUint32(header) != KTX1_ENDIANNESS) {
+        error = "big-endian files are not supported";
+        return false;
+    }
+    uint32_t glInternalFormat = ReadUint32(header + 16);
+    image.width = (int) ReadUint32(header + 24);
+    image.height = (int) ReadUint32(header + 28);
+    uint32_t depth = ReadUint32(header + 32);
+    uint32_t arrayElements = ReadUint32(header + 36);
+    uint32_t faces = ReadUint32(header + 40);
+    uint32_t levelCount = ReadUint32(header + 44);
+    uint32_t keyValueBytes = ReadUint32(header + 48);
+
+    image.format = FindTextureFormat(glInternalFormat);
+    if (!image.format) {
+        error = "unsupported internal format";
+        return false;
+    }
+    if (depth > 1 || arrayElements > 0 || faces != 1) {
+        error = "only 2D textures are supported";
+        return false;
+    }
+    if (!CheckSize(image, levelCount, error)) {
+        return false;
+    }
+    // 0 asks the loader to generate mipmaps, which compressed formats cannot
+    image.levels.resize(levelCount > 0 ? levelCount : 1);
+
+    size_t offset = KTX1_HEADER_SIZE + (size_t) keyValueBytes;
+    for (unsigned int i = 0; i < image.levels.size(); i++) {
+        SetLevelSize(image, i);
+        if (offset + 4 > size) {
+            error = "truncated level";
+            return false;
+        }
+        size_t levelSize = ReadUint32(data + offset);
+        offset += 4;
+        if (levelSize != GetLevelSize(*image.format, image.levels[i].width,
+                                      image.levels[i].height) || offset + levelSize > size) {
+            error = "level size does not match its format";
+            return false;
+        }
+        image.levels[i].data = data + offset;
+        image.levels[i].size = levelSize;
+        offset += (levelSize + 3) & ~(size_t) 3;
+    }
+    return true;
+}
+
+/**
+ * KTX 2: a header, an index of where each level starts, then the levels, smallest first
+ * in the file. Supercompressed files (Basis Universal, zstd) are not supported.
+ */
+static bool ParseKTX2(const uint8_t * data, size_t size, KTXImage & image,
+                      std::string & error) {
+
+    if (size < KTX2_HEADER_SIZE) {
+        error = "truncated header";
+        return false;
+    }
+    const uint8_t * header = data + KTX_IDENTIFIER_SIZE;
+    uint32_t vkFormat = ReadUint32(header);
+    image.width = (int) ReadUint32(header + 8);
+    image.height = (int) ReadUint32(header + 12);
+    uint32_t depth = ReadUint32(header + 16);
+    uint32_t layers = ReadUint32(header + 20);
+    uint32_t faces = ReadUint32(header + 24);
+    uint32_t levelCount = ReadUint32(header + 28);
+    uint32_t supercompression = ReadUint32(header + 32);
+
+    image.format = FindVulkanFormat(vkFormat);
+    if (!image.format) {
+        error = "unsupported format";
+        return false;
+    }
+    if (supercompression != 0) {
+        error = "supercompressed files are not supported";
+        return false;
+    }
+    if (depth > 1 || layers > 1 || faces != 1) {
+        error = "only 2D textures are supported";
+        return false;
+    }
+    if (!CheckSize(image, levelCount, error)) {
+        return false;
+    }
+    image.levels.resize(levelCount > 0 ? levelCount : 1);
+    if (KTX2_HEADER_SIZE + image.levels.size() * KTX2_LEVEL_INDEX_SIZE > size) {
+        error = "truncated level index";
+        return false;
+    }
+
+    for (unsigned int i = 0; i < image.levels.size(); i++) {
+        SetLevelSize(image, i);
+        const uint8_t * index = data + KTX2_HEADER_SIZE + i * KTX2_LEVEL_INDEX_SIZE;
+        uint64_t offset = ReadUint64(index);
+        uint64_t levelSize = ReadUint64(index + 8);
+        if (levelSize != GetLevelSize(*image.format, image.levels[i].width,
+                                      image.levels[i].height) ||
+            offset > size || levelSize > size - offset) {
+            error = "level size does not match its format";
+            return false;
+        }
+        image.levels[i].data = data + offset;
+        image.levels[i].size = (size_t) levelSize;
+    }
+    return true;
+}
+
+bool ParseKTX(const uint8_t * data, size_t size, KTXImage & image, std::string & error) {
+
+    image.format = NULL;
+    image.width = image.height = 0;
+    image.levels.clear();
+    if (size >= KTX_IDENTIFIER_SIZE && !memcmp(data, ktx1Identifier, KTX_IDENTIFIER_SIZE)) {
+        return ParseKTX1(data, size, image, error);
+    }
+    if (size >= KTX_IDENTIFIER_SIZE && !memcmp(data, ktx2Identifier, KTX_IDENTIFIER_SIZE)) {
+        return ParseKTX2(data, size, image, error);
+    }
+    error = "not a KTX file";
+    return false;
+}
@@ -0,0 +1,102 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+
+#ifndef MY_KTX_H
+#define MY_KTX_H
+
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+// this file is also built on the host by tools/textureBenchmark.cpp, so it gets the formats
+// of GLES 3 and its extensions from here rather than gl3stub.h
+#ifndef GL_COMPRESSED_R11_EAC
+#define GL_COMPRESSED_R11_EAC             0x9270
+#define GL_COMPRESSED_SIGNED_R11_EAC      0x9271
+#define GL_COMPRESSED_RG11_EAC            0x9272
+#define GL_COMPRESSED_SIGNED_RG11_EAC     0x9273
+#define GL_COMPRESSED_RGB8_ETC2           0x9274
+#define GL_COMPRESSED_SRGB8_ETC2          0x9275
+#define GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2 0x9276
+#define GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2 0x9277
+#define GL_COMPRESSED_RGBA8_ETC2_EAC      0x9278
+#define GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC 0x9279
+#endif
+#ifndef GL_RGBA8
+#define GL_RGBA8                          0x8058
+#endif
+#ifndef GL_SRGB8_ALPHA8
+#define GL_SRGB8_ALPHA8                   0x8C43
+#endif
+#ifndef GL_COMPRESSED_RGBA_ASTC_4x4_KHR
+#define GL_COMPRESSED_RGBA_ASTC_4x4_KHR   0x93B0
+#define GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4_KHR 0x93D0
+#endif
+
+// KTX2 files name their format by Vulkan's enum
+#define VK_FORMAT_R8G8B8A8_UNORM            37
+#define VK_FORMAT_R8G8B8A8_SRGB             43
+#define VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK   147
+#define VK_FORMAT_ASTC_4x4_UNORM_BLOCK      157
+#define VK_FORMAT_ASTC_12x12_SRGB_BLOCK     184
+
+enum TextureCodec {
+    TEXTURE_CODEC_NONE,     // RGBA8, uploaded as it is
+    TEXTURE_CODEC_ETC1,
+    TEXTURE_CODEC_ETC2_RGB,
+    TEXTURE_CODEC_ETC2_RGB_A1,
+    TEXTURE_CODEC_ETC2_RGBA,
+    TEXTURE_CODEC_EAC_R11,
+    TEXTURE_CODEC_EAC_RG11,
+    TEXTURE_CODEC_ASTC
+};
+
+struct TextureFormatInfo {
+    GLenum      glFormat;
+    uint32_t    vkFormat;       // 0 if KTX2 has no such format
+    int         blockWidth, blockHeight, blockBytes;
+    bool        srgb;
+    TextureCodec codec;
+};
+
+/**
+ * One mip level, pointing into the file's data
+ */
+struct KTXLevel {
+    const uint8_t * data;
+    size_t  size;
+    int     width, height;
+};
+
+/**
+ * A 2D texture in a KTX 1 or KTX 2 file. Parsing copies nothing, the levels point into the
+ * file's data which has to outlive the image.
+ */
+struct KTXImage {
+    const TextureFormatInfo * format;
+    int     width, height;
+    std::vector<KTXLevel> levels; // level 0 is the largest
+};
+
+const TextureFormatInfo * FindTextureFormat(GLenum glFormat);
+size_t  GetLevelSize(const TextureFormatInfo & format, int width, int height);
+bool    ParseKTX(const uint8_t * data, size_t size, KTXImage & image, std::string & error);
+
+#endif //MY_KTX_H
@@ -0,0 +1,214 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+
+#include "myLZ4.h"
+#include <string.h>
+#include <vector>
+
+#define LZ4_MIN_MATCH       4
+#define LZ4_MAX_OFFSET      65535
+// the format ends every block with literals: a match starts at least 12 bytes before the
+// end and ends at least 5 bytes before it
+#define LZ4_MATCH_START_LIMIT   12
+#define LZ4_LAST_LITERALS   5
+#define LZ4_HASH_BITS       14
+
+static uint32_t Read32(const uint8_t * data) {
+
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+static uint32_t Hash(uint32_t sequence) {
+
+    return (sequence * 2654435761u) >> (32 - LZ4_HASH_BITS);
+}
+
+/**
+ * Worst case for incompressible data: the literals and a length byte for every 255 of them
+ */
+size_t LZ4CompressBound(size_t size) {
+
+    return size + size / 255 + 16;
+}
+
+// lengths of 15 and more continue in bytes of 255 until one that is smaller
+static uint8_t * WriteLength(uint8_t * out, size_t length) {
+
+    while (length >= 255) {
+        *out++ = 255;
+        length -= 255;
+    }
+    *out++ = (uint8_t) length;
+    return out;
+}
+
+static uint8_t * WriteSequence(uint8_t * out, const uint8_t * literals, size_t literalLength,
+                               size_t offset, size_t matchLength) {
+
+    uint8_t * token = out++;
+    *token = (uint8_t) ((literalLength < 15 ? literalLength : 15) << 4);
+    if (literalLength >= 15) {
+        out = WriteLength(out, literalLength - 15);
+    }
+    if (literalLength) {
+        memcpy(out, literals, literalLength);
+        out += literalLength;
+    }
+    if (matchLength == 0) {
+        return out;
+    }
+    *out++ = (uint8_t) offset;
+    *out++ = (uint8_t) (offset >> 8);
+    matchLength -= LZ4_MIN_MATCH;
+    *token |= (uint8_t) (matchLength < 15 ? matchLength : 15);
+    if (matchLength >= 15) {
+        out = WriteLength(out, matchLength - 15);
+    }
+    return out;
+}
+
+/**
+ * Compress size bytes into destination, which has to hold LZ4CompressBound(size) bytes.
+ * Returns the compressed size, 0 if destination is smaller.
+ */
+size_t LZ4Compress(const uint8_t * source, size_t size, uint8_t * destination,
+                   size_t capacity) {
+
+    if (capacity < LZ4CompressBound(size)) {
+        return 0;
+    }
+
+    uint8_t * out = destination;
+    size_t anchor = 0;
+    if (size > LZ4_MATCH_START_LIMIT) {
+        // positions + 1 of the last 4 bytes seen with each hash, 0 for none
+        std::vector<uint32_t> table(1 << LZ4_HASH_BITS, 0);
+        size_t matchStartLimit = size - LZ4_MATCH_START_LIMIT;
+        size_t matchEndLimit = size - LZ4_LAST_LITERALS;
+        size_t position = 0;
+        while (position < matchStartLimit) {
+            uint32_t sequence = Read32(source + position);
+            uint32_t & entry = table[Hash(sequence)];
+            size_t candidate = entry;
+            entry = (uint32_t) position + 1;
+            if (candidate == 0 || position - (candidate - 1) > LZ4_MAX_OFFSET ||
+                Read32(source + candidate - 1) != sequence) {
+                position++;
+                continue;
+            }
+            candidate--;
+            size_t length = LZ4_MIN_MATCH;
+            while (position + length < matchEndLimit &&
+                   source[candidate + length] == source[position + length]) {
+                length++;
+            }
+            out = WriteSequence(out, source + anchor, position - anchor, position - candidate,
+                                length);
+            position += length;
+            anchor = position;
+        }
+    }
+    out = WriteSequence(out, source + anchor, size - anchor, 0, 0);
+    return out - destination;
+}
+
+/**
+ * Decompress a block that has to expand to exactly decompressedSize bytes. Every length and
+ * offset is checked, so a corrupt block makes it return false rather than read or write
+ * out of bounds.
+ */
+bool LZ4Decompress(const uint8_t * source, size_t size, uint8_t * destination,
+                   size_t decompressedSize) {
+
+    const uint8_t * in = source;
+    const uint8_t * inEnd = source + size;
+    uint8_t * out = destination;
+    uint8_t * outEnd = destination + decompressedSize;
+
+    while (in < inEnd) {
+        uint8_t token = *in++;
+        size_t literalLength = token >> 4;
+        if (literalLength == 15) {
+            uint8_t byte;
+            do {
+                if (in >= inEnd) {
+                    return false;
+                }
+                byte = *in++;
+                literalLength += byte;
+            } while (byte == 255);
+        }
+        if (literalLength > (size_t) (inEnd - in) || literalLength > (size_t) (outEnd - out)) {
+            return false;
+        }
+        // short runs are copied as 16 bytes where both sides have room for it, a fixed size
+        // that compiles to a couple of moves
+        if (literalLength <= 16 && inEnd - in >= 16 && outEnd - out >= 16) {
+            memcpy(out, in, 16);
+        } else if (literalLength) {
+            memcpy(out, in, literalLength);
+        }
+        in += literalLength;
+        out += literalLength;
+        // the last sequence has no match
+        if (in == inEnd) {
+            break;
+        }
+
+        if (inEnd - in < 2) {
+            return false;
+        }
+        size_t offset = in[0] | (in[1] << 8);
+        in += 2;
+        if (offset == 0 || offset > (size_t) (out - destination)) {
+            return false;
+        }
+        size_t matchLength = (token & 15) + LZ4_MIN_MATCH;
+        if ((token & 15) == 15) {
+            uint8_t byte;
+            do {
+                if (in >= inEnd) {
+                    return false;
+                }
+                byte = *in++;
+                matchLength += byte;
+            } while (byte == 255);
+        }
+        if (matchLength > (size_t) (outEnd - out)) {
+            return false;
+        }
+        // a match may overlap what it writes, repeating its last offset bytes. From 8 bytes
+        // back on, 8 byte steps only read what is written already.
+        const uint8_t * match = out - offset;
+        if (offset >= 8 && (size_t) (outEnd - out) >= matchLength + 8) {
+            uint8_t * matchEnd = out + matchLength;
+            do {
+                memcpy(out, match, 8);
+                out += 8;
+                match += 8;
+            } while (out < matchEnd);
+            out = matchEnd;
+        } else {
+            for (size_t i = 0; i < matchLength; i++) {
+                *out++ = *match++;
+            }
+        }
+    }
+    return out == outEnd;
+}
@@ -0,0 +1,39 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+
+#ifndef MY_LZ4_H
+#define MY_LZ4_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * The LZ4 block format: a run of literals and a match of at least 4 bytes up to 64 KB back,
+ * over and over. Decoding is a few byte copies per sequence, which makes it fast enough to
+ * decompress assets at load time on a phone. The compressor is a simple greedy one, it
+ * runs in the host tools where ratio matters more than speed but not enough to need more.
+ *
+ * Blocks are compatible with the reference LZ4_compress_default and
+ * LZ4_decompress_safe, with no frame around them.
+ */
+size_t  LZ4CompressBound(size_t size);
+size_t  LZ4Compress(const uint8_t * source, size_t size, uint8_t * destination,
+                    size_t capacity);
+bool    LZ4Decompress(const uint8_t * source, size_t size, uint8_t * destination,
+                      size_t decompressedSize);
+
+#endif //MY_LZ4_H
@@ -0,0 +1,43 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include "myMesh.h"
+
+/**
+ * Bounding sphere centered on the bounding box, loose but cheap and stable
+ */
+void MyMesh::ComputeBounds() {
+
+    if (positions.empty()) {
+        boundsCenter = glm::vec3(0);
+        boundsRadius = 0;
+        return;
+    }
+
+    glm::vec3 minCorner = positions[0], maxCorner = positions[0];
+    for (size_t i = 1; i < positions.size(); i++) {
+        minCorner = glm::min(minCorner, positions[i]);
+        maxCorner = glm::max(maxCorner, positions[i]);
+    }
+    boundsCenter = 0.5f * (minCorner + maxCorner);
+
+    float radiusSquared = 0;
+    for (size_t i = 0; i < positions.size(); i++) {
+        glm::vec3 offset = positions[i] - boundsCenter;
+        radiusSquared = fmaxf(radiusSquared, glm::dot(offset, offset));
+    }
+    boundsRadius = sqrtf(radiusSquared);
+}
@@ -0,0 +1,65 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#ifndef MY_MESH_H
+#define MY_MESH_H
+
+#include "myGLM.h"
+#include <stdint.h>
+#include <vector>
+
+/**
+ * A small cluster of triangles stored consecutively in its LOD's index list
+ */
+struct MyMeshlet {
+    uint32_t    firstIndex;
+    uint32_t    triangleCount;
+    uint32_t    vertexCount;
+
+    // bounding sphere in model space
+    glm::vec3   center;
+    float       radius;
+
+    // all triangle normals lie within this cone, cutoff is 1 if the cone is too wide to cull
+    glm::vec3   coneAxis;
+    float       coneCutoff;
+};
+
+/**
+ * One level of detail: a triangle list that indexes into the mesh's shared vertices
+ */
+struct MyMeshLOD {
+    std::vector<uint32_t>   indices;
+    float       geometricError; // max deviation from the full-detail mesh, in model units
+    std::vector<MyMeshlet>  meshlets; // empty until BuildMeshlets reorders the indices
+};
+
+/**
+ * Indexed triangle mesh on the CPU. All LODs share the vertex arrays, lods[0] is full detail.
+ */
+struct MyMesh {
+    std::vector<glm::vec3>  positions;
+    std::vector<glm::vec3>  colors;     // one per position
+    std::vector<MyMeshLOD>  lods;
+
+    glm::vec3   boundsCenter;
+    float       boundsRadius;
+
+    int         GetVertexCount() const { return (int) positions.size(); }
+    void        ComputeBounds();
+};
+
+#endif //MY_MESH_H
@@ -0,0 +1,425 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include "myMeshLOD.h"
+#include "myLogger.h"
+#include <algorithm>
+#include <math.h>
+
+/**
+ * Symmetric 4x4 matrix measuring the sum of squared distances to a set of planes,
+ * each plane weighted by the area of the triangle it came from
+ */
+struct Quadric {
+    double  a00, a01, a02, a03, a11, a12, a13, a22, a23, a33;
+    double  weight;
+};
+
+static void AddPlane(Quadric & q, glm::dvec3 normal, double d, double weight) {
+
+    q.a00 += weight * normal.x * normal.x;
+    q.a01 += weight * normal.x * normal.y;
+    q.a02 += weight * normal.x * normal.z;
+    q.a03 += weight * normal.x * d;
+    q.a11 += weight * normal.y * normal.y;
+    q.a12 += weight * normal.y * normal.z;
+    q.a13 += weight * normal.y * d;
+    q.a22 += weight * normal.z * normal.z;
+    q.a23 += weight * normal.z * d;
+    q.a33 += weight * d * d;
+    q.weight += weight;
+}
+
+static void AddQuadric(Quadric & q, const Quadric & other) {
+
+    q.a00 += other.a00; q.a01 += other.a01; q.a02 += other.a02; q.a03 += other.a03;
+    q.a11 += other.a11; q.a12 += other.a12; q.a13 += other.a13;
+    q.a22 += other.a22; q.a23 += other.a23;
+    q.a33 += other.a33;
+    q.weight += other.weight;
+}
+
+static double EvaluateQuadric(const Quadric & q, glm::vec3 p) {
+
+    double x = p.x, y = p.y, z = p.z;
+    return q.a00 * x * x + 2 * q.a01 * x * y + 2 * q.a02 * x * z + 2 * q.a03 * x +
+           q.a11 * y * y + 2 * q.a12 * y * z + 2 * q.a13 * y +
+           q.a22 * z * z + 2 * q.a23 * z +
+           q.a33;
+}
+
+static bool LessPosition(glm::vec3 a, glm::vec3 b) {
+
+    if (a.x != b.x) return a.x < b.x;
+    if (a.y != b.y) return a.y < b.y;
+    return a.z < b.z;
+}
+
+struct VertexOrder {
+    const MyMesh * mesh;
+    bool    compareColors;
+
+    bool operator()(uint32_t a, uint32_t b) const {
+        const glm::vec3 & pa = mesh->positions[a], & pb = mesh->positions[b];
+        if (pa != pb || !compareColors) {
+            return LessPosition(pa, pb);
+        }
+        return LessPosition(mesh->colors[a], mesh->colors[b]);
+    }
+};
+
+/**
+ * canonical[v] is the first vertex with identical position and color, so that duplicated
+ * vertices are welded. Canonical vertices that share a position with a differently colored
+ * vertex sit on an attribute seam and are locked, since moving them would tear the surface.
+ */
+static void WeldVertices(const MyMesh & mesh, std::vector<uint32_t> & canonical,
+                         std::vector<char> & locked) {
+
+    size_t numVertices = mesh.positions.size();
+    std::vector<uint32_t> order(numVertices);
+    for (size_t i = 0; i < numVertices; i++) {
+        order[i] = (uint32_t) i;
+    }
+    VertexOrder vertexOrder = { &mesh, true };
+    std::sort(order.begin(), order.end(), vertexOrder);
+
+    canonical.resize(numVertices);
+    locked.assign(numVertices, 0);
+    size_t positionStart = 0;
+    int colorsAtPosition = 0;
+    for (size_t i = 0; i < numVertices; i++) {
+
+        uint32_t v = order[i];
+        bool samePosition = i > 0 && mesh.positions[order[i - 1]] == mesh.positions[v];
+        bool sameVertex = samePosition && mesh.colors[order[i - 1]] == mesh.colors[v];
+        canonical[v] = sameVertex ? canonical[order[i - 1]] : v;
+
+        if (!samePosition) {
+            positionStart = i;
+            colorsAtPosition = 0;
+        }
+        if (!sameVertex) {
+            colorsAtPosition++;
+        }
+        if (colorsAtPosition > 1) {
+            for (size_t j = positionStart; j <= i; j++) {
+                locked[canonical[order[j]]] = 1;
+            }
+        }
+    }
+}
+
+/**
+ * Edges used by one triangle lie on the border and edges used by more than two are
+ * non-manifold, their vertices are locked to keep the outline intact
+ */
+static void LockBorders(const std::vector<uint32_t> & indices, std::vector<char> & locked) {
+
+    std::vector<uint64_t> edges;
+    edges.reserve(indices.size());
+    for (size_t t = 0; t < indices.size(); t += 3) {
+        for (int e = 0; e < 3; e++) {
+            uint32_t a = indices[t + e], b = indices[t + (e + 1) % 3];
+            uint32_t lo = std::min(a, b), hi = std::max(a, b);
+            edges.push_back(((uint64_t) lo << 32) | hi);
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+
+    for (size_t i = 0; i < edges.size();) {
+        size_t j = i;
+        while (j < edges.size() && edges[j] == edges[i]) {
+            j++;
+        }
+        if (j - i != 2) {
+            locked[(uint32_t) (edges[i] >> 32)] = 1;
+            locked[(uint32_t) (edges[i] & 0xFFFFFFFF)] = 1;
+        }
+        i = j;
+    }
+}
+
+struct Collapse {
+    uint32_t    from, to;
+    double      cost, positionCost;
+
+    bool operator<(const Collapse & other) const { return cost < other.cost; }
+};
+
+/**
+ * Moving 'from' onto 'to' must not turn any of from's remaining triangles upside down
+ */
+static bool CollapseFlipsTriangle(const MyMesh & mesh, const std::vector<uint32_t> & indices,
+                                  const std::vector<uint32_t> & triangleStart,
+                                  const std::vector<uint32_t> & triangleList,
+                                  uint32_t from, uint32_t to) {
+
+    for (uint32_t i = triangleStart[from]; i < triangleStart[from + 1]; i++) {
+        const uint32_t * tri = &indices[3 * triangleList[i]];
+        if (tri[0] == to || tri[1] == to || tri[2] == to) {
+            continue; // this triangle disappears
+        }
+
+        glm::vec3 p[3], q[3];
+        for (int k = 0; k < 3; k++) {
+            p[k] = mesh.positions[tri[k]];
+            q[k] = tri[k] == from ? mesh.positions[to] : p[k];
+        }
+        glm::vec3 oldNormal = glm::cross(p[1] - p[0], p[2] - p[0]);
+        glm::vec3 newNormal = glm::cross(q[1] - q[0], q[2] - q[0]);
+        if (glm::dot(oldNormal, newNormal) <= 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Greedy edge collapse driven by quadric error. Vertices only ever move onto other existing
+ * vertices, so the result indexes the mesh's original vertex arrays and all levels can
+ * share one vertex buffer. resultError is the largest deviation introduced, in model units.
+ */
+std::vector<uint32_t> SimplifyMesh(const MyMesh & mesh, const std::vector<uint32_t> & sourceIndices,
+                                   size_t targetTriangleCount, float & resultError) {
+
+    resultError = 0;
+    size_t numVertices = mesh.positions.size();
+
+    std::vector<uint32_t> canonical;
+    std::vector<char> locked;
+    WeldVertices(mesh, canonical, locked);
+
+    std::vector<uint32_t> indices(sourceIndices.size());
+    for (size_t i = 0; i < sourceIndices.size(); i++) {
+        indices[i] = canonical[sourceIndices[i]];
+    }
+    LockBorders(indices, locked);
+
+    // every vertex starts with the planes of the triangles around it
+    std::vector<Quadric> quadrics(numVertices);
+    std::fill(quadrics.begin(), quadrics.end(), Quadric());
+    for (size_t t = 0; t < indices.size(); t += 3) {
+        glm::dvec3 p0 = glm::dvec3(mesh.positions[indices[t]]);
+        glm::dvec3 p1 = glm::dvec3(mesh.positions[indices[t + 1]]);
+        glm::dvec3 p2 = glm::dvec3(mesh.positions[indices[t + 2]]);
+        glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+        double length = glm::length(normal);
+        if (length == 0) {
+            continue;
+        }
+        normal /= length;
+        double d = -glm::dot(normal, p0);
+        for (int k = 0; k < 3; k++) {
+            AddPlane(quadrics[indices[t + k]], normal, d, 0.5 * length);
+        }
+    }
+
+    // color differences are scaled by the mesh size so that the weight is unit-independent
+    float radius = mesh.boundsRadius > 0 ? mesh.boundsRadius : 1.0f;
+    double attributeScale = LOD_ATTRIBUTE_WEIGHT * radius * radius;
+
+    std::vector<uint32_t> triangleStart, triangleList;
+    std::vector<Collapse> collapses;
+    std::vector<uint32_t> remap(numVertices);
+    std::vector<char> touched(numVertices);
+
+    while (indices.size() / 3 > targetTriangleCount) {
+
+        size_t numTriangles = indices.size() / 3;
+
+        // vertex -> triangles adjacency in compressed rows
+        triangleStart.assign(numVertices + 1, 0);
+        for (size_t i = 0; i < indices.size(); i++) {
+            triangleStart[indices[i] + 1]++;
+        }
+        for (size_t v = 0; v < numVertices; v++) {
+            triangleStart[v + 1] += triangleStart[v];
+        }
+        triangleList.resize(indices.size());
+        std::vector<uint32_t> fill(triangleStart.begin(), triangleStart.end() - 1);
+        for (size_t i = 0; i < indices.size(); i++) {
+            triangleList[fill[indices[i]]++] = (uint32_t) (i / 3);
+        }
+
+        // each interior edge shows up in two triangles, take it from the one where a < b
+        collapses.clear();
+        for (size_t t = 0; t < indices.size(); t += 3) {
+            for (int e = 0; e < 3; e++) {
+                uint32_t a = indices[t + e], b = indices[t + (e + 1) % 3];
+                if (a >= b) {
+                    continue;
+                }
+                for (int direction = 0; direction < 2; direction++) {
+                    uint32_t from = direction ? b : a, to = direction ? a : b;
+                    if (locked[from]) {
+                        continue;
+                    }
+                    Collapse collapse;
+                    collapse.from = from;
+                    collapse.to = to;
+                    collapse.positionCost = EvaluateQuadric(quadrics[from], mesh.positions[to]) +
+                                            EvaluateQuadric(quadrics[to], mesh.positions[to]);
+                    glm::vec3 colorChange = mesh.colors[from] - mesh.colors[to];
+                    collapse.cost = collapse.positionCost + attributeScale * quadrics[from].weight *
+                                                            glm::dot(colorChange, colorChange);
+                    collapses.push_back(collapse);
+                }
+            }
+        }
+        std::sort(collapses.begin(), collapses.end());
+
+        for (size_t v = 0; v < numVertices; v++) {
+            remap[v] = (uint32_t) v;
+        }
+        std::fill(touched.begin(), touched.end(), 0);
+        size_t removedTriangles = 0;
+
+        for (size_t c = 0; c < collapses.size(); c++) {
+
+            if (numTriangles - removedTriangles <= targetTriangleCount) {
+                break;
+            }
+            const Collapse & collapse = collapses[c];
+            if (touched[collapse.from] || touched[collapse.to]) {
+                continue;
+            }
+            if (CollapseFlipsTriangle(mesh, indices, triangleStart, triangleList,
+                                      collapse.from, collapse.to)) {
+                continue;
+            }
+
+            // freeze the neighbourhood: later collapses in this pass were checked against
+            // the old geometry
+            for (uint32_t i = triangleStart[collapse.from]; i < triangleStart[collapse.from + 1];
+                 i++) {
+                const uint32_t * tri = &indices[3 * triangleList[i]];
+                touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = 1;
+                if (tri[0] == collapse.to || tri[1] == collapse.to || tri[2] == collapse.to) {
+                    removedTriangles++;
+                }
+            }
+
+            double weight = quadrics[collapse.from].weight + quadrics[collapse.to].weight;
+            if (weight > 0) {
+                float error = (float) sqrt(fmax(0., collapse.positionCost) / weight);
+                resultError = fmaxf(resultError, error);
+            }
+            AddQuadric(quadrics[collapse.to], quadrics[collapse.from]);
+            remap[collapse.from] = collapse.to;
+        }
+
+        if (removedTriangles == 0) {
+            break; // everything left is locked or would flip
+        }
+
+        size_t write = 0;
+        for (size_t t = 0; t < indices.size(); t += 3) {
+            uint32_t a = remap[indices[t]], b = remap[indices[t + 1]], c = remap[indices[t + 2]];
+            if (a == b || b == c || a == c) {
+                continue;
+            }
+            indices[write++] = a;
+            indices[write++] = b;
+            indices[write++] = c;
+        }
+        indices.resize(write);
+    }
+
+    return indices;
+}
+
+/**
+ * Build the LOD chain from lods[0], each level roughly halving the triangle count,
+ * until simplification stops making progress
+ */
+void GenerateLODs(MyMesh & mesh) {
+
+    if (mesh.lods.empty()) {
+        return;
+    }
+    mesh.lods.resize(1);
+    mesh.lods[0].geometricError = 0;
+    if (mesh.boundsRadius <= 0) {
+        mesh.ComputeBounds();
+    }
+
+    size_t previousCount = mesh.lods[0].indices.size() / 3;
+    for (int level = 1; level < LOD_MAX_LEVELS; level++) {
+
+        // always simplify from full detail so that the error is measured against it
+        float error;
+        MyMeshLOD lod;
+        lod.indices = SimplifyMesh(mesh, mesh.lods[0].indices,
+                                   (size_t) (previousCount * LOD_REDUCTION_RATIO), error);
+        size_t count = lod.indices.size() / 3;
+        if (count == 0 || count > previousCount * (1 - LOD_MIN_REDUCTION)) {
+            break;
+        }
+        lod.geometricError = fmaxf(error, mesh.lods.back().geometricError);
+        mesh.lods.push_back(lod);
+        previousCount = count;
+    }
+
+    for (size_t i = 0; i < mesh.lods.size(); i++) {
+        MyLOGD("LOD %d: %d triangles, error %f", (int) i, (int) mesh.lods[i].indices.size() / 3,
+               mesh.lods[i].geometricError);
+    }
+}
+
+/**
+ * Pick the coarsest level whose error projects to at most LOD_PIXEL_ERROR pixels.
+ * distance is from the camera to the nearest point of the mesh, FOV is in degrees.
+ * Coarser levels than the current one must beat a lower threshold to avoid popping back
+ * and forth when the distance hovers around a switch point.
+ */
+int SelectLOD(const MyMesh & mesh, int currentLevel, float distance, float FOV,
+              int screenHeight, float lodBias) {
+
+    int numLevels = (int) mesh.lods.size();
+    if (numLevels <= 1) {
+        return 0;
+    }
+    distance = fmaxf(distance, 1e-3f);
+
+    float pixelsPerUnit = screenHeight / (2 * distance * tanf(FOV * float(M_PI / 360)));
+    for (int level = numLevels - 1; level > 0; level--) {
+        float threshold = LOD_PIXEL_ERROR * lodBias;
+        if (level > currentLevel) {
+            threshold *= LOD_HYSTERESIS;
+        }
+        if (mesh.lods[level].geometricError * pixelsPerUnit <= threshold) {
+            return level;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Pixels covered by the mesh's bounding sphere, at most the whole screen. distance is from
+ * the camera to the sphere's center, FOV is in degrees.
+ */
+float GetScreenCoverage(const MyMesh & mesh, float distance, float FOV, int screenWidth,
+                        int screenHeight) {
+
+    float screenArea = (float) screenWidth * screenHeight;
+    if (distance <= mesh.boundsRadius) {
+        return screenArea;
+    }
+    float pixelsPerUnit = screenHeight / (2 * distance * tanf(FOV * float(M_PI / 360)));
+    float radius = mesh.boundsRadius * pixelsPerUnit;
+    return fminf(float(M_PI) * radius * radius, screenArea);
+}
@@ -0,0 +1,42 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#ifndef MY_MESH_LOD_H
+#define MY_MESH_LOD_H
+
+#include "myMesh.h"
+
+// each LOD targets this fraction of the previous level's triangles
+#define LOD_REDUCTION_RATIO     0.5f
+#define LOD_MAX_LEVELS          5
+// stop adding levels once simplification removes less than this fraction of triangles
+#define LOD_MIN_REDUCTION       0.1f
+// how much a color difference costs relative to geometric error when collapsing an edge
+#define LOD_ATTRIBUTE_WEIGHT    0.5f
+// switch LOD when its error covers this many pixels
+#define LOD_PIXEL_ERROR         1.0f
+// a coarser level has to be this much below the pixel error before we switch to it
+#define LOD_HYSTERESIS          0.75f
+
+std::vector<uint32_t> SimplifyMesh(const MyMesh & mesh, const std::vector<uint32_t> & indices,
+                                   size_t targetTriangleCount, float & resultError);
+void    GenerateLODs(MyMesh & mesh);
+int     SelectLOD(const MyMesh & mesh, int currentLevel, float distance, float FOV,
+                  int screenHeight, float lodBias = 1.0f);
+float   GetScreenCoverage(const MyMesh & mesh, float distance, float FOV, int screenWidth,
+                          int screenHeight);
+
+#endif //MY_MESH_LOD_H
@@ -0,0 +1,335 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include "myMeshlet.h"
+#include "mySIMD.h"
+#include "myLogger.h"
+#include <math.h>
+#include <string.h>
+
+/**
+ * Sphere around the meshlet's vertices and the cone that contains all its triangle normals
+ */
+static void ComputeMeshletBounds(const MyMesh & mesh, const uint32_t * indices,
+                                 const std::vector<uint32_t> & vertices, MyMeshlet & meshlet) {
+
+    glm::vec3 center = glm::vec3(0);
+    for (size_t i = 0; i < vertices.size(); i++) {
+        center += mesh.positions[vertices[i]];
+    }
+    center /= (float) vertices.size();
+
+    float radius = 0;
+    for (size_t i = 0; i < vertices.size(); i++) {
+        radius = fmaxf(radius, glm::length(mesh.positions[vertices[i]] - center));
+    }
+    meshlet.center = center;
+    meshlet.radius = radius;
+
+    std::vector<glm::vec3> normals;
+    glm::vec3 normalSum = glm::vec3(0);
+    for (uint32_t t = 0; t < meshlet.triangleCount; t++) {
+        glm::vec3 p0 = mesh.positions[indices[3 * t]];
+        glm::vec3 normal = glm::cross(mesh.positions[indices[3 * t + 1]] - p0,
+                                      mesh.positions[indices[3 * t + 2]] - p0);
+        float length = glm::length(normal);
+        if (length > 0) {
+            normals.push_back(normal / length);
+            normalSum += normals.back();
+        }
+    }
+
+    meshlet.coneAxis = glm::vec3(0, 0, 1);
+    meshlet.coneCutoff = 1;
+    float axisLength = glm::length(normalSum);
+    if (axisLength == 0) {
+        return;
+    }
+    glm::vec3 axis = normalSum / axisLength;
+    float minDot = 1;
+    for (size_t i = 0; i < normals.size(); i++) {
+        minDot = fminf(minDot, glm::dot(axis, normals[i]));
+    }
+
+    // normals spread over more than ~85 degrees: some triangle always faces the camera
+    if (minDot > 0.1f) {
+        meshlet.coneAxis = axis;
+        meshlet.coneCutoff = sqrtf(1 - minDot * minDot);
+    }
+}
+
+/**
+ * Split the LOD's triangles into meshlets of at most MESHLET_MAX_VERTICES vertices and
+ * MESHLET_MAX_TRIANGLES triangles. Meshlets grow across shared vertices to stay compact,
+ * and lod.indices is reordered so that each meshlet's triangles are consecutive.
+ */
+void BuildMeshlets(const MyMesh & mesh, MyMeshLOD & lod) {
+
+    const std::vector<uint32_t> & indices = lod.indices;
+    size_t numTriangles = indices.size() / 3;
+    size_t numVertices = mesh.positions.size();
+
+    // vertex -> triangles adjacency in compressed rows
+    std::vector<uint32_t> triangleStart(numVertices + 1, 0), triangleList(indices.size());
+    for (size_t i = 0; i < indices.size(); i++) {
+        triangleStart[indices[i] + 1]++;
+    }
+    for (size_t v = 0; v < numVertices; v++) {
+        triangleStart[v + 1] += triangleStart[v];
+    }
+    std::vector<uint32_t> fill(triangleStart.begin(), triangleStart.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++) {
+        triangleList[fill[indices[i]]++] = (uint32_t) (i / 3);
+    }
+
+    std::vector<char> assigned(numTriangles, 0);
+    std::vector<char> inMeshlet(numVertices, 0);
+    std::vector<uint32_t> meshletVertices, candidates, newIndices;
+    newIndices.reserve(indices.size());
+    lod.meshlets.clear();
+
+    for (size_t seed = 0; seed < numTriangles; seed++) {
+
+        if (assigned[seed]) {
+            continue;
+        }
+
+        MyMeshlet meshlet;
+        meshlet.firstIndex = (uint32_t) newIndices.size();
+        meshlet.triangleCount = 0;
+        meshletVertices.clear();
+        candidates.clear();
+        candidates.push_back((uint32_t) seed);
+
+        for (size_t next = 0; next < candidates.size() &&
+                              meshlet.triangleCount < MESHLET_MAX_TRIANGLES; next++) {
+
+            uint32_t t = candidates[next];
+            if (assigned[t]) {
+                continue;
+            }
+            int newVertices = 0;
+            for (int k = 0; k < 3; k++) {
+                newVertices += inMeshlet[indices[3 * t + k]] ? 0 : 1;
+            }
+            if (meshletVertices.size() + newVertices > MESHLET_MAX_VERTICES) {
+                continue;
+            }
+
+            assigned[t] = 1;
+            meshlet.triangleCount++;
+            for (int k = 0; k < 3; k++) {
+                uint32_t v = indices[3 * t + k];
+                newIndices.push_back(v);
+                if (inMeshlet[v]) {
+                    continue;
+                }
+                inMeshlet[v] = 1;
+                meshletVertices.push_back(v);
+                // triangles around a new vertex are the next best candidates
+                for (uint32_t i = triangleStart[v]; i < triangleStart[v + 1]; i++) {
+                    if (!assigned[triangleList[i]]) {
+                        candidates.push_back(triangleList[i]);
+                    }
+                }
+            }
+        }
+
+        meshlet.vertexCount = (uint32_t) meshletVertices.size();
+        ComputeMeshletBounds(mesh, &newIndices[meshlet.firstIndex], meshletVertices, meshlet);
+        lod.meshlets.push_back(meshlet);
+
+        for (size_t i = 0; i < meshletVertices.size(); i++) {
+            inMeshlet[meshletVertices[i]] = 0;
+        }
+    }
+
+    lod.indices.swap(newIndices);
+}
+
+/**
+ * Frustum planes from the rows of a projection matrix, normalized to measure true distance.
+ * Planes are in the space that mat transforms from.
+ */
+void ExtractFrustumPlanes(const glm::mat4 & mat, glm::vec4 planes[6]) {
+
+    glm::vec4 row[4];
+    for (int i = 0; i < 4; i++) {
+        row[i] = glm::vec4(mat[0][i], mat[1][i], mat[2][i], mat[3][i]);
+    }
+    for (int i = 0; i < 3; i++) {
+        planes[2 * i]     = row[3] + row[i];
+        planes[2 * i + 1] = row[3] - row[i];
+    }
+    for (int p = 0; p < 6; p++) {
+        planes[p] /= glm::length(glm::vec3(planes[p]));
+    }
+}
+
+MyMeshletCuller::MyMeshletCuller() {
+
+    memset(&stats, 0, sizeof(stats));
+    backfaceCulling = false;
+    occlusionCuller = NULL;
+}
+
+/**
+ * Copy meshlet bounds into padded arrays. Padding entries have a huge negative radius
+ * so that the frustum test always rejects them.
+ */
+void MyMeshletCuller::Prepare(const std::vector<MyMeshlet> & meshlets) {
+
+    this->meshlets = meshlets;
+    size_t paddedCount = (meshlets.size() + 3) & ~3;
+
+    centerX.assign(paddedCount, 0);
+    centerY.assign(paddedCount, 0);
+    centerZ.assign(paddedCount, 0);
+    radius.assign(paddedCount, -1e30f);
+    axisX.assign(paddedCount, 0);
+    axisY.assign(paddedCount, 0);
+    axisZ.assign(paddedCount, 1);
+    cutoff.assign(paddedCount, 1);
+    culled.assign(paddedCount, 0);
+
+    for (size_t i = 0; i < meshlets.size(); i++) {
+        centerX[i] = meshlets[i].center.x;
+        centerY[i] = meshlets[i].center.y;
+        centerZ[i] = meshlets[i].center.z;
+        radius[i]  = meshlets[i].radius;
+        axisX[i]   = meshlets[i].coneAxis.x;
+        axisY[i]   = meshlets[i].coneAxis.y;
+        axisZ[i]   = meshlets[i].coneAxis.z;
+        cutoff[i]  = meshlets[i].coneCutoff;
+    }
+}
+
+/**
+ * Test meshlets [begin, end) four at a time. A meshlet is culled if its sphere is fully
+ * outside any frustum plane, or if the camera is inside the region from where every
+ * triangle of the meshlet is back-facing.
+ */
+void MyMeshletCuller::CullJob(void * data, int begin, int end) {
+
+    MyMeshletCuller * culler = (MyMeshletCuller *) data;
+
+    for (int i = begin * 4; i < end * 4; i += 4) {
+
+        Float4 x = Load4(&culler->centerX[i]);
+        Float4 y = Load4(&culler->centerY[i]);
+        Float4 z = Load4(&culler->centerZ[i]);
+        Float4 r = Load4(&culler->radius[i]);
+        Float4 negativeR = Sub4(Splat4(0), r);
+
+        Mask4 culled = SplatMask4(false);
+        for (int p = 0; p < 6; p++) {
+            const glm::vec4 & plane = culler->planes[p];
+            Float4 distance = Add4(Add4(Mul4(x, Splat4(plane.x)), Mul4(y, Splat4(plane.y))),
+                                   Add4(Mul4(z, Splat4(plane.z)), Splat4(plane.w)));
+            culled = Or4(culled, Less4(distance, negativeR));
+        }
+
+        if (culler->backfaceCulling) {
+            Float4 dx = Sub4(x, Splat4(culler->cameraPosition.x));
+            Float4 dy = Sub4(y, Splat4(culler->cameraPosition.y));
+            Float4 dz = Sub4(z, Splat4(culler->cameraPosition.z));
+            Float4 distance = Sqrt4(Add4(Add4(Mul4(dx, dx), Mul4(dy, dy)), Mul4(dz, dz)));
+            Float4 alongAxis = Add4(Add4(Mul4(dx, Load4(&culler->axisX[i])),
+                                         Mul4(dy, Load4(&culler->axisY[i]))),
+                                    Mul4(dz, Load4(&culler->axisZ[i])));
+            Float4 limit = Add4(Mul4(Load4(&culler->cutoff[i]), distance), r);
+            Mask4 backfacing = GreaterEqual4(alongAxis, limit);
+            // wide cones have cutoff 1 and can never satisfy the test, but keep the mask clean
+            backfacing = And4(backfacing, Less4(Load4(&culler->cutoff[i]), Splat4(1)));
+            culled = Or4(culled, backfacing);
+        }
+
+        StoreMask4(&culler->culled[i], culled);
+
+        // only meshlets that passed the cheap tests pay for the depth buffer lookup
+        if (!culler->occlusionCuller) {
+            continue;
+        }
+        for (int j = i; j < i + 4; j++) {
+            if (culler->culled[j] != MESHLET_VISIBLE) {
+                continue;
+            }
+            glm::vec3 center(culler->centerX[j], culler->centerY[j], culler->centerZ[j]);
+            glm::vec3 extent(culler->radius[j]);
+            if (!culler->occlusionCuller->IsBoxVisible(culler->mvpMat, center - extent,
+                                                       center + extent)) {
+                culler->culled[j] = MESHLET_OCCLUDED;
+            }
+        }
+    }
+}
+
+/**
+ * Cull meshlets on all threads, then merge consecutive visible meshlets into draw ranges.
+ * mvpMat and cameraPosition are in the mesh's model space. Meshlets that pass are also
+ * tested against occlusionCuller's depth buffer, if given.
+ */
+void MyMeshletCuller::Cull(MyJobSystem * jobSystem, const glm::mat4 & mvpMat,
+                           glm::vec3 cameraPosition, bool backfaceCulling,
+                           std::vector<MyDrawRange> & drawRanges,
+                           const MyOcclusionCuller * occlusionCuller) {
+
+    drawRanges.clear();
+    memset(&stats, 0, sizeof(stats));
+    if (meshlets.empty()) {
+        return;
+    }
+
+    ExtractFrustumPlanes(mvpMat, planes);
+    this->cameraPosition = cameraPosition;
+    this->backfaceCulling = backfaceCulling;
+    this->mvpMat = mvpMat;
+    this->occlusionCuller = occlusionCuller;
+
+    // jobs work on groups of 4 meshlets
+    int numGroups = (int) culled.size() / 4;
+    if (jobSystem) {
+        jobSystem->ParallelFor(CullJob, this, numGroups, MESHLET_CULL_BATCH / 4);
+    } else {
+        CullJob(this, 0, numGroups);
+    }
+
+    for (size_t i = 0; i < meshlets.size(); i++) {
+
+        const MyMeshlet & meshlet = meshlets[i];
+        stats.totalMeshlets++;
+        stats.totalTriangles += meshlet.triangleCount;
+        if (culled[i] == MESHLET_OCCLUDED) {
+            stats.occludedMeshlets++;
+        }
+        if (culled[i] != MESHLET_VISIBLE) {
+            continue;
+        }
+        stats.visibleMeshlets++;
+        stats.visibleTriangles += meshlet.triangleCount;
+
+        uint32_t indexCount = 3 * meshlet.triangleCount;
+        if (!drawRanges.empty() &&
+            drawRanges.back().firstIndex + drawRanges.back().indexCount == meshlet.firstIndex) {
+            drawRanges.back().indexCount += indexCount;
+        } else {
+            MyDrawRange range;
+            range.firstIndex = meshlet.firstIndex;
+            range.indexCount = indexCount;
+            drawRanges.push_back(range);
+        }
+    }
+}
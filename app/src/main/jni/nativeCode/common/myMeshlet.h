@@ -0,0 +1,83 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#ifndef MY_MESHLET_H
+#define MY_MESHLET_H
+
+#include "myMesh.h"
+#include "myJobSystem.h"
+#include "myOcclusionCuller.h"
+
+#define MESHLET_MAX_VERTICES    64
+#define MESHLET_MAX_TRIANGLES   124
+// meshlets culled per job
+#define MESHLET_CULL_BATCH      256
+// values of the per-meshlet cull mask
+#define MESHLET_VISIBLE         0
+#define MESHLET_OCCLUDED        1
+
+/**
+ * A run of consecutive indices to draw with one call
+ */
+struct MyDrawRange {
+    uint32_t    firstIndex;
+    uint32_t    indexCount;
+};
+
+struct MeshletCullStats {
+    int     totalMeshlets, visibleMeshlets;
+    int     totalTriangles, visibleTriangles;
+    int     occludedMeshlets;
+    float   GetCulledTriangleFraction() const {
+        return totalTriangles ? 1.0f - (float) visibleTriangles / totalTriangles : 0;
+    }
+};
+
+void    BuildMeshlets(const MyMesh & mesh, MyMeshLOD & lod);
+void    ExtractFrustumPlanes(const glm::mat4 & mat, glm::vec4 planes[6]);
+
+/**
+ * Culls the meshlets of one LOD against the view frustum and by their normal cones.
+ * Bounds are kept as structure-of-arrays padded to a multiple of 4 for the SIMD test.
+ */
+class MyMeshletCuller {
+public:
+    MyMeshletCuller();
+    void    Prepare(const std::vector<MyMeshlet> & meshlets);
+    void    Cull(MyJobSystem * jobSystem, const glm::mat4 & mvpMat, glm::vec3 cameraPosition,
+                 bool backfaceCulling, std::vector<MyDrawRange> & drawRanges,
+                 const MyOcclusionCuller * occlusionCuller = NULL);
+    const MeshletCullStats & GetStats() const { return stats; }
+
+private:
+    static void CullJob(void * data, int begin, int end);
+
+    std::vector<MyMeshlet>  meshlets;
+    std::vector<float>  centerX, centerY, centerZ, radius;
+    std::vector<float>  axisX, axisY, axisZ, cutoff;
+    std::vector<uint32_t>   culled; // all bits set if outside or back-facing, else MESHLET_*
+
+    // inputs of the current Cull call, read by the jobs
+    glm::vec4   planes[6];
+    glm::mat4   mvpMat;
+    const MyOcclusionCuller * occlusionCuller;
+    glm::vec3   cameraPosition;
+    bool        backfaceCulling;
+
+    MeshletCullStats    stats;
+};
+
+#endif //MY_MESHLET_H
@@ -0,0 +1,205 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include "myMomentum.h"
+#include "myLogger.h"
+#include <math.h>
+
+MyMomentum::MyMomentum() {
+
+    pthread_mutex_init(&momentumMutex, NULL);
+    numSamples = nextSample = 0;
+    isMoving = false;
+    angularVelocity = glm::vec3(0);
+    linearVelocity = glm::vec2(0);
+    lastUpdateTimeMs = accumulatorMs = 0;
+}
+
+MyMomentum::~MyMomentum() {
+
+    pthread_mutex_destroy(&momentumMutex);
+}
+
+/**
+ * Store a gesture event in the history ring, overwriting the oldest one
+ */
+void MyMomentum::AddSample(glm::vec3 rotation, glm::vec2 translation, double timeMs) {
+
+    pthread_mutex_lock(&momentumMutex);
+    GestureSample & sample = samples[nextSample];
+    sample.timeMs = timeMs;
+    sample.rotation = rotation;
+    sample.translation = translation;
+    nextSample = (nextSample + 1) % FLING_MAX_SAMPLES;
+    if (numSamples < FLING_MAX_SAMPLES) {
+        numSamples++;
+    }
+    pthread_mutex_unlock(&momentumMutex);
+}
+
+/**
+ * One-finger drag rotated the model by this quaternion
+ */
+void MyMomentum::AddRotationSample(glm::quat rotation, double timeMs) {
+
+    float angle = glm::angle(rotation);
+    glm::vec3 rotationVector = glm::vec3(0);
+    if (angle > 0 && angle == angle) {
+        rotationVector = glm::axis(rotation) * angle;
+    }
+    AddSample(rotationVector, glm::vec2(0), timeMs);
+}
+
+/**
+ * Two-finger drag moved the model by this distance (normalized to the GL surface)
+ */
+void MyMomentum::AddTranslationSample(float distanceX, float distanceY, double timeMs) {
+
+    AddSample(glm::vec3(0), glm::vec2(distanceX, distanceY), timeMs);
+}
+
+/**
+ * Finger lifted: coast with the average velocity of the recent gesture events
+ */
+void MyMomentum::Release(double timeMs) {
+
+    pthread_mutex_lock(&momentumMutex);
+
+    glm::vec3 totalRotation = glm::vec3(0);
+    glm::vec2 totalTranslation = glm::vec2(0);
+    double oldestTimeMs = timeMs;
+    int numRecent = 0;
+
+    for (int i = 0; i < numSamples; i++) {
+        const GestureSample & sample = samples[i];
+        if (timeMs - sample.timeMs > FLING_SAMPLE_WINDOW_MS) {
+            continue;
+        }
+        totalRotation += sample.rotation;
+        totalTranslation += sample.translation;
+        if (sample.timeMs < oldestTimeMs) {
+            oldestTimeMs = sample.timeMs;
+        }
+        numRecent++;
+    }
+    numSamples = nextSample = 0;
+
+    // finger was held still before lifting, or a single event: no fling
+    if (numRecent < 2) {
+        pthread_mutex_unlock(&momentumMutex);
+        return;
+    }
+
+    float spanSeconds = (float) (fmax(timeMs - oldestTimeMs, FLING_TIMESTEP_MS) / 1000.);
+    angularVelocity = totalRotation / spanSeconds;
+    linearVelocity = totalTranslation / spanSeconds;
+
+    previousState.rotation = currentState.rotation = renderedState.rotation = glm::quat();
+    previousState.translation = currentState.translation = renderedState.translation =
+            glm::vec2(0);
+    lastUpdateTimeMs = timeMs;
+    accumulatorMs = 0;
+    isMoving = glm::length(angularVelocity) > FLING_MIN_ANGULAR_SPEED ||
+               glm::length(linearVelocity) > FLING_MIN_LINEAR_SPEED;
+
+    pthread_mutex_unlock(&momentumMutex);
+}
+
+/**
+ * Finger touched the screen: catch the model and forget the old gesture
+ */
+void MyMomentum::Stop() {
+
+    pthread_mutex_lock(&momentumMutex);
+    isMoving = false;
+    numSamples = nextSample = 0;
+    pthread_mutex_unlock(&momentumMutex);
+}
+
+bool MyMomentum::IsMoving() {
+
+    pthread_mutex_lock(&momentumMutex);
+    bool moving = isMoving;
+    pthread_mutex_unlock(&momentumMutex);
+    return moving;
+}
+
+/**
+ * Advance the simulation by one fixed timestep with exponential damping
+ */
+void MyMomentum::Step() {
+
+    float stepSeconds = (float) (FLING_TIMESTEP_MS / 1000.);
+    previousState = currentState;
+
+    glm::vec3 rotationVector = angularVelocity * stepSeconds;
+    float angle = glm::length(rotationVector);
+    if (angle > 0) {
+        currentState.rotation = glm::angleAxis(angle, rotationVector / angle) *
+                                currentState.rotation;
+    }
+    currentState.translation += linearVelocity * stepSeconds;
+
+    float decay = expf(-FLING_DAMPING * stepSeconds);
+    angularVelocity *= decay;
+    linearVelocity *= decay;
+
+    if (glm::length(angularVelocity) < FLING_MIN_ANGULAR_SPEED &&
+        glm::length(linearVelocity) < FLING_MIN_LINEAR_SPEED) {
+        isMoving = false;
+    }
+}
+
+/**
+ * Run as many fixed steps as fit in the elapsed time, then interpolate between the last two
+ * states for the leftover fraction. Returns the motion to apply since the previous Update.
+ */
+bool MyMomentum::Update(double timeMs, glm::quat & rotationDelta, glm::vec2 & translationDelta) {
+
+    pthread_mutex_lock(&momentumMutex);
+
+    rotationDelta = glm::quat();
+    translationDelta = glm::vec2(0);
+    if (!isMoving) {
+        pthread_mutex_unlock(&momentumMutex);
+        return false;
+    }
+
+    accumulatorMs += fmin(timeMs - lastUpdateTimeMs, FLING_MAX_FRAME_TIME_MS);
+    lastUpdateTimeMs = timeMs;
+    while (accumulatorMs >= FLING_TIMESTEP_MS && isMoving) {
+        Step();
+        accumulatorMs -= FLING_TIMESTEP_MS;
+    }
+
+    SimulationState targetState;
+    if (isMoving) {
+        float alpha = (float) (accumulatorMs / FLING_TIMESTEP_MS);
+        targetState.rotation = glm::slerp(previousState.rotation, currentState.rotation, alpha);
+        targetState.translation = glm::mix(previousState.translation, currentState.translation,
+                                           alpha);
+    } else {
+        // fling ended, make sure the model ends up at the final simulated position
+        targetState = currentState;
+    }
+
+    rotationDelta = targetState.rotation * glm::inverse(renderedState.rotation);
+    translationDelta = targetState.translation - renderedState.translation;
+    renderedState = targetState;
+
+    pthread_mutex_unlock(&momentumMutex);
+    return true;
+}
@@ -0,0 +1,78 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#ifndef MY_MOMENTUM_H
+#define MY_MOMENTUM_H
+
+#include "myGLM.h"
+#include <pthread.h>
+
+// fling is simulated at a fixed rate independent of the display's frame rate
+#define FLING_TIMESTEP_MS           (1000. / 120.)
+// velocity decays as exp(-FLING_DAMPING * seconds)
+#define FLING_DAMPING               3.0f
+// gesture samples older than this at release time do not contribute to the velocity
+#define FLING_SAMPLE_WINDOW_MS      100.
+// fling stops when both speeds fall below these, in radians/s and gesture units/s
+#define FLING_MIN_ANGULAR_SPEED     0.05f
+#define FLING_MIN_LINEAR_SPEED      0.005f
+// a long stall (app paused, GC) is not simulated in full
+#define FLING_MAX_FRAME_TIME_MS     250.
+#define FLING_MAX_SAMPLES           16
+
+/**
+ * Keeps the model moving after a drag ends, using the velocity of the last few gesture events
+ */
+class MyMomentum {
+public:
+    MyMomentum();
+    ~MyMomentum();
+    void    AddRotationSample(glm::quat rotation, double timeMs);
+    void    AddTranslationSample(float distanceX, float distanceY, double timeMs);
+    void    Release(double timeMs);
+    void    Stop();
+    bool    IsMoving();
+    bool    Update(double timeMs, glm::quat & rotationDelta, glm::vec2 & translationDelta);
+
+private:
+    struct GestureSample {
+        double      timeMs;
+        glm::vec3   rotation;       // rotation vector: axis * angle
+        glm::vec2   translation;
+    };
+
+    // model's offset from where the fling started
+    struct SimulationState {
+        glm::quat   rotation;
+        glm::vec2   translation;
+    };
+
+    void    AddSample(glm::vec3 rotation, glm::vec2 translation, double timeMs);
+    void    Step();
+
+    pthread_mutex_t momentumMutex; // gestures arrive on UI thread, Update runs on GL thread
+
+    GestureSample   samples[FLING_MAX_SAMPLES];
+    int             numSamples, nextSample;
+
+    bool            isMoving;
+    glm::vec3       angularVelocity;    // radians/s around the axis it points along
+    glm::vec2       linearVelocity;     // gesture units/s
+    double          lastUpdateTimeMs, accumulatorMs;
+    SimulationState previousState, currentState, renderedState;
+};
+
+#endif //MY_MOMENTUM_H
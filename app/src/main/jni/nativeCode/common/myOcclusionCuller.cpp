@@ -0,0 +1,285 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include "myOcclusionCuller.h"
+#include "mySIMD.h"
+#include "misc.h"
+#include <math.h>
+#include <algorithm>
+
+#define OCCLUSION_TILES_X   (OCCLUSION_BUFFER_WIDTH / OCCLUSION_TILE_SIZE)
+#define OCCLUSION_TILES_Y   (OCCLUSION_BUFFER_HEIGHT / OCCLUSION_TILE_SIZE)
+#define OCCLUSION_BANDS     (OCCLUSION_BUFFER_HEIGHT / OCCLUSION_BAND_ROWS)
+
+MyOcclusionCuller::MyOcclusionCuller() {
+
+    depthBuffer.assign(OCCLUSION_BUFFER_WIDTH * OCCLUSION_BUFFER_HEIGHT, 1.0f);
+    tileMaxDepth.assign(OCCLUSION_TILES_X * OCCLUSION_TILES_Y, 1.0f);
+    testedObjects.store(0);
+    occludedObjects.store(0);
+    rasterizeTimeMs = 0;
+}
+
+void MyOcclusionCuller::BeginFrame() {
+
+    triangles.clear();
+    testedObjects.store(0);
+    occludedObjects.store(0);
+    rasterizeTimeMs = 0;
+}
+
+/**
+ * Project the occluder's triangles to the depth buffer's pixels and set up their edges.
+ * Back-facing triangles and those crossing the near plane are dropped.
+ */
+void MyOcclusionCuller::AddOccluder(const std::vector<glm::vec3> & positions,
+                                    const std::vector<uint32_t> & indices,
+                                    const glm::mat4 & mvpMat) {
+
+    // vertices are shared by several triangles, project each of them once
+    clipPositions.resize(positions.size());
+    for (size_t i = 0; i < positions.size(); i++) {
+        clipPositions[i] = mvpMat * glm::vec4(positions[i], 1.0f);
+    }
+
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+
+        float x[3], y[3], z[3];
+        bool nearClipped = false;
+        for (int k = 0; k < 3; k++) {
+            const glm::vec4 & clip = clipPositions[indices[i + k]];
+            if (clip.w < OCCLUSION_MIN_W) {
+                nearClipped = true;
+                break;
+            }
+            x[k] = (clip.x / clip.w * 0.5f + 0.5f) * OCCLUSION_BUFFER_WIDTH;
+            y[k] = (clip.y / clip.w * 0.5f + 0.5f) * OCCLUSION_BUFFER_HEIGHT;
+            z[k] = clip.z / clip.w * 0.5f + 0.5f;
+        }
+        if (nearClipped) {
+            continue;
+        }
+
+        // counter-clockwise triangles face the camera
+        float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+        if (area <= 0) {
+            continue;
+        }
+
+        ScreenTriangle triangle;
+        triangle.minX = std::max(0, (int) floorf(fminf(x[0], fminf(x[1], x[2]))));
+        triangle.maxX = std::min(OCCLUSION_BUFFER_WIDTH - 1,
+                                 (int) ceilf(fmaxf(x[0], fmaxf(x[1], x[2]))));
+        triangle.minY = std::max(0, (int) floorf(fminf(y[0], fminf(y[1], y[2]))));
+        triangle.maxY = std::min(OCCLUSION_BUFFER_HEIGHT - 1,
+                                 (int) ceilf(fmaxf(y[0], fmaxf(y[1], y[2]))));
+        if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY) {
+            continue;
+        }
+
+        // edge k runs from vertex k to k+1, points on its left are inside
+        for (int k = 0; k < 3; k++) {
+            int next = (k + 1) % 3;
+            triangle.edgeA[k] = y[k] - y[next];
+            triangle.edgeB[k] = x[next] - x[k];
+            triangle.edgeC[k] = -(triangle.edgeA[k] * x[k] + triangle.edgeB[k] * y[k]);
+        }
+
+        // z/w is linear in screen space
+        triangle.depthA = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) / area;
+        triangle.depthB = ((z[2] - z[0]) * (x[1] - x[0]) - (z[1] - z[0]) * (x[2] - x[0])) / area;
+        triangle.depthC = z[0] - triangle.depthA * x[0] - triangle.depthB * y[0];
+
+        triangles.push_back(triangle);
+    }
+}
+
+void MyOcclusionCuller::RasterizeJob(void * data, int begin, int end) {
+
+    MyOcclusionCuller * culler = (MyOcclusionCuller *) data;
+    for (int band = begin; band < end; band++) {
+        culler->RasterizeBand(band);
+    }
+}
+
+/**
+ * Clear one band of rows, rasterize every occluder that touches it four pixels at a time,
+ * then update the band's tiles
+ */
+void MyOcclusionCuller::RasterizeBand(int band) {
+
+    int firstRow = band * OCCLUSION_BAND_ROWS;
+    int lastRow = firstRow + OCCLUSION_BAND_ROWS - 1;
+    float * bandDepth = &depthBuffer[firstRow * OCCLUSION_BUFFER_WIDTH];
+    std::fill(bandDepth, bandDepth + OCCLUSION_BAND_ROWS * OCCLUSION_BUFFER_WIDTH, 1.0f);
+
+    const float pixelOffsets[4] = {0.5f, 1.5f, 2.5f, 3.5f};
+    Float4 offsets = Load4(pixelOffsets);
+    Float4 zero = Splat4(0);
+
+    for (size_t t = 0; t < triangles.size(); t++) {
+
+        const ScreenTriangle & triangle = triangles[t];
+        int minY = std::max(triangle.minY, firstRow);
+        int maxY = std::min(triangle.maxY, lastRow);
+        if (minY > maxY) {
+            continue;
+        }
+        int minX = triangle.minX & ~3;
+
+        Float4 stepA[3], depthStep = Splat4(4 * triangle.depthA);
+        for (int k = 0; k < 3; k++) {
+            stepA[k] = Splat4(4 * triangle.edgeA[k]);
+        }
+
+        for (int row = minY; row <= maxY; row++) {
+
+            float centerY = row + 0.5f;
+            Float4 x = Add4(Splat4((float) minX), offsets);
+            Float4 edge[3];
+            for (int k = 0; k < 3; k++) {
+                edge[k] = Add4(Mul4(x, Splat4(triangle.edgeA[k])),
+                               Splat4(triangle.edgeB[k] * centerY + triangle.edgeC[k]));
+            }
+            Float4 depth = Add4(Mul4(x, Splat4(triangle.depthA)),
+                                Splat4(triangle.depthB * centerY + triangle.depthC));
+
+            float * rowDepth = &depthBuffer[row * OCCLUSION_BUFFER_WIDTH];
+            for (int column = minX; column <= triangle.maxX; column += 4) {
+                Mask4 inside = And4(And4(GreaterEqual4(edge[0], zero),
+                                         GreaterEqual4(edge[1], zero)),
+                                    GreaterEqual4(edge[2], zero));
+                if (AnyTrue4(inside)) {
+                    Float4 current = Load4(rowDepth + column);
+                    Store4(rowDepth + column, Select4(inside, Min4(current, depth), current));
+                }
+                for (int k = 0; k < 3; k++) {
+                    edge[k] = Add4(edge[k], stepA[k]);
+                }
+                depth = Add4(depth, depthStep);
+            }
+        }
+    }
+
+    for (int tileY = firstRow / OCCLUSION_TILE_SIZE;
+         tileY <= lastRow / OCCLUSION_TILE_SIZE; tileY++) {
+        for (int tileX = 0; tileX < OCCLUSION_TILES_X; tileX++) {
+            Float4 farthest = zero;
+            for (int row = 0; row < OCCLUSION_TILE_SIZE; row++) {
+                const float * p = &depthBuffer[(tileY * OCCLUSION_TILE_SIZE + row) *
+                                               OCCLUSION_BUFFER_WIDTH +
+                                               tileX * OCCLUSION_TILE_SIZE];
+                for (int column = 0; column < OCCLUSION_TILE_SIZE; column += 4) {
+                    farthest = Max4(farthest, Load4(p + column));
+                }
+            }
+            float lanes[4];
+            Store4(lanes, farthest);
+            tileMaxDepth[tileY * OCCLUSION_TILES_X + tileX] =
+                    fmaxf(fmaxf(lanes[0], lanes[1]), fmaxf(lanes[2], lanes[3]));
+        }
+    }
+}
+
+/**
+ * Rasterize the occluders added this frame, one band of rows per job
+ */
+void MyOcclusionCuller::Rasterize(MyJobSystem * jobSystem) {
+
+    double startTimeMs = GetMonotonicTimeMs();
+    if (jobSystem) {
+        jobSystem->ParallelFor(RasterizeJob, this, OCCLUSION_BANDS, 1);
+    } else {
+        RasterizeJob(this, 0, OCCLUSION_BANDS);
+    }
+    rasterizeTimeMs = GetMonotonicTimeMs() - startTimeMs;
+}
+
+/**
+ * A box is hidden if its nearest depth is behind the occluders at every pixel it covers.
+ * Whole tiles are skipped when the box is behind their farthest depth.
+ */
+bool MyOcclusionCuller::IsBoxVisible(const glm::mat4 & mvpMat, glm::vec3 boxMin,
+                                     glm::vec3 boxMax) const {
+
+    testedObjects.fetch_add(1, std::memory_order_relaxed);
+
+    float minX = OCCLUSION_BUFFER_WIDTH, maxX = 0;
+    float minY = OCCLUSION_BUFFER_HEIGHT, maxY = 0;
+    float nearestDepth = 1;
+    for (int corner = 0; corner < 8; corner++) {
+        glm::vec3 p((corner & 1) ? boxMax.x : boxMin.x, (corner & 2) ? boxMax.y : boxMin.y,
+                    (corner & 4) ? boxMax.z : boxMin.z);
+        glm::vec4 clip = mvpMat * glm::vec4(p, 1.0f);
+        if (clip.w < OCCLUSION_MIN_W) {
+            return true; // box reaches the camera
+        }
+        float x = (clip.x / clip.w * 0.5f + 0.5f) * OCCLUSION_BUFFER_WIDTH;
+        float y = (clip.y / clip.w * 0.5f + 0.5f) * OCCLUSION_BUFFER_HEIGHT;
+        minX = fminf(minX, x);
+        maxX = fmaxf(maxX, x);
+        minY = fminf(minY, y);
+        maxY = fmaxf(maxY, y);
+        nearestDepth = fminf(nearestDepth, clip.z / clip.w * 0.5f + 0.5f);
+    }
+    if (nearestDepth <= 0) {
+        return true;
+    }
+
+    // pixels whose centers the box covers
+    int firstColumn = std::max(0, (int) floorf(minX));
+    int lastColumn  = std::min(OCCLUSION_BUFFER_WIDTH - 1, (int) ceilf(maxX) - 1);
+    int firstRow    = std::max(0, (int) floorf(minY));
+    int lastRow     = std::min(OCCLUSION_BUFFER_HEIGHT - 1, (int) ceilf(maxY) - 1);
+    if (firstColumn > lastColumn || firstRow > lastRow) {
+        return true; // off screen, left to the frustum test
+    }
+
+    for (int tileY = firstRow / OCCLUSION_TILE_SIZE;
+         tileY <= lastRow / OCCLUSION_TILE_SIZE; tileY++) {
+        for (int tileX = firstColumn / OCCLUSION_TILE_SIZE;
+             tileX <= lastColumn / OCCLUSION_TILE_SIZE; tileX++) {
+
+            if (tileMaxDepth[tileY * OCCLUSION_TILES_X + tileX] < nearestDepth) {
+                continue;
+            }
+            int rowEnd = std::min(lastRow, (tileY + 1) * OCCLUSION_TILE_SIZE - 1);
+            int columnEnd = std::min(lastColumn, (tileX + 1) * OCCLUSION_TILE_SIZE - 1);
+            for (int row = std::max(firstRow, tileY * OCCLUSION_TILE_SIZE); row <= rowEnd; row++) {
+                const float * rowDepth = &depthBuffer[row * OCCLUSION_BUFFER_WIDTH];
+                for (int column = std::max(firstColumn, tileX * OCCLUSION_TILE_SIZE);
+                     column <= columnEnd; column++) {
+                    if (rowDepth[column] >= nearestDepth) {
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+
+    occludedObjects.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+OcclusionStats MyOcclusionCuller::GetStats() const {
+
+    OcclusionStats stats;
+    stats.occluderTriangles = (int) triangles.size();
+    stats.testedObjects = testedObjects.load();
+    stats.occludedObjects = occludedObjects.load();
+    stats.rasterizeTimeMs = rasterizeTimeMs;
+    return stats;
+}
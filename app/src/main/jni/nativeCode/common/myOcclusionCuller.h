@@ -0,0 +1,78 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#ifndef MY_OCCLUSION_CULLER_H
+#define MY_OCCLUSION_CULLER_H
+
+#include "myGLM.h"
+#include "myJobSystem.h"
+#include <atomic>
+#include <stdint.h>
+#include <vector>
+
+// resolution of the software depth buffer, independent of the screen's
+#define OCCLUSION_BUFFER_WIDTH  256
+#define OCCLUSION_BUFFER_HEIGHT 128
+// each tile of the hierarchical level keeps the farthest depth of its pixels
+#define OCCLUSION_TILE_SIZE     8
+// rows rasterized by one job, a multiple of OCCLUSION_TILE_SIZE
+#define OCCLUSION_BAND_ROWS     16
+// occluder triangles with a vertex closer than this (in clip w) are skipped, not clipped
+#define OCCLUSION_MIN_W         1e-3f
+
+struct OcclusionStats {
+    int     occluderTriangles;
+    int     testedObjects, occludedObjects;
+    double  rasterizeTimeMs;
+};
+
+/**
+ * Rasterizes a few occluder meshes into a small depth buffer on the CPU, then tests
+ * bounding boxes against it so that hidden objects are never submitted to GL.
+ * Occluders should lie inside the surfaces they stand for, else they hide visible objects.
+ */
+class MyOcclusionCuller {
+public:
+    MyOcclusionCuller();
+    void    BeginFrame();
+    void    AddOccluder(const std::vector<glm::vec3> & positions,
+                        const std::vector<uint32_t> & indices, const glm::mat4 & mvpMat);
+    void    Rasterize(MyJobSystem * jobSystem);
+    // safe to call from several threads once Rasterize returns
+    bool    IsBoxVisible(const glm::mat4 & mvpMat, glm::vec3 boxMin, glm::vec3 boxMax) const;
+    OcclusionStats GetStats() const;
+
+private:
+    // edge functions and depth plane of a front-facing triangle in buffer pixels
+    struct ScreenTriangle {
+        float   edgeA[3], edgeB[3], edgeC[3];
+        float   depthA, depthB, depthC;
+        int     minX, maxX, minY, maxY;
+    };
+
+    static void RasterizeJob(void * data, int begin, int end);
+    void    RasterizeBand(int band);
+
+    std::vector<ScreenTriangle> triangles;
+    std::vector<glm::vec4>  clipPositions;  // scratch for the occluder being added
+    std::vector<float>  depthBuffer;    // nearest occluder depth in [0, 1], row 0 at the bottom
+    std::vector<float>  tileMaxDepth;   // farthest depth in each tile
+
+    mutable std::atomic<int> testedObjects, occludedObjects;
+    double  rasterizeTimeMs;
+};
+
+#endif //MY_OCCLUSION_CULLER_H
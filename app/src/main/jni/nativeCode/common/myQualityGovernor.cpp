@@ -0,0 +1,205 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include "myQualityGovernor.h"
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
+// costs are estimates: MSAA roughly doubles fill cost at 4x, resolution scales it by area
+const QualityLevel qualityLadder[] = {
+    // name             LOD bias  max scale  MSAA  swap  cost
+    {"msaa4x",          1.0f,     1.0f,      4,    1,    1.0f},
+    {"msaa2x",          1.0f,     1.0f,      2,    1,    0.8f},
+    {"full",            1.0f,     1.0f,      0,    1,    0.65f},
+    {"reduced",         1.5f,     0.85f,     0,    1,    0.5f},
+    {"low",             2.0f,     0.7f,      0,    1,    0.35f},
+    {"low-30fps",       2.0f,     0.7f,      0,    2,    0.35f},
+};
+const int qualityLevelCount = sizeof(qualityLadder) / sizeof(qualityLadder[0]);
+// "full": MSAA is only turned on once the frame times show there is headroom for it
+const int qualityStartLevel = 2;
+static_assert(sizeof(qualityLadder) / sizeof(qualityLadder[0]) <= GOVERNOR_MAX_LEVELS,
+              "qualityLadder is longer than GOVERNOR_MAX_LEVELS");
+
+MyQualityGovernor::MyQualityGovernor(float frameBudgetMs, bool vsyncLimited) {
+
+    this->frameBudgetMs = frameBudgetMs;
+    this->vsyncLimited = vsyncLimited;
+    level = qualityStartLevel;
+    window.reserve(GOVERNOR_WINDOW_FRAMES);
+    thermalHeadroom = -1;
+    windowsOverBudget = windowsRunningHot = windowsWithHeadroom = 0;
+    upWindows = GOVERNOR_UP_WINDOWS;
+    settleWindows = 0;
+    windowsSinceRaise = GOVERNOR_TRIAL_WINDOWS + 1;
+    ResetStats();
+}
+
+void MyQualityGovernor::ResetStats() {
+
+    memset(&stats, 0, sizeof(stats));
+    stats.lastThermalHeadroom = thermalHeadroom;
+}
+
+/**
+ * Budget for the current level, a capped frame rate gets as many refreshes as it waits for
+ */
+float MyQualityGovernor::GetFrameBudgetMs() const {
+
+    return frameBudgetMs * qualityLadder[level].swapInterval;
+}
+
+float MyQualityGovernor::GetPercentile() {
+
+    size_t rank = (size_t) (GOVERNOR_PERCENTILE * (window.size() - 1));
+    std::nth_element(window.begin(), window.begin() + rank, window.end());
+    return window[rank];
+}
+
+void MyQualityGovernor::SetLevel(int newLevel) {
+
+    // leaving a level that was just raised to means it could not be sustained, so wait
+    // longer before trying it again
+    if (newLevel > level && windowsSinceRaise <= GOVERNOR_TRIAL_WINDOWS) {
+        upWindows = std::min(2 * upWindows, GOVERNOR_MAX_UP_WINDOWS);
+    }
+    if (newLevel < level) {
+        windowsSinceRaise = 0;
+    }
+    level = newLevel;
+    windowsOverBudget = windowsRunningHot = windowsWithHeadroom = 0;
+    settleWindows = GOVERNOR_SETTLE_WINDOWS;
+    stats.levelChanges++;
+}
+
+/**
+ * Add one frame's time and the latest thermal headroom, negative if unknown.
+ * Returns true if the level changed, the caller then applies GetQuality().
+ */
+bool MyQualityGovernor::AddFrame(float frameTimeMs, float thermalHeadroom) {
+
+    if (thermalHeadroom >= 0) {
+        this->thermalHeadroom = thermalHeadroom;
+    }
+    window.push_back(frameTimeMs);
+    if ((int) window.size() < GOVERNOR_WINDOW_FRAMES) {
+        return false;
+    }
+
+    float percentileMs = GetPercentile();
+    window.clear();
+    stats.windows++;
+    stats.windowsAtLevel[level]++;
+    stats.lastPercentileMs = percentileMs;
+    stats.lastThermalHeadroom = this->thermalHeadroom;
+    windowsSinceRaise++;
+
+    if (settleWindows > 0) {
+        settleWindows--;
+        return false;
+    }
+
+    float budgetMs = GetFrameBudgetMs();
+    bool thermalKnown = this->thermalHeadroom >= 0;
+    bool runningHot = thermalKnown && this->thermalHeadroom >= GOVERNOR_THERMAL_HIGH;
+    bool cool = !thermalKnown || this->thermalHeadroom <= GOVERNOR_THERMAL_LOW;
+    bool headroom = vsyncLimited ? percentileMs <= budgetMs :
+                    percentileMs < GOVERNOR_UP_THRESHOLD * budgetMs;
+
+    bool overBudget = percentileMs > budgetMs;
+    windowsOverBudget = overBudget ? windowsOverBudget + 1 : 0;
+    windowsRunningHot = runningHot ? windowsRunningHot + 1 : 0;
+    if (overBudget || runningHot) {
+        windowsWithHeadroom = 0;
+        if ((windowsOverBudget >= GOVERNOR_DOWN_WINDOWS ||
+             windowsRunningHot >= GOVERNOR_THERMAL_DOWN_WINDOWS) &&
+            level < qualityLevelCount - 1) {
+            SetLevel(level + 1);
+            return true;
+        }
+    } else if (headroom && cool) {
+        if (++windowsWithHeadroom >= upWindows && level > 0) {
+            SetLevel(level - 1);
+            return true;
+        }
+    } else {
+        // between the thresholds: the current level fits, keep it
+        windowsWithHeadroom = 0;
+    }
+    return false;
+}
+
+/**
+ * Text trace, one frame per line: frame time in ms, thermal headroom, quality level
+ */
+bool LoadFrameTrace(const std::string & fileName, std::vector<FrameSample> & trace) {
+
+    FILE * file = fopen(fileName.c_str(), "r");
+    if (!file) {
+        return false;
+    }
+    trace.clear();
+    FrameSample sample;
+    while (fscanf(file, "%f %f %d", &sample.frameTimeMs, &sample.thermalHeadroom,
+                  &sample.level) == 3) {
+        sample.level = std::max(0, std::min(sample.level, qualityLevelCount - 1));
+        trace.push_back(sample);
+    }
+    fclose(file);
+    return true;
+}
+
+bool SaveFrameTrace(const std::string & fileName, const std::vector<FrameSample> & trace) {
+
+    FILE * file = fopen(fileName.c_str(), "w");
+    if (!file) {
+        return false;
+    }
+    for (size_t i = 0; i < trace.size(); i++) {
+        fprintf(file, "%.3f %.3f %d\n", trace[i].frameTimeMs, trace[i].thermalHeadroom,
+                trace[i].level);
+    }
+    fclose(file);
+    return true;
+}
+
+/**
+ * Replay a recorded trace through a new governor and return its level for every frame.
+ * Recorded times are rescaled by the cost of the governor's level relative to the level
+ * they were recorded at, so the replay responds to its own decisions. A positive
+ * refreshIntervalMs means the trace holds vsync-limited frame intervals.
+ */
+void SimulateQualityGovernor(const std::vector<FrameSample> & trace, float frameBudgetMs,
+                             float refreshIntervalMs, std::vector<int> & levels) {
+
+    bool vsyncLimited = refreshIntervalMs > 0;
+    MyQualityGovernor governor(frameBudgetMs, vsyncLimited);
+    levels.resize(trace.size());
+    for (size_t i = 0; i < trace.size(); i++) {
+        const QualityLevel & recorded = qualityLadder[trace[i].level];
+        const QualityLevel & current = governor.GetQuality();
+        float frameTimeMs = trace[i].frameTimeMs * current.relativeCost / recorded.relativeCost;
+        // with vsync a frame takes whole refreshes, at least as many as the swap interval
+        if (vsyncLimited) {
+            float refreshes = std::max((float) current.swapInterval,
+                                       (float) (int) (frameTimeMs / refreshIntervalMs + 0.999f));
+            frameTimeMs = refreshes * refreshIntervalMs;
+        }
+        levels[i] = governor.GetLevel();
+        governor.AddFrame(frameTimeMs, trace[i].thermalHeadroom);
+    }
+}
@@ -0,0 +1,124 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#ifndef MY_QUALITY_GOVERNOR_H
+#define MY_QUALITY_GOVERNOR_H
+
+#include <string>
+#include <vector>
+
+// frame times are judged by their 90th percentile over windows of this many frames
+#define GOVERNOR_WINDOW_FRAMES      60
+#define GOVERNOR_PERCENTILE         0.9f
+// consecutive windows over budget before quality is lowered
+#define GOVERNOR_DOWN_WINDOWS       2
+// consecutive windows with headroom before quality is raised, doubled up to the maximum
+// each time a raised level has to be left again soon after
+#define GOVERNOR_UP_WINDOWS         10
+#define GOVERNOR_MAX_UP_WINDOWS     80
+// a level that is left within this many windows of being raised to counts as a failed raise
+#define GOVERNOR_TRIAL_WINDOWS      20
+// windows ignored after a level change while the new settings take effect
+#define GOVERNOR_SETTLE_WINDOWS     1
+// frame times below this fraction of the budget leave room to raise quality
+#define GOVERNOR_UP_THRESHOLD       0.7f
+// thermal headroom as reported by Android: 1 is where severe throttling starts
+#define GOVERNOR_THERMAL_HIGH       0.85f
+#define GOVERNOR_THERMAL_LOW        0.6f
+// temperature reacts to a lower level over tens of seconds, so running hot lowers quality
+// only after this many windows
+#define GOVERNOR_THERMAL_DOWN_WINDOWS   15
+// size of the per-level stats, the ladder may not be longer
+#define GOVERNOR_MAX_LEVELS         8
+
+/**
+ * Settings of one rung of the quality ladder
+ */
+struct QualityLevel {
+    const char * name;
+    float   lodBias;            // multiplies the pixel error that LOD selection accepts
+    float   maxResolutionScale; // dynamic resolution never goes above this
+    int     msaaSamples;
+    int     swapInterval;       // 2 caps the frame rate at half the refresh rate
+    float   relativeCost;       // rough GPU cost per frame vs the top level, for simulation
+};
+
+extern const QualityLevel   qualityLadder[];
+extern const int            qualityLevelCount;
+extern const int            qualityStartLevel;
+
+/**
+ * One frame of a recorded trace: its time, the thermal headroom known at that point
+ * (negative if unavailable), and the quality level it was rendered at
+ */
+struct FrameSample {
+    float   frameTimeMs;
+    float   thermalHeadroom;
+    int     level;
+};
+
+struct QualityGovernorStats {
+    int     windows;            // since the last ResetStats
+    int     levelChanges;
+    float   lastPercentileMs;
+    float   lastThermalHeadroom;
+    int     windowsAtLevel[GOVERNOR_MAX_LEVELS];
+};
+
+/**
+ * Steps through qualityLadder, level 0 being the best, to keep frame times within budget and
+ * the SoC out of thermal throttling over long sessions. It starts at qualityStartLevel and
+ * only climbs to the MSAA levels above it when the device has headroom. Quality drops after
+ * a couple of windows over budget or running hot, and rises only after a longer run of
+ * windows with headroom, so short spikes do not make it oscillate.
+ *
+ * The governor only sees the samples it is given, never a clock or GL, so replaying a trace
+ * gives the same decisions every time.
+ */
+class MyQualityGovernor {
+public:
+    MyQualityGovernor(float frameBudgetMs, bool vsyncLimited);
+    bool    AddFrame(float frameTimeMs, float thermalHeadroom);
+    int     GetLevel() const { return level; }
+    const QualityLevel & GetQuality() const { return qualityLadder[level]; }
+    float   GetFrameBudgetMs() const;
+    const QualityGovernorStats & GetStats() const { return stats; }
+    void    ResetStats();
+
+private:
+    void    SetLevel(int newLevel);
+    float   GetPercentile();
+
+    float   frameBudgetMs;      // at swap interval 1
+    // frame intervals never drop below the refresh interval, so with vsync-limited times
+    // staying on budget is all the headroom we can see
+    bool    vsyncLimited;
+    int     level;
+
+    std::vector<float> window;
+    float   thermalHeadroom;
+    int     windowsOverBudget, windowsRunningHot, windowsWithHeadroom;
+    int     upWindows, settleWindows, windowsSinceRaise;
+
+    QualityGovernorStats stats;
+};
+
+bool    LoadFrameTrace(const std::string & fileName, std::vector<FrameSample> & trace);
+bool    SaveFrameTrace(const std::string & fileName, const std::vector<FrameSample> & trace);
+void    SimulateQualityGovernor(const std::vector<FrameSample> & trace, float frameBudgetMs,
+                                float refreshIntervalMs, std::vector<int> & levels);
+
+#endif //MY_QUALITY_GOVERNOR_H
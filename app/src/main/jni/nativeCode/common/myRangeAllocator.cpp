@@ -0,0 +1,83 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include "myRangeAllocator.h"
+
+MyRangeAllocator::MyRangeAllocator(uint32_t capacity) {
+
+    this->capacity = capacity;
+    usedSize = 0;
+    FreeRange all = {0, capacity};
+    freeRanges.push_back(all);
+}
+
+/**
+ * Return the offset of a free range of size elements, or RANGE_ALLOCATION_FAILED
+ */
+uint32_t MyRangeAllocator::Allocate(uint32_t size) {
+
+    if (size == 0) {
+        return RANGE_ALLOCATION_FAILED;
+    }
+    for (size_t i = 0; i < freeRanges.size(); i++) {
+        if (freeRanges[i].size < size) {
+            continue;
+        }
+        uint32_t offset = freeRanges[i].offset;
+        freeRanges[i].offset += size;
+        freeRanges[i].size -= size;
+        if (freeRanges[i].size == 0) {
+            freeRanges.erase(freeRanges.begin() + i);
+        }
+        usedSize += size;
+        return offset;
+    }
+    return RANGE_ALLOCATION_FAILED;
+}
+
+/**
+ * Return a range to the free list and merge it with its free neighbors
+ */
+void MyRangeAllocator::Free(uint32_t offset, uint32_t size) {
+
+    size_t i = 0;
+    while (i < freeRanges.size() && freeRanges[i].offset < offset) {
+        i++;
+    }
+    FreeRange range = {offset, size};
+    freeRanges.insert(freeRanges.begin() + i, range);
+    usedSize -= size;
+
+    if (i + 1 < freeRanges.size() &&
+        freeRanges[i].offset + freeRanges[i].size == freeRanges[i + 1].offset) {
+        freeRanges[i].size += freeRanges[i + 1].size;
+        freeRanges.erase(freeRanges.begin() + i + 1);
+    }
+    if (i > 0 && freeRanges[i - 1].offset + freeRanges[i - 1].size == freeRanges[i].offset) {
+        freeRanges[i - 1].size += freeRanges[i].size;
+        freeRanges.erase(freeRanges.begin() + i);
+    }
+}
+
+uint32_t MyRangeAllocator::GetHighWaterMark() const {
+
+    // the last free range reaches the end unless the buffer is full up to capacity
+    if (!freeRanges.empty() &&
+        freeRanges.back().offset + freeRanges.back().size == capacity) {
+        return freeRanges.back().offset;
+    }
+    return capacity;
+}
@@ -0,0 +1,49 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#ifndef MY_RANGE_ALLOCATOR_H
+#define MY_RANGE_ALLOCATOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#define RANGE_ALLOCATION_FAILED 0xFFFFFFFF
+
+/**
+ * First-fit sub-allocator for ranges of elements in a fixed-size buffer.
+ * Only offsets are tracked, the caller owns the storage.
+ */
+class MyRangeAllocator {
+public:
+    MyRangeAllocator(uint32_t capacity);
+    uint32_t    Allocate(uint32_t size);
+    void        Free(uint32_t offset, uint32_t size);
+    uint32_t    GetCapacity() const { return capacity; }
+    uint32_t    GetUsedSize() const { return usedSize; }
+    // end of the last allocated range, buffers only need to be this large
+    uint32_t    GetHighWaterMark() const;
+
+private:
+    struct FreeRange {
+        uint32_t    offset, size;
+    };
+
+    uint32_t    capacity, usedSize;
+    std::vector<FreeRange> freeRanges; // sorted by offset, never adjacent
+};
+
+#endif //MY_RANGE_ALLOCATOR_H
@@ -0,0 +1,783 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+
+#include "myRenderGraph.h"
+#include "myLogger.h"
+#include <algorithm>
+#include <string.h>
+
+static bool IsDepthFormat(GLenum format) {
+
+    return format == GL_DEPTH_COMPONENT16 || format == GL_DEPTH_COMPONENT24 ||
+           format == GL_DEPTH_COMPONENT32F || format == GL_DEPTH24_STENCIL8 ||
+           format == GL_DEPTH32F_STENCIL8;
+}
+
+static GLenum GetDepthAttachment(GLenum format) {
+
+    if (format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8) {
+        return GL_DEPTH_STENCIL_ATTACHMENT;
+    }
+    return GL_DEPTH_ATTACHMENT;
+}
+
+/**
+ * What the driver allocates per sample, formats it pads like 24-bit depth count as padded
+ */
+static int GetBytesPerPixel(GLenum format) {
+
+    switch (format) {
+        case GL_R8:
+            return 1;
+        case GL_RG8:
+        case GL_RGB565:
+        case GL_RGBA4:
+        case GL_RGB5_A1:
+        case GL_R16F:
+        case GL_DEPTH_COMPONENT16:
+            return 2;
+        case GL_RG16F:
+        case GL_RGBA16F:
+            return format == GL_RG16F ? 4 : 8;
+        case GL_DEPTH32F_STENCIL8:
+            return 8;
+        case GL_RGBA32F:
+            return 16;
+        default:
+            return 4;
+    }
+}
+
+static size_t GetTargetBytes(const RenderTargetDesc & desc) {
+
+    return (size_t) desc.width * desc.height * GetBytesPerPixel(desc.format) *
+           std::max(1, (int) desc.samples);
+}
+
+MyRenderGraph::MyRenderGraph() {
+
+    nextSerial = 1;
+    compiled = false;
+    memset(&stats, 0, sizeof(stats));
+}
+
+MyRenderGraph::~MyRenderGraph() {
+
+    for (unsigned int i = 0; i < framebuffers.size(); i++) {
+        glDeleteFramebuffers(1, &framebuffers[i].name);
+    }
+    for (unsigned int i = 0; i < physicalTargets.size(); i++) {
+        DeletePhysicalTarget(physicalTargets[i]);
+    }
+}
+
+/**
+ * Start declaring the next frame's passes, keeps the GL objects of the previous one
+ */
+void MyRenderGraph::Reset() {
+
+    targets.clear();
+    passes.clear();
+    compiled = false;
+}
+
+/**
+ * Declare a transient target, its contents are undefined until a pass writes it
+ */
+int MyRenderGraph::CreateTarget(const char * name, const RenderTargetDesc & desc) {
+
+    Target target;
+    target.name = name;
+    target.desc = desc;
+    target.imported = false;
+    target.attachment = GL_NONE;
+    target.readers = 0;
+    targets.push_back(target);
+    return (int) targets.size() - 1;
+}
+
+/**
+ * Declare one of the window's attachments, GL_COLOR_ATTACHMENT0 or GL_DEPTH_ATTACHMENT,
+ * with the format of the EGL config for the traffic estimate. Imported targets are the
+ * graph's outputs: passes are kept if their results reach one that is stored.
+ */
+int MyRenderGraph::ImportBackbuffer(const char * name, GLenum attachment,
+                                    const RenderTargetDesc & desc) {
+
+    Target target;
+    target.name = name;
+    target.desc = desc;
+    target.imported = true;
+    target.attachment = attachment;
+    target.readers = 0;
+    targets.push_back(target);
+    return (int) targets.size() - 1;
+}
+
+/**
+ * Passes run in the order they are added
+ */
+int MyRenderGraph::AddPass(const char * name, RenderPassFunction function, void * data) {
+
+    Pass pass;
+    pass.name = name;
+    pass.function = function;
+    pass.data = data;
+    pass.clearColor[0] = pass.clearColor[1] = pass.clearColor[2] = 0;
+    pass.clearColor[3] = 1;
+    pass.clearDepth = 1;
+    pass.culled = false;
+    pass.framebuffer = 0;
+    pass.width = pass.height = 0;
+    passes.push_back(pass);
+    return (int) passes.size() - 1;
+}
+
+void MyRenderGraph::SetClearColor(int pass, float red, float green, float blue, float alpha) {
+
+    passes[pass].clearColor[0] = red;
+    passes[pass].clearColor[1] = green;
+    passes[pass].clearColor[2] = blue;
+    passes[pass].clearColor[3] = alpha;
+}
+
+void MyRenderGraph::SetClearDepth(int pass, float depth) {
+
+    passes[pass].clearDepth = depth;
+}
+
+void MyRenderGraph::Read(int pass, int target) {
+
+    passes[pass].reads.push_back(target);
+    targets[target].readers++;
+}
+
+void MyRenderGraph::Write(int pass, int target, RenderLoadAction load,
+                          RenderStoreAction store) {
+
+    passes[pass].writes.push_back(target);
+    passes[pass].loads.push_back(load);
+    passes[pass].stores.push_back(store);
+    targets[target].writers.push_back(pass);
+}
+
+/**
+ * Cull, alias and get the framebuffers ready for Execute. Returns false if a framebuffer
+ * is incomplete or a pass mixes window and transient attachments, Execute then does
+ * nothing and the frame has to be declared differently.
+ */
+bool MyRenderGraph::Compile() {
+
+    CullPasses();
+    ComputeLifetimes();
+    std::vector<PhysicalTarget> slots;
+    AliasTargets(slots);
+    bool changed = CreatePhysicalTargets(slots);
+    compiled = CreateFramebuffers();
+    if (!compiled) {
+        return false;
+    }
+    ResolveAttachmentActions();
+    if (changed) {
+        LogReport();
+    }
+    CheckGLError("MyRenderGraph::Compile");
+    return true;
+}
+
+void MyRenderGraph::CullPass(int pass, std::vector<int> & unusedTargets) {
+
+    passes[pass].culled = true;
+    for (unsigned int i = 0; i < passes[pass].reads.size(); i++) {
+        int target = passes[pass].reads[i];
+        if (--targets[target].refCount == 0) {
+            unusedTargets.push_back(target);
+        }
+    }
+}
+
+/**
+ * A pass is culled once nothing reads any target it writes, counting the window as a
+ * reader of imported targets. Culling a pass releases the targets it reads in turn.
+ */
+void MyRenderGraph::CullPasses() {
+
+    std::vector<int> unusedTargets;
+    for (unsigned int i = 0; i < targets.size(); i++) {
+        targets[i].discardedWrites = true;
+    }
+    for (unsigned int i = 0; i < passes.size(); i++) {
+        for (unsigned int j = 0; j < passes[i].writes.size(); j++) {
+            if (passes[i].stores[j] == RENDER_STORE_STORE) {
+                targets[passes[i].writes[j]].discardedWrites = false;
+            }
+        }
+    }
+    for (unsigned int i = 0; i < targets.size(); i++) {
+        bool output = targets[i].imported && !targets[i].discardedWrites;
+        targets[i].refCount = targets[i].readers + (output ? 1 : 0);
+        if (targets[i].refCount == 0) {
+            unusedTargets.push_back(i);
+        }
+    }
+    for (unsigned int i = 0; i < passes.size(); i++) {
+        passes[i].culled = false;
+        passes[i].refCount = (int) passes[i].writes.size();
+    }
+    for (unsigned int i = 0; i < passes.size(); i++) {
+        if (passes[i].refCount == 0) {
+            CullPass(i, unusedTargets);
+        }
+    }
+
+    while (!unusedTargets.empty()) {
+        const Target & target = targets[unusedTargets.back()];
+        unusedTargets.pop_back();
+        for (unsigned int i = 0; i < target.writers.size(); i++) {
+            Pass & writer = passes[target.writers[i]];
+            if (!writer.culled && --writer.refCount == 0) {
+                CullPass(target.writers[i], unusedTargets);
+            }
+        }
+    }
+
+    stats.passes = (int) passes.size();
+    stats.culledPasses = 0;
+    for (unsigned int i = 0; i < passes.size(); i++) {
+        stats.culledPasses += passes[i].culled ? 1 : 0;
+    }
+}
+
+/**
+ * Lifetimes run from the first to the last live pass that reads or writes a target
+ */
+void MyRenderGraph::ComputeLifetimes() {
+
+    for (unsigned int i = 0; i < targets.size(); i++) {
+        targets[i].firstUse = targets[i].lastUse = targets[i].lastWriter = -1;
+        targets[i].liveReaders = 0;
+        targets[i].physical = -1;
+    }
+    for (int i = 0; i < (int) passes.size(); i++) {
+        if (passes[i].culled) {
+            continue;
+        }
+        for (unsigned int j = 0; j < passes[i].reads.size(); j++) {
+            Target & target = targets[passes[i].reads[j]];
+            target.firstUse = target.firstUse < 0 ? i : target.firstUse;
+            target.lastUse = i;
+            target.liveReaders++;
+        }
+        for (unsigned int j = 0; j < passes[i].writes.size(); j++) {
+            Target & target = targets[passes[i].writes[j]];
+            target.firstUse = target.firstUse < 0 ? i : target.firstUse;
+            target.lastUse = i;
+            target.lastWriter = i;
+        }
+    }
+    // multisampled textures need GLES 3.1, so MSAA targets are always renderbuffers
+    for (unsigned int i = 0; i < targets.size(); i++) {
+        targets[i].texture = targets[i].liveReaders > 0 && targets[i].desc.samples == 0;
+    }
+}
+
+/**
+ * Greedy interval assignment: in order of first use, each transient target takes the
+ * first slot of its kind that is free by then, or a new one. Two targets used by the same
+ * pass never share. Slots become the physical targets.
+ */
+void MyRenderGraph::AliasTargets(std::vector<PhysicalTarget> & slots) {
+
+    // first use, then declaration order
+    std::vector<std::pair<int, int> > order;
+    for (unsigned int i = 0; i < targets.size(); i++) {
+        if (!targets[i].imported && targets[i].firstUse >= 0) {
+            order.push_back(std::make_pair(targets[i].firstUse, (int) i));
+        }
+    }
+    std::sort(order.begin(), order.end());
+
+    // free until the end of this pass
+    std::vector<int> slotLastUse;
+    stats.transientTargets = (int) order.size();
+    stats.transientBytes = stats.physicalBytes = 0;
+    for (unsigned int i = 0; i < order.size(); i++) {
+        Target & target = targets[order[i].second];
+        stats.transientBytes += GetTargetBytes(target.desc);
+        unsigned int slot = 0;
+        while (slot < slots.size() && !(slots[slot].desc == target.desc &&
+                                         slots[slot].texture == target.texture &&
+                                         slotLastUse[slot] < target.firstUse)) {
+            slot++;
+        }
+        if (slot == slots.size()) {
+            PhysicalTarget physical;
+            physical.desc = target.desc;
+            physical.texture = target.texture;
+            physical.name = 0;
+            physical.serial = 0;
+            physical.bytes = GetTargetBytes(target.desc);
+            physical.used = false;
+            slots.push_back(physical);
+            slotLastUse.push_back(-1);
+            stats.physicalBytes += physical.bytes;
+        }
+        slotLastUse[slot] = target.lastUse;
+        target.physical = slot;
+    }
+    stats.physicalTargets = (int) slots.size();
+}
+
+/**
+ * Take the objects of last frame for the slots that match them, create the others and
+ * delete what is left over. Returns true if anything was created or deleted.
+ */
+bool MyRenderGraph::CreatePhysicalTargets(const std::vector<PhysicalTarget> & slots) {
+
+    bool changed = false;
+    for (unsigned int i = 0; i < physicalTargets.size(); i++) {
+        physicalTargets[i].used = false;
+    }
+    std::vector<PhysicalTarget> kept;
+    for (unsigned int i = 0; i < slots.size(); i++) {
+        unsigned int j = 0;
+        while (j < physicalTargets.size() && (physicalTargets[j].used ||
+               !(physicalTargets[j].desc == slots[i].desc) ||
+               physicalTargets[j].texture != slots[i].texture)) {
+            j++;
+        }
+        if (j < physicalTargets.size()) {
+            physicalTargets[j].used = true;
+            kept.push_back(physicalTargets[j]);
+        } else {
+            kept.push_back(slots[i]);
+            CreatePhysicalTarget(kept.back());
+            changed = true;
+        }
+    }
+    for (unsigned int i = 0; i < physicalTargets.size(); i++) {
+        if (!physicalTargets[i].used) {
+            DeletePhysicalTarget(physicalTargets[i]);
+            changed = true;
+        }
+    }
+    physicalTargets.swap(kept);
+    return changed;
+}
+
+void MyRenderGraph::CreatePhysicalTarget(PhysicalTarget & physical) {
+
+    const RenderTargetDesc & desc = physical.desc;
+    physical.serial = nextSerial++;
+    if (!physical.texture) {
+        glGenRenderbuffers(1, &physical.name);
+        glBindRenderbuffer(GL_RENDERBUFFER, physical.name);
+        if (desc.samples > 0) {
+            glRenderbufferStorageMultisample(GL_RENDERBUFFER, desc.samples, desc.format,
+                                             desc.width, desc.height);
+        } else {
+            glRenderbufferStorage(GL_RENDERBUFFER, desc.format, desc.width, desc.height);
+        }
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        return;
+    }
+
+    glGenTextures(1, &physical.name);
+    glBindTexture(GL_TEXTURE_2D, physical.name);
+    if (IsGLES3Supported()) {
+        glTexStorage2D(GL_TEXTURE_2D, 1, desc.format, desc.width, desc.height);
+    } else if (desc.format == GL_RGB565) {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, desc.width, desc.height, 0, GL_RGB,
+                     GL_UNSIGNED_SHORT_5_6_5, NULL);
+    } else {
+        // GLES 2 textures are unsized, anything else is rendered as RGBA
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, desc.width, desc.height, 0, GL_RGBA,
+                     GL_UNSIGNED_BYTE, NULL);
+    }
+    // depth textures cannot be filtered without a compare mode, NPOT ones need clamping
+    GLint filter = IsDepthFormat(desc.format) ? GL_NEAREST : GL_LINEAR;
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void MyRenderGraph::DeletePhysicalTarget(PhysicalTarget & physical) {
+
+    if (physical.texture) {
+        glDeleteTextures(1, &physical.name);
+    } else {
+        glDeleteRenderbuffers(1, &physical.name);
+    }
+    physical.name = 0;
+}
+
+/**
+ * Where a target is attached in the framebuffer of a pass that writes it
+ */
+GLenum MyRenderGraph::GetAttachment(int pass, int target) const {
+
+    if (targets[target].imported) {
+        return targets[target].attachment;
+    }
+    if (IsDepthFormat(targets[target].desc.format)) {
+        return GetDepthAttachment(targets[target].desc.format);
+    }
+    int colorIndex = 0;
+    for (unsigned int i = 0; i < passes[pass].writes.size(); i++) {
+        int written = passes[pass].writes[i];
+        if (written == target) {
+            break;
+        }
+        if (!targets[written].imported && !IsDepthFormat(targets[written].desc.format)) {
+            colorIndex++;
+        }
+    }
+    return GL_COLOR_ATTACHMENT0 + colorIndex;
+}
+
+/**
+ * Passes that write the window draw into framebuffer 0, the others get a framebuffer per
+ * set of attachments, kept across frames like the targets
+ */
+bool MyRenderGraph::CreateFramebuffers() {
+
+    for (unsigned int i = 0; i < framebuffers.size(); i++) {
+        framebuffers[i].used = false;
+    }
+
+    bool complete = true;
+    for (unsigned int i = 0; i < passes.size() && complete; i++) {
+        Pass & pass = passes[i];
+        if (pass.culled) {
+            continue;
+        }
+        pass.framebuffer = 0;
+        const RenderTargetDesc & firstDesc = targets[pass.writes[0]].desc;
+        pass.width = firstDesc.width;
+        pass.height = firstDesc.height;
+
+        Framebuffer key;
+        for (int j = 0; j < RENDER_GRAPH_MAX_COLOR_ATTACHMENTS; j++) {
+            key.colorSerials[j] = 0;
+        }
+        key.depthSerial = 0;
+        int colorCount = 0, importedCount = 0;
+        for (unsigned int j = 0; j < pass.writes.size(); j++) {
+            const Target & target = targets[pass.writes[j]];
+            if (target.imported) {
+                importedCount++;
+            } else if (IsDepthFormat(target.desc.format)) {
+                key.depthSerial = physicalTargets[target.physical].serial;
+            } else if (colorCount < RENDER_GRAPH_MAX_COLOR_ATTACHMENTS) {
+                key.colorSerials[colorCount++] = physicalTargets[target.physical].serial;
+            } else {
+                MyLOGE("Render pass %s writes more than %d colors", pass.name.c_str(),
+                       RENDER_GRAPH_MAX_COLOR_ATTACHMENTS);
+                complete = false;
+            }
+        }
+        if (importedCount > 0) {
+            if (importedCount < (int) pass.writes.size()) {
+                MyLOGE("Render pass %s writes the window and render targets",
+                       pass.name.c_str());
+                complete = false;
+            }
+            continue;
+        }
+
+        unsigned int j = 0;
+        while (j < framebuffers.size() && (key.depthSerial != framebuffers[j].depthSerial ||
+               memcmp(key.colorSerials, framebuffers[j].colorSerials,
+                      sizeof(key.colorSerials)))) {
+            j++;
+        }
+        if (j < framebuffers.size()) {
+            framebuffers[j].used = true;
+            pass.framebuffer = framebuffers[j].name;
+            continue;
+        }
+
+        glGenFramebuffers(1, &key.name);
+        glBindFramebuffer(GL_FRAMEBUFFER, key.name);
+        for (unsigned int k = 0; k < pass.writes.size(); k++) {
+            const Target & target = targets[pass.writes[k]];
+            const PhysicalTarget & physical = physicalTargets[target.physical];
+            GLenum attachment = GetAttachment(i, pass.writes[k]);
+            if (physical.texture) {
+                glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, physical.name,
+                                       0);
+            } else {
+                glFramebufferRenderbuffer(GL_FRAMEBUFFER, attachment, GL_RENDERBUFFER,
+                                          physical.name);
+            }
+        }
+        if (colorCount > 1) {
+            GLenum drawBuffers[RENDER_GRAPH_MAX_COLOR_ATTACHMENTS];
+            for (int k = 0; k < colorCount; k++) {
+                drawBuffers[k] = GL_COLOR_ATTACHMENT0 + k;
+            }
+            glDrawBuffers(colorCount, drawBuffers);
+        }
+        GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        key.used = true;
+        framebuffers.push_back(key);
+        pass.framebuffer = key.name;
+        if (status != GL_FRAMEBUFFER_COMPLETE) {
+            MyLOGE("Framebuffer of render pass %s is incomplete (0x%x)", pass.name.c_str(),
+                   status);
+            complete = false;
+        }
+    }
+
+    // an incomplete framebuffer is deleted with the unused ones
+    unsigned int kept = 0;
+    for (unsigned int i = 0; i < framebuffers.size(); i++) {
+        if (framebuffers[i].used && complete) {
+            framebuffers[kept++] = framebuffers[i];
+        } else {
+            glDeleteFramebuffers(1, &framebuffers[i].name);
+        }
+    }
+    framebuffers.resize(kept);
+    return complete;
+}
+
+/**
+ * The window's attachments go by other names than a framebuffer object's
+ */
+void MyRenderGraph::AddAttachment(std::vector<std::pair<GLuint, GLenum> > & attachments,
+                                  GLuint framebuffer, GLenum attachment) const {
+
+    if (framebuffer) {
+        attachments.push_back(std::make_pair(framebuffer, attachment));
+        return;
+    }
+    if (attachment == GL_COLOR_ATTACHMENT0) {
+        attachments.push_back(std::make_pair(framebuffer, (GLenum) GL_COLOR));
+    }
+    if (attachment == GL_DEPTH_ATTACHMENT || attachment == GL_DEPTH_STENCIL_ATTACHMENT) {
+        attachments.push_back(std::make_pair(framebuffer, (GLenum) GL_DEPTH));
+    }
+    if (attachment == GL_STENCIL_ATTACHMENT || attachment == GL_DEPTH_STENCIL_ATTACHMENT) {
+        attachments.push_back(std::make_pair(framebuffer, (GLenum) GL_STENCIL));
+    }
+}
+
+/**
+ * Turn load and store actions into clears and invalidations, and count the traffic.
+ *
+ * An attachment the pass does not care about, or loads while nothing was written to it
+ * yet, is invalidated before the pass. A transient target is invalidated in the
+ * framebuffer it was written to right after the last pass that uses it: targets written
+ * but never read are dropped before they are stored, the others before an aliased target
+ * reuses their memory. Writes that store nothing are invalidated after their pass too.
+ */
+void MyRenderGraph::ResolveAttachmentActions() {
+
+    stats.loadedBytes = stats.storedBytes = stats.avoidedBytes = 0;
+    std::vector<bool> written(targets.size(), false);
+    for (int i = 0; i < (int) passes.size(); i++) {
+        Pass & pass = passes[i];
+        pass.clearMask = 0;
+        pass.clearedColors.clear();
+        pass.discards.clear();
+        pass.invalidations.clear();
+        if (pass.culled) {
+            continue;
+        }
+
+        int colorCount = 0;
+        for (unsigned int j = 0; j < pass.writes.size(); j++) {
+            const Target & target = targets[pass.writes[j]];
+            GLenum attachment = GetAttachment(i, pass.writes[j]);
+            bool color = attachment != GL_DEPTH_ATTACHMENT &&
+                         attachment != GL_DEPTH_STENCIL_ATTACHMENT &&
+                         attachment != GL_STENCIL_ATTACHMENT;
+            size_t bytes = GetTargetBytes(target.desc);
+
+            RenderLoadAction load = pass.loads[j];
+            if (load == RENDER_LOAD_LOAD && !target.imported && !written[pass.writes[j]]) {
+                load = RENDER_LOAD_DONT_CARE;
+            }
+            if (load == RENDER_LOAD_CLEAR) {
+                if (color) {
+                    pass.clearMask |= GL_COLOR_BUFFER_BIT;
+                    pass.clearedColors.push_back(colorCount);
+                } else {
+                    pass.clearMask |= attachment == GL_DEPTH_ATTACHMENT ? GL_DEPTH_BUFFER_BIT :
+                                      attachment == GL_STENCIL_ATTACHMENT ?
+                                      GL_STENCIL_BUFFER_BIT :
+                                      GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT;
+                }
+            } else if (load == RENDER_LOAD_DONT_CARE) {
+                AddAttachment(pass.discards, pass.framebuffer, attachment);
+            }
+            if (load == RENDER_LOAD_LOAD) {
+                stats.loadedBytes += bytes;
+            } else {
+                stats.avoidedBytes += bytes;
+            }
+            colorCount += color ? 1 : 0;
+            written[pass.writes[j]] = true;
+
+            bool lastUse = !target.imported && target.lastUse == i;
+            if (pass.stores[j] == RENDER_STORE_DONT_CARE || lastUse) {
+                AddAttachment(pass.invalidations, pass.framebuffer, attachment);
+                stats.avoidedBytes += bytes;
+            } else {
+                stats.storedBytes += bytes;
+            }
+        }
+
+        // targets this pass only reads, invalidated where they were written
+        for (unsigned int j = 0; j < pass.reads.size(); j++) {
+            int read = pass.reads[j];
+            const Target & target = targets[read];
+            if (target.imported || target.lastUse != i || target.lastWriter < 0 ||
+                target.lastWriter == i ||
+                std::find(pass.reads.begin(), pass.reads.begin() + j, read) !=
+                pass.reads.begin() + j) {
+                continue;
+            }
+            AddAttachment(pass.invalidations, passes[target.lastWriter].framebuffer,
+                          GetAttachment(target.lastWriter, read));
+        }
+        std::sort(pass.invalidations.begin(), pass.invalidations.end());
+
+        // glClear covers every draw buffer, so with only some cleared GLES 3 clears them
+        // one by one, GLES 2 has a single color attachment
+        if ((int) pass.clearedColors.size() == colorCount || !IsGLES3Supported()) {
+            pass.clearedColors.clear();
+        } else {
+            pass.clearMask &= ~GL_COLOR_BUFFER_BIT;
+        }
+    }
+}
+
+/**
+ * One call per framebuffer, the attachments are sorted by it
+ */
+void MyRenderGraph::Invalidate(const std::vector<std::pair<GLuint, GLenum> > & attachments) {
+
+    unsigned int i = 0;
+    while (i < attachments.size()) {
+        GLuint framebuffer = attachments[i].first;
+        GLenum names[RENDER_GRAPH_MAX_COLOR_ATTACHMENTS + 2];
+        GLsizei count = 0;
+        while (i < attachments.size() && attachments[i].first == framebuffer) {
+            names[count++] = attachments[i++].second;
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        if (InvalidateFramebuffer(count, names)) {
+            stats.invalidatedAttachments += count;
+        }
+    }
+}
+
+void MyRenderGraph::Clear(const Pass & pass) const {
+
+    glClearColor(pass.clearColor[0], pass.clearColor[1], pass.clearColor[2],
+                 pass.clearColor[3]);
+    glClearDepthf(pass.clearDepth);
+    if (pass.clearMask) {
+        glClear(pass.clearMask);
+    }
+    for (unsigned int i = 0; i < pass.clearedColors.size(); i++) {
+        glClearBufferfv(GL_COLOR, pass.clearedColors[i], pass.clearColor);
+    }
+}
+
+/**
+ * Run the live passes in order. Leaves the window bound.
+ */
+void MyRenderGraph::Execute() {
+
+    stats.invalidatedAttachments = 0;
+    if (!compiled) {
+        return;
+    }
+    for (unsigned int i = 0; i < passes.size(); i++) {
+        Pass & pass = passes[i];
+        if (pass.culled) {
+            continue;
+        }
+        Invalidate(pass.discards);
+        glBindFramebuffer(GL_FRAMEBUFFER, pass.framebuffer);
+        glViewport(0, 0, pass.width, pass.height);
+        if (pass.clearMask || !pass.clearedColors.empty()) {
+            Clear(pass);
+        }
+        pass.function(pass.data, *this, i);
+        Invalidate(pass.invalidations);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    CheckGLError("MyRenderGraph::Execute");
+}
+
+/**
+ * The context was lost with the targets and framebuffers in it, forget their names
+ * without deleting them. The next Compile creates them again.
+ */
+void MyRenderGraph::ForgetGLObjects() {
+
+    physicalTargets.clear();
+    framebuffers.clear();
+    compiled = false;
+}
+
+/**
+ * Texture of a target that a pass reads, 0 for renderbuffers and culled targets
+ */
+GLuint MyRenderGraph::GetTexture(int target) const {
+
+    int physical = targets[target].physical;
+    if (physical < 0 || !physicalTargets[physical].texture) {
+        return 0;
+    }
+    return physicalTargets[physical].name;
+}
+
+/**
+ * Framebuffer of the last pass that writes a target, to blit from
+ */
+GLuint MyRenderGraph::GetFramebuffer(int target) const {
+
+    int writer = targets[target].lastWriter;
+    return writer < 0 ? 0 : passes[writer].framebuffer;
+}
+
+void MyRenderGraph::LogReport() const {
+
+    MyLOGI("Render graph: %d passes (%d culled), %d transient targets in %d allocations, "
+           "%d KB before aliasing and %d KB after", stats.passes, stats.culledPasses,
+           stats.transientTargets, stats.physicalTargets, (int) (stats.transientBytes / 1024),
+           (int) (stats.physicalBytes / 1024));
+    for (unsigned int i = 0; i < targets.size(); i++) {
+        const Target & target = targets[i];
+        if (target.imported || target.firstUse < 0) {
+            continue;
+        }
+        MyLOGD("  %s: %dx%d format 0x%x %d samples, passes %s to %s, %s %d", target.name.c_str(),
+               target.desc.width, target.desc.height, target.desc.format, target.desc.samples,
+               passes[target.firstUse].name.c_str(), passes[target.lastUse].name.c_str(),
+               target.texture ? "texture" : "renderbuffer",
+               physicalTargets[target.physical].name);
+    }
+}
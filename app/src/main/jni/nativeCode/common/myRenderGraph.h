@@ -0,0 +1,191 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+
+#ifndef MY_RENDER_GRAPH_H
+#define MY_RENDER_GRAPH_H
+
+#include "myGLFunctions.h"
+#include <vector>
+#include <string>
+
+// color attachments a pass can write besides one depth attachment
+#define RENDER_GRAPH_MAX_COLOR_ATTACHMENTS  4
+
+/**
+ * Size, format and sample count of a transient render target. Targets with equal
+ * descriptions and lifetimes that do not overlap share one texture or renderbuffer.
+ */
+struct RenderTargetDesc {
+    GLsizei width, height;
+    GLenum  format;     // sized internal format like GL_RGBA8 or GL_DEPTH_COMPONENT24
+    GLsizei samples;    // 0 without MSAA, multisampled targets need GLES 3
+
+    RenderTargetDesc(GLsizei width = 0, GLsizei height = 0, GLenum format = 0,
+                     GLsizei samples = 0) :
+            width(width), height(height), format(format), samples(samples) {}
+    bool operator==(const RenderTargetDesc & other) const {
+        return width == other.width && height == other.height && format == other.format &&
+               samples == other.samples;
+    }
+};
+
+// what a pass does with an attachment's contents when it starts
+enum RenderLoadAction {
+    RENDER_LOAD_LOAD,       // keep what earlier passes wrote
+    RENDER_LOAD_CLEAR,      // clear to the pass's clear values
+    RENDER_LOAD_DONT_CARE   // every pixel that matters is overwritten
+};
+
+// and when it ends, transient targets are invalidated after their last use either way
+enum RenderStoreAction {
+    RENDER_STORE_STORE,
+    RENDER_STORE_DONT_CARE  // invalidate it, like the window's depth after the last pass
+};
+
+/**
+ * Framebuffer traffic per frame on a tiled GPU, avoided bytes are those of a renderer that
+ * loads every attachment at the start of a pass and stores it at the end
+ */
+struct RenderGraphStats {
+    int     passes, culledPasses;
+    int     transientTargets, physicalTargets;
+    size_t  transientBytes;     // if every transient target had memory of its own
+    size_t  physicalBytes;      // after aliasing, what is actually allocated
+    int     invalidatedAttachments; // by the last Execute
+    size_t  loadedBytes, storedBytes, avoidedBytes;
+};
+
+class MyRenderGraph;
+// called with the pass's framebuffer bound and the viewport covering its attachments
+typedef void (*RenderPassFunction)(void * data, MyRenderGraph & graph, int pass);
+
+/**
+ * Frame graph of render passes that declare which targets they read and write. The graph
+ * is declared again every frame between Reset and Compile, which is cheap since the GL
+ * objects behind it are kept from frame to frame.
+ *
+ * Compile culls the passes whose results never reach an imported target like the window,
+ * finds the first and last pass that uses each transient target, and lets targets whose
+ * lifetimes do not overlap share a texture or renderbuffer. Execute runs the passes in
+ * the order they were added and invalidates each transient target after its last use, so
+ * that tiled GPUs do not store it to memory or load it back for the next user.
+ *
+ * Transient targets are renderbuffers unless a pass reads them without MSAA, then they are
+ * textures. Read means sampled or blitted from; writing a target attaches it to the pass's
+ * framebuffer with a load and a store action. Loading a target that no earlier pass wrote
+ * this frame is the same as not caring about it. Attachments the pass does not care about
+ * are invalidated before it runs and those it clears are cleared by the graph, so on a
+ * tiled GPU neither is read from memory.
+ */
+class MyRenderGraph {
+public:
+    MyRenderGraph();
+    ~MyRenderGraph();
+    void    Reset();
+    int     CreateTarget(const char * name, const RenderTargetDesc & desc);
+    int     ImportBackbuffer(const char * name, GLenum attachment,
+                             const RenderTargetDesc & desc);
+    int     AddPass(const char * name, RenderPassFunction function, void * data);
+    void    SetClearColor(int pass, float red, float green, float blue, float alpha);
+    void    SetClearDepth(int pass, float depth);
+    void    Read(int pass, int target);
+    void    Write(int pass, int target, RenderLoadAction load = RENDER_LOAD_LOAD,
+                  RenderStoreAction store = RENDER_STORE_STORE);
+    bool    Compile();
+    void    Execute();
+    void    ForgetGLObjects();
+    bool    IsPassCulled(int pass) const { return passes[pass].culled; }
+    GLuint  GetTexture(int target) const;
+    GLuint  GetFramebuffer(int target) const;
+    const RenderGraphStats & GetStats() const { return stats; }
+    void    LogReport() const;
+
+private:
+    struct Target {
+        std::string name;
+        RenderTargetDesc desc;
+        bool    imported;       // the window's attachment, never aliased or invalidated
+        GLenum  attachment;     // of imported targets, transient ones go by their format
+        std::vector<int> writers;
+        int     readers;
+        bool    discardedWrites; // every write stores nothing, imported targets are no output
+        int     refCount;       // used while culling
+        int     firstUse, lastUse; // live pass indices, -1 if no live pass uses it
+        int     lastWriter;     // live pass whose framebuffer holds it
+        int     liveReaders;
+        bool    texture;
+        int     physical;       // index into physicalTargets
+    };
+    struct Pass {
+        std::string name;
+        RenderPassFunction function;
+        void *  data;
+        std::vector<int> reads, writes;
+        std::vector<RenderLoadAction> loads;   // per write
+        std::vector<RenderStoreAction> stores;
+        GLfloat clearColor[4], clearDepth;
+        int     refCount;
+        bool    culled;
+        GLuint  framebuffer;    // 0 for the window
+        GLsizei width, height;
+        GLbitfield clearMask;
+        std::vector<GLint> clearedColors; // draw buffers cleared one by one with MRT
+        // the pass's attachments it does not care about, then those of any framebuffer
+        // whose target is not used after this pass
+        std::vector<std::pair<GLuint, GLenum> > discards, invalidations;
+    };
+    // a texture or renderbuffer kept across frames, serial identifies it in framebuffers
+    struct PhysicalTarget {
+        RenderTargetDesc desc;
+        bool    texture;
+        GLuint  name;
+        int     serial;
+        size_t  bytes;
+        bool    used;
+    };
+    struct Framebuffer {
+        int     colorSerials[RENDER_GRAPH_MAX_COLOR_ATTACHMENTS];
+        int     depthSerial;
+        GLuint  name;
+        bool    used;
+    };
+
+    void    CullPass(int pass, std::vector<int> & unusedTargets);
+    void    CullPasses();
+    void    ComputeLifetimes();
+    void    AliasTargets(std::vector<PhysicalTarget> & slots);
+    bool    CreatePhysicalTargets(const std::vector<PhysicalTarget> & slots);
+    bool    CreateFramebuffers();
+    void    ResolveAttachmentActions();
+    void    AddAttachment(std::vector<std::pair<GLuint, GLenum> > & attachments,
+                          GLuint framebuffer, GLenum attachment) const;
+    void    Invalidate(const std::vector<std::pair<GLuint, GLenum> > & attachments);
+    void    Clear(const Pass & pass) const;
+    GLenum  GetAttachment(int pass, int target) const;
+    void    CreatePhysicalTarget(PhysicalTarget & physical);
+    void    DeletePhysicalTarget(PhysicalTarget & physical);
+
+    std::vector<Target> targets;
+    std::vector<Pass> passes;
+    std::vector<PhysicalTarget> physicalTargets; // in the order of AliasTargets' slots
+    std::vector<Framebuffer> framebuffers;
+    int     nextSerial;
+    bool    compiled;
+    RenderGraphStats stats;
+};
+
+#endif //MY_RENDER_GRAPH_H
@@ -0,0 +1,355 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include "myRenderQueue.h"
+#include "myLogger.h"
+#include "misc.h"
+#include <string.h>
+#include <math.h>
+
+MyRenderQueue::MyRenderQueue(int numRecordingThreads) {
+
+    if (numRecordingThreads < 1) {
+        numRecordingThreads = 1;
+    }
+    threadPackets.resize(numRecordingThreads);
+    memset(&stats, 0, sizeof(stats));
+    memset(&depthOnlyProgram, 0, sizeof(depthOnlyProgram));
+    memset(&overdrawProgram, 0, sizeof(overdrawProgram));
+    depthPrepass = overdrawView = false;
+    uniformBuffers = NULL;
+}
+
+/**
+ * Pack the draw state into a key so that sorting groups draws by pass, then program,
+ * then buffer, and orders them by depth within a group
+ */
+uint64_t MyRenderQueue::MakeSortKey(unsigned int pass, GLuint programID, GLuint vertexBuffer,
+                                    float normalizedDepth) {
+
+    normalizedDepth = fmaxf(0.f, fminf(1.f, normalizedDepth));
+    uint64_t depth = (uint64_t) (normalizedDepth * ((1 << SORT_KEY_DEPTH_BITS) - 1));
+
+    return ((uint64_t) (pass & 0xF) << SORT_KEY_PASS_SHIFT) |
+           ((uint64_t) (programID & 0xFFFF) << SORT_KEY_PROGRAM_SHIFT) |
+           ((uint64_t) (vertexBuffer & 0xFFFF) << SORT_KEY_BUFFER_SHIFT) |
+           (depth << SORT_KEY_DEPTH_SHIFT);
+}
+
+/**
+ * Forget packets of the previous frame, capacity is retained to avoid reallocations
+ */
+void MyRenderQueue::BeginFrame() {
+
+    for (size_t i = 0; i < threadPackets.size(); i++) {
+        threadPackets[i].packets.clear();
+    }
+}
+
+/**
+ * Append a packet to the calling thread's list. Each thread must use its own index.
+ */
+void MyRenderQueue::Record(int threadIndex, const DrawPacket & packet) {
+
+    threadPackets[threadIndex].packets.push_back(packet);
+}
+
+/**
+ * LSD radix sort on the 64-bit key, one byte per pass.
+ * Passes where every key has the same byte are skipped.
+ */
+void MyRenderQueue::RadixSort() {
+
+    size_t count = sortEntries.size();
+    sortScratch.resize(count);
+
+    // histogram all 8 bytes in a single sweep
+    uint32_t histogram[8][256];
+    memset(histogram, 0, sizeof(histogram));
+    for (size_t i = 0; i < count; i++) {
+        uint64_t key = sortEntries[i].key;
+        for (int b = 0; b < 8; b++) {
+            histogram[b][(key >> (8 * b)) & 0xFF]++;
+        }
+    }
+
+    SortEntry * src = &sortEntries[0];
+    SortEntry * dst = &sortScratch[0];
+    for (int b = 0; b < 8; b++) {
+
+        uint32_t * bucket = histogram[b];
+        if (bucket[(src[0].key >> (8 * b)) & 0xFF] == count) {
+            continue;
+        }
+
+        // convert counts to starting offsets
+        uint32_t offset = 0;
+        for (int i = 0; i < 256; i++) {
+            uint32_t n = bucket[i];
+            bucket[i] = offset;
+            offset += n;
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            dst[bucket[(src[i].key >> (8 * b)) & 0xFF]++] = src[i];
+        }
+        SortEntry * temp = src;
+        src = dst;
+        dst = temp;
+    }
+
+    if (src != &sortEntries[0]) {
+        sortEntries.swap(sortScratch);
+    }
+}
+
+/**
+ * Merge packets from all threads, sort them by key and issue them on the GL thread,
+ * with a depth prepass or as an overdraw visualization if those are enabled
+ */
+void MyRenderQueue::Submit() {
+
+    memset(&stats, 0, sizeof(stats));
+    double startTimeMs = GetMonotonicTimeMs();
+
+    sortEntries.clear();
+    for (size_t t = 0; t < threadPackets.size(); t++) {
+        const std::vector<DrawPacket> & packets = threadPackets[t].packets;
+        for (size_t i = 0; i < packets.size(); i++) {
+            SortEntry entry;
+            entry.key = packets[i].sortKey;
+            entry.threadIndex = (uint32_t) t;
+            entry.packetIndex = (uint32_t) i;
+            sortEntries.push_back(entry);
+        }
+    }
+    if (sortEntries.empty()) {
+        return;
+    }
+    RadixSort();
+    WriteDrawUniforms();
+
+    // the depth prepass lays down depth with color writes off, so that the color pass only
+    // shades the nearest fragment of each pixel
+    if (depthPrepass && depthOnlyProgram.programID) {
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        ReplayPackets(&depthOnlyProgram);
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glDepthMask(GL_FALSE);
+    }
+
+    if (overdrawView && overdrawProgram.programID) {
+        // every shaded fragment adds one step to the pixel's red channel
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE);
+        ReplayPackets(&overdrawProgram);
+        glDisable(GL_BLEND);
+    } else {
+        ReplayPackets(NULL);
+    }
+
+    if (depthPrepass && depthOnlyProgram.programID) {
+        glDepthMask(GL_TRUE);
+    }
+    stats.submitTimeMs = GetMonotonicTimeMs() - startTimeMs;
+}
+
+/**
+ * Copy the sorted packets' per-draw uniforms to the uniform buffer ring in one mapping.
+ * Consecutive packets with the same matrix share a block, so they need no rebinding.
+ */
+void MyRenderQueue::WriteDrawUniforms() {
+
+    drawUniformOffsets.clear();
+    if (!uniformBuffers || !uniformBuffers->IsSupported()) {
+        return;
+    }
+
+    // count the distinct blocks first so that a single region is mapped
+    const glm::mat4 * previousMat = NULL;
+    int blockCount = 0;
+    for (size_t i = 0; i < sortEntries.size(); i++) {
+        const DrawPacket & packet =
+                threadPackets[sortEntries[i].threadIndex].packets[sortEntries[i].packetIndex];
+        if (!previousMat || memcmp(previousMat, &packet.mvpMat, sizeof(glm::mat4)) != 0) {
+            blockCount++;
+        }
+        previousMat = &packet.mvpMat;
+    }
+
+    GLintptr offset;
+    char * data = uniformBuffers->MapDrawUniforms(blockCount, offset);
+    if (!data) {
+        return;
+    }
+    GLsizeiptr stride = uniformBuffers->GetDrawStride();
+    offset -= stride;
+    data -= stride;
+    previousMat = NULL;
+    drawUniformOffsets.resize(sortEntries.size());
+    for (size_t i = 0; i < sortEntries.size(); i++) {
+        const DrawPacket & packet =
+                threadPackets[sortEntries[i].threadIndex].packets[sortEntries[i].packetIndex];
+        if (!previousMat || memcmp(previousMat, &packet.mvpMat, sizeof(glm::mat4)) != 0) {
+            offset += stride;
+            data += stride;
+            DrawUniforms * uniforms = (DrawUniforms *) data;
+            uniforms->mvpMat = packet.mvpMat;
+        }
+        drawUniformOffsets[i] = offset;
+        previousMat = &packet.mvpMat;
+    }
+    uniformBuffers->UnmapDrawUniforms();
+}
+
+/**
+ * Issue the sorted packets, with passProgram instead of their own program if it is given.
+ * Program, buffer, attribute and uniform state is only changed when it differs from the
+ * previous draw.
+ */
+void MyRenderQueue::ReplayPackets(const PassProgram * passProgram) {
+
+    GLuint currentProgram = 0, currentVertexBuffer = 0, currentColorBuffer = 0;
+    GLintptr currentVertexOffset = 0, currentColorOffset = 0;
+    GLuint currentIndexBuffer = 0;
+    GLuint vertexAttribute = 0, colorAttribute = 0;
+    bool   vertexEnabled = false, colorEnabled = false;
+    GLintptr currentUniformOffset = -1;
+    const glm::mat4 * currentMat = NULL;   // last mvpMat set on the current program
+
+    for (size_t i = 0; i < sortEntries.size(); i++) {
+
+        const DrawPacket & packet =
+                threadPackets[sortEntries[i].threadIndex].packets[sortEntries[i].packetIndex];
+
+        // debug and depth-only passes draw every packet with their own program
+        GLuint programID = passProgram ? passProgram->programID : packet.programID;
+        GLint  mvpLocation = passProgram ? passProgram->mvpLocation : packet.mvpLocation;
+        GLuint colorBuffer = passProgram ? 0 : packet.colorBuffer;
+
+        // attribute locations belong to the program, so reset attribute state with it
+        if (programID != currentProgram) {
+            if (vertexEnabled) {
+                glDisableVertexAttribArray(vertexAttribute);
+            }
+            if (colorEnabled) {
+                glDisableVertexAttribArray(colorAttribute);
+            }
+            vertexEnabled = colorEnabled = false;
+            currentVertexBuffer = currentColorBuffer = 0;
+            currentMat = NULL;
+
+            glUseProgram(programID);
+            currentProgram = programID;
+            stats.programChanges++;
+        }
+
+        // programs reading DrawData take the matrix from the block written for this packet,
+        // the others, e.g. on GLES 2, get it as a uniform when it changes
+        if (!drawUniformOffsets.empty() && drawUniformOffsets[i] != currentUniformOffset) {
+            uniformBuffers->BindDrawUniforms(drawUniformOffsets[i]);
+            currentUniformOffset = drawUniformOffsets[i];
+            stats.uniformRangeBinds++;
+        }
+        if (mvpLocation != -1 &&
+            (!currentMat || memcmp(currentMat, &packet.mvpMat, sizeof(glm::mat4)) != 0)) {
+            glUniformMatrix4fv(mvpLocation, 1, GL_FALSE, (const GLfloat *) &packet.mvpMat);
+            currentMat = &packet.mvpMat;
+            stats.uniformCalls++;
+        }
+
+        if (!vertexEnabled) {
+            vertexAttribute = passProgram ? passProgram->vertexAttribute : packet.vertexAttribute;
+            glEnableVertexAttribArray(vertexAttribute);
+            vertexEnabled = true;
+        }
+        if (packet.vertexBuffer != currentVertexBuffer ||
+            packet.vertexOffset != currentVertexOffset) {
+            glBindBuffer(GL_ARRAY_BUFFER, packet.vertexBuffer);
+            glVertexAttribPointer(vertexAttribute, packet.vertexComponents, GL_FLOAT, GL_FALSE, 0,
+                                  (void *) packet.vertexOffset);
+            currentVertexBuffer = packet.vertexBuffer;
+            currentVertexOffset = packet.vertexOffset;
+            stats.bufferBinds++;
+        }
+
+        if (colorBuffer) {
+            if (!colorEnabled) {
+                colorAttribute = packet.colorAttribute;
+                glEnableVertexAttribArray(colorAttribute);
+                colorEnabled = true;
+            }
+            if (colorBuffer != currentColorBuffer ||
+                packet.colorOffset != currentColorOffset) {
+                glBindBuffer(GL_ARRAY_BUFFER, colorBuffer);
+                glVertexAttribPointer(colorAttribute, packet.colorComponents, GL_FLOAT, GL_FALSE,
+                                      0, (void *) packet.colorOffset);
+                currentColorBuffer = colorBuffer;
+                currentColorOffset = packet.colorOffset;
+                stats.bufferBinds++;
+            }
+        } else if (colorEnabled) {
+            glDisableVertexAttribArray(colorAttribute);
+            colorEnabled = false;
+            currentColorBuffer = 0;
+        }
+
+        if (packet.indexBuffer) {
+            if (packet.indexBuffer != currentIndexBuffer) {
+                glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, packet.indexBuffer);
+                currentIndexBuffer = packet.indexBuffer;
+                stats.bufferBinds++;
+            }
+            size_t indexSize = packet.indexType == GL_UNSIGNED_INT ? 4 : 2;
+            glDrawElements(packet.primitiveMode, packet.elementCount, packet.indexType,
+                           (void *) (packet.firstElement * indexSize));
+        } else {
+            glDrawArrays(packet.primitiveMode, packet.firstElement, packet.elementCount);
+        }
+        stats.drawCount++;
+    }
+
+    if (vertexEnabled) {
+        glDisableVertexAttribArray(vertexAttribute);
+    }
+    if (colorEnabled) {
+        glDisableVertexAttribArray(colorAttribute);
+    }
+}
+
+/**
+ * Read back the overdraw view and count the fragments shaded per covered pixel.
+ * Stalls the pipeline, so call it only now and then.
+ */
+void MyRenderQueue::MeasureOverdraw(int width, int height) {
+
+    if (!overdrawView || width <= 0 || height <= 0) {
+        return;
+    }
+
+    overdrawPixels.resize(width * height * 4);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, &overdrawPixels[0]);
+
+    long fragments = 0, coveredPixels = 0;
+    for (size_t i = 0; i < overdrawPixels.size(); i += 4) {
+        int layers = (overdrawPixels[i] + OVERDRAW_STEP / 2) / OVERDRAW_STEP;
+        if (layers) {
+            fragments += layers;
+            coveredPixels++;
+        }
+    }
+    stats.averageOverdraw = coveredPixels ? (float) fragments / coveredPixels : 0;
+}
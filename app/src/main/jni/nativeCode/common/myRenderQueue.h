@@ -0,0 +1,131 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#ifndef MY_RENDER_QUEUE_H
+#define MY_RENDER_QUEUE_H
+
+#include "myGLFunctions.h"
+#include "myGLM.h"
+#include "myUniformBuffers.h"
+#include <stdint.h>
+#include <vector>
+
+// bit layout of the 64-bit sort key, most significant field is sorted first
+// [63..60] pass | [59..44] program | [43..28] vertex buffer | [27..4] depth | [3..0] unused
+#define SORT_KEY_PASS_SHIFT     60
+#define SORT_KEY_PROGRAM_SHIFT  44
+#define SORT_KEY_BUFFER_SHIFT   28
+#define SORT_KEY_DEPTH_SHIFT    4
+#define SORT_KEY_DEPTH_BITS     24
+
+// overdraw.fsh adds this much to the red channel per fragment, so up to 31 layers are counted
+#define OVERDRAW_STEP           8
+
+/**
+ * Everything needed to issue one draw call, recorded by any thread and replayed on GL thread
+ */
+struct DrawPacket {
+    uint64_t    sortKey;
+    GLuint      programID;
+    GLuint      vertexBuffer, colorBuffer;     // colorBuffer may be 0 if unused
+    GLintptr    vertexOffset, colorOffset;     // byte offsets of the data, e.g. in a stream buffer
+    GLuint      indexBuffer;                   // 0 draws non-indexed with glDrawArrays
+    GLenum      indexType;                     // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+    GLuint      vertexAttribute, colorAttribute;
+    GLint       vertexComponents, colorComponents;
+    GLint       mvpLocation;                   // -1 if the program reads mvpMat from DrawData
+    glm::mat4   mvpMat;
+    GLenum      primitiveMode;
+    GLint       firstElement;                  // first vertex, or first index if indexed
+    GLsizei     elementCount;
+};
+
+/**
+ * Counters describing the last replayed frame
+ */
+struct RenderQueueStats {
+    int     drawCount;
+    int     programChanges;
+    int     bufferBinds;
+    int     uniformCalls;       // glUniform* calls for the packets' own uniforms
+    int     uniformRangeBinds;  // glBindBufferRange calls selecting a draw's uniform block
+    double  submitTimeMs;       // CPU time spent in Submit
+    float   averageOverdraw;    // fragments per covered pixel, set by MeasureOverdraw
+};
+
+/**
+ * Program used instead of the packets' own in a depth-only or debug pass.
+ * It only reads the vertex positions.
+ */
+struct PassProgram {
+    GLuint      programID;
+    GLuint      vertexAttribute;
+    GLint       mvpLocation;
+};
+
+class MyRenderQueue {
+public:
+    MyRenderQueue(int numRecordingThreads = 1);
+    void    BeginFrame();
+    void    Record(int threadIndex, const DrawPacket & packet);
+    void    Submit();
+    void    SetDepthOnlyProgram(const PassProgram & program) { depthOnlyProgram = program; }
+    void    SetOverdrawProgram(const PassProgram & program) { overdrawProgram = program; }
+    void    SetDepthPrepass(bool enabled) { depthPrepass = enabled; }
+    void    SetOverdrawView(bool enabled) { overdrawView = enabled; }
+    void    SetUniformBuffers(MyUniformBuffers * buffers) { uniformBuffers = buffers; }
+    bool    IsDepthPrepassEnabled() const { return depthPrepass; }
+    bool    IsOverdrawViewEnabled() const { return overdrawView; }
+    void    MeasureOverdraw(int width, int height);
+    int     GetNumRecordingThreads() const { return (int) threadPackets.size(); }
+    const RenderQueueStats & GetStats() const { return stats; }
+
+    static uint64_t MakeSortKey(unsigned int pass, GLuint programID, GLuint vertexBuffer,
+                                float normalizedDepth);
+
+private:
+    struct SortEntry {
+        uint64_t    key;
+        uint32_t    threadIndex;
+        uint32_t    packetIndex;
+    };
+
+    // padded so that threads appending to neighbouring lists do not share a cache line
+    struct PacketList {
+        std::vector<DrawPacket> packets;
+        char    padding[64];
+    };
+
+    void    RadixSort();
+    void    WriteDrawUniforms();
+    void    ReplayPackets(const PassProgram * passProgram);
+
+    // one packet list per recording thread so that recording never takes a lock
+    std::vector<PacketList> threadPackets;
+    std::vector<SortEntry>  sortEntries, sortScratch;
+    RenderQueueStats        stats;
+
+    // with uniform buffers each sorted packet's DrawData block is written once per frame,
+    // here is where, and every pass binds it from there
+    MyUniformBuffers *      uniformBuffers;
+    std::vector<GLintptr>   drawUniformOffsets;
+
+    PassProgram depthOnlyProgram, overdrawProgram;
+    bool        depthPrepass, overdrawView;
+    std::vector<unsigned char> overdrawPixels;
+};
+
+#endif //MY_RENDER_QUEUE_H
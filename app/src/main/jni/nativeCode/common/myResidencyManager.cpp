@@ -0,0 +1,287 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+
+#include "myResidencyManager.h"
+#include <algorithm>
+#include <float.h>
+#include <string.h>
+
+MyResidencyManager::MyResidencyManager(size_t budgetBytes) {
+
+    frame = 0;
+    memset(&stats, 0, sizeof(stats));
+    stats.budgetBytes = budgetBytes;
+}
+
+/**
+ * Takes effect at the next Update, which evicts what no longer fits
+ */
+void MyResidencyManager::SetBudget(size_t budgetBytes) {
+
+    stats.budgetBytes = budgetBytes;
+}
+
+/**
+ * Register a resource with the GPU bytes of each of its levels, finest first, of which
+ * the owner already holds residentLevel and coarser. These count against the budget even
+ * if they exceed it. Returns the resource's ID, or RESIDENCY_NO_RESOURCE if it has no levels.
+ */
+int MyResidencyManager::AddResource(const std::vector<size_t> & levelBytes, int residentLevel,
+                                    ResidencyFunction setLevel, void * owner, int ownerIndex) {
+
+    if (levelBytes.empty()) {
+        return RESIDENCY_NO_RESOURCE;
+    }
+    int coarsestLevel = (int) levelBytes.size() - 1;
+    Resource resource;
+    resource.levelBytes = levelBytes;
+    resource.residentLevel = std::max(0, std::min(residentLevel, coarsestLevel));
+    resource.ownerLevel = resource.residentLevel;
+    resource.requestedLevel = coarsestLevel;
+    resource.priority = 0;
+    resource.lastUsedFrame = -1;
+    resource.setLevel = setLevel;
+    resource.owner = owner;
+    resource.ownerIndex = ownerIndex;
+    resources.push_back(resource);
+
+    for (int level = resource.residentLevel; level <= coarsestLevel; level++) {
+        stats.residentBytes += levelBytes[level];
+    }
+    stats.peakBytes = std::max(stats.peakBytes, stats.residentBytes);
+    stats.resources = (int) resources.size();
+    return (int) resources.size() - 1;
+}
+
+/**
+ * The resource is drawn this frame and needs level, or a coarser one if it does not fit.
+ * Several requests in a frame keep the finest level and the highest priority.
+ */
+void MyResidencyManager::Request(int resourceID, int level, float priority) {
+
+    if (resourceID < 0 || resourceID >= (int) resources.size()) {
+        return;
+    }
+    Resource & resource = resources[resourceID];
+    level = std::max(0, std::min(level, (int) resource.levelBytes.size() - 1));
+    if (level < resource.residentLevel) {
+        stats.misses++;
+    } else {
+        stats.hits++;
+    }
+    if (resource.lastUsedFrame != frame) {
+        resource.lastUsedFrame = frame;
+        resource.requestedLevel = level;
+        resource.priority = priority;
+    } else {
+        resource.requestedLevel = std::min(resource.requestedLevel, level);
+        resource.priority = std::max(resource.priority, priority);
+    }
+}
+
+bool MyResidencyManager::ComparePriority(const MissingResource & a, const MissingResource & b) {
+
+    return a.priority > b.priority;
+}
+
+/**
+ * Finest level that requests of this frame still need, the coarsest is always kept
+ */
+int MyResidencyManager::GetNeededLevel(const Resource & resource) const {
+
+    if (resource.lastUsedFrame == frame) {
+        return resource.requestedLevel;
+    }
+    return (int) resource.levelBytes.size() - 1;
+}
+
+/**
+ * Bytes that EvictLevel would free for a level of the given priority before running out
+ */
+size_t MyResidencyManager::GetEvictableBytes(float priority) const {
+
+    size_t bytes = 0;
+    for (size_t i = 0; i < resources.size(); i++) {
+        const Resource & resource = resources[i];
+        int keptLevel = (int) resource.levelBytes.size() - 1;
+        if (resource.priority >= priority) {
+            keptLevel = std::max(resource.residentLevel, GetNeededLevel(resource));
+        }
+        for (int level = resource.residentLevel; level < keptLevel; level++) {
+            bytes += resource.levelBytes[level];
+        }
+    }
+    return bytes;
+}
+
+/**
+ * Drop the finest level of the least recently used resource, the one with the lowest
+ * priority if several were last used in the same frame. Levels that requests of this frame
+ * need go last, and only from resources with a priority below the given one. Returns false
+ * if there is nothing left to evict.
+ */
+bool MyResidencyManager::EvictLevel(float priority) {
+
+    int victim = -1;
+    bool victimNeeded = false;
+    for (int i = 0; i < (int) resources.size(); i++) {
+        const Resource & resource = resources[i];
+        if (resource.residentLevel == (int) resource.levelBytes.size() - 1) {
+            continue;
+        }
+        bool needed = resource.residentLevel >= GetNeededLevel(resource);
+        if (needed && resource.priority >= priority) {
+            continue;
+        }
+        if (victim < 0 || (victimNeeded && !needed) ||
+            (needed == victimNeeded &&
+             (resource.lastUsedFrame < resources[victim].lastUsedFrame ||
+              (resource.lastUsedFrame == resources[victim].lastUsedFrame &&
+               resource.priority < resources[victim].priority)))) {
+            victim = i;
+            victimNeeded = needed;
+        }
+    }
+    if (victim < 0) {
+        return false;
+    }
+    Resource & resource = resources[victim];
+    size_t bytes = resource.levelBytes[resource.residentLevel];
+    resource.residentLevel++;
+    stats.residentBytes -= bytes;
+    stats.evictedBytes += bytes;
+    stats.evictions++;
+    return true;
+}
+
+/**
+ * Tell the owners what changed, evictions first so that memory is freed before more is
+ * used. Returns true if anything changed.
+ */
+bool MyResidencyManager::NotifyOwners() {
+
+    bool changed = false;
+    for (int pass = 0; pass < 2; pass++) {
+        for (size_t i = 0; i < resources.size(); i++) {
+            Resource & resource = resources[i];
+            bool evicted = resource.residentLevel > resource.ownerLevel;
+            bool loaded = resource.residentLevel < resource.ownerLevel;
+            if ((pass == 0 && evicted) || (pass == 1 && loaded)) {
+                // set first, the owner may correct both with SetResidentLevel
+                resource.ownerLevel = resource.residentLevel;
+                resource.setLevel(resource.owner, resource.ownerIndex, resource.residentLevel);
+                changed = true;
+            }
+        }
+    }
+    return changed;
+}
+
+/**
+ * Stream in the levels requested since the last Update, highest priority first, evicting
+ * what is not needed to make room. A request that cannot fit gets the finest level that
+ * does. Call once a frame before drawing, returns true if levels were loaded or dropped.
+ */
+bool MyResidencyManager::Update() {
+
+    // the budget may have been lowered, then even needed levels go
+    while (stats.residentBytes > stats.budgetBytes && EvictLevel(FLT_MAX)) {
+    }
+
+    missingResources.clear();
+    for (int i = 0; i < (int) resources.size(); i++) {
+        const Resource & resource = resources[i];
+        if (resource.lastUsedFrame == frame && resource.requestedLevel < resource.residentLevel) {
+            MissingResource missing;
+            missing.resourceID = i;
+            missing.priority = resource.priority;
+            missingResources.push_back(missing);
+        }
+    }
+    std::sort(missingResources.begin(), missingResources.end(), ComparePriority);
+
+    for (size_t i = 0; i < missingResources.size(); i++) {
+        Resource & resource = resources[missingResources[i].resourceID];
+        while (resource.residentLevel > resource.requestedLevel) {
+            size_t bytes = resource.levelBytes[resource.residentLevel - 1];
+            // evict nothing for a level that would not fit anyway
+            if (stats.residentBytes + bytes > stats.budgetBytes &&
+                stats.residentBytes + bytes > stats.budgetBytes +
+                                              GetEvictableBytes(resource.priority)) {
+                break;
+            }
+            while (stats.residentBytes + bytes > stats.budgetBytes &&
+                   EvictLevel(resource.priority)) {
+            }
+            resource.residentLevel--;
+            stats.residentBytes += bytes;
+            stats.uploadedBytes += bytes;
+        }
+    }
+    stats.peakBytes = std::max(stats.peakBytes, stats.residentBytes);
+
+    bool changed = NotifyOwners();
+    frame++;
+    return changed;
+}
+
+/**
+ * The owner holds a different level than it was told, such as when it ran out of memory
+ * streaming one in. The bytes and counters are corrected to that level, and a level that
+ * is still requested is tried again at the next Update.
+ */
+void MyResidencyManager::SetResidentLevel(int resourceID, int level) {
+
+    if (resourceID < 0 || resourceID >= (int) resources.size()) {
+        return;
+    }
+    Resource & resource = resources[resourceID];
+    level = std::max(0, std::min(level, (int) resource.levelBytes.size() - 1));
+    // levels that were counted as streamed in but are not there
+    for (; resource.residentLevel < level; resource.residentLevel++) {
+        size_t bytes = resource.levelBytes[resource.residentLevel];
+        stats.residentBytes -= bytes;
+        stats.uploadedBytes -= std::min(stats.uploadedBytes, bytes);
+    }
+    // levels that were counted as evicted but are still held
+    for (; resource.residentLevel > level; resource.residentLevel--) {
+        size_t bytes = resource.levelBytes[resource.residentLevel - 1];
+        stats.residentBytes += bytes;
+        stats.evictedBytes -= std::min(stats.evictedBytes, bytes);
+        stats.evictions -= stats.evictions > 0 ? 1 : 0;
+    }
+    resource.ownerLevel = level;
+    stats.peakBytes = std::max(stats.peakBytes, stats.residentBytes);
+}
+
+/**
+ * Finest level the owner was told to keep, it may still be streaming in
+ */
+int MyResidencyManager::GetResidentLevel(int resourceID) const {
+
+    return resources[resourceID].residentLevel;
+}
+
+/**
+ * Clear the counters, the resident bytes and the budget stay
+ */
+void MyResidencyManager::ResetStats() {
+
+    stats.hits = stats.misses = stats.evictions = 0;
+    stats.evictedBytes = stats.uploadedBytes = 0;
+    stats.peakBytes = stats.residentBytes;
+}
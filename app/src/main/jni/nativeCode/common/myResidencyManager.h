@@ -0,0 +1,101 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+
+#ifndef MY_RESIDENCY_MANAGER_H
+#define MY_RESIDENCY_MANAGER_H
+
+#include <stddef.h>
+#include <vector>
+
+#define RESIDENCY_NO_RESOURCE   -1
+
+// called with the finest level the owner should keep on the GPU, levels finer than it are
+// dropped and coarser ones are loaded if they are missing
+typedef void (*ResidencyFunction)(void * owner, int ownerIndex, int level);
+
+struct ResidencyStats {
+    int     resources;
+    size_t  budgetBytes;
+    size_t  residentBytes;      // of the levels the owners were told to keep
+    size_t  peakBytes;
+    // requests for a level that was resident vs one that had to be streamed in
+    long    hits, misses;
+    long    evictions;          // levels dropped to stay within the budget
+    size_t  evictedBytes;
+    size_t  uploadedBytes;      // levels streamed in, not counting what resources start with
+};
+
+/**
+ * Keeps the GPU memory of textures and meshes within a budget. A resource is a chain of
+ * levels, 0 being the finest and largest, such as a texture's mip levels or a mesh's LODs.
+ * Its coarsest level is always resident so that there is something to draw, finer ones
+ * come and go from the finest end.
+ *
+ * Whoever draws a resource requests the level it needs every frame, with a priority such
+ * as its screen coverage. Update then streams in the missing levels, highest priority
+ * first. When they do not fit, levels are evicted from the resources that were used least
+ * recently, or with the lowest priority among those used as recently. Levels that a request
+ * of this frame needs are only evicted for one with a higher priority. The owners do the
+ * actual loading and freeing, through the function they registered, and report back with
+ * SetResidentLevel when they could not.
+ *
+ * There is no GL in here, only bookkeeping, so the policy can be tested on a host.
+ */
+class MyResidencyManager {
+public:
+    MyResidencyManager(size_t budgetBytes);
+    void    SetBudget(size_t budgetBytes);
+    int     AddResource(const std::vector<size_t> & levelBytes, int residentLevel,
+                        ResidencyFunction setLevel, void * owner, int ownerIndex);
+    void    Request(int resourceID, int level, float priority);
+    bool    Update();
+    void    SetResidentLevel(int resourceID, int level);
+    int     GetResidentLevel(int resourceID) const;
+    const ResidencyStats & GetStats() const { return stats; }
+    void    ResetStats();
+
+private:
+    struct Resource {
+        std::vector<size_t> levelBytes;
+        int     residentLevel;      // finest level kept
+        int     ownerLevel;         // what the owner was last told
+        int     requestedLevel;     // finest requested in lastUsedFrame
+        float   priority;           // highest requested in lastUsedFrame
+        long    lastUsedFrame;
+        ResidencyFunction setLevel;
+        void *  owner;
+        int     ownerIndex;
+    };
+
+    struct MissingResource {
+        int     resourceID;
+        float   priority;
+    };
+
+    static bool ComparePriority(const MissingResource & a, const MissingResource & b);
+    int     GetNeededLevel(const Resource & resource) const;
+    size_t  GetEvictableBytes(float priority) const;
+    bool    EvictLevel(float priority);
+    bool    NotifyOwners();
+
+    std::vector<Resource> resources;
+    std::vector<MissingResource> missingResources; // scratch for Update
+    long    frame;
+    ResidencyStats stats;
+};
+
+#endif //MY_RESIDENCY_MANAGER_H
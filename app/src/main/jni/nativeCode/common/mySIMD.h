@@ -0,0 +1,96 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#ifndef MY_SIMD_H
+#define MY_SIMD_H
+
+#include <stdint.h>
+#include <math.h>
+
+// 4-wide float operations: NEON on ARM, SSE2 on x86, plain C elsewhere
+#if defined(__ARM_NEON__) || defined(__aarch64__)
+#include <arm_neon.h>
+typedef float32x4_t Float4;
+typedef uint32x4_t  Mask4;
+static inline Float4 Load4(const float * p)           { return vld1q_f32(p); }
+static inline Float4 Splat4(float v)                  { return vdupq_n_f32(v); }
+static inline Float4 Add4(Float4 a, Float4 b)         { return vaddq_f32(a, b); }
+static inline Float4 Sub4(Float4 a, Float4 b)         { return vsubq_f32(a, b); }
+static inline Float4 Mul4(Float4 a, Float4 b)         { return vmulq_f32(a, b); }
+static inline Mask4  Less4(Float4 a, Float4 b)        { return vcltq_f32(a, b); }
+static inline Mask4  GreaterEqual4(Float4 a, Float4 b){ return vcgeq_f32(a, b); }
+static inline Mask4  Or4(Mask4 a, Mask4 b)            { return vorrq_u32(a, b); }
+static inline Mask4  And4(Mask4 a, Mask4 b)           { return vandq_u32(a, b); }
+static inline Mask4  SplatMask4(bool v)               { return vdupq_n_u32(v ? 0xFFFFFFFF : 0); }
+static inline void   StoreMask4(uint32_t * p, Mask4 m){ vst1q_u32(p, m); }
+static inline Float4 Sqrt4(Float4 a) {
+    // ARMv7 has no vector sqrt: refine the reciprocal estimate once, sqrt(a) = a / sqrt(a)
+    Float4 estimate = vrsqrteq_f32(vmaxq_f32(a, vdupq_n_f32(1e-20f)));
+    estimate = vmulq_f32(estimate, vrsqrtsq_f32(vmulq_f32(a, estimate), estimate));
+    return vmulq_f32(a, estimate);
+}
+static inline Float4 Min4(Float4 a, Float4 b)         { return vminq_f32(a, b); }
+static inline Float4 Max4(Float4 a, Float4 b)         { return vmaxq_f32(a, b); }
+static inline Float4 Select4(Mask4 m, Float4 a, Float4 b) { return vbslq_f32(m, a, b); }
+static inline void   Store4(float * p, Float4 a)      { vst1q_f32(p, a); }
+static inline bool   AnyTrue4(Mask4 m) {
+    uint32x2_t halves = vorr_u32(vget_low_u32(m), vget_high_u32(m));
+    return (vget_lane_u32(halves, 0) | vget_lane_u32(halves, 1)) != 0;
+}
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+typedef __m128 Float4;
+typedef __m128 Mask4;
+static inline Float4 Load4(const float * p)           { return _mm_loadu_ps(p); }
+static inline Float4 Splat4(float v)                  { return _mm_set1_ps(v); }
+static inline Float4 Add4(Float4 a, Float4 b)         { return _mm_add_ps(a, b); }
+static inline Float4 Sub4(Float4 a, Float4 b)         { return _mm_sub_ps(a, b); }
+static inline Float4 Mul4(Float4 a, Float4 b)         { return _mm_mul_ps(a, b); }
+static inline Mask4  Less4(Float4 a, Float4 b)        { return _mm_cmplt_ps(a, b); }
+static inline Mask4  GreaterEqual4(Float4 a, Float4 b){ return _mm_cmpge_ps(a, b); }
+static inline Mask4  Or4(Mask4 a, Mask4 b)            { return _mm_or_ps(a, b); }
+static inline Mask4  And4(Mask4 a, Mask4 b)           { return _mm_and_ps(a, b); }
+static inline Mask4  SplatMask4(bool v)               { return _mm_castsi128_ps(_mm_set1_epi32(v ? -1 : 0)); }
+static inline void   StoreMask4(uint32_t * p, Mask4 m){ _mm_storeu_si128((__m128i *) p, _mm_castps_si128(m)); }
+static inline Float4 Sqrt4(Float4 a)                  { return _mm_sqrt_ps(a); }
+static inline Float4 Min4(Float4 a, Float4 b)         { return _mm_min_ps(a, b); }
+static inline Float4 Max4(Float4 a, Float4 b)         { return _mm_max_ps(a, b); }
+static inline Float4 Select4(Mask4 m, Float4 a, Float4 b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+static inline void   Store4(float * p, Float4 a)      { _mm_storeu_ps(p, a); }
+static inline bool   AnyTrue4(Mask4 m)                { return _mm_movemask_ps(m) != 0; }
+#else
+struct Float4 { float v[4]; };
+struct Mask4  { uint32_t v[4]; };
+static inline Float4 Load4(const float * p)           { Float4 r; for (int i = 0; i < 4; i++) r.v[i] = p[i]; return r; }
+static inline Float4 Splat4(float x)                  { Float4 r; for (int i = 0; i < 4; i++) r.v[i] = x; return r; }
+static inline Float4 Add4(Float4 a, Float4 b)         { for (int i = 0; i < 4; i++) a.v[i] += b.v[i]; return a; }
+static inline Float4 Sub4(Float4 a, Float4 b)         { for (int i = 0; i < 4; i++) a.v[i] -= b.v[i]; return a; }
+static inline Float4 Mul4(Float4 a, Float4 b)         { for (int i = 0; i < 4; i++) a.v[i] *= b.v[i]; return a; }
+static inline Mask4  Less4(Float4 a, Float4 b)        { Mask4 r; for (int i = 0; i < 4; i++) r.v[i] = a.v[i] < b.v[i] ? 0xFFFFFFFF : 0; return r; }
+static inline Mask4  GreaterEqual4(Float4 a, Float4 b){ Mask4 r; for (int i = 0; i < 4; i++) r.v[i] = a.v[i] >= b.v[i] ? 0xFFFFFFFF : 0; return r; }
+static inline Mask4  Or4(Mask4 a, Mask4 b)            { for (int i = 0; i < 4; i++) a.v[i] |= b.v[i]; return a; }
+static inline Mask4  And4(Mask4 a, Mask4 b)           { for (int i = 0; i < 4; i++) a.v[i] &= b.v[i]; return a; }
+static inline Mask4  SplatMask4(bool x)               { Mask4 r; for (int i = 0; i < 4; i++) r.v[i] = x ? 0xFFFFFFFF : 0; return r; }
+static inline void   StoreMask4(uint32_t * p, Mask4 m){ for (int i = 0; i < 4; i++) p[i] = m.v[i]; }
+static inline Float4 Sqrt4(Float4 a)                  { for (int i = 0; i < 4; i++) a.v[i] = sqrtf(a.v[i]); return a; }
+static inline Float4 Min4(Float4 a, Float4 b)         { for (int i = 0; i < 4; i++) a.v[i] = fminf(a.v[i], b.v[i]); return a; }
+static inline Float4 Max4(Float4 a, Float4 b)         { for (int i = 0; i < 4; i++) a.v[i] = fmaxf(a.v[i], b.v[i]); return a; }
+static inline Float4 Select4(Mask4 m, Float4 a, Float4 b) { for (int i = 0; i < 4; i++) a.v[i] = m.v[i] ? a.v[i] : b.v[i]; return a; }
+static inline void   Store4(float * p, Float4 a)      { for (int i = 0; i < 4; i++) p[i] = a.v[i]; }
+static inline bool   AnyTrue4(Mask4 m)                { return (m.v[0] | m.v[1] | m.v[2] | m.v[3]) != 0; }
+#endif
+
+#endif //MY_SIMD_H
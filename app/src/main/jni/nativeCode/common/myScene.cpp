@@ -0,0 +1,288 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+
+#include "myScene.h"
+#include <math.h>
+#include <string.h>
+
+static_assert(sizeof(MyTransform) == 32 && sizeof(SceneNode) == 64,
+              "scene nodes are mapped from files and must keep their layout");
+
+// true if count items of itemSize at offset lie within size bytes
+static bool IsInRange(uint64_t offset, uint64_t count, uint64_t itemSize, uint64_t size) {
+
+    return offset <= size && count * itemSize <= size - offset;
+}
+
+static bool IsFinite(const float * values, int count) {
+
+    for (int i = 0; i < count; i++) {
+        if (!isfinite(values[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+MyScene::MyScene() {
+
+    header = NULL;
+    nodes = NULL;
+    meshes = NULL;
+    materials = NULL;
+    strings = NULL;
+}
+
+/**
+ * Use the scene of size bytes at data, which has to stay there while the scene is in use.
+ * Returns false with the reason in error if it is not a valid scene of this version.
+ */
+bool MyScene::Open(const uint8_t * data, size_t size, std::string & error) {
+
+    header = NULL;
+    if (((uintptr_t) data & 3) != 0) {
+        error = "scene is not 4-byte aligned";
+        return false;
+    }
+    if (size < sizeof(SceneHeader)) {
+        error = "scene is too small";
+        return false;
+    }
+    const SceneHeader * newHeader = (const SceneHeader *) data;
+    if (memcmp(newHeader->magic, SCENE_MAGIC, SCENE_MAGIC_SIZE) != 0) {
+        error = "not a scene";
+        return false;
+    }
+    if (newHeader->version != SCENE_VERSION) {
+        error = "unsupported scene version";
+        return false;
+    }
+    if (newHeader->fileSize != size) {
+        error = "truncated scene";
+        return false;
+    }
+    if ((newHeader->nodeOffset & 3) != 0 || (newHeader->meshOffset & 3) != 0 ||
+        (newHeader->materialOffset & 3) != 0 ||
+        !IsInRange(newHeader->nodeOffset, newHeader->nodeCount, sizeof(SceneNode), size) ||
+        !IsInRange(newHeader->meshOffset, newHeader->meshCount, sizeof(SceneMesh), size) ||
+        !IsInRange(newHeader->materialOffset, newHeader->materialCount,
+                   sizeof(SceneMaterial), size) ||
+        !IsInRange(newHeader->stringOffset, newHeader->stringSize, 1, size) ||
+        newHeader->stringSize == 0 || data[newHeader->stringOffset + newHeader->stringSize - 1]) {
+        error = "scene sections are out of range";
+        return false;
+    }
+
+    header = newHeader;
+    nodes = (const SceneNode *) (data + header->nodeOffset);
+    meshes = (const SceneMesh *) (data + header->meshOffset);
+    materials = (const SceneMaterial *) (data + header->materialOffset);
+    strings = (const char *) (data + header->stringOffset);
+
+    // the last string ends the table, so any offset within it reads a terminated string
+    for (uint32_t mesh = 0; mesh < header->meshCount; mesh++) {
+        if (meshes[mesh].name >= header->stringSize) {
+            error = "invalid scene mesh";
+            header = NULL;
+            return false;
+        }
+    }
+    for (uint32_t material = 0; material < header->materialCount; material++) {
+        const SceneMaterial & m = materials[material];
+        if (m.name >= header->stringSize || m.texture >= header->stringSize ||
+            !IsFinite(m.color, 4)) {
+            error = "invalid scene material";
+            header = NULL;
+            return false;
+        }
+    }
+    for (uint32_t node = 0; node < header->nodeCount; node++) {
+        if (!CheckNode(node)) {
+            error = "invalid scene node";
+            header = NULL;
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Parents and earlier siblings come first and point to their children and next siblings,
+ * so links only lead forward and the hierarchy cannot loop
+ */
+bool MyScene::CheckNode(int node) const {
+
+    const SceneNode & n = nodes[node];
+    int count = (int) header->nodeCount;
+    if (n.parent != SCENE_NONE && (n.parent < 0 || n.parent >= node)) {
+        return false;
+    }
+    if (n.firstChild != SCENE_NONE &&
+        (n.firstChild <= node || n.firstChild >= count || nodes[n.firstChild].parent != node)) {
+        return false;
+    }
+    if (n.nextSibling != SCENE_NONE &&
+        (n.nextSibling <= node || n.nextSibling >= count ||
+         nodes[n.nextSibling].parent != n.parent)) {
+        return false;
+    }
+    if ((n.mesh != SCENE_NONE && (n.mesh < 0 || n.mesh >= (int) header->meshCount)) ||
+        (n.material != SCENE_NONE &&
+         (n.material < 0 || n.material >= (int) header->materialCount))) {
+        return false;
+    }
+    const MyTransform & t = n.transform;
+    float values[] = {t.rotation.x, t.rotation.y, t.rotation.z, t.rotation.w,
+                      t.translation.x, t.translation.y, t.translation.z, t.scale};
+    return n.name < header->stringSize && IsFinite(values, 8) && t.scale > 0;
+}
+
+/**
+ * Index of the first node with this name, or SCENE_NONE
+ */
+int MyScene::FindNode(const char * name) const {
+
+    for (int node = 0; node < GetNodeCount(); node++) {
+        if (strcmp(strings + nodes[node].name, name) == 0) {
+            return node;
+        }
+    }
+    return SCENE_NONE;
+}
+
+/**
+ * Transforms of all nodes relative to the scene, parents come first so one pass suffices
+ */
+void MyScene::ComputeWorldTransforms(std::vector<MyTransform> & world) const {
+
+    world.resize(GetNodeCount());
+    for (int node = 0; node < GetNodeCount(); node++) {
+        const SceneNode & n = nodes[node];
+        if (n.parent == SCENE_NONE) {
+            world[node] = n.transform;
+        } else {
+            world[node] = ComposeTransforms(world[n.parent], n.transform);
+        }
+    }
+}
+
+MySceneBuilder::MySceneBuilder() {
+
+    // offset 0 is the empty string
+    strings.push_back(0);
+    stringOffsets[""] = 0;
+}
+
+uint32_t MySceneBuilder::AddString(const std::string & value) {
+
+    std::map<std::string, uint32_t>::iterator it = stringOffsets.find(value);
+    if (it != stringOffsets.end()) {
+        return it->second;
+    }
+    uint32_t offset = (uint32_t) strings.size();
+    strings.insert(strings.end(), value.begin(), value.end());
+    strings.push_back(0);
+    stringOffsets[value] = offset;
+    return offset;
+}
+
+int MySceneBuilder::AddMesh(const std::string & name) {
+
+    SceneMesh mesh;
+    memset(&mesh, 0, sizeof(mesh));
+    mesh.name = AddString(name);
+    meshes.push_back(mesh);
+    return (int) meshes.size() - 1;
+}
+
+int MySceneBuilder::AddMaterial(const std::string & name, const std::string & texture,
+                                const float color[4]) {
+
+    SceneMaterial material;
+    material.name = AddString(name);
+    material.texture = AddString(texture);
+    memcpy(material.color, color, sizeof(material.color));
+    materials.push_back(material);
+    return (int) materials.size() - 1;
+}
+
+/**
+ * Add a node under parent, or at the top if it is SCENE_NONE. Returns its index, or
+ * SCENE_NONE if the parent, mesh or material was not added yet.
+ */
+int MySceneBuilder::AddNode(const std::string & name, int parent, const MyTransform & transform,
+                            int mesh, int material) {
+
+    int node = (int) nodes.size();
+    if (parent < SCENE_NONE || parent >= node || mesh < SCENE_NONE ||
+        mesh >= (int) meshes.size() || material < SCENE_NONE ||
+        material >= (int) materials.size()) {
+        return SCENE_NONE;
+    }
+    SceneNode sceneNode;
+    sceneNode.transform = transform;
+    sceneNode.parent = parent;
+    sceneNode.firstChild = sceneNode.nextSibling = SCENE_NONE;
+    sceneNode.mesh = mesh;
+    sceneNode.material = material;
+    sceneNode.name = AddString(name);
+    sceneNode.reserved[0] = sceneNode.reserved[1] = 0;
+    nodes.push_back(sceneNode);
+    lastChild.push_back(SCENE_NONE);
+
+    // top-level nodes are not linked, they are found by their parent being SCENE_NONE
+    if (parent != SCENE_NONE) {
+        if (lastChild[parent] == SCENE_NONE) {
+            nodes[parent].firstChild = node;
+        } else {
+            nodes[lastChild[parent]].nextSibling = node;
+        }
+        lastChild[parent] = node;
+    }
+    return node;
+}
+
+void MySceneBuilder::Write(std::vector<uint8_t> & file) const {
+
+    SceneHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SCENE_MAGIC, SCENE_MAGIC_SIZE);
+    header.version = SCENE_VERSION;
+    header.nodeCount = (uint32_t) nodes.size();
+    header.nodeOffset = sizeof(header);
+    header.meshCount = (uint32_t) meshes.size();
+    header.meshOffset = header.nodeOffset + header.nodeCount * sizeof(SceneNode);
+    header.materialCount = (uint32_t) materials.size();
+    header.materialOffset = header.meshOffset + header.meshCount * sizeof(SceneMesh);
+    header.stringOffset = header.materialOffset + header.materialCount * sizeof(SceneMaterial);
+    header.stringSize = (uint32_t) strings.size();
+    header.fileSize = header.stringOffset + header.stringSize;
+
+    file.assign(header.fileSize, 0);
+    memcpy(&file[0], &header, sizeof(header));
+    if (!nodes.empty()) {
+        memcpy(&file[header.nodeOffset], &nodes[0], nodes.size() * sizeof(SceneNode));
+    }
+    if (!meshes.empty()) {
+        memcpy(&file[header.meshOffset], &meshes[0], meshes.size() * sizeof(SceneMesh));
+    }
+    if (!materials.empty()) {
+        memcpy(&file[header.materialOffset], &materials[0],
+               materials.size() * sizeof(SceneMaterial));
+    }
+    memcpy(&file[header.stringOffset], &strings[0], strings.size());
+}
@@ -0,0 +1,140 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+
+#ifndef MY_SCENE_H
+#define MY_SCENE_H
+
+#include "myTransform.h"
+#include <map>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#define SCENE_MAGIC         "CUBESCNE"
+#define SCENE_MAGIC_SIZE    8
+// files of another version are rejected, it changes whenever the layout below does
+#define SCENE_VERSION       1
+// for parents, children, meshes and materials a node does not have
+#define SCENE_NONE          -1
+
+/*
+ * Layout of a scene file, little-endian with 4-byte fields throughout so that a file
+ * mapped at a 4-byte aligned address is used in place. Offsets are from the start of the
+ * file and names are offsets into its strings, each followed by a 0.
+ */
+struct SceneHeader {
+    char        magic[SCENE_MAGIC_SIZE];
+    uint32_t    version;
+    uint32_t    fileSize;
+    uint32_t    nodeCount;
+    uint32_t    nodeOffset;
+    uint32_t    meshCount;
+    uint32_t    meshOffset;
+    uint32_t    materialCount;
+    uint32_t    materialOffset;
+    uint32_t    stringOffset;
+    uint32_t    stringSize;
+    uint32_t    reserved[4];
+};
+
+/*
+ * Nodes come after their parents, so world transforms are found in one pass in file order,
+ * and the children of a node are a list through firstChild and nextSibling
+ */
+struct SceneNode {
+    MyTransform transform;  // relative to the parent
+    int32_t     parent;
+    int32_t     firstChild;
+    int32_t     nextSibling;
+    int32_t     mesh;
+    int32_t     material;
+    uint32_t    name;
+    uint32_t    reserved[2];
+};
+
+struct SceneMesh {
+    uint32_t    name;       // of the mesh asset, or of a mesh the app creates itself
+    uint32_t    reserved;
+};
+
+struct SceneMaterial {
+    uint32_t    name;
+    uint32_t    texture;    // name of the texture asset, an empty string if there is none
+    float       color[4];
+};
+
+/**
+ * A scene of nodes with transforms and references to meshes and materials, read in place
+ * from a mapped file: opening it checks the file but copies and parses nothing, so a large
+ * scene opens in the time it takes to read through its nodes once.
+ *
+ * Open rejects files of another version and any file whose indices or offsets would lead
+ * outside it, so nothing read through MyScene is out of bounds or loops.
+ */
+class MyScene {
+public:
+    MyScene();
+    bool    Open(const uint8_t * data, size_t size, std::string & error);
+    bool    IsOpen() const { return header != NULL; }
+    int     GetNodeCount() const { return header ? (int) header->nodeCount : 0; }
+    int     GetMeshCount() const { return header ? (int) header->meshCount : 0; }
+    int     GetMaterialCount() const { return header ? (int) header->materialCount : 0; }
+    const SceneNode &       GetNode(int node) const { return nodes[node]; }
+    const SceneMesh &       GetMesh(int mesh) const { return meshes[mesh]; }
+    const SceneMaterial &   GetMaterial(int material) const { return materials[material]; }
+    const char *    GetString(uint32_t offset) const { return strings + offset; }
+    int     FindNode(const char * name) const;
+    void    ComputeWorldTransforms(std::vector<MyTransform> & world) const;
+
+private:
+    bool    CheckNode(int node) const;
+
+    const SceneHeader *     header;
+    const SceneNode *       nodes;
+    const SceneMesh *       meshes;
+    const SceneMaterial *   materials;
+    const char *            strings;
+};
+
+/**
+ * Collects a scene and writes it in the layout MyScene reads. Nodes are added after their
+ * parents, which is the order they are stored in. Names that repeat are stored once.
+ */
+class MySceneBuilder {
+public:
+    MySceneBuilder();
+    int     AddMesh(const std::string & name);
+    int     AddMaterial(const std::string & name, const std::string & texture,
+                        const float color[4]);
+    int     AddNode(const std::string & name, int parent, const MyTransform & transform,
+                    int mesh = SCENE_NONE, int material = SCENE_NONE);
+    int     GetNodeCount() const { return (int) nodes.size(); }
+    void    Write(std::vector<uint8_t> & file) const;
+
+private:
+    uint32_t    AddString(const std::string & value);
+
+    std::vector<SceneNode>      nodes;
+    std::vector<int>            lastChild;
+    std::vector<SceneMesh>      meshes;
+    std::vector<SceneMaterial>  materials;
+    std::vector<char>           strings;
+    std::map<std::string, uint32_t> stringOffsets;
+};
+
+#endif //MY_SCENE_H
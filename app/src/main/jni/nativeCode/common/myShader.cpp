@@ -18,6 +18,7 @@
 #include "myJNIHelper.h"
 #include <iostream>
 #include <fstream>
+#include <string.h>
 
 /**
  * Read the shader code from assets
@@ -26,6 +27,25 @@ bool ReadShaderCode(std::string & shaderCode, std::string & shaderFileName) {
 
     MyLOGI("Reading shader: %s", shaderFileName.c_str());
 
+    // the asset pack holds the shaders if the APK has one, lines are added as getline
+    // would below
+    std::vector<uint8_t> packedCode;
+    if (gHelperObject->ReadPackedAsset(shaderFileName.c_str(), packedCode)) {
+        const char * code = (const char *) packedCode.data();
+        size_t lineStart = 0;
+        while (lineStart < packedCode.size()) {
+            const char * lineEnd = (const char *) memchr(code + lineStart, '\n',
+                                                         packedCode.size() - lineStart);
+            size_t lineLength = lineEnd ? lineEnd - (code + lineStart)
+                                        : packedCode.size() - lineStart;
+            shaderCode += "\n";
+            shaderCode.append(code + lineStart, lineLength);
+            lineStart += lineLength + 1;
+        }
+        MyLOGI("Read successfully from the asset pack");
+        return true;
+    }
+
     // android shaders are stored in assets
     // read them using MyJNIHelper
     bool isFilePresent = gHelperObject->ExtractAssetReturnFilename(shaderFileName,
@@ -96,6 +116,10 @@ bool LinkProgram(GLuint programID, GLuint vertexShaderID,
 
     glAttachShader(programID, vertexShaderID);
     glAttachShader(programID, fragmentShaderID);
+    // drivers may only keep a binary of programs that asked for it before linking
+    if (IsGLES3Supported()) {
+        glProgramParameteri(programID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
     glLinkProgram(programID);
 
     // Check the program
@@ -20,6 +20,9 @@
 #include "myLogger.h"
 #include <string>
 
+bool ReadShaderCode(std::string & shaderCode, std::string & shaderFileName);
+bool CompileShader(GLuint & shaderID, const GLenum shaderType, std::string shaderCode);
+bool LinkProgram(GLuint programID, GLuint vertexShaderID, GLuint fragmentShaderID);
 GLuint LoadShaders(std::string vertexShaderCode, std::string fragmentShaderCode);
 GLuint GetAttributeLocation(GLuint programID, std::string variableName);
 GLint GetUniformLocation(GLuint programID, std::string uniformName);
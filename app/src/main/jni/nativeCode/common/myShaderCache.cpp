@@ -0,0 +1,360 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+
+#include "myShaderCache.h"
+#include "myShader.h"
+#include "myLogger.h"
+#include "misc.h"
+#include <algorithm>
+#include <string.h>
+
+/**
+ * ReadShaderCode starts every line with a newline, drop the first one so that line numbers
+ * in #line directives match the file
+ */
+static bool ReadShaderAsset(const std::string & fileName, std::string & code) {
+
+    std::string assetName = fileName;
+    code.clear();
+    if (!ReadShaderCode(code, assetName)) {
+        return false;
+    }
+    if (!code.empty() && code[0] == '\n') {
+        code.erase(0, 1);
+    }
+    return true;
+}
+
+MyShaderCache::MyShaderCache() {
+
+    pthread_mutex_init(&mutex, NULL);
+    pthread_cond_init(&queueCondition, NULL);
+    pthread_cond_init(&doneCondition, NULL);
+    threadStarted = threadRunning = quit = false;
+    resources = NULL;
+    attributes.push_back(std::make_pair(std::string("vertexPosition"),
+                                        (GLuint) VERTEX_POSITION_ATTRIBUTE));
+    attributes.push_back(std::make_pair(std::string("vertexColor"),
+                                        (GLuint) VERTEX_COLOR_ATTRIBUTE));
+    attributes.push_back(std::make_pair(std::string("instanceMat"),
+                                        (GLuint) INSTANCE_MATRIX_ATTRIBUTE));
+    display = EGL_NO_DISPLAY;
+    backgroundContext = EGL_NO_CONTEXT;
+    backgroundSurface = EGL_NO_SURFACE;
+    memset(&stats, 0, sizeof(stats));
+}
+
+MyShaderCache::~MyShaderCache() {
+
+    StopBackgroundThread();
+    for (std::map<uint32_t, Entry *>::iterator it = entries.begin(); it != entries.end(); ++it) {
+        if (resources) {
+            resources->Destroy(it->second->handle);
+        }
+        delete it->second;
+    }
+    pthread_cond_destroy(&doneCondition);
+    pthread_cond_destroy(&queueCondition);
+    pthread_mutex_destroy(&mutex);
+}
+
+/**
+ * Start the background compiler for the current context, once per context on the GL
+ * thread. Programs already handed to resources come back with it after a lost context,
+ * the others are forgotten and compiled again when they are requested.
+ */
+void MyShaderCache::Init(MyGPUResources * resources) {
+
+    StopBackgroundThread();
+    this->resources = resources;
+    std::map<uint32_t, Entry *>::iterator it = entries.begin();
+    while (it != entries.end()) {
+        if (it->second->handle == GPU_NULL_HANDLE && it->second->state != ENTRY_FAILED) {
+            delete it->second;
+            entries.erase(it++);
+        } else {
+            ++it;
+        }
+    }
+    queue.clear();
+    memset(&stats, 0, sizeof(stats));
+
+    // the list does not change, a restored context has no need to read it again
+    std::string listText, error;
+    if (listedVariants.empty() && (!ReadShaderAsset(SHADER_VARIANT_LIST, listText) ||
+        !ParseShaderVariantList(listText, listedVariants, error))) {
+        MyLOGW("Cannot use %s: %s", SHADER_VARIANT_LIST, error.c_str());
+    }
+
+    if (!StartBackgroundThread()) {
+        MyLOGW("No shared context, shader variants compile on the GL thread");
+    }
+}
+
+/**
+ * Create a context sharing objects with the current one and a thread that compiles on it
+ */
+bool MyShaderCache::StartBackgroundThread() {
+
+    display = eglGetCurrentDisplay();
+    EGLContext sharedContext = eglGetCurrentContext();
+    if (display == EGL_NO_DISPLAY || sharedContext == EGL_NO_CONTEXT) {
+        return false;
+    }
+
+    // same config and client version as the GL thread's context
+    EGLint configID = 0, clientVersion = 2, configCount = 0;
+    eglQueryContext(display, sharedContext, EGL_CONFIG_ID, &configID);
+    eglQueryContext(display, sharedContext, EGL_CONTEXT_CLIENT_VERSION, &clientVersion);
+    EGLint configAttributes[] = {EGL_CONFIG_ID, configID, EGL_NONE};
+    EGLConfig config;
+    if (!eglChooseConfig(display, configAttributes, &config, 1, &configCount) ||
+        configCount < 1) {
+        return false;
+    }
+    EGLint contextAttributes[] = {EGL_CONTEXT_CLIENT_VERSION, clientVersion, EGL_NONE};
+    backgroundContext = eglCreateContext(display, config, sharedContext, contextAttributes);
+    if (backgroundContext == EGL_NO_CONTEXT) {
+        return false;
+    }
+
+    // the context needs a surface to be made current, a tiny pbuffer or none at all
+    // where the driver allows surfaceless contexts
+    EGLint surfaceAttributes[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+    backgroundSurface = eglCreatePbufferSurface(display, config, surfaceAttributes);
+    if (backgroundSurface == EGL_NO_SURFACE) {
+        const char * extensions = eglQueryString(display, EGL_EXTENSIONS);
+        if (!extensions || !strstr(extensions, "EGL_KHR_surfaceless_context")) {
+            eglDestroyContext(display, backgroundContext);
+            backgroundContext = EGL_NO_CONTEXT;
+            return false;
+        }
+    }
+
+    quit = false;
+    threadRunning = true;
+    threadStarted = pthread_create(&thread, NULL, CompileLoop, this) == 0;
+    if (!threadStarted) {
+        StopBackgroundThread();
+        return false;
+    }
+    return true;
+}
+
+void MyShaderCache::StopBackgroundThread() {
+
+    if (threadStarted) {
+        pthread_mutex_lock(&mutex);
+        quit = true;
+        pthread_cond_broadcast(&queueCondition);
+        pthread_mutex_unlock(&mutex);
+        pthread_join(thread, NULL);
+    }
+    threadStarted = threadRunning = quit = false;
+
+    if (backgroundSurface != EGL_NO_SURFACE) {
+        eglDestroySurface(display, backgroundSurface);
+        backgroundSurface = EGL_NO_SURFACE;
+    }
+    if (backgroundContext != EGL_NO_CONTEXT) {
+        eglDestroyContext(display, backgroundContext);
+        backgroundContext = EGL_NO_CONTEXT;
+    }
+}
+
+void * MyShaderCache::CompileLoop(void * arg) {
+
+    MyShaderCache * cache = (MyShaderCache *) arg;
+    if (!eglMakeCurrent(cache->display, cache->backgroundSurface, cache->backgroundSurface,
+                        cache->backgroundContext)) {
+        // queued variants stay queued and the GL thread compiles them when it asks again
+        MyLOGW("Cannot use the shader compile context: 0x%x", eglGetError());
+        pthread_mutex_lock(&cache->mutex);
+        cache->threadRunning = false;
+        pthread_mutex_unlock(&cache->mutex);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&cache->mutex);
+    while (!cache->quit) {
+        if (cache->queue.empty()) {
+            pthread_cond_wait(&cache->queueCondition, &cache->mutex);
+            continue;
+        }
+        Entry * entry = cache->queue.front();
+        cache->queue.pop_front();
+        entry->state = ENTRY_COMPILING;
+        pthread_mutex_unlock(&cache->mutex);
+        cache->Compile(entry);
+        pthread_mutex_lock(&cache->mutex);
+    }
+    pthread_mutex_unlock(&cache->mutex);
+
+    eglMakeCurrent(cache->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglReleaseThread();
+    return NULL;
+}
+
+/**
+ * Compile and link an entry on whichever thread calls it, then publish the result
+ */
+void MyShaderCache::Compile(Entry * entry) {
+
+    double startTimeMs = GetMonotonicTimeMs();
+    std::string name = GetShaderVariantName(entry->variant);
+
+    GLuint vertexShaderID = 0, fragmentShaderID = 0;
+    GLuint programID = glCreateProgram();
+    bool compiled = CompileShader(vertexShaderID, GL_VERTEX_SHADER, entry->vertexSource) &&
+                    CompileShader(fragmentShaderID, GL_FRAGMENT_SHADER, entry->fragmentSource);
+    if (compiled) {
+        for (size_t i = 0; i < attributes.size(); i++) {
+            glBindAttribLocation(programID, attributes[i].second, attributes[i].first.c_str());
+        }
+        // LinkProgram deletes the shaders, and the program if linking fails
+        compiled = LinkProgram(programID, vertexShaderID, fragmentShaderID);
+    } else {
+        glDeleteShader(vertexShaderID);
+        glDeleteShader(fragmentShaderID);
+        glDeleteProgram(programID);
+    }
+    if (!compiled) {
+        // the error log refers to files by the source numbers of the #line directives
+        MyLOGE("Shader variant %s failed", name.c_str());
+        for (size_t i = 0; i < entry->sourceFiles.size(); i++) {
+            MyLOGE("  source %d: %s", (int) i, entry->sourceFiles[i].c_str());
+        }
+        programID = 0;
+    }
+
+    // the GL thread may only use the program once this context has finished linking it
+    if (eglGetCurrentContext() == backgroundContext) {
+        glFinish();
+    }
+    double compileTimeMs = GetMonotonicTimeMs() - startTimeMs;
+    if (compiled) {
+        MyLOGI("Shader variant %s compiled in %.1f ms", name.c_str(), compileTimeMs);
+    }
+
+    pthread_mutex_lock(&mutex);
+    entry->programID = programID;
+    entry->state = compiled ? ENTRY_READY : ENTRY_FAILED;
+    stats.compileTimeMs += compileTimeMs;
+    if (compiled) {
+        stats.compiledVariants++;
+    } else {
+        stats.failedVariants++;
+    }
+    pthread_cond_broadcast(&doneCondition);
+    pthread_mutex_unlock(&mutex);
+}
+
+/**
+ * Return the variant's program, or 0 if it failed or is still compiling. The first request
+ * preprocesses the variant and queues it. With wait the GL thread blocks until the program
+ * is ready, compiling it itself if the background thread has not started on it yet.
+ */
+GLuint MyShaderCache::GetProgram(const ShaderVariant & variant, bool wait) {
+
+    Entry * entry;
+    std::map<uint32_t, Entry *>::iterator found = entries.find(variant.GetKey());
+    if (found != entries.end()) {
+        entry = found->second;
+    } else {
+        entry = new Entry();
+        entry->variant = variant;
+        entry->programID = 0;
+        entry->handle = GPU_NULL_HANDLE;
+        entry->state = ENTRY_QUEUED;
+        entries[variant.GetKey()] = entry;
+
+        std::string name = GetShaderVariantName(variant), error;
+        const ShaderProgramDesc & desc = GetShaderProgramDesc(variant.program);
+        std::vector<std::string> fragmentFiles;
+        if (!IsValidShaderVariant(variant, error) ||
+            !PreprocessShader(ReadShaderAsset, desc.vertexShader, SHADER_STAGE_VERTEX,
+                              variant.features, entry->vertexSource, entry->sourceFiles,
+                              error) ||
+            !PreprocessShader(ReadShaderAsset, desc.fragmentShader, SHADER_STAGE_FRAGMENT,
+                              variant.features, entry->fragmentSource, fragmentFiles, error)) {
+            MyLOGE("Shader variant %s: %s", name.c_str(), error.c_str());
+            pthread_mutex_lock(&mutex);
+            entry->state = ENTRY_FAILED;
+            stats.failedVariants++;
+            pthread_mutex_unlock(&mutex);
+            return 0;
+        }
+        // the fragment shader's source numbers continue after the vertex shader's
+        entry->sourceFiles.insert(entry->sourceFiles.end(), fragmentFiles.begin(),
+                                  fragmentFiles.end());
+
+        bool listed = false;
+        for (size_t i = 0; i < listedVariants.size(); i++) {
+            listed = listed || listedVariants[i].GetKey() == variant.GetKey();
+        }
+        if (!listed) {
+            MyLOGW("Shader variant %s is not in %s, it was not validated at build time",
+                   name.c_str(), SHADER_VARIANT_LIST);
+        }
+
+        pthread_mutex_lock(&mutex);
+        queue.push_back(entry);
+        pthread_cond_signal(&queueCondition);
+        pthread_mutex_unlock(&mutex);
+    }
+
+    pthread_mutex_lock(&mutex);
+    if (entry->state == ENTRY_READY || entry->state == ENTRY_FAILED ||
+        (!wait && threadRunning)) {
+        bool ready = entry->state == ENTRY_READY;
+        pthread_mutex_unlock(&mutex);
+        return ready ? Adopt(entry) : 0;
+    }
+
+    // needed now: rather than wait behind other queued variants, compile it here
+    double startTimeMs = GetMonotonicTimeMs();
+    if (entry->state == ENTRY_QUEUED) {
+        queue.erase(std::find(queue.begin(), queue.end(), entry));
+        entry->state = ENTRY_COMPILING;
+        pthread_mutex_unlock(&mutex);
+        Compile(entry);
+        pthread_mutex_lock(&mutex);
+    }
+    while (entry->state == ENTRY_COMPILING) {
+        pthread_cond_wait(&doneCondition, &mutex);
+    }
+    stats.blockedTimeMs += GetMonotonicTimeMs() - startTimeMs;
+    bool ready = entry->state == ENTRY_READY;
+    pthread_mutex_unlock(&mutex);
+    return ready ? Adopt(entry) : 0;
+}
+
+/**
+ * Hand a compiled program to resources, which keeps its sources and binary to restore it
+ * after a lost context, and return its current name. Only the GL thread touches a ready
+ * entry, so this needs no lock.
+ */
+GLuint MyShaderCache::Adopt(Entry * entry) {
+
+    if (entry->handle == GPU_NULL_HANDLE) {
+        entry->handle = resources->AdoptProgram(entry->programID, entry->vertexSource,
+                                                entry->fragmentSource, attributes);
+        std::string().swap(entry->vertexSource);
+        std::string().swap(entry->fragmentSource);
+    }
+    return resources->GetName(entry->handle);
+}
@@ -0,0 +1,100 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+
+#ifndef MY_SHADER_CACHE_H
+#define MY_SHADER_CACHE_H
+
+#include "myGLFunctions.h"
+#include "myGPUResources.h"
+#include "myShaderVariants.h"
+#include <EGL/egl.h>
+#include <pthread.h>
+#include <deque>
+#include <map>
+
+// attribute locations are bound before linking, so they are the same in every variant
+#define VERTEX_POSITION_ATTRIBUTE   0
+#define VERTEX_COLOR_ATTRIBUTE      1
+#define INSTANCE_MATRIX_ATTRIBUTE   2   // a mat4 takes locations 2 to 5
+
+struct ShaderCacheStats {
+    int     compiledVariants;
+    int     failedVariants;
+    double  compileTimeMs;      // spent compiling and linking, on either thread
+    double  blockedTimeMs;      // the GL thread spent waiting for or compiling variants
+};
+
+/**
+ * Compiles shader variants on first use and keeps their programs. Compiling happens on a
+ * background thread with its own EGL context that shares objects with the GL thread's, so
+ * a variant that is not needed right away never stalls a frame. Without a shared context
+ * variants are compiled on the GL thread when they are requested.
+ */
+class MyShaderCache {
+public:
+    MyShaderCache();
+    ~MyShaderCache();
+    void    Init(MyGPUResources * resources);
+    GLuint  GetProgram(const ShaderVariant & variant, bool wait);
+    const ShaderCacheStats & GetStats() const { return stats; }
+
+private:
+    enum EntryState {
+        ENTRY_QUEUED,
+        ENTRY_COMPILING,
+        ENTRY_READY,
+        ENTRY_FAILED
+    };
+
+    struct Entry {
+        ShaderVariant   variant;
+        std::string     vertexSource, fragmentSource;   // until resources takes them
+        std::vector<std::string> sourceFiles;
+        GLuint          programID;  // as linked, GetProgram returns the handle's name
+        GPUHandle       handle;     // set when the GL thread first gets the program
+        EntryState      state;
+    };
+
+    bool    StartBackgroundThread();
+    void    StopBackgroundThread();
+    static void *   CompileLoop(void * arg);
+    void    Compile(Entry * entry);
+    GLuint  Adopt(Entry * entry);
+
+    // only the GL thread touches the map, the mutex guards the queue and the entries' state
+    std::map<uint32_t, Entry *> entries;
+    std::deque<Entry *> queue;
+    pthread_mutex_t mutex;
+    pthread_cond_t  queueCondition, doneCondition;
+    pthread_t   thread;
+    bool        threadStarted;  // CompileLoop was started and has to be joined
+    bool        threadRunning;  // and it is compiling on its context
+    bool        quit;
+
+    MyGPUResources * resources;
+    AttributeBindings attributes;
+
+    EGLDisplay  display;
+    EGLContext  backgroundContext;
+    EGLSurface  backgroundSurface;
+
+    // variants listed in SHADER_VARIANT_LIST, others are reported when first requested
+    std::vector<ShaderVariant> listedVariants;
+    ShaderCacheStats stats;
+};
+
+#endif //MY_SHADER_CACHE_H
@@ -0,0 +1,247 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+
+#include "myShaderVariants.h"
+#include <sstream>
+#include <stdio.h>
+
+#define COMMON_FEATURES (SHADER_FEATURE_GLES3 | SHADER_FEATURE_UNIFORM_BUFFERS | \
+                         SHADER_FEATURE_INSTANCING | SHADER_FEATURE_QUANTIZED_VERTICES)
+
+static const ShaderProgramDesc programDescs[SHADER_PROGRAM_COUNT] = {
+    {"cube",      "cube.vsh",      "cube.fsh",      COMMON_FEATURES | SHADER_FEATURE_LIGHTING},
+    {"depthOnly", "depthOnly.vsh", "depthOnly.fsh", COMMON_FEATURES},
+    {"overdraw",  "depthOnly.vsh", "overdraw.fsh",  COMMON_FEATURES},
+};
+
+static const char * featureNames[SHADER_FEATURE_COUNT] = {
+    "GLES3", "UNIFORM_BUFFERS", "LIGHTING", "INSTANCING", "QUANTIZED_VERTICES"
+};
+
+const ShaderProgramDesc & GetShaderProgramDesc(int program) {
+
+    return programDescs[program];
+}
+
+const char * GetShaderFeatureName(int featureIndex) {
+
+    return featureNames[featureIndex];
+}
+
+/**
+ * Check that the program supports the features and that the features needing GLSL ES 3.00
+ * or the uniform blocks have them
+ */
+bool IsValidShaderVariant(const ShaderVariant & variant, std::string & reason) {
+
+    if (variant.program < 0 || variant.program >= SHADER_PROGRAM_COUNT) {
+        reason = "unknown program";
+        return false;
+    }
+    unsigned int features = variant.features;
+    if (features & ~programDescs[variant.program].supportedFeatures) {
+        reason = "feature not supported by the program";
+        return false;
+    }
+    bool es3 = (features & SHADER_FEATURE_GLES3) != 0;
+    bool uniformBuffers = (features & SHADER_FEATURE_UNIFORM_BUFFERS) != 0;
+    if (uniformBuffers && !es3) {
+        reason = "UNIFORM_BUFFERS needs GLES3";
+        return false;
+    }
+    // lighting reads the froxel parameters and instancing the camera from FrameData
+    if ((features & (SHADER_FEATURE_LIGHTING | SHADER_FEATURE_INSTANCING)) && !uniformBuffers) {
+        reason = "LIGHTING and INSTANCING need UNIFORM_BUFFERS";
+        return false;
+    }
+    return true;
+}
+
+/**
+ * The program's name followed by its features, as written in the variant list
+ */
+std::string GetShaderVariantName(const ShaderVariant & variant) {
+
+    std::string name = programDescs[variant.program].name;
+    for (int i = 0; i < SHADER_FEATURE_COUNT; i++) {
+        if (variant.features & (1 << i)) {
+            name += " ";
+            name += featureNames[i];
+        }
+    }
+    return name;
+}
+
+/**
+ * Parse a variant list: one variant per line, program name then feature names.
+ * Empty lines and lines starting with # are skipped.
+ */
+bool ParseShaderVariantList(const std::string & text, std::vector<ShaderVariant> & variants,
+                            std::string & error) {
+
+    std::istringstream lines(text);
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(lines, line)) {
+        lineNumber++;
+        std::istringstream words(line);
+        std::string word;
+        if (!(words >> word) || word[0] == '#') {
+            continue;
+        }
+
+        ShaderVariant variant(-1, 0);
+        for (int i = 0; i < SHADER_PROGRAM_COUNT; i++) {
+            if (word == programDescs[i].name) {
+                variant.program = i;
+            }
+        }
+        bool known = variant.program >= 0;
+        while (known && words >> word) {
+            known = false;
+            for (int i = 0; i < SHADER_FEATURE_COUNT; i++) {
+                if (word == featureNames[i]) {
+                    variant.features |= 1 << i;
+                    known = true;
+                }
+            }
+        }
+        if (!known) {
+            std::ostringstream message;
+            message << "line " << lineNumber << ": unknown name " << word;
+            error = message.str();
+            return false;
+        }
+        variants.push_back(variant);
+    }
+    return true;
+}
+
+/**
+ * Every valid variant of every program
+ */
+void EnumerateShaderVariants(std::vector<ShaderVariant> & variants) {
+
+    std::string reason;
+    for (int program = 0; program < SHADER_PROGRAM_COUNT; program++) {
+        for (unsigned int features = 0; features < (1u << SHADER_FEATURE_COUNT); features++) {
+            ShaderVariant variant(program, features);
+            if (IsValidShaderVariant(variant, reason)) {
+                variants.push_back(variant);
+            }
+        }
+    }
+}
+
+/**
+ * GLSL ES 1.00 numbers the line after #line N as N + 1, 3.00 as N
+ */
+static void AppendLineDirective(std::string & source, int line, int sourceIndex, bool es3) {
+
+    char directive[32];
+    snprintf(directive, sizeof(directive), "#line %d %d\n", es3 ? line : line - 1, sourceIndex);
+    source += directive;
+}
+
+/**
+ * Append fileName to source with its #include lines replaced by the included files.
+ * A file is included at most once per shader, later includes of it are dropped.
+ */
+static bool ExpandIncludes(ShaderFileReader reader, const std::string & fileName, int depth,
+                           bool es3, std::string & source, std::vector<std::string> & sourceFiles,
+                           std::string & error) {
+
+    for (size_t i = 0; i < sourceFiles.size(); i++) {
+        if (sourceFiles[i] == fileName) {
+            return true;
+        }
+    }
+    if (depth > SHADER_MAX_INCLUDE_DEPTH) {
+        error = fileName + ": includes nested too deeply";
+        return false;
+    }
+    std::string code;
+    if (!reader(SHADER_DIRECTORY + fileName, code)) {
+        error = fileName + ": cannot read";
+        return false;
+    }
+    int sourceIndex = (int) sourceFiles.size();
+    sourceFiles.push_back(fileName);
+
+    AppendLineDirective(source, 1, sourceIndex, es3);
+    std::istringstream lines(code);
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(lines, line)) {
+        lineNumber++;
+
+        // only '#' 'include' '"name"' with optional whitespace around the tokens
+        size_t pos = line.find_first_not_of(" \t");
+        if (pos == std::string::npos || line[pos] != '#') {
+            source += line + "\n";
+            continue;
+        }
+        pos = line.find_first_not_of(" \t", pos + 1);
+        if (pos != std::string::npos && line.compare(pos, 7, "version") == 0) {
+            std::ostringstream message;
+            message << fileName << ":" << lineNumber << ": #version is added by the front end";
+            error = message.str();
+            return false;
+        }
+        if (pos == std::string::npos || line.compare(pos, 7, "include") != 0) {
+            source += line + "\n";
+            continue;
+        }
+        size_t open = line.find('"', pos + 7);
+        size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+        if (close == std::string::npos) {
+            std::ostringstream message;
+            message << fileName << ":" << lineNumber << ": malformed #include";
+            error = message.str();
+            return false;
+        }
+        std::string includeName = line.substr(open + 1, close - open - 1);
+        if (!ExpandIncludes(reader, includeName, depth + 1, es3, source, sourceFiles, error)) {
+            return false;
+        }
+        AppendLineDirective(source, lineNumber + 1, sourceIndex, es3);
+    }
+    return true;
+}
+
+/**
+ * Turn a shader asset into compilable source for one variant: #version for the GLSL ES
+ * version, a 0/1 #define for the stage and each feature, then the file with its includes
+ * expanded. Includes are expanded whether or not they sit inside an #if.
+ * sourceFiles receives the files in the order of the source numbers in #line directives.
+ */
+bool PreprocessShader(ShaderFileReader reader, const std::string & fileName, ShaderStage stage,
+                      unsigned int features, std::string & source,
+                      std::vector<std::string> & sourceFiles, std::string & error) {
+
+    bool es3 = (features & SHADER_FEATURE_GLES3) != 0;
+    source = es3 ? "#version 300 es\n" : "#version 100\n";
+    bool vertex = stage == SHADER_STAGE_VERTEX;
+    source += vertex ? "#define VERTEX_SHADER 1\n" : "#define VERTEX_SHADER 0\n";
+    source += vertex ? "#define FRAGMENT_SHADER 0\n" : "#define FRAGMENT_SHADER 1\n";
+    for (int i = 0; i < SHADER_FEATURE_COUNT; i++) {
+        source += std::string("#define ") + featureNames[i] +
+                  ((features & (1 << i)) ? " 1\n" : " 0\n");
+    }
+    sourceFiles.clear();
+    return ExpandIncludes(reader, fileName, 0, es3, source, sourceFiles, error);
+}
@@ -0,0 +1,84 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+
+#ifndef MY_SHADER_VARIANTS_H
+#define MY_SHADER_VARIANTS_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// features that select a shader variant, each one becomes a 0/1 #define of its name
+#define SHADER_FEATURE_GLES3                (1 << 0)    // GLSL ES 3.00 instead of 1.00
+#define SHADER_FEATURE_UNIFORM_BUFFERS      (1 << 1)    // camera in FrameData and DrawData
+#define SHADER_FEATURE_LIGHTING             (1 << 2)    // clustered forward lighting
+#define SHADER_FEATURE_INSTANCING           (1 << 3)    // per-instance model matrix attribute
+#define SHADER_FEATURE_QUANTIZED_VERTICES   (1 << 4)    // normalized short positions
+#define SHADER_FEATURE_COUNT                5
+
+// shader sources and #include paths are relative to this asset directory
+#define SHADER_DIRECTORY            "shaders/"
+// variants the app uses, checked by tools/shaderVariants.cpp
+#define SHADER_VARIANT_LIST         "shaders/variants.txt"
+#define SHADER_MAX_INCLUDE_DEPTH    8
+
+enum ShaderProgramName {
+    SHADER_PROGRAM_CUBE,
+    SHADER_PROGRAM_DEPTH_ONLY,
+    SHADER_PROGRAM_OVERDRAW,
+    SHADER_PROGRAM_COUNT
+};
+
+enum ShaderStage {
+    SHADER_STAGE_VERTEX,
+    SHADER_STAGE_FRAGMENT
+};
+
+struct ShaderProgramDesc {
+    const char *    name;               // as written in the variant list
+    const char *    vertexShader;
+    const char *    fragmentShader;
+    unsigned int    supportedFeatures;
+};
+
+/**
+ * One permutation of a program: which program and which features it is compiled with
+ */
+struct ShaderVariant {
+    int             program;
+    unsigned int    features;
+
+    ShaderVariant(int program = SHADER_PROGRAM_CUBE, unsigned int features = 0) :
+            program(program), features(features) {}
+    uint32_t    GetKey() const { return ((uint32_t) program << 16) | features; }
+};
+
+// reads an asset, e.g. "shaders/cube.vsh", into code and returns false if it is missing
+typedef bool (*ShaderFileReader)(const std::string & fileName, std::string & code);
+
+const ShaderProgramDesc & GetShaderProgramDesc(int program);
+const char * GetShaderFeatureName(int featureIndex);
+bool    IsValidShaderVariant(const ShaderVariant & variant, std::string & reason);
+std::string GetShaderVariantName(const ShaderVariant & variant);
+bool    ParseShaderVariantList(const std::string & text, std::vector<ShaderVariant> & variants,
+                               std::string & error);
+void    EnumerateShaderVariants(std::vector<ShaderVariant> & variants);
+bool    PreprocessShader(ShaderFileReader reader, const std::string & fileName,
+                         ShaderStage stage, unsigned int features, std::string & source,
+                         std::vector<std::string> & sourceFiles, std::string & error);
+
+#endif //MY_SHADER_VARIANTS_H
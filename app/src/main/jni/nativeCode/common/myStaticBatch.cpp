@@ -0,0 +1,293 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include "myStaticBatch.h"
+#include "myLogger.h"
+#include <algorithm>
+
+MyStaticBatch::MyStaticBatch() : vertexAllocator(STATIC_BATCH_MAX_VERTICES),
+                                 indexAllocator(STATIC_BATCH_MAX_INDICES) {
+
+    resources = NULL;
+    vertexBuffer = colorBuffer = indexBuffer = GPU_NULL_HANDLE;
+    gpuVertexCount = gpuIndexCount = 0;
+    dirtyVertexBegin = dirtyIndexBegin = 0xFFFFFFFF;
+    dirtyVertexEnd = dirtyIndexEnd = 0;
+    drawsBefore = drawsAfter = 0;
+}
+
+MyStaticBatch::~MyStaticBatch() {
+
+    if (resources) {
+        resources->Destroy(vertexBuffer);
+        resources->Destroy(colorBuffer);
+        resources->Destroy(indexBuffer);
+    }
+}
+
+/**
+ * Copy the mesh, moved by transform, into the batch. Returns the mesh's ID or
+ * STATIC_BATCH_NO_MESH if the batch is full.
+ */
+int MyStaticBatch::AddMesh(const MyMesh & mesh, const MyTransform & transform) {
+
+    uint32_t vertexCount = (uint32_t) mesh.positions.size();
+    uint32_t indexCount = 0;
+    for (size_t i = 0; i < mesh.lods.size(); i++) {
+        indexCount += (uint32_t) mesh.lods[i].indices.size();
+    }
+
+    uint32_t firstVertex = vertexAllocator.Allocate(vertexCount);
+    if (firstVertex == RANGE_ALLOCATION_FAILED) {
+        MyLOGE("Static batch is out of vertices for %d more", vertexCount);
+        return STATIC_BATCH_NO_MESH;
+    }
+    uint32_t firstIndex = indexAllocator.Allocate(indexCount);
+    if (firstIndex == RANGE_ALLOCATION_FAILED) {
+        MyLOGE("Static batch is out of indices for %d more", indexCount);
+        vertexAllocator.Free(firstVertex, vertexCount);
+        return STATIC_BATCH_NO_MESH;
+    }
+
+    if (positions.size() < firstVertex + vertexCount) {
+        positions.resize(firstVertex + vertexCount);
+        colors.resize(firstVertex + vertexCount);
+    }
+    for (uint32_t i = 0; i < vertexCount; i++) {
+        positions[firstVertex + i] = transform.translation +
+                                     transform.rotation * (transform.scale * mesh.positions[i]);
+        colors[firstVertex + i] = mesh.colors[i];
+    }
+
+    MyBatchedMesh batched;
+    batched.firstVertex = firstVertex;
+    batched.vertexCount = vertexCount;
+    batched.firstIndex = firstIndex;
+    batched.indexCount = indexCount;
+    batched.residentLOD = 0;
+    if (indices.size() < firstIndex + indexCount) {
+        indices.resize(firstIndex + indexCount);
+    }
+    uint32_t next = firstIndex;
+    for (size_t level = 0; level < mesh.lods.size(); level++) {
+        const std::vector<uint32_t> & lodIndices = mesh.lods[level].indices;
+        batched.lodFirstIndex.push_back(next);
+        batched.lodIndexCount.push_back((uint32_t) lodIndices.size());
+        for (size_t i = 0; i < lodIndices.size(); i++) {
+            indices[next++] = (GLushort) (firstVertex + lodIndices[i]);
+        }
+    }
+
+    dirtyVertexBegin = std::min(dirtyVertexBegin, firstVertex);
+    dirtyVertexEnd = std::max(dirtyVertexEnd, firstVertex + vertexCount);
+    dirtyIndexBegin = std::min(dirtyIndexBegin, firstIndex);
+    dirtyIndexEnd = std::max(dirtyIndexEnd, firstIndex + indexCount);
+
+    // reuse the slot of a removed mesh
+    for (size_t i = 0; i < meshes.size(); i++) {
+        if (meshes[i].vertexCount == 0) {
+            meshes[i] = batched;
+            return (int) i;
+        }
+    }
+    meshes.push_back(batched);
+    return (int) meshes.size() - 1;
+}
+
+/**
+ * Release the mesh's ranges, they are reused by later meshes. Buffers do not shrink.
+ */
+void MyStaticBatch::RemoveMesh(int meshID) {
+
+    MyBatchedMesh & batched = meshes[meshID];
+    if (batched.vertexCount == 0) {
+        return;
+    }
+    vertexAllocator.Free(batched.firstVertex, batched.vertexCount);
+    for (size_t level = batched.residentLOD; level < batched.lodIndexCount.size(); level++) {
+        if (batched.lodIndexCount[level]) {
+            indexAllocator.Free(batched.lodFirstIndex[level], batched.lodIndexCount[level]);
+        }
+    }
+    batched = MyBatchedMesh(); // a slot with no vertices is free
+}
+
+/**
+ * Keep the mesh's LODs from level on in the index buffer. Finer ones move out to copies
+ * and their ranges are reused by later meshes or LODs, as with RemoveMesh the buffers do
+ * not shrink. Evicted LODs that are coarser than level come back at a new place, so their
+ * lodFirstIndex changes. Returns false if the batch is out of indices for them, the LODs
+ * that did fit stay.
+ */
+bool MyStaticBatch::SetResidentLOD(int meshID, int level) {
+
+    MyBatchedMesh & batched = meshes[meshID];
+    int lodCount = (int) batched.lodIndexCount.size();
+    if (batched.vertexCount == 0 || lodCount == 0) {
+        return false;
+    }
+    level = std::max(0, std::min(level, lodCount - 1));
+    batched.evictedIndices.resize(lodCount);
+
+    while ((int) batched.residentLOD < level) {
+        uint32_t lod = batched.residentLOD;
+        uint32_t first = batched.lodFirstIndex[lod];
+        uint32_t count = batched.lodIndexCount[lod];
+        if (count) {
+            batched.evictedIndices[lod].assign(indices.begin() + first,
+                                               indices.begin() + first + count);
+            indexAllocator.Free(first, count);
+        }
+        batched.residentLOD++;
+    }
+
+    while ((int) batched.residentLOD > level) {
+        uint32_t lod = batched.residentLOD - 1;
+        uint32_t count = batched.lodIndexCount[lod];
+        if (count) {
+            uint32_t first = indexAllocator.Allocate(count);
+            if (first == RANGE_ALLOCATION_FAILED) {
+                MyLOGE("Static batch is out of indices to restore LOD %d", lod);
+                return false;
+            }
+            if (indices.size() < first + count) {
+                indices.resize(first + count);
+            }
+            std::vector<GLushort> & evicted = batched.evictedIndices[lod];
+            std::copy(evicted.begin(), evicted.end(), indices.begin() + first);
+            std::vector<GLushort>().swap(evicted);
+            batched.lodFirstIndex[lod] = first;
+            dirtyIndexBegin = std::min(dirtyIndexBegin, first);
+            dirtyIndexEnd = std::max(dirtyIndexEnd, first + count);
+        }
+        batched.residentLOD--;
+    }
+    return true;
+}
+
+/**
+ * Create the GL buffers and fill them with all the meshes, needs the GL context.
+ * The batch keeps its own copies, so resources does not keep another one.
+ */
+void MyStaticBatch::CreateGLBuffers(MyGPUResources * resources) {
+
+    this->resources = resources;
+    vertexBuffer = resources->CreateBuffer(GL_ARRAY_BUFFER, GL_STATIC_DRAW, false);
+    colorBuffer = resources->CreateBuffer(GL_ARRAY_BUFFER, GL_STATIC_DRAW, false);
+    indexBuffer = resources->CreateBuffer(GL_ELEMENT_ARRAY_BUFFER, GL_STATIC_DRAW, false);
+    gpuVertexCount = gpuIndexCount = 0;
+    RestoreGLBuffers();
+
+    StaticBatchStats stats = GetStats();
+    MyLOGD("Static batch of %d meshes: %d buffers (%d unbatched), %d KB (%d KB unbatched)",
+           stats.meshCount, stats.buffersAfter, stats.buffersBefore,
+           (int) (stats.bytesAfter / 1024), (int) (stats.bytesBefore / 1024));
+}
+
+/**
+ * Refill the buffers from the copies once resources has restored them after a lost context,
+ * they come back at their old size with undefined contents
+ */
+void MyStaticBatch::RestoreGLBuffers() {
+
+    dirtyVertexBegin = dirtyIndexBegin = 0;
+    dirtyVertexEnd = vertexAllocator.GetHighWaterMark();
+    dirtyIndexEnd = indexAllocator.GetHighWaterMark();
+    UpdateGLBuffers();
+}
+
+/**
+ * Upload the ranges changed since the last upload. Buffers are reallocated to the
+ * allocators' high-water marks only when they have to grow.
+ */
+void MyStaticBatch::UpdateGLBuffers() {
+
+    uint32_t vertexCount = vertexAllocator.GetHighWaterMark();
+    if (vertexCount > gpuVertexCount && vertexCount > 0) {
+        resources->BufferData(vertexBuffer, vertexCount * sizeof(glm::vec3), &positions[0]);
+        resources->BufferData(colorBuffer, vertexCount * sizeof(glm::vec3), &colors[0]);
+        gpuVertexCount = vertexCount;
+    } else if (dirtyVertexBegin < dirtyVertexEnd) {
+        GLintptr offset = dirtyVertexBegin * sizeof(glm::vec3);
+        GLsizeiptr size = (dirtyVertexEnd - dirtyVertexBegin) * sizeof(glm::vec3);
+        resources->BufferSubData(vertexBuffer, offset, size, &positions[dirtyVertexBegin]);
+        resources->BufferSubData(colorBuffer, offset, size, &colors[dirtyVertexBegin]);
+    }
+
+    uint32_t indexCount = indexAllocator.GetHighWaterMark();
+    if (indexCount > gpuIndexCount && indexCount > 0) {
+        resources->BufferData(indexBuffer, indexCount * sizeof(GLushort), &indices[0]);
+        gpuIndexCount = indexCount;
+    } else if (dirtyIndexBegin < dirtyIndexEnd) {
+        resources->BufferSubData(indexBuffer, dirtyIndexBegin * sizeof(GLushort),
+                                 (dirtyIndexEnd - dirtyIndexBegin) * sizeof(GLushort),
+                                 &indices[dirtyIndexBegin]);
+    }
+
+    dirtyVertexBegin = dirtyIndexBegin = 0xFFFFFFFF;
+    dirtyVertexEnd = dirtyIndexEnd = 0;
+    CheckGLError("MyStaticBatch::UpdateGLBuffers");
+}
+
+static bool CompareFirstIndex(const MyDrawRange & a, const MyDrawRange & b) {
+
+    return a.firstIndex < b.firstIndex;
+}
+
+/**
+ * Sort draw ranges of the batch's index buffer and merge those that touch or overlap
+ */
+void MyStaticBatch::MergeDrawRanges(std::vector<MyDrawRange> & drawRanges) {
+
+    drawsBefore = (int) drawRanges.size();
+    if (drawRanges.size() > 1) {
+        std::sort(drawRanges.begin(), drawRanges.end(), CompareFirstIndex);
+        size_t merged = 0;
+        for (size_t i = 1; i < drawRanges.size(); i++) {
+            MyDrawRange & last = drawRanges[merged];
+            uint32_t lastEnd = last.firstIndex + last.indexCount;
+            if (drawRanges[i].firstIndex <= lastEnd) {
+                last.indexCount = std::max(lastEnd, drawRanges[i].firstIndex +
+                                                    drawRanges[i].indexCount) - last.firstIndex;
+            } else {
+                drawRanges[++merged] = drawRanges[i];
+            }
+        }
+        drawRanges.resize(merged + 1);
+    }
+    drawsAfter = (int) drawRanges.size();
+}
+
+StaticBatchStats MyStaticBatch::GetStats() const {
+
+    StaticBatchStats stats;
+    stats.meshCount = 0;
+    stats.bytesBefore = 0;
+    for (size_t i = 0; i < meshes.size(); i++) {
+        if (meshes[i].vertexCount == 0) {
+            continue;
+        }
+        stats.meshCount++;
+        stats.bytesBefore += meshes[i].vertexCount * 2 * sizeof(glm::vec3) +
+                             meshes[i].indexCount * sizeof(GLushort);
+    }
+    stats.buffersBefore = 3 * stats.meshCount;
+    stats.buffersAfter = 3;
+    stats.bytesAfter = gpuVertexCount * 2 * sizeof(glm::vec3) + gpuIndexCount * sizeof(GLushort);
+    stats.drawsBefore = drawsBefore;
+    stats.drawsAfter = drawsAfter;
+    return stats;
+}
@@ -0,0 +1,96 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#ifndef MY_STATIC_BATCH_H
+#define MY_STATIC_BATCH_H
+
+#include "myGLFunctions.h"
+#include "myGPUResources.h"
+#include "myMesh.h"
+#include "myMeshlet.h"
+#include "myRangeAllocator.h"
+#include "myTransform.h"
+
+// indices are GLushort so that GLES 2 devices without OES_element_index_uint can draw them
+#define STATIC_BATCH_MAX_VERTICES   65536
+#define STATIC_BATCH_MAX_INDICES    (1 << 20)
+#define STATIC_BATCH_NO_MESH        -1
+
+struct StaticBatchStats {
+    int     meshCount;
+    // as if every mesh had its own position, color and index buffers
+    int     buffersBefore, buffersAfter;
+    size_t  bytesBefore, bytesAfter;
+    // draw calls of the last MergeDrawRanges, before and after merging
+    int     drawsBefore, drawsAfter;
+};
+
+/**
+ * Where a mesh's vertices and the indices of each of its LODs live in the batch's buffers.
+ * Indices already include firstVertex, so LODs are drawn straight from the shared buffers.
+ * LODs finer than residentLOD were evicted and their lodFirstIndex is stale.
+ */
+struct MyBatchedMesh {
+    uint32_t    firstVertex, vertexCount;
+    uint32_t    firstIndex, indexCount;
+    std::vector<uint32_t> lodFirstIndex;
+    std::vector<uint32_t> lodIndexCount;
+    uint32_t    residentLOD;
+    std::vector<std::vector<GLushort> > evictedIndices; // copies of the evicted LODs
+};
+
+/**
+ * Packs static meshes that share the position + color vertex format into one set of
+ * vertex, color and index buffers, so that they are drawn without rebinding buffers and
+ * neighbouring ranges merge into a single draw call.
+ */
+class MyStaticBatch {
+public:
+    MyStaticBatch();
+    ~MyStaticBatch();
+    int     AddMesh(const MyMesh & mesh, const MyTransform & transform = MyTransform());
+    void    RemoveMesh(int meshID);
+    bool    SetResidentLOD(int meshID, int level);
+    const MyBatchedMesh & GetMesh(int meshID) const { return meshes[meshID]; }
+
+    // CreateGLBuffers once there is a GL context, RestoreGLBuffers after resources restored
+    // them in a new one, UpdateGLBuffers to upload meshes added since
+    void    CreateGLBuffers(MyGPUResources * resources);
+    void    RestoreGLBuffers();
+    void    UpdateGLBuffers();
+    void    MergeDrawRanges(std::vector<MyDrawRange> & drawRanges);
+
+    GLuint  GetVertexBuffer() const { return resources->GetName(vertexBuffer); }
+    GLuint  GetColorBuffer() const { return resources->GetName(colorBuffer); }
+    GLuint  GetIndexBuffer() const { return resources->GetName(indexBuffer); }
+    StaticBatchStats GetStats() const;
+
+private:
+    MyRangeAllocator    vertexAllocator, indexAllocator;
+    std::vector<MyBatchedMesh> meshes; // removed meshes keep their slot with no vertices
+
+    // copies of the buffers' contents, kept to upload changed ranges and to restore them
+    std::vector<glm::vec3>  positions, colors;
+    std::vector<GLushort>   indices;
+
+    MyGPUResources * resources;
+    GPUHandle   vertexBuffer, colorBuffer, indexBuffer;
+    uint32_t    gpuVertexCount, gpuIndexCount; // sizes of the GL buffers
+    uint32_t    dirtyVertexBegin, dirtyVertexEnd, dirtyIndexBegin, dirtyIndexEnd;
+    int         drawsBefore, drawsAfter;
+};
+
+#endif //MY_STATIC_BATCH_H
@@ -0,0 +1,232 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include "myStreamBuffer.h"
+#include "myLogger.h"
+
+MyStreamBuffer::MyStreamBuffer(GLenum target, GLsizeiptr size, GLsizeiptr alignment) {
+
+    this->target = target;
+    this->capacity = size;
+    this->alignment = alignment;
+    resources = NULL;
+    buffer = GPU_NULL_HANDLE;
+    useFences = false;
+    head = frameStart = 0;
+    inFlightBytes = frameBytes = 0;
+    mappedOffset = mappedSize = 0;
+    ResetStats();
+}
+
+MyStreamBuffer::~MyStreamBuffer() {
+
+    if (resources) {
+        resources->Destroy(buffer);
+    }
+}
+
+/**
+ * Create the GL buffer and pick the upload path, needs the GL context
+ */
+void MyStreamBuffer::CreateGLBuffer(MyGPUResources * resources) {
+
+    this->resources = resources;
+    useFences = IsGLES3Supported();
+    if (!useFences) {
+        staging.resize(capacity);
+    }
+
+    buffer = resources->CreateBuffer(target, GL_STREAM_DRAW, false);
+    resources->BufferData(buffer, capacity, NULL);
+    RestoreGLBuffer();
+    CheckGLError("MyStreamBuffer::CreateGLBuffer");
+}
+
+/**
+ * Start the ring over once resources restored the buffer in a new context, the fences
+ * died with the old one and are dropped without deleting them
+ */
+void MyStreamBuffer::RestoreGLBuffer() {
+
+    frames.clear();
+    head = frameStart = 0;
+    inFlightBytes = frameBytes = 0;
+}
+
+void MyStreamBuffer::ResetStats() {
+
+    stats.uploadedBytes = 0;
+    stats.fenceWaits = 0;
+    stats.orphans = 0;
+    stats.failedMaps = 0;
+}
+
+/**
+ * Let the driver give us fresh storage while the GPU keeps reading the old one. Earlier
+ * frames' draws have been issued and keep the old storage, the current frame's regions are
+ * carried over at the same offsets, so only GLES 2 may call this mid-frame.
+ */
+void MyStreamBuffer::Orphan() {
+
+    glBindBuffer(target, GetBuffer());
+    glBufferData(target, capacity, NULL, GL_STREAM_DRAW);
+    for (size_t i = 0; i < frames.size(); i++) {
+        glDeleteSync(frames[i].fence);
+    }
+    frames.clear();
+    stats.orphans++;
+    if (frameBytes == 0) {
+        head = frameStart = 0;
+        inFlightBytes = 0;
+        return;
+    }
+    inFlightBytes = frameBytes;
+    UploadFrameRegions();
+}
+
+/**
+ * Copy the current frame's regions from staging, they run from frameStart to head and
+ * may wrap around the end. Wrap waste is copied along, it is never read.
+ */
+void MyStreamBuffer::UploadFrameRegions() {
+
+    if (frameStart < head) {
+        glBufferSubData(target, frameStart, head - frameStart, &staging[frameStart]);
+        return;
+    }
+    if (frameStart < capacity) {
+        glBufferSubData(target, frameStart, capacity - frameStart, &staging[frameStart]);
+    }
+    if (head > 0) {
+        glBufferSubData(target, 0, head, &staging[0]);
+    }
+}
+
+/**
+ * Block until the oldest frames have been consumed and size bytes fit in front of head.
+ * Returns false if a fence wait failed or timed out.
+ */
+bool MyStreamBuffer::WaitForSpace(GLsizeiptr size) {
+
+    while (capacity - inFlightBytes < size && !frames.empty()) {
+        FrameRegion & oldest = frames.front();
+        GLenum result = glClientWaitSync(oldest.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if (result == GL_TIMEOUT_EXPIRED) {
+            stats.fenceWaits++;
+            result = glClientWaitSync(oldest.fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                                      STREAM_BUFFER_WAIT_TIMEOUT);
+        }
+        if (result == GL_WAIT_FAILED || result == GL_TIMEOUT_EXPIRED) {
+            MyLOGW("Stream buffer fence wait failed");
+            return false;
+        }
+        glDeleteSync(oldest.fence);
+        inFlightBytes -= oldest.size;
+        frames.pop_front();
+    }
+    return true;
+}
+
+/**
+ * Reserve size bytes for writing. Returns where to write them and, in offset, where they
+ * are in the GL buffer, or NULL if they cannot be had without losing regions handed out
+ * earlier this frame. The buffer stays bound to target until Unmap.
+ */
+void * MyStreamBuffer::Map(GLsizeiptr size, GLintptr & offset) {
+
+    GLsizeiptr alignedSize = (size + alignment - 1) / alignment * alignment;
+    if (alignedSize > capacity) {
+        MyLOGE("Stream buffer of %d bytes cannot hold %d", (int) capacity, (int) size);
+        return NULL;
+    }
+
+    // skip the tail of the buffer if the data does not fit there
+    bool wrap = head + alignedSize > capacity;
+    GLsizeiptr wasted = wrap ? capacity - head : 0;
+
+    if (capacity - inFlightBytes < wasted + alignedSize) {
+        bool spaceFreed;
+        if (capacity - frameBytes < wasted + alignedSize) {
+            // a single frame that fills the whole ring cannot wait for itself, between
+            // frames there is nothing to keep
+            spaceFreed = frameBytes == 0;
+        } else if (!useFences) {
+            // nothing tells when GLES 2 is done with earlier frames
+            spaceFreed = true;
+        } else {
+            spaceFreed = WaitForSpace(wasted + alignedSize) || frameBytes == 0;
+        }
+        if (!spaceFreed) {
+            MyLOGE("Stream buffer of %d bytes has no room for %d more this frame",
+                   (int) capacity, (int) size);
+            stats.failedMaps++;
+            return NULL;
+        }
+        if (capacity - inFlightBytes < wasted + alignedSize) {
+            Orphan();
+            wrap = head + alignedSize > capacity;
+            wasted = wrap ? capacity - head : 0;
+        }
+    }
+    if (wrap) {
+        head = 0;
+        inFlightBytes += wasted;
+        frameBytes += wasted;
+    }
+
+    mappedOffset = offset = head;
+    mappedSize = size;
+    head += alignedSize;
+    inFlightBytes += alignedSize;
+    frameBytes += alignedSize;
+    stats.uploadedBytes += size;
+
+    glBindBuffer(target, GetBuffer());
+    if (!useFences) {
+        return &staging[mappedOffset];
+    }
+    // the fences already guarantee the GPU is not reading this range
+    return glMapBufferRange(target, mappedOffset, size, GL_MAP_WRITE_BIT |
+                            GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+}
+
+void MyStreamBuffer::Unmap() {
+
+    if (useFences) {
+        glUnmapBuffer(target);
+    } else {
+        glBufferSubData(target, mappedOffset, mappedSize, &staging[mappedOffset]);
+    }
+    glBindBuffer(target, 0);
+}
+
+/**
+ * Fence the regions written this frame, call after the draws that read them
+ */
+void MyStreamBuffer::EndFrame() {
+
+    if (frameBytes == 0) {
+        return;
+    }
+    if (useFences) {
+        FrameRegion region;
+        region.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        region.size = frameBytes;
+        frames.push_back(region);
+    }
+    frameStart = head;
+    frameBytes = 0;
+}
@@ -0,0 +1,91 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#ifndef MY_STREAM_BUFFER_H
+#define MY_STREAM_BUFFER_H
+
+#include "myGLFunctions.h"
+#include "myGPUResources.h"
+#include <deque>
+#include <vector>
+
+// default offset alignment of allocations, enough for any vertex attribute
+#define STREAM_BUFFER_ALIGNMENT     16
+// how long to wait for the GPU before giving up on a fence, in nanoseconds
+#define STREAM_BUFFER_WAIT_TIMEOUT  100000000
+
+struct StreamBufferStats {
+    size_t  uploadedBytes;  // since the last ResetStats
+    int     fenceWaits;     // times the CPU caught up with the GPU and blocked
+    int     orphans;        // times the whole buffer was reallocated
+    int     failedMaps;     // the frame filled the ring, or the GPU did not catch up in time
+};
+
+/**
+ * Ring buffer for data that is rewritten every frame: dynamic meshes, particles, instances.
+ * On GLES 3 regions are mapped unsynchronized and a fence per frame tells when the GPU is
+ * done with them. GLES 2 has neither, so data is copied with glBufferSubData and the
+ * buffer is orphaned with glBufferData when the ring runs out.
+ *
+ * Regions handed out earlier in the frame may be bound for draws that are issued later,
+ * so orphaning must not lose them. GLES 2 copies them to the new storage from its staging
+ * copy. GLES 3 has no copy and only orphans between frames, a Map that would need it
+ * mid-frame fails instead, as does one that does not fit beside the frame's own regions.
+ */
+class MyStreamBuffer {
+public:
+    MyStreamBuffer(GLenum target, GLsizeiptr size, GLsizeiptr alignment = STREAM_BUFFER_ALIGNMENT);
+    ~MyStreamBuffer();
+    void    CreateGLBuffer(MyGPUResources * resources);
+    void    RestoreGLBuffer();
+    void *  Map(GLsizeiptr size, GLintptr & offset);
+    void    Unmap();
+    void    EndFrame();
+    GLuint  GetBuffer() const { return resources->GetName(buffer); }
+    const StreamBufferStats & GetStats() const { return stats; }
+    void    ResetStats();
+
+private:
+    void    Orphan();
+    void    UploadFrameRegions();
+    bool    WaitForSpace(GLsizeiptr size);
+
+    // bytes handed out in one frame and the fence that signals when the GPU has read them
+    struct FrameRegion {
+        GLsync      fence;
+        GLsizeiptr  size;
+    };
+
+    GLenum      target;
+    MyGPUResources * resources;
+    GPUHandle   buffer;
+    GLsizeiptr  capacity, alignment;
+    bool        useFences;
+
+    GLintptr    head;               // next free byte
+    GLintptr    frameStart;         // where the current frame's regions begin
+    GLsizeiptr  inFlightBytes;      // earlier frames' regions plus the current frame's
+    GLsizeiptr  frameBytes;         // bytes used by the current frame, including wrap waste
+    std::deque<FrameRegion> frames;
+
+    std::vector<char> staging;      // GLES 2 writes here before glBufferSubData
+    GLintptr    mappedOffset;
+    GLsizeiptr  mappedSize;
+
+    StreamBufferStats stats;
+};
+
+#endif //MY_STREAM_BUFFER_H
@@ -0,0 +1,974 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+
+#include "myTextureDecoder.h"
+#include <string.h>
+
+/*
+ * ETC1, ETC2 and EAC, see section C.1 of the Khronos Data Format Specification.
+ * Blocks are big-endian and index their 4x4 texels by column: texel x, y is bit x * 4 + y.
+ */
+
+// the small and large modifier of each table, applied as +small, +large, -small, -large
+static const int etcModifiers[8][2] = {
+        {2, 8}, {5, 17}, {9, 29}, {13, 42}, {18, 60}, {24, 80}, {33, 106}, {47, 183}
+};
+// distance between the paint colors of the T and H modes
+static const int etcDistances[8] = {3, 6, 11, 16, 23, 32, 41, 64};
+static const int eacModifiers[16][8] = {
+        {-3, -6, -9, -15, 2, 5, 8, 14}, {-3, -7, -10, -13, 2, 6, 9, 12},
+        {-2, -5, -8, -13, 1, 4, 7, 12}, {-2, -4, -6, -13, 1, 3, 5, 12},
+        {-3, -6, -8, -12, 2, 5, 7, 11}, {-3, -7, -9, -11, 2, 6, 8, 10},
+        {-4, -7, -8, -11, 3, 6, 7, 10}, {-3, -5, -8, -11, 2, 4, 7, 10},
+        {-2, -6, -8, -10, 1, 5, 7, 9},  {-2, -5, -8, -10, 1, 4, 7, 9},
+        {-2, -4, -8, -10, 1, 3, 7, 9},  {-2, -5, -7, -10, 1, 4, 6, 9},
+        {-3, -4, -7, -10, 2, 3, 6, 9},  {-1, -2, -3, -10, 0, 1, 2, 9},
+        {-4, -6, -8, -9, 3, 5, 7, 8},   {-3, -5, -7, -9, 2, 4, 6, 8}
+};
+
+static inline int Clamp(int value, int low, int high) {
+
+    return value < low ? low : value > high ? high : value;
+}
+
+static inline uint64_t ReadBigEndian64(const uint8_t * data) {
+
+    uint64_t value = 0;
+    for (int i = 0; i < 8; i++) {
+        value = (value << 8) | data[i];
+    }
+    return value;
+}
+
+static inline int Extend4(int value) { return (value << 4) | value; }
+static inline int Extend5(int value) { return (value << 3) | (value >> 2); }
+static inline int Extend6(int value) { return (value << 2) | (value >> 4); }
+static inline int Extend7(int value) { return (value << 1) | (value >> 6); }
+
+static inline void SetTexel(uint8_t * texel, int r, int g, int b, int a) {
+
+    texel[0] = (uint8_t) Clamp(r, 0, 255);
+    texel[1] = (uint8_t) Clamp(g, 0, 255);
+    texel[2] = (uint8_t) Clamp(b, 0, 255);
+    texel[3] = (uint8_t) a;
+}
+
+/**
+ * T and H modes pick each texel's color from four paint colors. With punchthrough alpha
+ * and the opaque bit clear, index 2 is transparent black.
+ */
+static void DecodePaintColors(uint32_t indices, const int paint[4][3], bool opaque,
+                              uint8_t * texels) {
+
+    for (int y = 0; y < 4; y++) {
+        for (int x = 0; x < 4; x++) {
+            int bit = x * 4 + y;
+            int index = ((indices >> (15 + bit)) & 2) | ((indices >> bit) & 1);
+            uint8_t * texel = texels + (y * 4 + x) * 4;
+            if (!opaque && index == 2) {
+                SetTexel(texel, 0, 0, 0, 0);
+            } else {
+                SetTexel(texel, paint[index][0], paint[index][1], paint[index][2], 255);
+            }
+        }
+    }
+}
+
+static void DecodeETC2TMode(uint32_t high, uint32_t indices, bool opaque, uint8_t * texels) {
+
+    int color1[3] = {Extend4((((high >> 27) & 3) << 2) | ((high >> 24) & 3)),
+                     Extend4((high >> 20) & 0xF), Extend4((high >> 16) & 0xF)};
+    int color2[3] = {Extend4((high >> 12) & 0xF), Extend4((high >> 8) & 0xF),
+                     Extend4((high >> 4) & 0xF)};
+    int distance = etcDistances[(((high >> 2) & 3) << 1) | (high & 1)];
+    int paint[4][3];
+    for (int c = 0; c < 3; c++) {
+        paint[0][c] = color1[c];
+        paint[1][c] = Clamp(color2[c] + distance, 0, 255);
+        paint[2][c] = color2[c];
+        paint[3][c] = Clamp(color2[c] - distance, 0, 255);
+    }
+    DecodePaintColors(indices, paint, opaque, texels);
+}
+
+static void DecodeETC2HMode(uint32_t high, uint32_t indices, bool opaque, uint8_t * texels) {
+
+    int color1[3] = {Extend4((high >> 27) & 0xF),
+                     Extend4((((high >> 24) & 7) << 1) | ((high >> 20) & 1)),
+                     Extend4((((high >> 19) & 1) << 3) | ((high >> 15) & 7))};
+    int color2[3] = {Extend4((high >> 11) & 0xF), Extend4((high >> 7) & 0xF),
+                     Extend4((high >> 3) & 0xF)};
+    // the lowest bit of the distance is in the order of the two colors
+    int value1 = (color1[0] << 16) | (color1[1] << 8) | color1[2];
+    int value2 = (color2[0] << 16) | (color2[1] << 8) | color2[2];
+    int distance = etcDistances[(((high >> 2) & 1) << 2) | ((high & 1) << 1) |
+                                (value1 >= value2 ? 1 : 0)];
+    int paint[4][3];
+    for (int c = 0; c < 3; c++) {
+        paint[0][c] = Clamp(color1[c] + distance, 0, 255);
+        paint[1][c] = Clamp(color1[c] - distance, 0, 255);
+        paint[2][c] = Clamp(color2[c] + distance, 0, 255);
+        paint[3][c] = Clamp(color2[c] - distance, 0, 255);
+    }
+    DecodePaintColors(indices, paint, opaque, texels);
+}
+
+/**
+ * Planar mode interpolates a color at the origin, at x = 4 and at y = 4. It is always
+ * opaque.
+ */
+static void DecodeETC2PlanarMode(uint32_t high, uint32_t low, uint8_t * texels) {
+
+    int origin[3] = {Extend6((high >> 25) & 0x3F),
+                     Extend7((((high >> 24) & 1) << 6) | ((high >> 17) & 0x3F)),
+                     Extend6((((high >> 16) & 1) << 5) | (((high >> 11) & 3) << 3) |
+                             ((high >> 7) & 7))};
+    int horizontal[3] = {Extend6((((high >> 2) & 0x1F) << 1) | (high & 1)),
+                         Extend7((low >> 25) & 0x7F), Extend6((low >> 19) & 0x3F)};
+    int vertical[3] = {Extend6((low >> 13) & 0x3F), Extend7((low >> 6) & 0x7F),
+                       Extend6(low & 0x3F)};
+    for (int y = 0; y < 4; y++) {
+        for (int x = 0; x < 4; x++) {
+            int color[3];
+            for (int c = 0; c < 3; c++) {
+                color[c] = (x * (horizontal[c] - origin[c]) + y * (vertical[c] - origin[c]) +
+                            4 * origin[c] + 2) >> 2;
+            }
+            SetTexel(texels + (y * 4 + x) * 4, color[0], color[1], color[2], 255);
+        }
+    }
+}
+
+/**
+ * ETC2 RGB, which ETC1 is a subset of. Differential colors that overflow select the T, H
+ * and planar modes, ETC1 decoders wrap them around instead. Punchthrough alpha turns the
+ * differential bit into an opaque bit and always uses differential colors.
+ */
+static void DecodeETCColor(const uint8_t * block, bool etc2, bool punchthrough,
+                           uint8_t * texels) {
+
+    uint64_t bits = ReadBigEndian64(block);
+    uint32_t high = (uint32_t) (bits >> 32);
+    uint32_t indices = (uint32_t) bits;
+    bool differential = (high & 2) != 0;
+    bool flip = (high & 1) != 0;
+    bool opaque = !punchthrough || differential;
+    if (punchthrough) {
+        differential = true;
+    }
+
+    int base[2][3];
+    if (differential) {
+        for (int c = 0; c < 3; c++) {
+            int value = (high >> (27 - 8 * c)) & 0x1F;
+            int delta = (int) ((high >> (24 - 8 * c)) & 7);
+            delta = (delta ^ 4) - 4;
+            if (etc2 && (value + delta < 0 || value + delta > 31)) {
+                if (c == 0) {
+                    DecodeETC2TMode(high, indices, opaque, texels);
+                } else if (c == 1) {
+                    DecodeETC2HMode(high, indices, opaque, texels);
+                } else {
+                    DecodeETC2PlanarMode(high, indices, texels);
+                }
+                return;
+            }
+            base[0][c] = Extend5(value);
+            base[1][c] = Extend5((value + delta) & 0x1F);
+        }
+    } else {
+        for (int c = 0; c < 3; c++) {
+            base[0][c] = Extend4((high >> (28 - 8 * c)) & 0xF);
+            base[1][c] = Extend4((high >> (24 - 8 * c)) & 0xF);
+        }
+    }
+
+    int tables[2] = {(int) ((high >> 5) & 7), (int) ((high >> 2) & 7)};
+    for (int y = 0; y < 4; y++) {
+        for (int x = 0; x < 4; x++) {
+            int bit = x * 4 + y;
+            int index = ((indices >> (15 + bit)) & 2) | ((indices >> bit) & 1);
+            int subblock = flip ? y >> 1 : x >> 1;
+            uint8_t * texel = texels + (y * 4 + x) * 4;
+            if (!opaque && index == 2) {
+                SetTexel(texel, 0, 0, 0, 0);
+                continue;
+            }
+            // without the opaque bit the small modifiers are 0
+            int modifier = !opaque && !(index & 1) ? 0 : etcModifiers[tables[subblock]][index & 1];
+            if (index & 2) {
+                modifier = -modifier;
+            }
+            const int * color = base[subblock];
+            SetTexel(texel, color[0] + modifier, color[1] + modifier, color[2] + modifier, 255);
+        }
+    }
+}
+
+/**
+ * EAC into one channel of the texels: the 8-bit alpha of ETC2 RGBA, or the 11-bit R or G
+ * channels rounded to 8 bits
+ */
+static void DecodeEAC(const uint8_t * block, bool elevenBits, int channel, uint8_t * texels) {
+
+    uint64_t bits = ReadBigEndian64(block);
+    int base = (int) (bits >> 56);
+    int multiplier = (int) ((bits >> 52) & 0xF);
+    const int * modifiers = eacModifiers[(bits >> 48) & 0xF];
+    for (int y = 0; y < 4; y++) {
+        for (int x = 0; x < 4; x++) {
+            int modifier = modifiers[(bits >> (45 - 3 * (x * 4 + y))) & 7];
+            int value;
+            if (elevenBits) {
+                value = base * 8 + 4 + (multiplier ? modifier * multiplier * 8 : modifier);
+                value = (Clamp(value, 0, 2047) * 255 + 1023) / 2047;
+            } else {
+                value = Clamp(base + modifier * multiplier, 0, 255);
+            }
+            texels[(y * 4 + x) * 4 + channel] = (uint8_t) value;
+        }
+    }
+}
+
+/*
+ * ASTC LDR, see section C.2 of the Khronos Data Format Specification. Blocks are
+ * little-endian 128-bit values with the color endpoints from the bottom and the weights
+ * from the top, bit-reversed.
+ */
+
+#define ASTC_MAX_WEIGHTS        64
+#define ASTC_MIN_WEIGHT_BITS    24
+#define ASTC_MAX_WEIGHT_BITS    96
+#define ASTC_MAX_COLOR_VALUES   18
+// quantization levels of the integer sequence encoding, from 2 to 256 values
+#define ASTC_QUANT_6            4
+#define ASTC_QUANT_256          20
+
+struct ASTCBits {
+    uint64_t low, high;
+};
+
+// bits, trits and quints of each quantization level
+static const uint8_t iseRanges[ASTC_QUANT_256 + 1][3] = {
+        {1, 0, 0}, {0, 1, 0}, {2, 0, 0}, {0, 0, 1}, {1, 1, 0}, {3, 0, 0}, {1, 0, 1},
+        {2, 1, 0}, {4, 0, 0}, {2, 0, 1}, {3, 1, 0}, {5, 0, 0}, {3, 0, 1}, {4, 1, 0},
+        {6, 0, 0}, {4, 0, 1}, {5, 1, 0}, {7, 0, 0}, {5, 0, 1}, {6, 1, 0}, {8, 0, 0}
+};
+
+static inline uint32_t GetBits(const ASTCBits & bits, int offset, int count) {
+
+    if (count == 0 || offset >= 128) {
+        return 0;
+    }
+    uint64_t value;
+    if (offset >= 64) {
+        value = bits.high >> (offset - 64);
+    } else if (offset == 0) {
+        value = bits.low;
+    } else {
+        value = (bits.low >> offset) | (bits.high << (64 - offset));
+    }
+    return (uint32_t) (value & ((1ull << count) - 1));
+}
+
+/**
+ * The count bits at offset moved to the bottom, with zeros above them
+ */
+static ASTCBits ExtractBits(const ASTCBits & bits, int offset, int count) {
+
+    ASTCBits result = {0, 0};
+    if (offset == 0) {
+        result = bits;
+    } else if (offset >= 64) {
+        result.low = bits.high >> (offset - 64);
+    } else {
+        result.low = (bits.low >> offset) | (bits.high << (64 - offset));
+        result.high = bits.high >> offset;
+    }
+    if (count < 64) {
+        result.low &= (1ull << count) - 1;
+        result.high = 0;
+    } else if (count < 128) {
+        result.high &= (1ull << (count - 64)) - 1;
+    }
+    return result;
+}
+
+static uint64_t ReverseBits(uint64_t value) {
+
+    value = ((value >> 1) & 0x5555555555555555ull) | ((value & 0x5555555555555555ull) << 1);
+    value = ((value >> 2) & 0x3333333333333333ull) | ((value & 0x3333333333333333ull) << 2);
+    value = ((value >> 4) & 0x0F0F0F0F0F0F0F0Full) | ((value & 0x0F0F0F0F0F0F0F0Full) << 4);
+    value = ((value >> 8) & 0x00FF00FF00FF00FFull) | ((value & 0x00FF00FF00FF00FFull) << 8);
+    value = ((value >> 16) & 0x0000FFFF0000FFFFull) | ((value & 0x0000FFFF0000FFFFull) << 16);
+    return (value >> 32) | (value << 32);
+}
+
+static int GetISEBitCount(int count, int quant) {
+
+    const uint8_t * range = iseRanges[quant];
+    return count * range[0] + (range[1] ? (8 * count + 4) / 5 : 0) +
+           (range[2] ? (7 * count + 2) / 3 : 0);
+}
+
+/**
+ * Decode count values of the integer sequence at the bottom of bits. A trit packs 5 values'
+ * top digits into 8 bits and a quint 3 values' into 7, interleaved with the low bits.
+ */
+static void DecodeISE(const ASTCBits & bits, int count, int quant, int * values) {
+
+    int bitCount = iseRanges[quant][0];
+    int offset = 0;
+    if (iseRanges[quant][1]) {
+        static const int tritBits[5] = {2, 2, 1, 2, 1};
+        for (int i = 0; i < count; i += 5) {
+            int low[5];
+            int packed = 0, packedBits = 0;
+            for (int j = 0; j < 5; j++) {
+                low[j] = GetBits(bits, offset, bitCount);
+                offset += bitCount;
+                packed |= GetBits(bits, offset, tritBits[j]) << packedBits;
+                offset += tritBits[j];
+                packedBits += tritBits[j];
+            }
+            int trits[5], c;
+            if (((packed >> 2) & 7) == 7) {
+                c = (((packed >> 5) & 7) << 2) | (packed & 3);
+                trits[4] = trits[3] = 2;
+            } else {
+                c = packed & 0x1F;
+                if (((packed >> 5) & 3) == 3) {
+                    trits[4] = 2;
+                    trits[3] = (packed >> 7) & 1;
+                } else {
+                    trits[4] = (packed >> 7) & 1;
+                    trits[3] = (packed >> 5) & 3;
+                }
+            }
+            if ((c & 3) == 3) {
+                trits[2] = 2;
+                trits[1] = (c >> 4) & 1;
+                trits[0] = (((c >> 3) & 1) << 1) | (((c >> 2) & 1) & ~((c >> 3) & 1));
+            } else if (((c >> 2) & 3) == 3) {
+                trits[2] = 2;
+                trits[1] = 2;
+                trits[0] = c & 3;
+            } else {
+                trits[2] = (c >> 4) & 1;
+                trits[1] = (c >> 2) & 3;
+                trits[0] = (((c >> 1) & 1) << 1) | ((c & 1) & ~((c >> 1) & 1));
+            }
+            for (int j = 0; j < 5 && i + j < count; j++) {
+                values[i + j] = (trits[j] << bitCount) | low[j];
+            }
+        }
+    } else if (iseRanges[quant][2]) {
+        static const int quintBits[3] = {3, 2, 2};
+        for (int i = 0; i < count; i += 3) {
+            int low[3];
+            int packed = 0, packedBits = 0;
+            for (int j = 0; j < 3; j++) {
+                low[j] = GetBits(bits, offset, bitCount);
+                offset += bitCount;
+                packed |= GetBits(bits, offset, quintBits[j]) << packedBits;
+                offset += quintBits[j];
+                packedBits += quintBits[j];
+            }
+            int quints[3];
+            if (((packed >> 1) & 3) == 3 && ((packed >> 5) & 3) == 0) {
+                int q0 = packed & 1;
+                quints[2] = (q0 << 2) | ((((packed >> 4) & 1) & ~q0) << 1) |
+                            (((packed >> 3) & 1) & ~q0);
+                quints[1] = quints[0] = 4;
+            } else {
+                int c;
+                if (((packed >> 1) & 3) == 3) {
+                    quints[2] = 4;
+                    c = (((packed >> 3) & 3) << 3) | ((~(packed >> 5) & 3) << 1) | (packed & 1);
+                } else {
+                    quints[2] = (packed >> 5) & 3;
+                    c = packed & 0x1F;
+                }
+                if ((c & 7) == 5) {
+                    quints[1] = 4;
+                    quints[0] = (c >> 3) & 3;
+                } else {
+                    quints[1] = (c >> 3) & 3;
+                    quints[0] = c & 7;
+                }
+            }
+            for (int j = 0; j < 3 && i + j < count; j++) {
+                values[i + j] = (quints[j] << bitCount) | low[j];
+            }
+        }
+    } else {
+        for (int i = 0; i < count; i++) {
+            values[i] = GetBits(bits, offset, bitCount);
+            offset += bitCount;
+        }
+    }
+}
+
+// repeat the bits of value, bitCount wide, until they fill targetBits
+static int ReplicateBits(int value, int bitCount, int targetBits) {
+
+    int result = 0;
+    for (int shift = targetBits - bitCount; shift > -bitCount; shift -= bitCount) {
+        result |= shift >= 0 ? value << shift : value >> -shift;
+    }
+    return result;
+}
+
+/**
+ * Scale a value of the integer sequence to 0..255. Trit and quint values mix their digit in
+ * with a multiplier C and a bit pattern B made of the low bits.
+ */
+static int UnquantizeColor(int value, int quant) {
+
+    int bitCount = iseRanges[quant][0];
+    if (!iseRanges[quant][1] && !iseRanges[quant][2]) {
+        return ReplicateBits(value, bitCount, 8);
+    }
+    int digit = value >> bitCount;
+    int a = (value & 1) ? 0x1FF : 0;
+    int b = (value >> 1) & 1, c = (value >> 2) & 1, d = (value >> 3) & 1;
+    int e = (value >> 4) & 1, f = (value >> 5) & 1;
+    int pattern = 0, multiplier = 0;
+    if (iseRanges[quant][1]) {
+        switch (bitCount) {
+            case 1: multiplier = 204; break;
+            case 2: pattern = (b << 8) | (b << 4) | (b << 2) | (b << 1); multiplier = 93; break;
+            case 3: pattern = (c << 8) | (b << 7) | (c << 3) | (b << 2) | (c << 1) | b;
+                multiplier = 44; break;
+            case 4: pattern = (d << 8) | (c << 7) | (b << 6) | (d << 2) | (c << 1) | b;
+                multiplier = 22; break;
+            case 5: pattern = (e << 8) | (d << 7) | (c << 6) | (b << 5) | (e << 1) | d;
+                multiplier = 11; break;
+            case 6: pattern = (f << 8) | (e << 7) | (d << 6) | (c << 5) | (b << 4) | f;
+                multiplier = 5; break;
+        }
+    } else {
+        switch (bitCount) {
+            case 1: multiplier = 113; break;
+            case 2: pattern = (b << 8) | (b << 3) | (b << 2); multiplier = 54; break;
+            case 3: pattern = (c << 8) | (b << 7) | (c << 2) | (b << 1) | c; multiplier = 26;
+                break;
+            case 4: pattern = (d << 8) | (c << 7) | (b << 6) | (d << 1) | c; multiplier = 13;
+                break;
+            case 5: pattern = (e << 8) | (d << 7) | (c << 6) | (b << 5) | e; multiplier = 6;
+                break;
+        }
+    }
+    int result = (digit * multiplier + pattern) ^ a;
+    return (a & 0x80) | (result >> 2);
+}
+
+/**
+ * Scale a weight to 0..64, the same way as colors but with 7-bit patterns
+ */
+static int UnquantizeWeight(int value, int quant) {
+
+    int bitCount = iseRanges[quant][0];
+    int result;
+    if (!iseRanges[quant][1] && !iseRanges[quant][2]) {
+        result = ReplicateBits(value, bitCount, 6);
+    } else if (bitCount == 0) {
+        return value * (iseRanges[quant][1] ? 32 : 16);
+    } else {
+        int digit = value >> bitCount;
+        int a = (value & 1) ? 0x7F : 0;
+        int b = (value >> 1) & 1, c = (value >> 2) & 1;
+        int pattern = 0, multiplier;
+        if (iseRanges[quant][1]) {
+            multiplier = bitCount == 1 ? 50 : bitCount == 2 ? 23 : 11;
+            if (bitCount == 2) {
+                pattern = (b << 6) | (b << 2) | b;
+            } else if (bitCount == 3) {
+                pattern = (c << 6) | (b << 5) | (c << 1) | b;
+            }
+        } else {
+            multiplier = bitCount == 1 ? 28 : 13;
+            if (bitCount == 2) {
+                pattern = (b << 6) | (b << 1);
+            }
+        }
+        result = (digit * multiplier + pattern) ^ a;
+        result = (a & 0x20) | (result >> 2);
+    }
+    return result > 32 ? result + 1 : result;
+}
+
+/**
+ * Size of the weight grid, dual plane and weight quantization from the 11-bit block mode.
+ * Returns false for reserved modes and grids the block cannot hold.
+ */
+static bool DecodeBlockMode(int mode, int & gridWidth, int & gridHeight, bool & dualPlane,
+                            int & quant, int & weightBits) {
+
+    int range = (mode >> 4) & 1;
+    int precision = (mode >> 9) & 1;
+    int dual = (mode >> 10) & 1;
+    int a = (mode >> 5) & 3;
+    if (mode & 3) {
+        range |= (mode & 3) << 1;
+        int b = (mode >> 7) & 3;
+        switch ((mode >> 2) & 3) {
+            case 0: gridWidth = b + 4; gridHeight = a + 2; break;
+            case 1: gridWidth = b + 8; gridHeight = a + 2; break;
+            case 2: gridWidth = a + 2; gridHeight = b + 8; break;
+            default:
+                b &= 1;
+                if (mode & 0x100) {
+                    gridWidth = b + 2;
+                    gridHeight = a + 2;
+                } else {
+                    gridWidth = a + 2;
+                    gridHeight = b + 6;
+                }
+                break;
+        }
+    } else {
+        range |= ((mode >> 2) & 3) << 1;
+        if (((mode >> 2) & 3) == 0) {
+            return false;
+        }
+        int b = (mode >> 9) & 3;
+        switch ((mode >> 7) & 3) {
+            case 0: gridWidth = 12; gridHeight = a + 2; break;
+            case 1: gridWidth = a + 2; gridHeight = 12; break;
+            case 2:
+                gridWidth = a + 6;
+                gridHeight = b + 6;
+                dual = precision = 0;
+                break;
+            default:
+                if (a == 0) {
+                    gridWidth = 6;
+                    gridHeight = 10;
+                } else if (a == 1) {
+                    gridWidth = 10;
+                    gridHeight = 6;
+                } else {
+                    return false;
+                }
+                break;
+        }
+    }
+    dualPlane = dual != 0;
+    quant = range - 2 + 6 * precision;
+    int weightCount = gridWidth * gridHeight * (dual + 1);
+    weightBits = GetISEBitCount(weightCount, quant);
+    return weightCount <= ASTC_MAX_WEIGHTS && weightBits >= ASTC_MIN_WEIGHT_BITS &&
+           weightBits <= ASTC_MAX_WEIGHT_BITS;
+}
+
+static uint32_t HashPartitionSeed(uint32_t seed) {
+
+    seed ^= seed >> 15;
+    seed *= 0xEEDE0891;
+    seed ^= seed >> 5;
+    seed += seed << 16;
+    seed ^= seed >> 7;
+    seed ^= seed >> 3;
+    seed ^= seed << 6;
+    seed ^= seed >> 17;
+    return seed;
+}
+
+/**
+ * Partition of a texel: the pattern is a hash of the seed in the block, evaluated as four
+ * sawtooth functions of the position whose largest wins
+ */
+static int SelectPartition(int seed, int x, int y, int partitionCount, bool smallBlock) {
+
+    if (smallBlock) {
+        x <<= 1;
+        y <<= 1;
+    }
+    seed += (partitionCount - 1) * 1024;
+    uint32_t random = HashPartitionSeed((uint32_t) seed);
+    int seeds[8];
+    for (int i = 0; i < 8; i++) {
+        seeds[i] = (random >> (4 * i)) & 0xF;
+        seeds[i] *= seeds[i];
+    }
+    int shift1, shift2;
+    if (seed & 1) {
+        shift1 = (seed & 2) ? 4 : 5;
+        shift2 = partitionCount == 3 ? 6 : 5;
+    } else {
+        shift1 = partitionCount == 3 ? 6 : 5;
+        shift2 = (seed & 2) ? 4 : 5;
+    }
+    // the z terms of 3D textures are left out
+    int a = (((seeds[0] >> shift1) * x + (seeds[1] >> shift2) * y) + (random >> 14)) & 0x3F;
+    int b = (((seeds[2] >> shift1) * x + (seeds[3] >> shift2) * y) + (random >> 10)) & 0x3F;
+    int c = (((seeds[4] >> shift1) * x + (seeds[5] >> shift2) * y) + (random >> 6)) & 0x3F;
+    int d = (((seeds[6] >> shift1) * x + (seeds[7] >> shift2) * y) + (random >> 2)) & 0x3F;
+    if (partitionCount < 4) {
+        d = 0;
+    }
+    if (partitionCount < 3) {
+        c = 0;
+    }
+    if (a >= b && a >= c && a >= d) {
+        return 0;
+    } else if (b >= c && b >= d) {
+        return 1;
+    }
+    return c >= d ? 2 : 3;
+}
+
+// move the top bit of b into a's place and make a signed 6-bit offset
+static inline void TransferBit(int & a, int & b) {
+
+    b >>= 1;
+    b |= a & 0x80;
+    a >>= 1;
+    a &= 0x3F;
+    if (a & 0x20) {
+        a -= 0x40;
+    }
+}
+
+static inline void SetEndpoint(int * endpoint, int r, int g, int b, int a) {
+
+    endpoint[0] = Clamp(r, 0, 255);
+    endpoint[1] = Clamp(g, 0, 255);
+    endpoint[2] = Clamp(b, 0, 255);
+    endpoint[3] = Clamp(a, 0, 255);
+}
+
+// pull red and green toward blue, which endpoints in reverse order are stored with
+static inline void SetBlueContracted(int * endpoint, int r, int g, int b, int a) {
+
+    SetEndpoint(endpoint, (r + b) >> 1, (g + b) >> 1, b, a);
+}
+
+/**
+ * The two endpoint colors of a color endpoint mode, false for HDR modes
+ */
+static bool DecodeEndpoints(int mode, int * v, int * endpoint0, int * endpoint1) {
+
+    switch (mode) {
+        case 0:
+            SetEndpoint(endpoint0, v[0], v[0], v[0], 255);
+            SetEndpoint(endpoint1, v[1], v[1], v[1], 255);
+            return true;
+        case 1: {
+            int low = (v[0] >> 2) | (v[1] & 0xC0);
+            int high = low + (v[1] & 0x3F);
+            SetEndpoint(endpoint0, low, low, low, 255);
+            SetEndpoint(endpoint1, high, high, high, 255);
+            return true;
+        }
+        case 4:
+            SetEndpoint(endpoint0, v[0], v[0], v[0], v[2]);
+            SetEndpoint(endpoint1, v[1], v[1], v[1], v[3]);
+            return true;
+        case 5:
+            TransferBit(v[1], v[0]);
+            TransferBit(v[3], v[2]);
+            SetEndpoint(endpoint0, v[0], v[0], v[0], v[2]);
+            SetEndpoint(endpoint1, v[0] + v[1], v[0] + v[1], v[0] + v[1], v[2] + v[3]);
+            return true;
+        case 6:
+            SetEndpoint(endpoint0, (v[0] * v[3]) >> 8, (v[1] * v[3]) >> 8, (v[2] * v[3]) >> 8,
+                        255);
+            SetEndpoint(endpoint1, v[0], v[1], v[2], 255);
+            return true;
+        case 8:
+        case 12: {
+            int alpha0 = mode == 12 ? v[6] : 255, alpha1 = mode == 12 ? v[7] : 255;
+            if (v[1] + v[3] + v[5] >= v[0] + v[2] + v[4]) {
+                SetEndpoint(endpoint0, v[0], v[2], v[4], alpha0);
+                SetEndpoint(endpoint1, v[1], v[3], v[5], alpha1);
+            } else {
+                SetBlueContracted(endpoint0, v[1], v[3], v[5], alpha1);
+                SetBlueContracted(endpoint1, v[0], v[2], v[4], alpha0);
+            }
+            return true;
+        }
+        case 9:
+        case 13: {
+            TransferBit(v[1], v[0]);
+            TransferBit(v[3], v[2]);
+            TransferBit(v[5], v[4]);
+            int alpha0 = 255, alpha1 = 255;
+            if (mode == 13) {
+                TransferBit(v[7], v[6]);
+                alpha0 = v[6];
+                alpha1 = v[6] + v[7];
+            }
+            if (v[1] + v[3] + v[5] >= 0) {
+                SetEndpoint(endpoint0, v[0], v[2], v[4], alpha0);
+                SetEndpoint(endpoint1, v[0] + v[1], v[2] + v[3], v[4] + v[5], alpha1);
+            } else {
+                SetBlueContracted(endpoint0, v[0] + v[1], v[2] + v[3], v[4] + v[5], alpha1);
+                SetBlueContracted(endpoint1, v[0], v[2], v[4], alpha0);
+            }
+            return true;
+        }
+        case 10:
+            SetEndpoint(endpoint0, (v[0] * v[3]) >> 8, (v[1] * v[3]) >> 8, (v[2] * v[3]) >> 8,
+                        v[4]);
+            SetEndpoint(endpoint1, v[0], v[1], v[2], v[5]);
+            return true;
+        default:
+            return false;
+    }
+}
+
+static void FillErrorColor(int texelCount, uint8_t * texels) {
+
+    for (int i = 0; i < texelCount; i++) {
+        SetTexel(texels + i * 4, 255, 0, 255, 255);
+    }
+}
+
+/**
+ * A void-extent block has one color for all its texels, 16 bits per channel
+ */
+static void DecodeASTCVoidExtent(const ASTCBits & bits, int texelCount, uint8_t * texels) {
+
+    bool hdr = GetBits(bits, 9, 1) != 0;
+    bool reserved = GetBits(bits, 10, 2) == 3;
+    int lowS = GetBits(bits, 12, 13), highS = GetBits(bits, 25, 13);
+    int lowT = GetBits(bits, 38, 13), highT = GetBits(bits, 51, 13);
+    bool noExtent = lowS == 0x1FFF && highS == 0x1FFF && lowT == 0x1FFF && highT == 0x1FFF;
+    if (hdr || !reserved || (!noExtent && (lowS >= highS || lowT >= highT))) {
+        FillErrorColor(texelCount, texels);
+        return;
+    }
+    for (int i = 0; i < texelCount; i++) {
+        for (int c = 0; c < 4; c++) {
+            texels[i * 4 + c] = (uint8_t) (GetBits(bits, 64 + 16 * c, 16) >> 8);
+        }
+    }
+}
+
+static void DecodeASTCBlock(const uint8_t * block, int blockWidth, int blockHeight, bool srgb,
+                            uint8_t * texels) {
+
+    ASTCBits bits;
+    memcpy(&bits.low, block, 8);
+    memcpy(&bits.high, block + 8, 8);
+    int texelCount = blockWidth * blockHeight;
+
+    int blockMode = GetBits(bits, 0, 11);
+    if ((blockMode & 0x1FF) == 0x1FC) {
+        DecodeASTCVoidExtent(bits, texelCount, texels);
+        return;
+    }
+    int gridWidth, gridHeight, weightQuant, weightBits;
+    bool dualPlane;
+    int partitionCount = GetBits(bits, 11, 2) + 1;
+    if (!DecodeBlockMode(blockMode, gridWidth, gridHeight, dualPlane, weightQuant, weightBits) ||
+        gridWidth > blockWidth || gridHeight > blockHeight ||
+        (dualPlane && partitionCount == 4)) {
+        FillErrorColor(texelCount, texels);
+        return;
+    }
+
+    // endpoint modes that do not fit in the 4 or 6 bits after the partitions continue
+    // below the weights, and the plane of a dual-plane block is below those
+    int belowWeights = 128 - weightBits;
+    int endpointModes[4];
+    int colorStart;
+    if (partitionCount == 1) {
+        endpointModes[0] = GetBits(bits, 13, 4);
+        colorStart = 17;
+    } else {
+        colorStart = 29;
+        int encoded = GetBits(bits, 23, 6);
+        if ((encoded & 3) == 0) {
+            for (int i = 0; i < partitionCount; i++) {
+                endpointModes[i] = encoded >> 2;
+            }
+        } else {
+            int extraBits = 3 * partitionCount - 4;
+            belowWeights -= extraBits;
+            encoded |= GetBits(bits, belowWeights, extraBits) << 6;
+            int baseClass = (encoded & 3) - 1;
+            for (int i = 0; i < partitionCount; i++) {
+                endpointModes[i] = (((encoded >> (2 + i)) & 1) + baseClass) << 2;
+                endpointModes[i] |= (encoded >> (2 + partitionCount + 2 * i)) & 3;
+            }
+        }
+    }
+    int dualPlaneChannel = -1;
+    if (dualPlane) {
+        belowWeights -= 2;
+        dualPlaneChannel = GetBits(bits, belowWeights, 2);
+    }
+
+    // colors get the finest quantization that fits in the bits left
+    int colorCount = 0;
+    for (int i = 0; i < partitionCount; i++) {
+        colorCount += ((endpointModes[i] >> 2) + 1) * 2;
+    }
+    int colorBits = belowWeights - colorStart;
+    int colorQuant = ASTC_QUANT_256;
+    while (colorQuant >= ASTC_QUANT_6 && GetISEBitCount(colorCount, colorQuant) > colorBits) {
+        colorQuant--;
+    }
+    if (colorCount > ASTC_MAX_COLOR_VALUES || colorQuant < ASTC_QUANT_6) {
+        FillErrorColor(texelCount, texels);
+        return;
+    }
+    int colors[ASTC_MAX_COLOR_VALUES];
+    DecodeISE(ExtractBits(bits, colorStart, GetISEBitCount(colorCount, colorQuant)),
+              colorCount, colorQuant, colors);
+    int endpoints[4][2][4];
+    for (int i = 0, color = 0; i < partitionCount; i++) {
+        int * values = colors + color;
+        color += ((endpointModes[i] >> 2) + 1) * 2;
+        for (int j = 0; values + j < colors + color; j++) {
+            values[j] = UnquantizeColor(values[j], colorQuant);
+        }
+        if (!DecodeEndpoints(endpointModes[i], values, endpoints[i][0], endpoints[i][1])) {
+            FillErrorColor(texelCount, texels);
+            return;
+        }
+    }
+
+    // weights read from the top down, with room for the infill to look one past the grid
+    ASTCBits reversed = {ReverseBits(bits.high), ReverseBits(bits.low)};
+    int planeCount = dualPlane ? 2 : 1;
+    int gridCount = gridWidth * gridHeight;
+    int weights[ASTC_MAX_WEIGHTS];
+    DecodeISE(ExtractBits(reversed, 0, weightBits), gridCount * planeCount, weightQuant, weights);
+    int gridWeights[2][ASTC_MAX_WEIGHTS + 16];
+    memset(gridWeights, 0, sizeof(gridWeights));
+    for (int i = 0; i < gridCount * planeCount; i++) {
+        gridWeights[i % planeCount][i / planeCount] = UnquantizeWeight(weights[i], weightQuant);
+    }
+
+    int seed = GetBits(bits, 13, 10);
+    bool smallBlock = texelCount < 31;
+    int scaleS = (1024 + blockWidth / 2) / (blockWidth - 1);
+    int scaleT = (1024 + blockHeight / 2) / (blockHeight - 1);
+    for (int t = 0; t < blockHeight; t++) {
+        for (int s = 0; s < blockWidth; s++) {
+            // bilinear infill of the weight grid, in 1/16ths
+            int gridS = (scaleS * s * (gridWidth - 1) + 32) >> 6;
+            int gridT = (scaleT * t * (gridHeight - 1) + 32) >> 6;
+            int fractionS = gridS & 0xF, fractionT = gridT & 0xF;
+            int index = (gridS >> 4) + (gridT >> 4) * gridWidth;
+            int factor11 = (fractionS * fractionT + 8) >> 4;
+            int factor10 = fractionT - factor11;
+            int factor01 = fractionS - factor11;
+            int factor00 = 16 - fractionS - fractionT + factor11;
+            int texelWeights[2];
+            for (int p = 0; p < planeCount; p++) {
+                const int * w = gridWeights[p] + index;
+                texelWeights[p] = (w[0] * factor00 + w[1] * factor01 + w[gridWidth] * factor10 +
+                                   w[gridWidth + 1] * factor11 + 8) >> 4;
+            }
+
+            int partition = partitionCount > 1 ?
+                            SelectPartition(seed, s, t, partitionCount, smallBlock) : 0;
+            uint8_t * texel = texels + (t * blockWidth + s) * 4;
+            for (int c = 0; c < 4; c++) {
+                int weight = texelWeights[c == dualPlaneChannel ? 1 : 0];
+                // expand to 16 bits, sRGB colors by appending 0x80 instead of repeating
+                int low = endpoints[partition][0][c], high = endpoints[partition][1][c];
+                if (srgb && c < 3) {
+                    low = (low << 8) | 0x80;
+                    high = (high << 8) | 0x80;
+                } else {
+                    low = (low << 8) | low;
+                    high = (high << 8) | high;
+                }
+                texel[c] = (uint8_t) (((low * (64 - weight) + high * weight + 32) >> 6) >> 8);
+            }
+        }
+    }
+}
+
+static void DecodeBlock(const TextureFormatInfo & format, const uint8_t * block,
+                        uint8_t * texels) {
+
+    switch (format.codec) {
+        case TEXTURE_CODEC_ETC1:
+            DecodeETCColor(block, false, false, texels);
+            break;
+        case TEXTURE_CODEC_ETC2_RGB:
+            DecodeETCColor(block, true, false, texels);
+            break;
+        case TEXTURE_CODEC_ETC2_RGB_A1:
+            DecodeETCColor(block, true, true, texels);
+            break;
+        case TEXTURE_CODEC_ETC2_RGBA:
+            DecodeETCColor(block + 8, true, false, texels);
+            DecodeEAC(block, false, 3, texels);
+            break;
+        case TEXTURE_CODEC_EAC_R11:
+        case TEXTURE_CODEC_EAC_RG11:
+            for (int i = 0; i < 16; i++) {
+                SetTexel(texels + i * 4, 0, 0, 0, 255);
+            }
+            DecodeEAC(block, true, 0, texels);
+            if (format.codec == TEXTURE_CODEC_EAC_RG11) {
+                DecodeEAC(block + 8, true, 1, texels);
+            }
+            break;
+        case TEXTURE_CODEC_ASTC:
+            DecodeASTCBlock(block, format.blockWidth, format.blockHeight, format.srgb, texels);
+            break;
+        default:
+            memcpy(texels, block, format.blockBytes);
+            break;
+    }
+}
+
+int GetBlockRowCount(const TextureFormatInfo & format, int height) {
+
+    return (height + format.blockHeight - 1) / format.blockHeight;
+}
+
+/**
+ * Decode block rows [firstRow, endRow) of a level into rgba, which holds the whole level
+ * with rows of width * 4 bytes. Blocks that stick out over the edges are clipped.
+ */
+void DecodeBlockRows(const TextureFormatInfo & format, const uint8_t * data, int width,
+                     int height, int firstRow, int endRow, uint8_t * rgba) {
+
+    int blocksX = (width + format.blockWidth - 1) / format.blockWidth;
+    size_t rowBytes = (size_t) width * 4;
+    if (format.codec == TEXTURE_CODEC_NONE) {
+        memcpy(rgba + firstRow * rowBytes, data + firstRow * rowBytes,
+               (endRow - firstRow) * rowBytes);
+        return;
+    }
+
+    uint8_t texels[DECODER_MAX_BLOCK_TEXELS * 4];
+    for (int row = firstRow; row < endRow; row++) {
+        const uint8_t * block = data + (size_t) row * blocksX * format.blockBytes;
+        int y = row * format.blockHeight;
+        int rows = height - y < format.blockHeight ? height - y : format.blockHeight;
+        for (int blockX = 0; blockX < blocksX; blockX++, block += format.blockBytes) {
+            DecodeBlock(format, block, texels);
+            int x = blockX * format.blockWidth;
+            int columns = width - x < format.blockWidth ? width - x : format.blockWidth;
+            for (int i = 0; i < rows; i++) {
+                memcpy(rgba + (y + i) * rowBytes + x * 4, texels + i * format.blockWidth * 4,
+                       columns * 4);
+            }
+        }
+    }
+}
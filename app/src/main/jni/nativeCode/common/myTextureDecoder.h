@@ -0,0 +1,37 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+
+#ifndef MY_TEXTURE_DECODER_H
+#define MY_TEXTURE_DECODER_H
+
+#include "myKTX.h"
+
+// texels of a block that the decoders write at once, ASTC's largest is 12x12
+#define DECODER_MAX_BLOCK_TEXELS    144
+
+/**
+ * CPU fallback for compressed formats the GPU cannot sample: ETC1, ETC2, EAC and ASTC LDR
+ * are decoded to RGBA8. sRGB formats keep their sRGB values. R11 and RG11 lose their low
+ * 3 bits and ASTC HDR blocks decode to magenta, the error color of the LDR profile.
+ *
+ * A level is decoded in rows of blocks so that it can be split over jobs.
+ */
+int     GetBlockRowCount(const TextureFormatInfo & format, int height);
+void    DecodeBlockRows(const TextureFormatInfo & format, const uint8_t * data, int width,
+                        int height, int firstRow, int endRow, uint8_t * rgba);
+
+#endif //MY_TEXTURE_DECODER_H
@@ -0,0 +1,557 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+
+#include "myTextureManager.h"
+#include "myTextureDecoder.h"
+#include "myJNIHelper.h"
+#include "myLogger.h"
+#include "misc.h"
+#include <string.h>
+
+MyTextureManager::MyTextureManager(MyJobSystem * jobSystem, MyResidencyManager * residency) {
+
+    this->jobSystem = jobSystem;
+    this->residency = residency;
+    etc1Supported = etc2Supported = astcSupported = false;
+    uploadedBytes = 0;
+}
+
+MyTextureManager::~MyTextureManager() {
+
+    for (unsigned int i = 0; i < textures.size(); i++) {
+        Texture & texture = textures[i];
+        for (unsigned int level = 0; level < texture.decodeJobs.size(); level++) {
+            DecodeJob * job = texture.decodeJobs[level];
+            if (job->submitted) {
+                jobSystem->Wait(job->counter);
+            }
+            delete job->counter;
+            delete job;
+        }
+        ReleaseStorage(texture.storage);
+        ReleaseStorage(texture.nextStorage);
+        if (texture.asset) {
+            gHelperObject->CloseAsset(texture.asset);
+        }
+    }
+}
+
+/**
+ * Query which compressed formats the GPU samples, needs the GL context
+ */
+void MyTextureManager::Init() {
+
+    const char * extensions = (const char *) glGetString(GL_EXTENSIONS);
+    // ETC2 decoders read ETC1 blocks too
+    etc2Supported = IsGLES3Supported();
+    etc1Supported = etc2Supported ||
+            (extensions && strstr(extensions, "GL_OES_compressed_ETC1_RGB8_texture"));
+    astcSupported = extensions && strstr(extensions, "GL_KHR_texture_compression_astc_ldr");
+    MyLOGI("Texture formats: ETC1 %s, ETC2 %s, ASTC %s, others are decoded on the CPU",
+           etc1Supported ? "yes" : "no", etc2Supported ? "yes" : "no",
+           astcSupported ? "yes" : "no");
+}
+
+bool MyTextureManager::IsFormatSupported(const TextureFormatInfo & format) const {
+
+    switch (format.codec) {
+        case TEXTURE_CODEC_NONE:
+            return true;
+        case TEXTURE_CODEC_ETC1:
+            return etc1Supported;
+        case TEXTURE_CODEC_ASTC:
+            return astcSupported;
+        default:
+            return etc2Supported;
+    }
+}
+
+/**
+ * Map a KTX file from assets and start streaming it, returns its index or -1 if it could
+ * not be loaded
+ */
+int MyTextureManager::LoadAsset(const std::string & assetName) {
+
+    const uint8_t * data;
+    size_t size;
+    // textures are stored uncompressed in the asset pack, mapped with it for good
+    data = gHelperObject->FindPackedAsset(assetName.c_str(), &size);
+    if (data) {
+        return LoadFromMemory(assetName, data, size);
+    }
+    AAsset * asset = gHelperObject->OpenAssetBuffer(assetName.c_str(), &data, &size);
+    if (!asset) {
+        return -1;
+    }
+    int textureIndex = LoadFromMemory(assetName, data, size);
+    if (textureIndex < 0) {
+        gHelperObject->CloseAsset(asset);
+        return -1;
+    }
+    textures[textureIndex].asset = asset;
+    return textureIndex;
+}
+
+/**
+ * Load a KTX file that is already in memory, which has to stay there until the manager is
+ * deleted since levels are uploaded from it and uploaded again after a lost context
+ */
+int MyTextureManager::LoadFromMemory(const std::string & name, const uint8_t * data,
+                                     size_t size) {
+
+    Texture texture;
+    std::string error;
+    if (!ParseKTX(data, size, texture.image, error)) {
+        MyLOGE("Cannot load texture %s: %s", name.c_str(), error.c_str());
+        return -1;
+    }
+    texture.name = name;
+    texture.asset = NULL;
+    texture.fileSize = size;
+    texture.transcode = !IsFormatSupported(*texture.image.format);
+    int levelCount = (int) texture.image.levels.size();
+    texture.targetLevel = 0;
+    texture.residencyID = RESIDENCY_NO_RESOURCE;
+    texture.storage.textureID = texture.nextStorage.textureID = 0;
+    texture.storage.allocatedLevel = 0;
+    texture.storage.residentLevel = levelCount;
+    texture.nextStorage.allocatedLevel = -1;
+    texture.loadStartTimeMs = GetMonotonicTimeMs();
+    if (texture.transcode) {
+        CreateDecodeJobs(texture);
+    }
+
+    // start with the smallest level, the others come once they are requested
+    if (residency) {
+        std::vector<size_t> levelBytes;
+        for (int level = 0; level < levelCount; level++) {
+            levelBytes.push_back(GetUploadSize(texture, level));
+        }
+        texture.targetLevel = texture.storage.allocatedLevel = levelCount - 1;
+        texture.residencyID = residency->AddResource(levelBytes, levelCount - 1,
+                                                     SetLevelFromResidency, this,
+                                                     (int) textures.size());
+    }
+    textures.push_back(texture);
+    return (int) textures.size() - 1;
+}
+
+void MyTextureManager::DecodeRows(void * data, int begin, int end) {
+
+    DecodeJob * job = (DecodeJob *) data;
+    DecodeBlockRows(*job->format, job->data, job->width, job->height, begin, end,
+                    &job->rgba[0]);
+}
+
+void MyTextureManager::SetLevelFromResidency(void * data, int textureIndex, int level) {
+
+    MyTextureManager * self = (MyTextureManager *) data;
+    self->SetTargetLevel(textureIndex, level);
+}
+
+void MyTextureManager::CreateDecodeJobs(Texture & texture) {
+
+    for (unsigned int level = 0; level < texture.image.levels.size(); level++) {
+        const KTXLevel & source = texture.image.levels[level];
+        DecodeJob * job = new DecodeJob;
+        job->format = texture.image.format;
+        job->data = source.data;
+        job->width = source.width;
+        job->height = source.height;
+        int rows = GetBlockRowCount(*job->format, job->height);
+        job->jobCount = (rows + TEXTURE_DECODE_ROWS_PER_JOB - 1) / TEXTURE_DECODE_ROWS_PER_JOB;
+        job->submitted = false;
+        job->counter = new JobCounter();
+        texture.decodeJobs.push_back(job);
+    }
+}
+
+/**
+ * Levels about to be uploaded to a new GL texture are decoded again if their RGBA8 copy
+ * was freed after going to the old one
+ */
+void MyTextureManager::DecodeFreedLevels(Texture & texture) {
+
+    for (unsigned int level = 0; level < texture.decodeJobs.size(); level++) {
+        DecodeJob * job = texture.decodeJobs[level];
+        if (job->submitted && job->rgba.empty()) {
+            job->submitted = false;
+        }
+    }
+}
+
+/**
+ * Queue decode jobs up to the limit, smallest levels and older textures first. Workers
+ * steal the oldest jobs, so the levels needed first are decoded first.
+ */
+void MyTextureManager::SubmitDecodeJobs() {
+
+    int queuedJobs = 0;
+    for (unsigned int i = 0; i < textures.size(); i++) {
+        const std::vector<DecodeJob *> & decodeJobs = textures[i].decodeJobs;
+        for (unsigned int level = 0; level < decodeJobs.size(); level++) {
+            if (decodeJobs[level]->submitted && !decodeJobs[level]->counter->IsDone()) {
+                queuedJobs += decodeJobs[level]->jobCount;
+            }
+        }
+    }
+
+    for (unsigned int i = 0; i < textures.size(); i++) {
+        Texture & texture = textures[i];
+        const TextureStorage & storage = GetUploadStorage(texture);
+        for (int level = (int) texture.decodeJobs.size() - 1; level >= 0; level--) {
+            DecodeJob * job = texture.decodeJobs[level];
+            // levels that were evicted before their upload are not kept around
+            if (level < storage.allocatedLevel) {
+                if (job->submitted && job->counter->IsDone()) {
+                    std::vector<uint8_t>().swap(job->rgba);
+                    job->submitted = false;
+                }
+                continue;
+            }
+            // levels already uploaded need no decoding
+            if (job->submitted || level >= storage.residentLevel) {
+                continue;
+            }
+            // a level with more jobs than the limit goes alone
+            if (queuedJobs > 0 && queuedJobs + job->jobCount > TEXTURE_MAX_DECODE_JOBS) {
+                return;
+            }
+            job->rgba.resize((size_t) job->width * job->height * 4);
+            int rows = GetBlockRowCount(*job->format, job->height);
+            for (int row = 0; row < rows; row += TEXTURE_DECODE_ROWS_PER_JOB) {
+                int endRow = row + TEXTURE_DECODE_ROWS_PER_JOB < rows ?
+                             row + TEXTURE_DECODE_ROWS_PER_JOB : rows;
+                jobSystem->Submit(DecodeRows, job, row, endRow, job->counter);
+            }
+            job->submitted = true;
+            queuedJobs += job->jobCount;
+        }
+    }
+}
+
+bool MyTextureManager::IsCompressedUpload(const Texture & texture) const {
+
+    return !texture.transcode && texture.image.format->codec != TEXTURE_CODEC_NONE;
+}
+
+/**
+ * Internal format on the GPU: the file's for compressed uploads, RGBA8 otherwise
+ */
+GLenum MyTextureManager::GetUploadFormat(const Texture & texture) const {
+
+    const TextureFormatInfo & format = *texture.image.format;
+    if (!IsCompressedUpload(texture)) {
+        if (!IsGLES3Supported()) {
+            return GL_RGBA;
+        }
+        return format.srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+    }
+    if (format.codec == TEXTURE_CODEC_ETC1 && IsGLES3Supported()) {
+        return GL_COMPRESSED_RGB8_ETC2;
+    }
+    return format.glFormat;
+}
+
+size_t MyTextureManager::GetUploadSize(const Texture & texture, int level) const {
+
+    const KTXLevel & source = texture.image.levels[level];
+    if (IsCompressedUpload(texture)) {
+        return source.size;
+    }
+    return (size_t) source.width * source.height * 4;
+}
+
+/**
+ * Start building the texture at its target level if the one drawn has other levels. A
+ * texture with nothing uploaded yet just starts over at the target.
+ */
+void MyTextureManager::UpdateStorage(Texture & texture) {
+
+    int levelCount = (int) texture.image.levels.size();
+    TextureStorage & storage = texture.storage;
+    TextureStorage & nextStorage = texture.nextStorage;
+    if (storage.allocatedLevel == texture.targetLevel || !storage.textureID) {
+        storage.allocatedLevel = texture.targetLevel;
+        ReleaseStorage(nextStorage);
+        return;
+    }
+    if (nextStorage.allocatedLevel == texture.targetLevel) {
+        return;
+    }
+    ReleaseStorage(nextStorage);
+    nextStorage.allocatedLevel = texture.targetLevel;
+    nextStorage.residentLevel = levelCount;
+    texture.loadStartTimeMs = GetMonotonicTimeMs();
+    DecodeFreedLevels(texture);
+}
+
+/**
+ * Where the next levels go: the texture being built if there is one, else the one drawn
+ */
+const MyTextureManager::TextureStorage & MyTextureManager::GetUploadStorage(
+        const Texture & texture) const {
+
+    if (texture.nextStorage.allocatedLevel >= 0) {
+        return texture.nextStorage;
+    }
+    return texture.storage;
+}
+
+void MyTextureManager::ReleaseStorage(TextureStorage & storage) {
+
+    if (storage.textureID) {
+        glDeleteTextures(1, &storage.textureID);
+    }
+    storage.textureID = 0;
+    storage.allocatedLevel = -1;
+}
+
+void MyTextureManager::CreateTexture(Texture & texture, TextureStorage & storage) {
+
+    const KTXLevel & largest = texture.image.levels[storage.allocatedLevel];
+    int levelCount = (int) texture.image.levels.size() - storage.allocatedLevel;
+    bool powerOfTwo = !(largest.width & (largest.width - 1)) &&
+                      !(largest.height & (largest.height - 1));
+    glGenTextures(1, &storage.textureID);
+    glBindTexture(GL_TEXTURE_2D, storage.textureID);
+    if (IsGLES3Supported()) {
+        glTexStorage2D(GL_TEXTURE_2D, levelCount, GetUploadFormat(texture), largest.width,
+                       largest.height);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+    }
+    // GLES 2 cannot mipmap or repeat textures whose sides are not powers of 2
+    bool fullSupport = powerOfTwo || IsGLES3Supported();
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                    levelCount > 1 && fullSupport ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    GLint wrap = fullSupport ? GL_REPEAT : GL_CLAMP_TO_EDGE;
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
+}
+
+/**
+ * Upload a level, the next finer one than those already in storage, and make it the base
+ * level. Returns the bytes uploaded.
+ */
+size_t MyTextureManager::UploadLevel(Texture & texture, TextureStorage & storage, int level) {
+
+    if (!storage.textureID) {
+        CreateTexture(texture, storage);
+    }
+    glBindTexture(GL_TEXTURE_2D, storage.textureID);
+
+    const KTXLevel & source = texture.image.levels[level];
+    int glLevel = level - storage.allocatedLevel;
+    GLenum format = GetUploadFormat(texture);
+    if (IsCompressedUpload(texture)) {
+        if (IsGLES3Supported()) {
+            glCompressedTexSubImage2D(GL_TEXTURE_2D, glLevel, 0, 0, source.width,
+                                      source.height, format, (GLsizei) source.size,
+                                      source.data);
+        } else {
+            glCompressedTexImage2D(GL_TEXTURE_2D, glLevel, format, source.width, source.height,
+                                   0, (GLsizei) source.size, source.data);
+        }
+    } else {
+        const uint8_t * pixels = source.data;
+        if (texture.transcode) {
+            pixels = &texture.decodeJobs[level]->rgba[0];
+        }
+        if (IsGLES3Supported()) {
+            glTexSubImage2D(GL_TEXTURE_2D, glLevel, 0, 0, source.width, source.height, GL_RGBA,
+                            GL_UNSIGNED_BYTE, pixels);
+        } else {
+            glTexImage2D(GL_TEXTURE_2D, glLevel, format, source.width, source.height, 0,
+                         GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+        }
+        if (texture.transcode) {
+            std::vector<uint8_t>().swap(texture.decodeJobs[level]->rgba);
+        }
+    }
+    if (IsGLES3Supported()) {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, glLevel);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    CheckGLError("MyTextureManager::UploadLevel");
+
+    storage.residentLevel = level;
+    size_t size = GetUploadSize(texture, level);
+    uploadedBytes += size;
+    return size;
+}
+
+/**
+ * Upload the levels that are ready within the frame's budget and queue more decoding. Call
+ * once a frame on the GL thread, returns true while levels are still to come so that
+ * frames keep being rendered until they are in.
+ */
+bool MyTextureManager::Update() {
+
+    for (unsigned int i = 0; i < textures.size(); i++) {
+        UpdateStorage(textures[i]);
+    }
+    SubmitDecodeJobs();
+
+    long budget = TEXTURE_UPLOAD_BYTES_PER_FRAME;
+    bool streaming = false;
+    for (unsigned int i = 0; i < textures.size(); i++) {
+        Texture & texture = textures[i];
+        bool rebuilding = texture.nextStorage.allocatedLevel >= 0;
+        TextureStorage & storage = rebuilding ? texture.nextStorage : texture.storage;
+        while (storage.residentLevel > storage.allocatedLevel && budget > 0) {
+            int level = storage.residentLevel - 1;
+            if (texture.transcode && (!texture.decodeJobs[level]->submitted ||
+                                      !texture.decodeJobs[level]->counter->IsDone())) {
+                break;
+            }
+            budget -= (long) UploadLevel(texture, storage, level);
+        }
+
+        // the new texture replaces the drawn one once it is as sharp, or complete on GLES 2
+        // where textures are only drawn complete
+        if (rebuilding) {
+            int drawnLevel = storage.allocatedLevel;
+            if (IsGLES3Supported() && texture.storage.residentLevel > drawnLevel) {
+                drawnLevel = texture.storage.residentLevel;
+            }
+            if (storage.residentLevel <= drawnLevel) {
+                ReleaseStorage(texture.storage);
+                texture.storage = storage;
+                storage.textureID = 0;
+                storage.allocatedLevel = -1;
+            }
+        }
+
+        const TextureStorage & uploadStorage = GetUploadStorage(texture);
+        if (uploadStorage.residentLevel > uploadStorage.allocatedLevel) {
+            streaming = true;
+        } else if (texture.loadStartTimeMs > 0) {
+            const KTXLevel & largest = texture.image.levels[uploadStorage.allocatedLevel];
+            MyLOGI("Texture %s: %dx%d with %d levels of 0x%x%s in %.1f ms", texture.name.c_str(),
+                   largest.width, largest.height,
+                   (int) texture.image.levels.size() - uploadStorage.allocatedLevel,
+                   texture.image.format->glFormat, texture.transcode ? " decoded on the CPU" : "",
+                   GetMonotonicTimeMs() - texture.loadStartTimeMs);
+            texture.loadStartTimeMs = 0;
+        }
+    }
+    return streaming;
+}
+
+/**
+ * Ask the residency manager for the level that draws the texture at about one texel per
+ * pixel, screenSize being the pixels its larger side spans on screen, which also makes the
+ * texture's priority. Call every frame the texture is drawn.
+ */
+void MyTextureManager::RequestTexture(int textureIndex, float screenSize) {
+
+    if (!residency || textureIndex < 0 || textureIndex >= (int) textures.size()) {
+        return;
+    }
+    const Texture & texture = textures[textureIndex];
+    int size = texture.image.width > texture.image.height ? texture.image.width :
+               texture.image.height;
+    int level = 0;
+    while (level + 1 < (int) texture.image.levels.size() && (size >> (level + 1)) >= screenSize) {
+        level++;
+    }
+    residency->Request(texture.residencyID, level, screenSize * screenSize);
+}
+
+/**
+ * Keep level and coarser on the GPU, the next Update starts building the texture at its
+ * new size
+ */
+void MyTextureManager::SetTargetLevel(int textureIndex, int level) {
+
+    Texture & texture = textures[textureIndex];
+    int levelCount = (int) texture.image.levels.size();
+    texture.targetLevel = level < 0 ? 0 : (level >= levelCount ? levelCount - 1 : level);
+}
+
+/**
+ * The texture to bind, 0 until something can be shown: its smallest level on GLES 3 and
+ * all of them on GLES 2
+ */
+GLuint MyTextureManager::GetTexture(int textureIndex) const {
+
+    if (textureIndex < 0 || textureIndex >= (int) textures.size()) {
+        return 0;
+    }
+    const TextureStorage & storage = textures[textureIndex].storage;
+    if (storage.residentLevel == (int) textures[textureIndex].image.levels.size() ||
+        (!IsGLES3Supported() && storage.residentLevel > storage.allocatedLevel)) {
+        return 0;
+    }
+    return storage.textureID;
+}
+
+/**
+ * Finest level of the texture that is drawn, 0 once the texture is complete and the level
+ * count before its first upload
+ */
+int MyTextureManager::GetResidentLevel(int textureIndex) const {
+
+    return textures[textureIndex].storage.residentLevel;
+}
+
+/**
+ * The context is gone with the textures in it. They stream in again from the mapped files,
+ * decoding again the levels whose RGBA8 copy was freed.
+ */
+void MyTextureManager::ForgetGLObjects() {
+
+    for (unsigned int i = 0; i < textures.size(); i++) {
+        Texture & texture = textures[i];
+        texture.storage.textureID = texture.nextStorage.textureID = 0;
+        texture.storage.allocatedLevel = texture.targetLevel;
+        texture.storage.residentLevel = (int) texture.image.levels.size();
+        texture.nextStorage.allocatedLevel = -1;
+        texture.loadStartTimeMs = GetMonotonicTimeMs();
+        DecodeFreedLevels(texture);
+    }
+}
+
+TextureStats MyTextureManager::GetStats() const {
+
+    TextureStats stats;
+    memset(&stats, 0, sizeof(stats));
+    stats.textures = (int) textures.size();
+    stats.uploadedBytes = uploadedBytes;
+    for (unsigned int i = 0; i < textures.size(); i++) {
+        const Texture & texture = textures[i];
+        if (texture.storage.residentLevel <= texture.targetLevel &&
+            texture.nextStorage.allocatedLevel < 0) {
+            stats.completeTextures++;
+        }
+        if (texture.transcode) {
+            stats.transcodedTextures++;
+        }
+        stats.mappedBytes += texture.fileSize;
+        for (int level = 0; level < (int) texture.image.levels.size(); level++) {
+            if (level >= texture.storage.residentLevel) {
+                stats.gpuBytes += GetUploadSize(texture, level);
+            }
+            if (texture.nextStorage.allocatedLevel >= 0 &&
+                level >= texture.nextStorage.residentLevel) {
+                stats.gpuBytes += GetUploadSize(texture, level);
+            }
+        }
+    }
+    return stats;
+}
@@ -0,0 +1,134 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+
+#ifndef MY_TEXTURE_MANAGER_H
+#define MY_TEXTURE_MANAGER_H
+
+#include "myGLFunctions.h"
+#include "myKTX.h"
+#include "myJobSystem.h"
+#include "myResidencyManager.h"
+#include <android/asset_manager.h>
+#include <string>
+#include <vector>
+
+// bytes uploaded per frame, a level larger than this gets a frame to itself
+#define TEXTURE_UPLOAD_BYTES_PER_FRAME  (1024 * 1024)
+// block rows decoded per job, small enough that the frame thread never waits long on one
+#define TEXTURE_DECODE_ROWS_PER_JOB     8
+// decode jobs queued at once, well under what the job system's pools hold so that the
+// frame's own jobs always fit next to them
+#define TEXTURE_MAX_DECODE_JOBS         512
+
+struct TextureStats {
+    int     textures;
+    int     completeTextures;   // uploaded down to their target level
+    int     transcodedTextures; // decoded on the CPU since the GPU lacks their format
+    size_t  mappedBytes;        // KTX files kept in memory for uploads and restores
+    size_t  gpuBytes;           // of the uploaded levels, while a texture changes size
+                                // both of its GL textures count
+    size_t  uploadedBytes;      // since Init, including restores
+};
+
+/**
+ * Loads KTX and KTX 2 textures from assets and streams them to the GPU. Files are mapped
+ * rather than read, so compressed levels go from the APK to GL without a copy; the assets
+ * should be stored uncompressed in the APK for that.
+ *
+ * Levels are uploaded smallest first within a per-frame budget, and on GLES 3 the base
+ * level follows each one, so a blurry texture shows on the first frame and sharpens. GLES 2
+ * has no base level and a texture is used once all its levels are in.
+ *
+ * Formats the GPU cannot sample are decoded to RGBA8 on the job system, the decoded levels
+ * are freed once uploaded and decoded again after a lost context.
+ *
+ * With a residency manager, textures start with their smallest level and RequestTexture
+ * streams in the levels the screen needs. Since GL cannot free single levels, a texture
+ * that gains or loses levels is built again at its new size next to the old one, which is
+ * drawn until the new one has caught up with it.
+ */
+class MyTextureManager {
+public:
+    MyTextureManager(MyJobSystem * jobSystem, MyResidencyManager * residency = NULL);
+    ~MyTextureManager();
+    void    Init();
+    int     LoadAsset(const std::string & assetName);
+    int     LoadFromMemory(const std::string & name, const uint8_t * data, size_t size);
+    bool    Update();
+    void    RequestTexture(int textureIndex, float screenSize);
+    void    SetTargetLevel(int textureIndex, int level);
+    GLuint  GetTexture(int textureIndex) const;
+    int     GetResidentLevel(int textureIndex) const;
+    bool    IsFormatSupported(const TextureFormatInfo & format) const;
+    void    ForgetGLObjects();
+    TextureStats GetStats() const;
+
+private:
+    // decodes one level for the CPU fallback, as jobs of a few block rows each
+    struct DecodeJob {
+        const TextureFormatInfo *   format;
+        const uint8_t * data;
+        int             width, height;
+        std::vector<uint8_t> rgba;     // freed once uploaded
+        int             jobCount;
+        bool            submitted;
+        JobCounter *    counter;
+    };
+
+    // a GL texture whose level 0 is the file's allocatedLevel
+    struct TextureStorage {
+        GLuint          textureID;      // 0 until the first level is uploaded
+        int             allocatedLevel; // -1 if the storage is not in use
+        int             residentLevel;  // finest level uploaded, levels.size() if none
+    };
+
+    struct Texture {
+        std::string     name;
+        AAsset *        asset;          // NULL if the data came from LoadFromMemory
+        KTXImage        image;
+        size_t          fileSize;
+        bool            transcode;
+        int             targetLevel;    // finest level to have, 0 without residency
+        int             residencyID;
+        TextureStorage  storage;        // the one drawn
+        TextureStorage  nextStorage;    // built at targetLevel when storage has other levels
+        std::vector<DecodeJob *> decodeJobs; // one per level if transcoded
+        double          loadStartTimeMs; // 0 once logged
+    };
+
+    static void DecodeRows(void * data, int begin, int end);
+    static void SetLevelFromResidency(void * data, int textureIndex, int level);
+    void    CreateDecodeJobs(Texture & texture);
+    void    DecodeFreedLevels(Texture & texture);
+    void    SubmitDecodeJobs();
+    bool    IsCompressedUpload(const Texture & texture) const;
+    GLenum  GetUploadFormat(const Texture & texture) const;
+    size_t  GetUploadSize(const Texture & texture, int level) const;
+    void    UpdateStorage(Texture & texture);
+    const TextureStorage & GetUploadStorage(const Texture & texture) const;
+    void    ReleaseStorage(TextureStorage & storage);
+    void    CreateTexture(Texture & texture, TextureStorage & storage);
+    size_t  UploadLevel(Texture & texture, TextureStorage & storage, int level);
+
+    MyJobSystem *   jobSystem;
+    MyResidencyManager * residency; // NULL if every level stays on the GPU
+    std::vector<Texture>    textures;
+    bool    etc1Supported, etc2Supported, astcSupported;
+    size_t  uploadedBytes;
+};
+
+#endif //MY_TEXTURE_MANAGER_H
@@ -0,0 +1,108 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include "myTransform.h"
+
+MyTransform::MyTransform() {
+
+    rotation = glm::quat(1, 0, 0, 0);
+    translation = glm::vec3(0);
+    scale = 1;
+}
+
+/**
+ * Accumulate a rotation in world space. The quaternion is renormalized every time so
+ * that rounding errors cannot build up into a skewed or scaled model
+ */
+void MyTransform::Rotate(glm::quat deltaRotation) {
+
+    rotation = glm::normalize(deltaRotation * rotation);
+}
+
+void MyTransform::Translate(glm::vec3 deltaTranslation) {
+
+    translation += deltaTranslation;
+}
+
+/**
+ * Expand the quaternion into a scaled rotation matrix with translation in the last column
+ */
+MyAffine3x4 MyTransform::ToAffine() const {
+
+    float x = rotation.x, y = rotation.y, z = rotation.z, w = rotation.w;
+    float xx = x * x, yy = y * y, zz = z * z;
+    float xy = x * y, xz = x * z, yz = y * z;
+    float wx = w * x, wy = w * y, wz = w * z;
+
+    MyAffine3x4 affine;
+    affine.rows[0] = glm::vec4(scale * (1 - 2 * (yy + zz)), scale * 2 * (xy - wz),
+                               scale * 2 * (xz + wy), translation.x);
+    affine.rows[1] = glm::vec4(scale * 2 * (xy + wz), scale * (1 - 2 * (xx + zz)),
+                               scale * 2 * (yz - wx), translation.y);
+    affine.rows[2] = glm::vec4(scale * 2 * (xz - wy), scale * 2 * (yz + wx),
+                               scale * (1 - 2 * (xx + yy)), translation.z);
+    return affine;
+}
+
+/**
+ * Map a point from the parent's space back into this transform's local space
+ */
+glm::vec3 MyTransform::InverseTransformPoint(glm::vec3 point) const {
+
+    return (glm::conjugate(rotation) * (point - translation)) / scale;
+}
+
+/**
+ * Child's transform expressed in the parent's space, without going through matrices
+ */
+MyTransform ComposeTransforms(const MyTransform & parent, const MyTransform & child) {
+
+    MyTransform result;
+    result.rotation = glm::normalize(parent.rotation * child.rotation);
+    result.scale = parent.scale * child.scale;
+    result.translation = parent.translation + parent.rotation * (parent.scale * child.translation);
+    return result;
+}
+
+/**
+ * parent * child for two affine matrices: 36 multiplies instead of 64 for full 4x4s
+ */
+MyAffine3x4 ComposeAffine(const MyAffine3x4 & parent, const MyAffine3x4 & child) {
+
+    MyAffine3x4 result;
+    for (int i = 0; i < 3; i++) {
+        const glm::vec4 & row = parent.rows[i];
+        result.rows[i] = row.x * child.rows[0] + row.y * child.rows[1] + row.z * child.rows[2];
+        result.rows[i].w += row.w;
+    }
+    return result;
+}
+
+/**
+ * projectionView * model where model is affine, i.e., its last row is (0,0,0,1).
+ * glm matrices are column-major, so column j of the result combines columns of projectionView.
+ */
+glm::mat4 MultiplyAffine(const glm::mat4 & projectionView, const MyAffine3x4 & model) {
+
+    glm::mat4 result;
+    for (int j = 0; j < 4; j++) {
+        result[j] = projectionView[0] * model.rows[0][j] +
+                    projectionView[1] * model.rows[1][j] +
+                    projectionView[2] * model.rows[2][j];
+    }
+    result[3] += projectionView[3];
+    return result;
+}
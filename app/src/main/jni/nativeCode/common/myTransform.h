@@ -0,0 +1,49 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#ifndef MY_TRANSFORM_H
+#define MY_TRANSFORM_H
+
+#include "myGLM.h"
+
+/**
+ * Affine transform stored as the top 3 rows of a 4x4 matrix, the 4th row is always (0,0,0,1)
+ */
+struct MyAffine3x4 {
+    glm::vec4   rows[3];
+};
+
+/**
+ * Position, orientation and uniform scale of an object in 32 bytes.
+ * Applied to a point p as: translation + rotation * (scale * p)
+ */
+struct MyTransform {
+    glm::quat   rotation;
+    glm::vec3   translation;
+    float       scale;
+
+    MyTransform();
+    void        Rotate(glm::quat deltaRotation);
+    void        Translate(glm::vec3 deltaTranslation);
+    MyAffine3x4 ToAffine() const;
+    glm::vec3   InverseTransformPoint(glm::vec3 point) const;
+};
+
+MyTransform ComposeTransforms(const MyTransform & parent, const MyTransform & child);
+MyAffine3x4 ComposeAffine(const MyAffine3x4 & parent, const MyAffine3x4 & child);
+glm::mat4   MultiplyAffine(const glm::mat4 & projectionView, const MyAffine3x4 & model);
+
+#endif //MY_TRANSFORM_H
@@ -0,0 +1,152 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+
+#include "myUniformBuffers.h"
+#include "myLogger.h"
+#include <string.h>
+
+MyUniformBuffers::MyUniformBuffers() {
+
+    isSupported = false;
+    ring = NULL;
+    drawStride = sizeof(DrawUniforms);
+    frameUniforms = FrameUniforms();
+    ResetStats();
+}
+
+MyUniformBuffers::~MyUniformBuffers() {
+
+    if (ring) {
+        delete ring;
+    }
+}
+
+/**
+ * Create the ring once the GL context exists, returns false on GLES 2
+ */
+bool MyUniformBuffers::CreateGLBuffers(MyGPUResources * resources) {
+
+    isSupported = IsGLES3Supported();
+    if (!isSupported) {
+        return false;
+    }
+
+    // blocks are bound at offsets that are multiples of the driver's alignment,
+    // commonly 256 bytes, so each draw's 64 bytes occupy a whole aligned slot
+    GLint alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    alignment = glm::max(alignment, 16);
+    drawStride = (sizeof(DrawUniforms) + alignment - 1) / alignment * alignment;
+
+    if (ring) {
+        delete ring;
+    }
+    ring = new MyStreamBuffer(GL_UNIFORM_BUFFER, UNIFORM_RING_SIZE, alignment);
+    ring->CreateGLBuffer(resources);
+    MyLOGI("Uniform buffers: offset alignment %d, %d bytes per draw", alignment,
+           (int) drawStride);
+    return true;
+}
+
+/**
+ * Start the ring over after resources restored its buffer in a new context
+ */
+void MyUniformBuffers::RestoreGLBuffers() {
+
+    if (ring) {
+        ring->RestoreGLBuffer();
+    }
+}
+
+/**
+ * Point the program's FrameData and DrawData blocks at their binding points.
+ * Block bindings are program state, so this is needed once per program and again when
+ * a lost context brought the program back.
+ */
+void MyUniformBuffers::BindProgram(GLuint programID) {
+
+    if (!isSupported) {
+        return;
+    }
+    GLuint blockIndex = glGetUniformBlockIndex(programID, "FrameData");
+    if (blockIndex != GL_INVALID_INDEX) {
+        glUniformBlockBinding(programID, blockIndex, FRAME_UNIFORM_BINDING);
+    }
+    blockIndex = glGetUniformBlockIndex(programID, "DrawData");
+    if (blockIndex != GL_INVALID_INDEX) {
+        glUniformBlockBinding(programID, blockIndex, DRAW_UNIFORM_BINDING);
+    }
+    CheckGLError("MyUniformBuffers::BindProgram");
+}
+
+/**
+ * Copy the frame uniforms to the ring and bind them, call after filling GetFrameUniforms
+ * and before the frame's draws
+ */
+void MyUniformBuffers::UploadFrameUniforms() {
+
+    GLintptr offset;
+    void * data = ring->Map(sizeof(FrameUniforms), offset);
+    if (!data) {
+        return;
+    }
+    memcpy(data, &frameUniforms, sizeof(FrameUniforms));
+    ring->Unmap();
+    glBindBufferRange(GL_UNIFORM_BUFFER, FRAME_UNIFORM_BINDING, ring->GetBuffer(), offset,
+                      sizeof(FrameUniforms));
+    stats.rangeBinds++;
+    stats.uploadedBytes += sizeof(FrameUniforms);
+}
+
+/**
+ * Reserve count draw blocks, GetDrawStride bytes apart. Returns where to write the first
+ * one and, in firstOffset, its offset to pass to BindDrawUniforms.
+ */
+char * MyUniformBuffers::MapDrawUniforms(int count, GLintptr & firstOffset) {
+
+    GLsizeiptr size = count * drawStride;
+    stats.uploadedBytes += size;
+    return (char *) ring->Map(size, firstOffset);
+}
+
+void MyUniformBuffers::UnmapDrawUniforms() {
+
+    ring->Unmap();
+}
+
+void MyUniformBuffers::BindDrawUniforms(GLintptr offset) {
+
+    glBindBufferRange(GL_UNIFORM_BUFFER, DRAW_UNIFORM_BINDING, ring->GetBuffer(), offset,
+                      sizeof(DrawUniforms));
+    stats.rangeBinds++;
+}
+
+/**
+ * Fence this frame's blocks so the ring does not overwrite them while the GPU reads them
+ */
+void MyUniformBuffers::EndFrame() {
+
+    if (ring) {
+        ring->EndFrame();
+    }
+}
+
+void MyUniformBuffers::ResetStats() {
+
+    stats.rangeBinds = 0;
+    stats.uploadedBytes = 0;
+}
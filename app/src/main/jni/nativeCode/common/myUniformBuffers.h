@@ -0,0 +1,91 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+
+#ifndef MY_UNIFORM_BUFFERS_H
+#define MY_UNIFORM_BUFFERS_H
+
+#include "myGLFunctions.h"
+#include "myGLM.h"
+#include "myStreamBuffer.h"
+
+// binding points of the uniform blocks, set on every program that declares them
+#define FRAME_UNIFORM_BINDING   0
+#define DRAW_UNIFORM_BINDING    1
+// ring holding the frame block and every draw's block for the frames in flight
+#define UNIFORM_RING_SIZE       (256 * 1024)
+
+/**
+ * Contents of the FrameData uniform block, laid out as std140 and must match the shaders.
+ * Written once per frame and shared by every program.
+ */
+struct FrameUniforms {
+    glm::mat4   viewMat;
+    glm::mat4   projectionMat;
+    glm::mat4   inverseProjectionMat;
+    glm::vec4   viewportSize;   // xy: size being rendered to in pixels, zw: unused
+    glm::vec4   tileScale;      // xy: froxel tiles per pixel, zw: unused
+    glm::vec4   sliceParams;    // xy: froxel slice = log(depth) * x + y, zw: unused
+};
+
+/**
+ * Contents of the DrawData uniform block, one per draw
+ */
+struct DrawUniforms {
+    glm::mat4   mvpMat;
+};
+
+struct UniformBufferStats {
+    int     rangeBinds;         // glBindBufferRange calls since the last ResetStats
+    size_t  uploadedBytes;
+};
+
+/**
+ * Per-frame and per-draw uniforms in GLES 3 uniform buffers. Both live in a stream buffer
+ * and each draw selects its block with glBindBufferRange, so programs never need their
+ * own glUniform calls for the camera. GLES 2 has no uniform buffers and keeps setting
+ * uniforms on each program.
+ */
+class MyUniformBuffers {
+public:
+    MyUniformBuffers();
+    ~MyUniformBuffers();
+    bool    CreateGLBuffers(MyGPUResources * resources);
+    void    RestoreGLBuffers();
+    bool    IsSupported() const { return isSupported; }
+    void    BindProgram(GLuint programID);
+
+    FrameUniforms & GetFrameUniforms() { return frameUniforms; }
+    void    UploadFrameUniforms();
+
+    char *  MapDrawUniforms(int count, GLintptr & firstOffset);
+    void    UnmapDrawUniforms();
+    GLsizeiptr GetDrawStride() const { return drawStride; }
+    void    BindDrawUniforms(GLintptr offset);
+
+    void    EndFrame();
+    const UniformBufferStats & GetStats() const { return stats; }
+    void    ResetStats();
+
+private:
+    bool        isSupported;
+    MyStreamBuffer * ring;
+    GLsizeiptr  drawStride;     // sizeof(DrawUniforms) rounded up to the offset alignment
+    FrameUniforms frameUniforms;
+    UniformBufferStats stats;
+};
+
+#endif //MY_UNIFORM_BUFFERS_H
@@ -16,6 +16,12 @@
 
 #include "myShader.h"
 #include "myCube.h"
+#include "myJNIHelper.h"
+#include <EGL/egl.h>
+
+static std::vector<PointLight> CreatePointLights(int count);
+static void CreateBoxOccluder(glm::vec3 boxMin, glm::vec3 boxMax,
+                              std::vector<glm::vec3> & positions, std::vector<uint32_t> & indices);
 
 /**
  * Class constructor
@@ -24,30 +30,213 @@ MyCube::MyCube() {
 
     MyLOGD("MyCube::MyCube");
     initsDone = false;
+    screenWidth = screenHeight = 0;
+    surfaceCreatedTimeMs = 0;
+
+    sceneDirty.store(true);
+    animationRunning.store(false);
+    depthPrepass.store(false);
+    overdrawView.store(false);
+    skippedFrames = renderedFrames = 0;
+    lastRenderTimeMs = 0;
 
     // create MyGLCamera object and set default position for the object
     myGLCamera = new MyGLCamera();
-    float pos[]={0.,0.,0.,1,1,0.};
-    std::copy(&pos[0], &pos[5], std::back_inserter(modelDefaultPosition));
-    myGLCamera->SetModelPosition(modelDefaultPosition);
+    modelDefaultTransform.rotation = glm::quat(glm::vec3(1, 1, 0));
+    LoadScene();
+    myGLCamera->SetModelTransform(modelDefaultTransform);
+    momentum = new MyMomentum();
+
+    // per-frame scene work is spread over the big cores, each thread records
+    // draws into its own slot of the queue and they are issued in sorted order during Render
+    jobSystem = new MyJobSystem();
+    renderQueue = new MyRenderQueue(jobSystem->GetNumThreads());
+    gpuCuller = NULL;
+    gpuCullLOD = 0;
+    gpuTimer = NULL;
+    dynamicResolution = NULL;
+    renderGraph = new MyRenderGraph();
+    sceneWidth = sceneHeight = 0;
+    offscreenFailed = false;
+    qualityGovernor = NULL;
+    clusteredLighting = new MyClusteredLighting();
+    clusteredLighting->SetLights(CreatePointLights(SCENE_LIGHT_COUNT));
+    lightingEnabled = false;
+    uniformBuffers = new MyUniformBuffers();
+    gpuResources = new MyGPUResources();
+    shaderCache = new MyShaderCache();
+    residency = new MyResidencyManager(RESIDENCY_BUDGET_BYTES);
+    textureManager = new MyTextureManager(jobSystem, residency);
+    memset(&depthOnlyProgram, 0, sizeof(depthOnlyProgram));
+    memset(&overdrawProgram, 0, sizeof(overdrawProgram));
+    renderQueue->SetUniformBuffers(uniformBuffers);
+    thermalHeadroom = -1;
+    lodBias = 1.0f;
+    occlusionCuller = new MyOcclusionCuller();
+    staticBatch = new MyStaticBatch();
+
+    CreateCubeMesh();
 }
 
 MyCube::~MyCube() {
 
     MyLOGD("MyCube::~MyCube");
+    MyLOGD("Frames rendered: %ld, skipped: %ld", renderedFrames, skippedFrames);
     if (myGLCamera) {
         delete myGLCamera;
     }
+    if (momentum) {
+        delete momentum;
+    }
+    if (renderQueue) {
+        delete renderQueue;
+    }
+    // waits for its decode jobs, so before the job system
+    if (textureManager) {
+        delete textureManager;
+    }
+    if (jobSystem) {
+        delete jobSystem;
+    }
+    if (gpuCuller) {
+        delete gpuCuller;
+    }
+    if (occlusionCuller) {
+        delete occlusionCuller;
+    }
+    if (staticBatch) {
+        delete staticBatch;
+    }
+    if (residency) {
+        delete residency;
+    }
+    if (gpuTimer) {
+        delete gpuTimer;
+    }
+    if (dynamicResolution) {
+        delete dynamicResolution;
+    }
+    if (renderGraph) {
+        delete renderGraph;
+    }
+    if (qualityGovernor) {
+        delete qualityGovernor;
+    }
+    if (clusteredLighting) {
+        delete clusteredLighting;
+    }
+    if (uniformBuffers) {
+        delete uniformBuffers;
+    }
+    if (shaderCache) {
+        delete shaderCache;
+    }
+    // after every other owner has handed its resources back
+    if (gpuResources) {
+        delete gpuResources;
+    }
+#if RECORD_FRAME_TRACE
+    std::string traceFileName = gHelperObject->GetInternalPath() + "/frameTrace.txt";
+    if (SaveFrameTrace(traceFileName, frameTrace)) {
+        MyLOGI("Saved %d frame times to %s", (int) frameTrace.size(), traceFileName.c_str());
+    }
+#endif
 }
 
 /**
- * Perform inits and load the triangle's vertices/colors to GLES
+ * Point lights spread over a shell around the cube on a golden-angle spiral. Radius and
+ * intensity shrink as the count grows so that the scene's total light stays similar.
  */
-void MyCube::PerformGLInits() {
+static std::vector<PointLight> CreatePointLights(int count) {
 
-    MyLOGD("MyCube::PerformGLInits");
+    std::vector<PointLight> lights(count);
+    float scale = cbrtf(16.0f / count);
+    for (int i = 0; i < count; i++) {
+        float height = 1.0f - 2.0f * (i + 0.5f) / count;
+        float ringRadius = sqrtf(1.0f - height * height);
+        float angle = i * 2.39996323f;
+        float distance = 2.5f + 1.5f * ((i * 7) % 11) / 10.0f;
 
-    MyGLInits();
+        PointLight & light = lights[i];
+        light.position = distance * glm::vec3(ringRadius * cosf(angle), height,
+                                              ringRadius * sinf(angle));
+        light.radius = fmaxf(4.0f * scale, 0.5f);
+        // hues around the color wheel
+        float hue = 6.0f * i / count;
+        light.color = glm::clamp(glm::vec3(fabsf(hue - 3.0f) - 1.0f, 2.0f - fabsf(hue - 2.0f),
+                                           2.0f - fabsf(hue - 4.0f)), 0.0f, 1.0f);
+        light.intensity = 2.0f * scale;
+    }
+    return lights;
+}
+
+/**
+ * Box with triangles wound counter-clockwise seen from outside, as AddOccluder expects
+ */
+static void CreateBoxOccluder(glm::vec3 boxMin, glm::vec3 boxMax,
+                              std::vector<glm::vec3> & positions, std::vector<uint32_t> & indices) {
+
+    // corner i takes x, y and z from boxMax where bits 0, 1 and 2 of i are set
+    positions.clear();
+    for (int i = 0; i < 8; i++) {
+        positions.push_back(glm::vec3(i & 1 ? boxMax.x : boxMin.x, i & 2 ? boxMax.y : boxMin.y,
+                                      i & 4 ? boxMax.z : boxMin.z));
+    }
+    const uint32_t faces[6][4] = { {0, 4, 6, 2}, {1, 3, 7, 5}, {0, 1, 5, 4},
+                                   {2, 6, 7, 3}, {0, 2, 3, 1}, {4, 5, 7, 6} };
+    indices.clear();
+    for (int i = 0; i < 6; i++) {
+        const uint32_t triangles[6] = { faces[i][0], faces[i][1], faces[i][2],
+                                        faces[i][0], faces[i][2], faces[i][3] };
+        indices.insert(indices.end(), triangles, triangles + 6);
+    }
+}
+
+/**
+ * Take the cube's default transform from the scene in assets. The scene is used where it
+ * is mapped, so only its nodes are read; without it the transform set before is kept.
+ */
+void MyCube::LoadScene() {
+
+    const uint8_t * data;
+    size_t size;
+    AAsset * asset = NULL;
+    data = gHelperObject->FindPackedAsset(SCENE_ASSET_NAME, &size);
+    if (!data) {
+        asset = gHelperObject->OpenAssetBuffer(SCENE_ASSET_NAME, &data, &size);
+        if (!asset) {
+            return;
+        }
+    }
+
+    MyScene scene;
+    std::string error;
+    double startMs = GetMonotonicTimeMs();
+    if (!scene.Open(data, size, error)) {
+        MyLOGE("Cannot open scene %s: %s", SCENE_ASSET_NAME, error.c_str());
+    } else {
+        MyLOGI("Opened scene with %d nodes in %.3f ms", scene.GetNodeCount(),
+               GetMonotonicTimeMs() - startMs);
+        // the cube's mesh is made by CreateCubeMesh, the scene only places it
+        int cubeNode = scene.FindNode("cube");
+        if (cubeNode == SCENE_NONE) {
+            MyLOGE("Scene has no cube, keeping its default transform");
+        } else {
+            std::vector<MyTransform> worldTransforms;
+            scene.ComputeWorldTransforms(worldTransforms);
+            modelDefaultTransform = worldTransforms[cubeNode];
+        }
+    }
+    if (asset) {
+        gHelperObject->CloseAsset(asset);
+    }
+}
+
+/**
+ * Build the cube's mesh and its levels of detail on the CPU, done once since this
+ * does not depend on the GL context
+ */
+void MyCube::CreateCubeMesh() {
 
     GLfloat cubeVertices[] = {
             -1.0f,-1.0f,-1.0f,  // face0 left
@@ -88,11 +277,6 @@ void MyCube::PerformGLInits() {
             -1.0f, 1.0f,-1.0f   //     5
     };
 
-    // Generate a vertex buffer and load the vertices into it
-    glGenBuffers(1, &vertexBuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(cubeVertices), cubeVertices, GL_STATIC_DRAW);
-
     GLfloat cubeFaceColors[] = {
             1.0f, 0.0f, 0.0f, // red    - face0
             1.0f, 0.0f, 0.0f, //              0
@@ -132,51 +316,405 @@ void MyCube::PerformGLInits() {
             1.0f, 1.0f, 0.0f, //              5
     };
 
-    // Generate a vertex buffer and load the colors into it
-    glGenBuffers(1, &colorBuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, colorBuffer);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(cubeFaceColors), cubeFaceColors, GL_STATIC_DRAW);
+    int numVertices = sizeof(cubeVertices) / (3 * sizeof(GLfloat));
+    MyMeshLOD fullDetail;
+    for (int i = 0; i < numVertices; i++) {
+        cubeMesh.positions.push_back(glm::vec3(cubeVertices[3 * i], cubeVertices[3 * i + 1],
+                                               cubeVertices[3 * i + 2]));
+        cubeMesh.colors.push_back(glm::vec3(cubeFaceColors[3 * i], cubeFaceColors[3 * i + 1],
+                                            cubeFaceColors[3 * i + 2]));
+        fullDetail.indices.push_back(i);
+    }
+    fullDetail.geometricError = 0;
+    cubeMesh.lods.push_back(fullDetail);
+    cubeMesh.ComputeBounds();
+
+    // the cube is a convex box, so its shrunk bounding box is a conservative occluder: it
+    // can only hide meshlets on the cube's far side, never the surface in front of it
+    glm::vec3 boxMin = cubeMesh.positions[0], boxMax = cubeMesh.positions[0];
+    for (size_t i = 1; i < cubeMesh.positions.size(); i++) {
+        boxMin = glm::min(boxMin, cubeMesh.positions[i]);
+        boxMax = glm::max(boxMax, cubeMesh.positions[i]);
+    }
+    glm::vec3 boxCenter = 0.5f * (boxMin + boxMax);
+    CreateBoxOccluder(boxCenter + CUBE_OCCLUDER_SCALE * (boxMin - boxCenter),
+                      boxCenter + CUBE_OCCLUDER_SCALE * (boxMax - boxCenter),
+                      occluderPositions, occluderIndices);
+
+    // index buffer is GL_UNSIGNED_SHORT, larger meshes need OES_element_index_uint on GLES 2
+    GenerateLODs(cubeMesh);
+    currentLOD = 0;
+
+    lodCullers.resize(cubeMesh.lods.size());
+    for (size_t i = 0; i < cubeMesh.lods.size(); i++) {
+        BuildMeshlets(cubeMesh, cubeMesh.lods[i]);
+        lodCullers[i].Prepare(cubeMesh.lods[i].meshlets);
+    }
+
+    // indices are final once meshlets have reordered them
+    cubeMeshID = staticBatch->AddMesh(cubeMesh);
 
-    // shader related setup
-    std::string vertexShader    = "shaders/cubeMVP.vsh";
-    std::string fragmentShader  = "shaders/cubeMVP.fsh";
+    // all LODs start out resident, finer ones are evicted when memory runs short
+    const MyBatchedMesh & batchedCube = staticBatch->GetMesh(cubeMeshID);
+    std::vector<size_t> lodBytes;
+    for (size_t i = 0; i < batchedCube.lodIndexCount.size(); i++) {
+        lodBytes.push_back(batchedCube.lodIndexCount[i] * sizeof(GLushort));
+    }
+    cubeResidencyID = residency->AddResource(lodBytes, 0, SetCubeLOD, this, cubeMeshID);
+}
+
+/**
+ * Called by residency when the cube's LODs are evicted or streamed back. Indices of the
+ * LODs that came back are uploaded at once and the culler learns where they went.
+ */
+void MyCube::SetCubeLOD(void * data, int meshID, int level) {
+
+    MyCube * self = (MyCube *) data;
+    bool resident = self->staticBatch->SetResidentLOD(meshID, level);
+    self->staticBatch->UpdateGLBuffers();
+    const MyBatchedMesh & batchedCube = self->staticBatch->GetMesh(meshID);
+    if (!resident) {
+        // the batch stopped at a coarser LOD, residency must not count the rest
+        self->residency->SetResidentLevel(self->cubeResidencyID, (int) batchedCube.residentLOD);
+    }
+    self->lodFirstIndex.assign(batchedCube.lodFirstIndex.begin(),
+                               batchedCube.lodFirstIndex.end());
+    if (self->gpuCuller) {
+        self->gpuCuller->SetMeshlets(self->cubeMesh, self->lodFirstIndex);
+    }
+}
 
-    // compile the vertex and fragment shaders, and link them together
-    shaderProgramID = LoadShaders(vertexShader, fragmentShader);
-    // fetch the locations of "vertexPosition" and "vertexColor" from the shader
-    vertexAttribute = GetAttributeLocation(shaderProgramID, "vertexPosition");
-    colorAttribute  = GetAttributeLocation(shaderProgramID, "vertexColor");
-    MVPLocation     = GetUniformLocation(shaderProgramID, "mvpMat");
+/**
+ * Perform inits and load the triangle's vertices/colors to GLES. Called on every
+ * onSurfaceCreated, later calls restore what a lost context took with it.
+ */
+void MyCube::PerformGLInits() {
+
+    MyLOGD("MyCube::PerformGLInits");
+    surfaceCreatedTimeMs = GetMonotonicTimeMs();
+    // frame work is submitted from the GL thread, not the one that created the job system
+    jobSystem->RegisterMainThread();
+
+    MyGLInits();
+
+    if (initsDone) {
+        // the context may have been kept while the app was paused
+        if (gpuResources->IsContextLost()) {
+            RestoreGLObjects();
+        }
+        MarkSceneDirty();
+        return;
+    }
+    gpuResources->CreateGLObjects();
+
+    // vertices, colors and the indices of all LODs live in the static batch's shared buffers
+    staticBatch->CreateGLBuffers(gpuResources);
+    vertexBuffer = staticBatch->GetVertexBuffer();
+    colorBuffer = staticBatch->GetColorBuffer();
+    indexBuffer = staticBatch->GetIndexBuffer();
+    const MyBatchedMesh & batchedCube = staticBatch->GetMesh(cubeMeshID);
+    lodFirstIndex.assign(batchedCube.lodFirstIndex.begin(), batchedCube.lodFirstIndex.end());
+
+    // camera matrices go through uniform buffers on GLES 3, GLES 2 sets them per program
+#if USE_UNIFORM_BUFFERS
+    uniformBuffers->CreateGLBuffers(gpuResources);
+#endif
+    bool useUniformBuffers = uniformBuffers->IsSupported();
+
+    // shader related setup, lighting needs GLES 3 for its integer and float textures
+    lightingEnabled = useUniformBuffers;
+    unsigned int features = IsGLES3Supported() ? SHADER_FEATURE_GLES3 : 0;
+    if (useUniformBuffers) {
+        features |= SHADER_FEATURE_UNIFORM_BUFFERS;
+    }
+    shaderCache->Init(gpuResources);
+    textureManager->Init();
+    if (lightingEnabled) {
+        clusteredLighting->CreateGLTextures(gpuResources);
+    }
+
+    // the cube's variant is needed for the first frame, so wait for it to compile
+    cubeVariant = ShaderVariant(SHADER_PROGRAM_CUBE,
+                                features | (lightingEnabled ? SHADER_FEATURE_LIGHTING : 0));
+    // attribute locations are fixed by the shader cache
+    vertexAttribute = VERTEX_POSITION_ATTRIBUTE;
+    colorAttribute  = VERTEX_COLOR_ATTRIBUTE;
+    AcquireCubeProgram();
+
+    // programs that only need positions, for the depth prepass and the overdraw view, are
+    // compiled in the background and picked up by UpdatePassPrograms when they are used
+    depthOnlyVariant = ShaderVariant(SHADER_PROGRAM_DEPTH_ONLY, features);
+    overdrawVariant = ShaderVariant(SHADER_PROGRAM_OVERDRAW, features);
+    ResetPassPrograms();
+    shaderCache->GetProgram(depthOnlyVariant, false);
+    shaderCache->GetProgram(overdrawVariant, false);
+
+    // with GLES 3.1 meshlets are culled by a compute shader instead of the CPU
+    if (IsGLES31Supported()) {
+        gpuCuller = new MyGPUCuller();
+        if (gpuCuller->Init(gpuResources, "shaders/meshletCull.csh")) {
+            gpuCuller->SetGeometry(cubeMesh, lodFirstIndex, vertexBuffer, vertexAttribute,
+                                   colorBuffer, colorAttribute, indexBuffer);
+        } else {
+            MyLOGW("GPU culling unavailable, culling on the CPU");
+            delete gpuCuller;
+            gpuCuller = NULL;
+        }
+    }
+
+    // render at a lower resolution when frames take too long, judged by GPU time if the
+    // driver can measure it and by the interval between frames otherwise
+    gpuTimer = new MyGPUTimer();
+    bool gpuTimerSupported = gpuTimer->Init();
+    double budgetFraction = gpuTimerSupported ? GPU_FRAME_BUDGET_FRACTION :
+                            VSYNC_FRAME_BUDGET_FRACTION;
+    dynamicResolution = new MyDynamicResolution(DISPLAY_REFRESH_INTERVAL_MS * budgetFraction,
+                                                MIN_RESOLUTION_SCALE);
+    dynamicResolution->SetVsyncLimited(!gpuTimerSupported);
+    dynamicResolution->Init(gpuResources);
+
+    // slower changes that dynamic resolution cannot absorb, like thermal throttling over a
+    // long session, step the quality level instead
+    qualityGovernor = new MyQualityGovernor(DISPLAY_REFRESH_INTERVAL_MS * budgetFraction,
+                                            !gpuTimerSupported);
+    ApplyQualityLevel();
+
+    const ShaderCacheStats & shaderStats = shaderCache->GetStats();
+    MyLOGI("Shaders: GL thread blocked %.1f ms for %d variants at startup",
+           shaderStats.blockedTimeMs, shaderStats.compiledVariants);
 
     CheckGLError("Cube::PerformGLInits");
     initsDone = true;
+    MarkSceneDirty();
+}
+
+/**
+ * Android destroyed the context while the app was paused. Buffers, textures and programs
+ * come back from gpuResources in one pass, without reading assets or compiling shaders
+ * when the driver takes the program binaries back. Their owners then refill what they
+ * keep copies of themselves, set per-program state again and rebuild the objects that
+ * gpuResources does not manage.
+ */
+void MyCube::RestoreGLObjects() {
+
+    gpuResources->Restore();
+    staticBatch->RestoreGLBuffers();
+    uniformBuffers->RestoreGLBuffers();
+    vertexBuffer = staticBatch->GetVertexBuffer();
+    colorBuffer = staticBatch->GetColorBuffer();
+    indexBuffer = staticBatch->GetIndexBuffer();
+
+    shaderCache->Init(gpuResources);
+    AcquireCubeProgram();
+    ResetPassPrograms();
+
+    if (gpuCuller) {
+        gpuCuller->RestoreGLObjects(vertexBuffer, vertexAttribute, colorBuffer, colorAttribute,
+                                    indexBuffer);
+    }
+    gpuTimer->Init();
+    dynamicResolution->RestoreGLObjects();
+    renderGraph->ForgetGLObjects();
+    textureManager->ForgetGLObjects();
+
+    GPUResourceStats stats = gpuResources->GetStats();
+    MyLOGI("Context restored in %.1f ms: %d buffers, %d textures, %d programs (%d from "
+           "binaries), keeping %d KB of copies, %d KB of sources and %d KB of binaries",
+           GetMonotonicTimeMs() - surfaceCreatedTimeMs, stats.buffers, stats.textures,
+           stats.programs, stats.programsFromBinary, (int) (stats.contentBytes / 1024),
+           (int) (stats.sourceBytes / 1024), (int) (stats.binaryBytes / 1024));
+    CheckGLError("Cube::RestoreGLObjects");
+}
+
+/**
+ * Get the cube's program, compiling it if needed, and set its per-program state
+ */
+void MyCube::AcquireCubeProgram() {
+
+    shaderProgramID = shaderCache->GetProgram(cubeVariant, true);
+    MVPLocation = uniformBuffers->IsSupported() ? -1 :
+                  GetUniformLocation(shaderProgramID, "mvpMat");
+    uniformBuffers->BindProgram(shaderProgramID);
+    if (lightingEnabled) {
+        clusteredLighting->SetProgram(shaderProgramID);
+    }
 }
 
 /**
- * Render our colorful cube
+ * Until UpdatePassPrograms acquires them again the queue draws without the passes
+ */
+void MyCube::ResetPassPrograms() {
+
+    memset(&depthOnlyProgram, 0, sizeof(depthOnlyProgram));
+    memset(&overdrawProgram, 0, sizeof(overdrawProgram));
+    renderQueue->SetDepthOnlyProgram(depthOnlyProgram);
+    renderQueue->SetOverdrawProgram(overdrawProgram);
+}
+
+/**
+ * Record a draw packet for our colorful cube
  */
 void MyCube::RenderCube() {
-    // use the shader
-    glUseProgram(shaderProgramID);
 
+    // pick the level of detail from the distance to the cube's nearest point
+    float distance = myGLCamera->GetModelDistance() - cubeMesh.boundsRadius;
+    currentLOD = SelectLOD(cubeMesh, currentLOD, distance, myGLCamera->GetFOV(), screenHeight,
+                           lodBias);
+    // ask for the LOD by the cube's share of the screen, until it is back the finest
+    // resident one is drawn
+    float coverage = GetScreenCoverage(cubeMesh, myGLCamera->GetModelDistance(),
+                                       myGLCamera->GetFOV(), screenWidth, screenHeight);
+    residency->Request(cubeResidencyID, currentLOD, coverage);
+    int drawLOD = glm::max(currentLOD, (int) staticBatch->GetMesh(cubeMeshID).residentLOD);
+
+    // GPU culling draws the cube itself once the queue has been submitted
+    if (gpuCuller) {
+        gpuCullLOD = drawLOD;
+        return;
+    }
+
+    DrawPacket packet;
+    packet.programID        = shaderProgramID;
+    packet.vertexBuffer     = vertexBuffer;
+    packet.vertexOffset     = 0;
+    packet.vertexAttribute  = vertexAttribute;
+    packet.vertexComponents = 3;
+    packet.colorBuffer      = colorBuffer;
+    packet.colorOffset      = 0;
+    packet.colorAttribute   = colorAttribute;
+    packet.colorComponents  = 3;
+    packet.indexBuffer      = indexBuffer;
+    packet.indexType        = GL_UNSIGNED_SHORT;
+    packet.mvpLocation      = MVPLocation;
+    packet.mvpMat           = myGLCamera->GetMVP();
+    packet.primitiveMode    = GL_TRIANGLES;
+    // opaque draws go front to back so that hidden fragments fail the depth test early
+    float depth = myGLCamera->GetNormalizedViewDepth(cubeMesh.boundsCenter);
+    packet.sortKey          = MyRenderQueue::MakeSortKey(0, shaderProgramID, vertexBuffer, depth);
+
+    // meshlets hidden behind the box inside the cube are skipped
+    double cullStartTimeMs = GetMonotonicTimeMs();
+    occlusionCuller->BeginFrame();
+    occlusionCuller->AddOccluder(occluderPositions, occluderIndices, packet.mvpMat);
+    occlusionCuller->Rasterize(jobSystem);
+
+    MyMeshletCuller & culler = lodCullers[drawLOD];
+    culler.Cull(jobSystem, packet.mvpMat, myGLCamera->GetCameraPositionInModelSpace(),
+                true, drawRanges, occlusionCuller);
+    double cullTimeMs = GetMonotonicTimeMs() - cullStartTimeMs;
+
+    for (size_t i = 0; i < drawRanges.size(); i++) {
+        drawRanges[i].firstIndex += lodFirstIndex[drawLOD];
+    }
+    staticBatch->MergeDrawRanges(drawRanges);
+
+    int threadIndex = jobSystem->GetThreadIndex();
+    for (size_t i = 0; i < drawRanges.size(); i++) {
+        packet.firstElement = (GLint) drawRanges[i].firstIndex;
+        packet.elementCount = (GLsizei) drawRanges[i].indexCount;
+        renderQueue->Record(threadIndex, packet);
+    }
+
+    if (renderedFrames % FRAME_STATS_LOG_INTERVAL == 0) {
+        const MeshletCullStats & stats = culler.GetStats();
+        MyLOGD("Meshlets visible: %d/%d, triangles culled: %.1f%%", stats.visibleMeshlets,
+               stats.totalMeshlets, 100 * stats.GetCulledTriangleFraction());
+        OcclusionStats occlusionStats = occlusionCuller->GetStats();
+        MyLOGD("Occluded meshlets: %d/%d tested, rasterize %.3f ms, culling total %.3f ms",
+               occlusionStats.occludedObjects, occlusionStats.testedObjects,
+               occlusionStats.rasterizeTimeMs, cullTimeMs);
+        StaticBatchStats batchStats = staticBatch->GetStats();
+        MyLOGD("Static batch draws: %d merged into %d", batchStats.drawsBefore,
+               batchStats.drawsAfter);
+    }
+}
+
+/**
+ * Cull the cube's meshlets in a compute shader and draw the survivors indirectly. It issues
+ * its own GL calls, so it runs after the render queue has replayed rather than while
+ * packets are being recorded, and does the depth prepass and overdraw view the same way
+ * as the queue.
+ */
+void MyCube::DrawCubeGPUCulled() {
+
+    // the cube is closed and opaque, so meshlets facing away from the camera are never seen
+    gpuCuller->Cull(gpuCullLOD, myGLCamera->GetModelTransform(),
+                    myGLCamera->GetProjectionView(), myGLCamera->GetCameraPosition(), true);
     glm::mat4 mvpMat = myGLCamera->GetMVP();
-    glUniformMatrix4fv(MVPLocation, 1, GL_FALSE, (const GLfloat *) &mvpMat);
+    if (uniformBuffers->IsSupported()) {
+        GLintptr offset;
+        DrawUniforms * uniforms = (DrawUniforms *) uniformBuffers->MapDrawUniforms(1, offset);
+        if (uniforms) {
+            uniforms->mvpMat = mvpMat;
+            uniformBuffers->UnmapDrawUniforms();
+            uniformBuffers->BindDrawUniforms(offset);
+        }
+    }
 
-    // enable the vertex buffer
-    glEnableVertexAttribArray(vertexAttribute);
-    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
-    glVertexAttribPointer( vertexAttribute, 3, GL_FLOAT, GL_FALSE, 0, (void*)0 );
+    // same switches as the queue had for this frame
+    bool prepass = renderQueue->IsDepthPrepassEnabled() && depthOnlyProgram.programID;
+    if (prepass) {
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        gpuCuller->Draw(gpuCullLOD, depthOnlyProgram.programID, depthOnlyProgram.mvpLocation,
+                        mvpMat);
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glDepthMask(GL_FALSE);
+    }
+    if (renderQueue->IsOverdrawViewEnabled() && overdrawProgram.programID) {
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE);
+        gpuCuller->Draw(gpuCullLOD, overdrawProgram.programID, overdrawProgram.mvpLocation,
+                        mvpMat);
+        glDisable(GL_BLEND);
+    } else {
+        gpuCuller->Draw(gpuCullLOD, shaderProgramID, MVPLocation, mvpMat);
+    }
+    if (prepass) {
+        glDepthMask(GL_TRUE);
+    }
+}
 
-    // enable the color buffer
-    glEnableVertexAttribArray(colorAttribute);
-    glBindBuffer(GL_ARRAY_BUFFER, colorBuffer);
-    glVertexAttribPointer( colorAttribute, 3, GL_FLOAT, GL_FALSE, 0, (void*)0 );
+/**
+ * Fill in a pass program from its variant once the shader cache has compiled it.
+ * Returns true if the program changed.
+ */
+bool MyCube::AcquirePassProgram(const ShaderVariant & variant, PassProgram & program) {
 
-    // Draw the colorful triangle
-    glDrawArrays(GL_TRIANGLES, 0, 36); // cube has 12 triangles = 36 vertices.
+    if (program.programID) {
+        return false;
+    }
+    program.programID = shaderCache->GetProgram(variant, false);
+    if (!program.programID) {
+        return false;
+    }
+    program.vertexAttribute = VERTEX_POSITION_ATTRIBUTE;
+    program.mvpLocation = uniformBuffers->IsSupported() ? -1 :
+                          GetUniformLocation(program.programID, "mvpMat");
+    uniformBuffers->BindProgram(program.programID);
+    return true;
+}
+
+/**
+ * Hand the depth-only and overdraw programs to the queue once they are compiled. Until
+ * then the queue draws without the prepass or overdraw view and frames keep coming so
+ * that the program is picked up as soon as it is ready.
+ */
+void MyCube::UpdatePassPrograms() {
 
-    glDisableVertexAttribArray(vertexAttribute);
-    glDisableVertexAttribArray(colorAttribute);
+    if (depthPrepass.load()) {
+        if (AcquirePassProgram(depthOnlyVariant, depthOnlyProgram)) {
+            renderQueue->SetDepthOnlyProgram(depthOnlyProgram);
+        } else if (!depthOnlyProgram.programID) {
+            MarkSceneDirty();
+        }
+    }
+    if (overdrawView.load()) {
+        if (AcquirePassProgram(overdrawVariant, overdrawProgram)) {
+            renderQueue->SetOverdrawProgram(overdrawProgram);
+        } else if (!overdrawProgram.programID) {
+            MarkSceneDirty();
+        }
+    }
 }
 
 /**
@@ -184,12 +722,279 @@ void MyCube::RenderCube() {
  */
 void MyCube::Render() {
 
-    // clear the screen
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    MyGLDebugNewFrame();
+    sceneDirty.store(false);
+    // the interval since the last frame is only a frame time if that frame asked for this one
+    bool continuousFrame = animationRunning.load() && renderedFrames > 0;
+    double previousRenderTimeMs = lastRenderTimeMs;
+    UpdateFrameCounters();
+    UpdateMomentum();
+    UpdateQuality(continuousFrame, lastRenderTimeMs - previousRenderTimeMs);
+
+    // MSAA targets cannot be read back, so the overdraw view turns it off
+    dynamicResolution->SetSamples(overdrawView.load() ? 0 :
+                                  qualityGovernor->GetQuality().msaaSamples);
+    dynamicResolution->BeginFrame();
+    BuildRenderGraph();
+    if (!renderGraph->Compile()) {
+        MyLOGE("Dynamic resolution is off, drawing to the window");
+        offscreenFailed = true;
+        BuildRenderGraph();
+        renderGraph->Compile();
+    }
+
+    UpdatePassPrograms();
+    // levels requested by the last frame are loaded or evicted first, those still on their
+    // way need the frames after this one
+    if (residency->Update()) {
+        MarkSceneDirty();
+    }
+    if (textureManager->Update()) {
+        MarkSceneDirty();
+    }
+    renderQueue->SetDepthPrepass(depthPrepass.load());
+    renderQueue->SetOverdrawView(overdrawView.load());
+    // lights are assigned to froxels and bound before any draw, the GPU culler's included
+    if (lightingEnabled) {
+        clusteredLighting->AssignLights(jobSystem, myGLCamera->GetView());
+        clusteredLighting->Upload();
+        clusteredLighting->Bind(sceneWidth, sceneHeight, uniformBuffers->GetFrameUniforms());
+        if (renderedFrames % FRAME_STATS_LOG_INTERVAL == 0) {
+            const ClusteredLightingStats & stats = clusteredLighting->GetStats();
+            MyLOGD("Lights: %d, assigned in %.3f ms, %d froxels lit, max %d lights per "
+                   "froxel, %d list entries, %d dropped", stats.lightCount, stats.assignTimeMs,
+                   stats.nonEmptyClusters, stats.maxLightsPerCluster, stats.lightIndexCount,
+                   stats.droppedLights);
+        }
+    }
+
+    if (uniformBuffers->IsSupported()) {
+        FrameUniforms & frameUniforms = uniformBuffers->GetFrameUniforms();
+        frameUniforms.viewMat = myGLCamera->GetView();
+        frameUniforms.projectionMat = myGLCamera->GetProjection();
+        uniformBuffers->UploadFrameUniforms();
+    }
+
+    gpuTimer->BeginFrame();
+    renderGraph->Execute();
+    gpuTimer->EndFrame();
+
+    if (renderedFrames % FRAME_STATS_LOG_INTERVAL == 0) {
+        const RenderQueueStats & queueStats = renderQueue->GetStats();
+        MyLOGD("Submit: %d draws, %d uniform calls, %d uniform block binds, %.3f ms CPU",
+               queueStats.drawCount, queueStats.uniformCalls, queueStats.uniformRangeBinds,
+               queueStats.submitTimeMs);
+        if (uniformBuffers->IsSupported()) {
+            const UniformBufferStats & uniformStats = uniformBuffers->GetStats();
+            MyLOGD("Uniform buffers: %d range binds, %.1f KB written in %d frames",
+                   uniformStats.rangeBinds, uniformStats.uploadedBytes / 1024.0,
+                   FRAME_STATS_LOG_INTERVAL);
+            uniformBuffers->ResetStats();
+        }
+        const RenderGraphStats & graphStats = renderGraph->GetStats();
+        MyLOGD("Framebuffer traffic: %d KB loaded, %d KB stored, %d KB avoided by clears and "
+               "invalidating %d attachments", (int) (graphStats.loadedBytes / 1024),
+               (int) (graphStats.storedBytes / 1024), (int) (graphStats.avoidedBytes / 1024),
+               graphStats.invalidatedAttachments);
+        TextureStats textureStats = textureManager->GetStats();
+        if (textureStats.textures > 0) {
+            MyLOGD("Textures: %d of %d complete, %d decoded on the CPU, %d KB on the GPU from "
+                   "%d KB mapped", textureStats.completeTextures, textureStats.textures,
+                   textureStats.transcodedTextures, (int) (textureStats.gpuBytes / 1024),
+                   (int) (textureStats.mappedBytes / 1024));
+        }
+        const ResidencyStats & residencyStats = residency->GetStats();
+        MyLOGD("Residency: %d KB of %d KB budget (peak %d KB), %ld hits, %ld misses, %ld "
+               "levels evicted (%d KB), %d KB streamed in",
+               (int) (residencyStats.residentBytes / 1024),
+               (int) (residencyStats.budgetBytes / 1024),
+               (int) (residencyStats.peakBytes / 1024), residencyStats.hits,
+               residencyStats.misses, residencyStats.evictions,
+               (int) (residencyStats.evictedBytes / 1024),
+               (int) (residencyStats.uploadedBytes / 1024));
+    }
 
-    RenderCube();
     CheckGLError("Cube::Render");
 
+    // from onSurfaceCreated, at startup or when resuming, until this frame was submitted
+    if (surfaceCreatedTimeMs > 0) {
+        MyLOGI("First frame %.1f ms after the surface was created",
+               GetMonotonicTimeMs() - surfaceCreatedTimeMs);
+        surfaceCreatedTimeMs = 0;
+    }
+
+}
+
+/**
+ * Declare this frame's passes: the scene is drawn straight to the window, or into
+ * window-sized targets that dynamic resolution resolves and upscales
+ */
+void MyCube::BuildRenderGraph() {
+
+    renderGraph->Reset();
+    // GLSurfaceView's default EGL config has 8-bit color and 16-bit depth
+    int window = renderGraph->ImportBackbuffer("window", GL_COLOR_ATTACHMENT0,
+                                               RenderTargetDesc(screenWidth, screenHeight,
+                                                                GL_RGBA8));
+    int windowDepth = renderGraph->ImportBackbuffer("window depth", GL_DEPTH_ATTACHMENT,
+                                                    RenderTargetDesc(screenWidth, screenHeight,
+                                                                     GL_DEPTH_COMPONENT16));
+    // the scene pass clears what it draws to, and its depth is never stored
+    int scene = renderGraph->AddPass("scene", ScenePass, this);
+    if (!dynamicResolution->IsRenderingOffscreen() || offscreenFailed) {
+        sceneWidth = screenWidth;
+        sceneHeight = screenHeight;
+        renderGraph->Write(scene, window, RENDER_LOAD_CLEAR);
+        renderGraph->Write(scene, windowDepth, RENDER_LOAD_CLEAR, RENDER_STORE_DONT_CARE);
+        return;
+    }
+
+    sceneWidth = dynamicResolution->GetRenderWidth();
+    sceneHeight = dynamicResolution->GetRenderHeight();
+    int samples = dynamicResolution->GetSamples();
+    GLenum depthFormat = IsGLES3Supported() ? GL_DEPTH_COMPONENT24 : GL_DEPTH_COMPONENT16;
+    int sceneColor = renderGraph->CreateTarget("scene color",
+                                               RenderTargetDesc(screenWidth, screenHeight,
+                                                                GL_RGBA8, samples));
+    int sceneDepth = renderGraph->CreateTarget("scene depth",
+                                               RenderTargetDesc(screenWidth, screenHeight,
+                                                                depthFormat, samples));
+    renderGraph->Write(scene, sceneColor, RENDER_LOAD_CLEAR);
+    renderGraph->Write(scene, sceneDepth, RENDER_LOAD_CLEAR, RENDER_STORE_DONT_CARE);
+    dynamicResolution->AddPasses(*renderGraph, sceneColor, window, windowDepth);
+}
+
+void MyCube::ScenePass(void * data, MyRenderGraph & graph, int pass) {
+
+    ((MyCube *) data)->RenderScene();
+}
+
+/**
+ * Draw the cube into the bound framebuffer, at its lower-left corner when it is dynamic
+ * resolution's target
+ */
+void MyCube::RenderScene() {
+
+    glViewport(0, 0, sceneWidth, sceneHeight);
+
+    renderQueue->BeginFrame();
+    RenderCube();
+    renderQueue->Submit();
+    if (gpuCuller) {
+        DrawCubeGPUCulled();
+    }
+    uniformBuffers->EndFrame();
+
+    if (renderQueue->IsOverdrawViewEnabled() && renderedFrames % FRAME_STATS_LOG_INTERVAL == 0) {
+        renderQueue->MeasureOverdraw(sceneWidth, sceneHeight);
+        MyLOGD("Average overdraw: %.2f fragments per pixel",
+               renderQueue->GetStats().averageOverdraw);
+    }
+}
+
+/**
+ * In render-on-demand mode Render is only called when something changed, so the
+ * display refreshes elapsed since the previous call are counted as skipped frames
+ */
+void MyCube::UpdateFrameCounters() {
+
+    double currentTimeMs = GetMonotonicTimeMs();
+    if (renderedFrames > 0) {
+        long elapsedRefreshes = (long) ((currentTimeMs - lastRenderTimeMs) /
+                                        DISPLAY_REFRESH_INTERVAL_MS + 0.5);
+        if (elapsedRefreshes > 1) {
+            skippedFrames += elapsedRefreshes - 1;
+        }
+    }
+    lastRenderTimeMs = currentTimeMs;
+    renderedFrames++;
+
+    if (renderedFrames % FRAME_STATS_LOG_INTERVAL == 0) {
+        MyLOGD("Frames rendered: %ld, skipped: %ld", renderedFrames, skippedFrames);
+    }
+}
+
+/**
+ * Feed the last frame's time to dynamic resolution and the quality governor, and log
+ * how they have been adapting
+ */
+void MyCube::UpdateQuality(bool continuousFrame, double frameIntervalMs) {
+
+    float frameTimeMs;
+    bool hasFrameTime = gpuTimer->GetLatestTimeMs(frameTimeMs);
+    if (!hasFrameTime && !gpuTimer->IsSupported() && continuousFrame) {
+        frameTimeMs = (float) frameIntervalMs;
+        hasFrameTime = true;
+    }
+
+    if (hasFrameTime) {
+        dynamicResolution->AddFrameTime(frameTimeMs);
+#if RECORD_FRAME_TRACE
+        if (frameTrace.size() < FRAME_TRACE_MAX_FRAMES) {
+            FrameSample sample = {frameTimeMs, thermalHeadroom, qualityGovernor->GetLevel()};
+            frameTrace.push_back(sample);
+        }
+#endif
+        if (qualityGovernor->AddFrame(frameTimeMs, thermalHeadroom)) {
+            ApplyQualityLevel();
+        }
+    }
+
+    if (renderedFrames % FRAME_STATS_LOG_INTERVAL == 0) {
+        const DynamicResolutionStats & stats = dynamicResolution->GetStats();
+        if (stats.frames > 0) {
+            std::ostringstream histogram;
+            for (int i = 0; i < DYNRES_HISTOGRAM_BINS; i++) {
+                histogram << " " << stats.framesAtScale[i];
+            }
+            MyLOGD("Resolution scale: avg %.2f, min %.2f, max %.2f, %d changes, "
+                   "frame time %.2f ms, frames per 0.1 of scale:%s",
+                   stats.scaleSum / stats.frames, stats.minScale, stats.maxScale,
+                   stats.scaleChanges, stats.smoothedFrameTimeMs, histogram.str().c_str());
+        }
+        dynamicResolution->ResetStats();
+
+        const QualityGovernorStats & governorStats = qualityGovernor->GetStats();
+        MyLOGD("Quality level %s, %d changes, p90 frame time %.2f ms, thermal headroom %.2f",
+               qualityGovernor->GetQuality().name, governorStats.levelChanges,
+               governorStats.lastPercentileMs, governorStats.lastThermalHeadroom);
+        qualityGovernor->ResetStats();
+    }
+}
+
+/**
+ * Push the governor's current settings to LOD selection, dynamic resolution and the
+ * swap interval
+ */
+void MyCube::ApplyQualityLevel() {
+
+    const QualityLevel & quality = qualityGovernor->GetQuality();
+    lodBias = quality.lodBias;
+    dynamicResolution->SetMaxScale(quality.maxResolutionScale);
+    dynamicResolution->SetTargetFrameTime(qualityGovernor->GetFrameBudgetMs());
+    // takes effect at the next swap of the current surface
+    EGLDisplay display = eglGetCurrentDisplay();
+    if (display != EGL_NO_DISPLAY) {
+        eglSwapInterval(display, quality.swapInterval);
+    }
+    MyLOGI("Quality level %s: LOD bias %.1f, max scale %.2f, %dx MSAA, swap interval %d",
+           quality.name, quality.lodBias, quality.maxResolutionScale, quality.msaaSamples,
+           quality.swapInterval);
+}
+
+/**
+ * Move the model by the fling's motion since the last frame, and keep frames coming
+ * while it is still moving
+ */
+void MyCube::UpdateMomentum() {
+
+    glm::quat rotationDelta;
+    glm::vec2 translationDelta;
+    if (momentum->Update(GetMonotonicTimeMs(), rotationDelta, translationDelta)) {
+        myGLCamera->RotateModelBy(rotationDelta);
+        myGLCamera->TranslateModel(translationDelta.x, translationDelta.y);
+    }
+    animationRunning.store(momentum->IsMoving());
 }
 
 /**
@@ -200,18 +1005,27 @@ void MyCube::SetViewport(int width, int height) {
     screenHeight = height;
     screenWidth = width;
     glViewport(0, 0, width, height);
+    if (dynamicResolution) {
+        dynamicResolution->SetWindowSize(width, height);
+    }
+    offscreenFailed = false;
     CheckGLError("Cube::SetViewport");
 
     myGLCamera->SetAspectRatio((float) width / height);
+    clusteredLighting->SetProjection(myGLCamera->GetProjection(),
+                                     myGLCamera->GetNearPlaneDistance(),
+                                     myGLCamera->GetFarPlaneDistance());
+    MarkSceneDirty();
 }
 
-
 /**
  * reset model's position in double-tap
  */
 void MyCube::DoubleTapAction() {
 
-    myGLCamera->SetModelPosition(modelDefaultPosition);
+    momentum->Stop();
+    myGLCamera->SetModelTransform(modelDefaultTransform);
+    MarkSceneDirty();
 }
 
 /**
@@ -219,7 +1033,9 @@ void MyCube::DoubleTapAction() {
  */
 void MyCube::ScrollAction(float distanceX, float distanceY, float positionX, float positionY) {
 
-    myGLCamera->RotateModel(distanceX, distanceY, positionX, positionY);
+    glm::quat rotation = myGLCamera->RotateModel(distanceX, distanceY, positionX, positionY);
+    momentum->AddRotationSample(rotation, GetMonotonicTimeMs());
+    MarkSceneDirty();
 }
 
 /**
@@ -228,6 +1044,7 @@ void MyCube::ScrollAction(float distanceX, float distanceY, float positionX, flo
 void MyCube::ScaleAction(float scaleFactor) {
 
     myGLCamera->ScaleModel(scaleFactor);
+    MarkSceneDirty();
 }
 
 /**
@@ -236,4 +1053,27 @@ void MyCube::ScaleAction(float scaleFactor) {
 void MyCube::MoveAction(float distanceX, float distanceY) {
 
     myGLCamera->TranslateModel(distanceX, distanceY);
+    momentum->AddTranslationSample(distanceX, distanceY, GetMonotonicTimeMs());
+    MarkSceneDirty();
+}
+
+/**
+ * finger touched the screen: stop any fling in progress
+ */
+void MyCube::TouchDownAction() {
+
+    momentum->Stop();
+    animationRunning.store(false);
+}
+
+/**
+ * drag ended: let the model coast with the drag's velocity
+ */
+void MyCube::TouchUpAction() {
+
+    momentum->Release(GetMonotonicTimeMs());
+    if (momentum->IsMoving()) {
+        animationRunning.store(true);
+        MarkSceneDirty();
+    }
 }
\ No newline at end of file
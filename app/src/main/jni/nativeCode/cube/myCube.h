@@ -20,11 +20,56 @@
 #include "myLogger.h"
 #include "myGLFunctions.h"
 #include "myGLCamera.h"
+#include "myRenderQueue.h"
+#include "myJobSystem.h"
+#include "myMomentum.h"
+#include "myMeshLOD.h"
+#include "myMeshlet.h"
+#include "myGPUCuller.h"
+#include "myStaticBatch.h"
+#include "myDynamicResolution.h"
+#include "myGPUTimer.h"
+#include "myQualityGovernor.h"
+#include "myClusteredLighting.h"
+#include "myUniformBuffers.h"
+#include "myShaderCache.h"
+#include "myGPUResources.h"
+#include "myRenderGraph.h"
+#include "myTextureManager.h"
+#include "myResidencyManager.h"
+#include "myScene.h"
 #include <sstream>
 #include <iostream>
 #include <stdio.h>
 #include <string>
+#include <atomic>
 
+// used to count display refreshes that were skipped in render-on-demand mode
+#define DISPLAY_REFRESH_INTERVAL_MS 16.67
+// log skipped vs rendered frame counts after these many rendered frames
+#define FRAME_STATS_LOG_INTERVAL    300
+// dynamic resolution keeps GPU time under this share of a refresh, leaving room for the
+// compositor; without GPU timers the frame interval is used and may overshoot a little
+#define GPU_FRAME_BUDGET_FRACTION   0.85
+#define VSYNC_FRAME_BUDGET_FRACTION 1.1
+#define MIN_RESOLUTION_SCALE        0.5f
+// keep the last frames' times in memory and save them to frameTrace.txt in the app's
+// internal directory on exit, for replaying through SimulateQualityGovernor on a host
+#define RECORD_FRAME_TRACE          0
+#define FRAME_TRACE_MAX_FRAMES      36000
+// point lights around the cube, shaded with clustered forward lighting on GLES 3
+#define SCENE_LIGHT_COUNT           256
+// on GLES 3 pass camera data in uniform buffers instead of glUniform calls per program,
+// set to 0 to compare; lighting reads its parameters from them so it is off without
+#define USE_UNIFORM_BUFFERS         1
+// GPU memory that texture levels and mesh LODs may take, beyond it the least recently used
+// or smallest on screen are evicted down to what fits
+#define RESIDENCY_BUDGET_BYTES      (64 * 1024 * 1024)
+// the cube occludes with its bounding box shrunk by this factor, so the occluder lies strictly
+// inside the cube and never hides the cube's own surface
+#define CUBE_OCCLUDER_SCALE         0.9f
+// the cube's default transform is that of the node named "cube" in this scene
+#define SCENE_ASSET_NAME            "scenes/cube.scene"
 
 class MyCube {
 public:
@@ -38,19 +83,91 @@ public:
     void    ScrollAction(float distanceX, float distanceY, float positionX, float positionY);
     void    ScaleAction(float scaleFactor);
     void    MoveAction(float distanceX, float distanceY);
+    void    TouchDownAction();
+    void    TouchUpAction();
     int     GetScreenWidth() const { return screenWidth; }
     int     GetScreenHeight() const { return screenHeight; }
+    bool    IsRedrawNeeded() const { return sceneDirty.load() || animationRunning.load(); }
+    void    MarkSceneDirty() { sceneDirty.store(true); }
+    // set from the UI thread, picked up by the next Render
+    void    SetDepthPrepass(bool enabled) { depthPrepass.store(enabled); MarkSceneDirty(); }
+    void    SetOverdrawView(bool enabled) { overdrawView.store(enabled); MarkSceneDirty(); }
+    // called on the GL thread about once a second, negative if the device cannot tell
+    void    SetThermalHeadroom(float headroom) { thermalHeadroom = headroom; }
 
 private:
+    void    LoadScene();
+    void    CreateCubeMesh();
     void    RenderCube();
+    void    DrawCubeGPUCulled();
+    static void SetCubeLOD(void * data, int meshID, int level);
+    void    UpdateFrameCounters();
+    void    UpdateMomentum();
+    void    UpdateQuality(bool continuousFrame, double frameIntervalMs);
+    void    ApplyQualityLevel();
+    void    RestoreGLObjects();
+    void    AcquireCubeProgram();
+    void    ResetPassPrograms();
+    bool    AcquirePassProgram(const ShaderVariant & variant, PassProgram & program);
+    void    UpdatePassPrograms();
+    void    BuildRenderGraph();
+    static void ScenePass(void * data, MyRenderGraph & graph, int pass);
+    void    RenderScene();
 
     bool    initsDone;
     int     screenWidth, screenHeight;
+    double  surfaceCreatedTimeMs; // until the first frame after it is rendered, then 0
 
-    std::vector<float> modelDefaultPosition;
+    // set by gestures (UI thread) and cleared by Render (GL thread)
+    std::atomic<bool> sceneDirty;
+    std::atomic<bool> animationRunning;
+    std::atomic<bool> depthPrepass, overdrawView;
+    // display refreshes that were not rendered since nothing changed vs rendered frames
+    long    skippedFrames, renderedFrames;
+    double  lastRenderTimeMs;
+
+    MyTransform modelDefaultTransform; // restored by a double tap
     MyGLCamera * myGLCamera;
+    MyMomentum * momentum;
+    MyJobSystem * jobSystem;
+    MyRenderQueue * renderQueue;
+
+    MyMesh  cubeMesh;
+    int     currentLOD;
+    MyStaticBatch * staticBatch;
+    int     cubeMeshID;
+    std::vector<GLint> lodFirstIndex; // where each LOD starts in indexBuffer
+    int     cubeResidencyID; // the cube's LODs in residency
+    std::vector<MyMeshletCuller> lodCullers;
+    std::vector<MyDrawRange> drawRanges;
+    MyOcclusionCuller * occlusionCuller;
+    std::vector<glm::vec3> occluderPositions; // box inside the cube that hides its far side
+    std::vector<uint32_t> occluderIndices;
+    MyGPUCuller * gpuCuller; // NULL unless GLES 3.1 is available, then it replaces lodCullers
+    int     gpuCullLOD; // level RenderCube picked for DrawCubeGPUCulled
+    MyGPUTimer * gpuTimer;
+    MyDynamicResolution * dynamicResolution;
+    MyRenderGraph * renderGraph;
+    // the scene is drawn at sceneWidth x sceneHeight into the window or dynamic resolution's
+    // target, which stays off until the window changes if its framebuffers are incomplete
+    int     sceneWidth, sceneHeight;
+    bool    offscreenFailed;
+    MyQualityGovernor * qualityGovernor;
+    MyClusteredLighting * clusteredLighting;
+    bool    lightingEnabled; // needs GLES 3, otherwise the cube is drawn unlit
+    MyUniformBuffers * uniformBuffers;
+    MyGPUResources * gpuResources; // buffers, textures and programs that survive the context
+    MyShaderCache * shaderCache;
+    MyTextureManager * textureManager; // streams KTX textures in, smallest levels first
+    MyResidencyManager * residency; // keeps texture levels and LODs within a GPU budget
+    ShaderVariant   cubeVariant, depthOnlyVariant, overdrawVariant;
+    PassProgram     depthOnlyProgram, overdrawProgram; // programID is 0 until compiled
+    float   thermalHeadroom;
+    float   lodBias;
+    std::vector<FrameSample> frameTrace;
 
-    GLuint  vertexBuffer, colorBuffer; // vertex buffer for triangle's vertices, colors
+    GLuint  vertexBuffer, colorBuffer; // static batch's buffers for vertices, colors
+    GLuint  indexBuffer;               // and indices of all LODs
     GLuint  vertexAttribute, colorAttribute; // attributes for shader variables
     GLuint  shaderProgramID;
     GLint   MVPLocation; // location of MVP in the shader
@@ -0,0 +1,788 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+
+/*
+ * Host-side tool that packs a directory of assets into one indexed pack for MyAssetPack,
+ * lists a pack, and compares reading assets out of a pack with reading them file by file.
+ * KTX textures, scenes and anything that does not compress by at least an eighth are
+ * stored uncompressed and aligned so that the app uses them in place, the rest is LZ4
+ * compressed in blocks. Assets with the same contents are stored once.
+ *
+ * Build from the repository root:
+ *   g++ -std=c++11 -O2 -Iapp/src/main/jni/nativeCode/common tools/assetPacker.cpp \
+ *       app/src/main/jni/nativeCode/common/myAssetPack.cpp \
+ *       app/src/main/jni/nativeCode/common/myLZ4.cpp -lpthread -o assetPacker
+ *
+ * Usage:
+ *   assetPacker pack app/src/main/assets assets.pack   every file under the directory
+ *   assetPacker list assets.pack
+ *   assetPacker bench [directory] [threads]             synthetic assets if none is given
+ *
+ * The app maps assets.pack from the root of its assets, aapt must be told not to compress
+ * it (noCompress 'pack') and the packed files left out of the APK.
+ */
+
+#include "myAssetPack.h"
+#include "myLZ4.h"
+#include <algorithm>
+#include <dirent.h>
+#include <fcntl.h>
+#include <map>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEFAULT_THREADS     4
+// repeat short measurements until they take this long
+#define MIN_MEASURE_MS      200.0
+// compressed entries must save this share of their size, otherwise they are stored
+#define MIN_SAVING_DIVISOR  8
+// synthetic assets of the benchmark
+#define BENCH_SHADERS       400
+#define BENCH_MESHES        200
+#define BENCH_TEXTURES      100
+#define BENCH_DUPLICATES    50
+#define BENCH_LARGE_MESH    (4 * 1024 * 1024)
+
+struct PackInput {
+    std::string             name;
+    std::vector<uint8_t>    data;
+    uint32_t                nameHash;
+};
+
+// data of one unique content, shared by the entries that have it
+struct PackContent {
+    uint32_t                compression;
+    std::vector<uint8_t>    stored;
+    std::vector<AssetPackBlock> blocks;
+    uint64_t                hash;
+    uint32_t                dataOffset, firstBlock;
+};
+
+static double GetTimeMs() {
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000.0 + now.tv_nsec / 1000000.0;
+}
+
+static uint32_t NextRandom(uint32_t & seed) {
+
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+static size_t Align(size_t offset, size_t alignment) {
+
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+static bool ReadFile(const std::string & fileName, std::vector<uint8_t> & data) {
+
+    FILE * file = fopen(fileName.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    data.resize(size > 0 ? (size_t) size : 0);
+    bool result = size >= 0 && (size == 0 || fread(&data[0], 1, data.size(), file) == data.size());
+    fclose(file);
+    return result;
+}
+
+static bool WriteFile(const std::string & fileName, const std::vector<uint8_t> & data) {
+
+    FILE * file = fopen(fileName.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    bool result = data.empty() || fwrite(&data[0], 1, data.size(), file) == data.size();
+    return fclose(file) == 0 && result;
+}
+
+/**
+ * Names of the files under directory, relative to it and separated by '/' as the asset
+ * manager names them. Hidden files are left out, and packs so that a pack is not packed
+ * into the next one.
+ */
+static void ListFiles(const std::string & directory, const std::string & prefix,
+                      std::vector<std::string> & names) {
+
+    DIR * dir = opendir((directory + "/" + prefix).c_str());
+    if (!dir) {
+        return;
+    }
+    while (struct dirent * item = readdir(dir)) {
+        std::string name = item->d_name;
+        if (name[0] == '.') {
+            continue;
+        }
+        std::string path = prefix.empty() ? name : prefix + "/" + name;
+        struct stat status;
+        if (stat((directory + "/" + path).c_str(), &status) != 0) {
+            continue;
+        }
+        if (S_ISDIR(status.st_mode)) {
+            ListFiles(directory, path, names);
+        } else if (S_ISREG(status.st_mode) &&
+                   (name.size() < 5 || name.compare(name.size() - 5, 5, ".pack") != 0)) {
+            names.push_back(path);
+        }
+    }
+    closedir(dir);
+}
+
+// textures and scenes are mapped from the pack by the app rather than copied
+static bool IsUsedInPlace(const std::string & name) {
+
+    size_t dot = name.rfind('.');
+    return dot != std::string::npos &&
+           (name.compare(dot, std::string::npos, ".ktx") == 0 ||
+            name.compare(dot, std::string::npos, ".ktx2") == 0 ||
+            name.compare(dot, std::string::npos, ".scene") == 0);
+}
+
+/**
+ * Compress in blocks, or store if it is used in place or compression saves too little
+ */
+static void Compress(const PackInput & input, uint32_t blockSize, PackContent & content) {
+
+    content.compression = ASSET_COMPRESSION_NONE;
+    content.stored.clear();
+    content.blocks.clear();
+    if (!IsUsedInPlace(input.name) && !input.data.empty()) {
+        std::vector<uint8_t> block(LZ4CompressBound(blockSize));
+        for (size_t offset = 0; offset < input.data.size(); offset += blockSize) {
+            size_t size = std::min((size_t) blockSize, input.data.size() - offset);
+            size_t storedSize = LZ4Compress(&input.data[offset], size, &block[0], block.size());
+            AssetPackBlock packBlock = {(uint32_t) content.stored.size(), (uint32_t) storedSize};
+            content.blocks.push_back(packBlock);
+            content.stored.insert(content.stored.end(), block.begin(),
+                                  block.begin() + storedSize);
+        }
+        size_t size = input.data.size();
+        if (content.stored.size() <= size - size / MIN_SAVING_DIVISOR) {
+            content.compression = ASSET_COMPRESSION_LZ4;
+            return;
+        }
+        content.blocks.clear();
+    }
+    content.stored = input.data;
+}
+
+static bool CompareNameHash(const PackInput * a, const PackInput * b) {
+
+    if (a->nameHash != b->nameHash) {
+        return a->nameHash < b->nameHash;
+    }
+    return a->name < b->name;
+}
+
+/**
+ * Build a pack of the inputs, returns false if names repeat or it would exceed 4 GB
+ */
+static bool BuildPack(std::vector<PackInput> & inputs, std::vector<uint8_t> & pack,
+                      int & uniqueContents) {
+
+    std::vector<PackInput *> sorted;
+    for (unsigned int i = 0; i < inputs.size(); i++) {
+        inputs[i].nameHash = HashAssetName(inputs[i].name.c_str(), inputs[i].name.size());
+        sorted.push_back(&inputs[i]);
+    }
+    std::sort(sorted.begin(), sorted.end(), CompareNameHash);
+    for (unsigned int i = 1; i < sorted.size(); i++) {
+        if (sorted[i]->name == sorted[i - 1]->name) {
+            fprintf(stderr, "%s is in the pack twice\n", sorted[i]->name.c_str());
+            return false;
+        }
+    }
+
+    // one content per distinct data, found by hash and confirmed by comparing
+    std::multimap<uint64_t, int> contentByHash;
+    std::vector<PackContent> contents;
+    std::vector<int> contentOfEntry(sorted.size());
+    std::vector<const PackInput *> contentInput;
+    uint32_t blockCount = 0;
+    for (unsigned int i = 0; i < sorted.size(); i++) {
+        const std::vector<uint8_t> & data = sorted[i]->data;
+        uint64_t hash = HashAssetContent(data.empty() ? NULL : &data[0], data.size());
+        int content = -1;
+        std::multimap<uint64_t, int>::iterator it = contentByHash.lower_bound(hash);
+        for (; it != contentByHash.end() && it->first == hash && content < 0; it++) {
+            if (contentInput[it->second]->data == data) {
+                content = it->second;
+            }
+        }
+        if (content < 0) {
+            content = (int) contents.size();
+            contents.push_back(PackContent());
+            contentInput.push_back(sorted[i]);
+            Compress(*sorted[i], ASSET_PACK_BLOCK_SIZE, contents.back());
+            contents.back().hash = hash;
+            contents.back().firstBlock = blockCount;
+            blockCount += (uint32_t) contents.back().blocks.size();
+            contentByHash.insert(std::make_pair(hash, content));
+        }
+        contentOfEntry[i] = content;
+    }
+    uniqueContents = (int) contents.size();
+
+    uint32_t bucketBits = 0;
+    while ((1u << bucketBits) < sorted.size() && bucketBits < ASSET_PACK_MAX_BUCKET_BITS) {
+        bucketBits++;
+    }
+    uint32_t bucketCount = (1u << bucketBits) + 1;
+    AssetPackHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, ASSET_PACK_MAGIC, ASSET_PACK_MAGIC_SIZE);
+    header.version = ASSET_PACK_VERSION;
+    header.entryCount = (uint32_t) sorted.size();
+    header.bucketBits = bucketBits;
+    header.blockCount = blockCount;
+    header.blockSize = ASSET_PACK_BLOCK_SIZE;
+    uint64_t offset = sizeof(header);
+    header.bucketOffset = (uint32_t) offset;
+    offset += bucketCount * sizeof(uint32_t);
+    header.entryOffset = (uint32_t) offset;
+    offset += sorted.size() * sizeof(AssetPackEntry);
+    header.blockOffset = (uint32_t) offset;
+    offset += blockCount * sizeof(AssetPackBlock);
+    header.nameOffset = (uint32_t) offset;
+    for (unsigned int i = 0; i < sorted.size(); i++) {
+        header.nameSize += (uint32_t) sorted[i]->name.size() + 1;
+    }
+    header.nameSize = std::max(header.nameSize, 1u);
+    offset += header.nameSize;
+    for (unsigned int i = 0; i < contents.size(); i++) {
+        offset = Align(offset, contents[i].compression == ASSET_COMPRESSION_NONE ?
+                               ASSET_PACK_ALIGNMENT : 4);
+        contents[i].dataOffset = (uint32_t) offset;
+        offset += contents[i].stored.size();
+    }
+    if (offset > UINT32_MAX) {
+        fprintf(stderr, "pack would be larger than 4 GB\n");
+        return false;
+    }
+    header.fileSize = (uint32_t) offset;
+
+    pack.assign(header.fileSize, 0);
+    memcpy(&pack[0], &header, sizeof(header));
+    uint32_t * buckets = (uint32_t *) &pack[header.bucketOffset];
+    AssetPackEntry * entries = (AssetPackEntry *) &pack[header.entryOffset];
+    AssetPackBlock * blocks = (AssetPackBlock *) &pack[header.blockOffset];
+    char * names = (char *) &pack[header.nameOffset];
+    uint32_t nameOffset = 0;
+    for (unsigned int i = 0; i < sorted.size(); i++) {
+        const PackContent & content = contents[contentOfEntry[i]];
+        AssetPackEntry & entry = entries[i];
+        entry.nameHash = sorted[i]->nameHash;
+        entry.nameOffset = nameOffset;
+        entry.nameLength = (uint32_t) sorted[i]->name.size();
+        memcpy(names + nameOffset, sorted[i]->name.c_str(), entry.nameLength + 1);
+        nameOffset += entry.nameLength + 1;
+        entry.compression = content.compression;
+        entry.dataOffset = content.dataOffset;
+        entry.storedSize = (uint32_t) content.stored.size();
+        entry.size = (uint32_t) sorted[i]->data.size();
+        entry.firstBlock = content.compression == ASSET_COMPRESSION_NONE ? 0 : content.firstBlock;
+        entry.blockCount = (uint32_t) content.blocks.size();
+        entry.contentHash[0] = (uint32_t) content.hash;
+        entry.contentHash[1] = (uint32_t) (content.hash >> 32);
+        // entries are sorted by hash, so each bucket ends where the next one's first is
+        uint32_t bucket = bucketBits ? entry.nameHash >> (32 - bucketBits) : 0;
+        buckets[bucket + 1] = i + 1;
+    }
+    for (uint32_t bucket = 1; bucket < bucketCount; bucket++) {
+        buckets[bucket] = std::max(buckets[bucket], buckets[bucket - 1]);
+    }
+    for (unsigned int i = 0; i < contents.size(); i++) {
+        const PackContent & content = contents[i];
+        if (!content.stored.empty()) {
+            memcpy(&pack[content.dataOffset], &content.stored[0], content.stored.size());
+        }
+        for (unsigned int block = 0; block < content.blocks.size(); block++) {
+            blocks[content.firstBlock + block] = content.blocks[block];
+        }
+    }
+    return true;
+}
+
+static bool MapFile(const char * fileName, const uint8_t ** data, size_t * size) {
+
+    int fd = open(fileName, O_RDONLY);
+    struct stat status;
+    if (fd < 0 || fstat(fd, &status) != 0 || status.st_size == 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return false;
+    }
+    void * mapped = mmap(NULL, (size_t) status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        return false;
+    }
+    *data = (const uint8_t *) mapped;
+    *size = (size_t) status.st_size;
+    return true;
+}
+
+static bool ReadInputs(const std::string & directory, std::vector<PackInput> & inputs) {
+
+    std::vector<std::string> names;
+    ListFiles(directory, "", names);
+    inputs.resize(names.size());
+    for (unsigned int i = 0; i < names.size(); i++) {
+        inputs[i].name = names[i];
+        if (!ReadFile(directory + "/" + names[i], inputs[i].data)) {
+            fprintf(stderr, "cannot read %s\n", names[i].c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+static void PrintPackSize(const std::vector<PackInput> & inputs, const std::vector<uint8_t> & pack,
+                          int uniqueContents) {
+
+    size_t inputBytes = 0;
+    for (unsigned int i = 0; i < inputs.size(); i++) {
+        inputBytes += inputs[i].data.size();
+    }
+    printf("%d assets, %d unique, %.1f KB in %.1f KB (%.1f%%)\n", (int) inputs.size(),
+           uniqueContents, inputBytes / 1024.0, pack.size() / 1024.0,
+           inputBytes ? 100.0 * pack.size() / inputBytes : 0.0);
+}
+
+static int Pack(const char * directory, const char * packName) {
+
+    std::vector<PackInput> inputs;
+    if (!ReadInputs(directory, inputs)) {
+        return 1;
+    }
+    std::vector<uint8_t> pack;
+    int uniqueContents;
+    if (!BuildPack(inputs, pack, uniqueContents)) {
+        return 1;
+    }
+    // read it back as the app will before writing it
+    MyAssetPack assetPack;
+    std::string error;
+    if (!assetPack.Open(&pack[0], pack.size(), error)) {
+        fprintf(stderr, "built an invalid pack: %s\n", error.c_str());
+        return 1;
+    }
+    if (!WriteFile(packName, pack)) {
+        fprintf(stderr, "cannot write %s\n", packName);
+        return 1;
+    }
+    PrintPackSize(inputs, pack, uniqueContents);
+    return 0;
+}
+
+static int List(const char * packName) {
+
+    const uint8_t * data;
+    size_t size;
+    if (!MapFile(packName, &data, &size)) {
+        fprintf(stderr, "cannot read %s\n", packName);
+        return 1;
+    }
+    MyAssetPack pack;
+    std::string error;
+    if (!pack.Open(data, size, error)) {
+        fprintf(stderr, "%s: %s\n", packName, error.c_str());
+        return 1;
+    }
+    for (int i = 0; i < pack.GetEntryCount(); i++) {
+        const AssetPackEntry & entry = pack.GetEntry(i);
+        printf("%10u %10u %-6s %3u blocks at %10u  %s\n", entry.size, entry.storedSize,
+               entry.compression == ASSET_COMPRESSION_LZ4 ? "lz4" : "stored", entry.blockCount,
+               entry.dataOffset, pack.GetEntryName(i));
+    }
+    munmap((void *) data, size);
+    return 0;
+}
+
+enum BenchMode {
+    BENCH_FILES,        // open and read every asset's own file
+    BENCH_PACK_COPY,    // look up and copy or decompress every asset from the pack
+    BENCH_PACK_IN_PLACE // as above, but stored assets are used where they are
+};
+
+struct BenchThread {
+    BenchMode           mode;
+    const std::vector<PackInput> * inputs;
+    const std::string * directory;
+    const MyAssetPack * pack;
+    int                 index, count;
+    size_t              bytes;
+    bool                failed;
+};
+
+static void * ReadAssets(void * arg) {
+
+    BenchThread * thread = (BenchThread *) arg;
+    const std::vector<PackInput> & inputs = *thread->inputs;
+    std::vector<uint8_t> buffer;
+    thread->bytes = 0;
+    thread->failed = false;
+    for (unsigned int i = thread->index; i < inputs.size(); i += thread->count) {
+        if (thread->mode == BENCH_FILES) {
+            thread->failed |= !ReadFile(*thread->directory + "/" + inputs[i].name, buffer);
+            thread->bytes += buffer.size();
+            continue;
+        }
+        int entry = thread->pack->FindEntry(inputs[i].name.c_str());
+        if (entry == ASSET_PACK_NO_ENTRY) {
+            thread->failed = true;
+            continue;
+        }
+        const uint8_t * data = thread->pack->GetStoredData(entry);
+        if (thread->mode == BENCH_PACK_IN_PLACE && data) {
+            // touch the contents so that their pages count
+            for (size_t offset = 0; offset < inputs[i].data.size(); offset += 4096) {
+                thread->bytes += data[offset] & 1;
+            }
+            thread->bytes += inputs[i].data.size();
+            continue;
+        }
+        thread->failed |= !thread->pack->ReadEntry(entry, buffer);
+        thread->bytes += buffer.size();
+    }
+    return NULL;
+}
+
+/**
+ * Read all assets a way with the names split over threads, returns the time of one pass
+ */
+static double MeasureRead(BenchMode mode, const std::vector<PackInput> & inputs,
+                          const std::string & directory, const MyAssetPack & pack,
+                          int threadCount) {
+
+    std::vector<BenchThread> threads(threadCount);
+    std::vector<pthread_t> handles(threadCount);
+    int runs = 0;
+    bool failed = false;
+    double startMs = GetTimeMs();
+    do {
+        for (int i = 0; i < threadCount; i++) {
+            BenchThread thread = {mode, &inputs, &directory, &pack, i, threadCount, 0, false};
+            threads[i] = thread;
+            pthread_create(&handles[i], NULL, ReadAssets, &threads[i]);
+        }
+        for (int i = 0; i < threadCount; i++) {
+            pthread_join(handles[i], NULL);
+            failed |= threads[i].failed;
+        }
+        runs++;
+    } while (GetTimeMs() - startMs < MIN_MEASURE_MS);
+    if (failed) {
+        printf("  reading failed\n");
+    }
+    return (GetTimeMs() - startMs) / runs;
+}
+
+struct BlockThread {
+    const MyAssetPack * pack;
+    int                 entry, firstBlock, endBlock;
+    uint8_t *           output;
+};
+
+static void * DecompressBlocks(void * arg) {
+
+    BlockThread * thread = (BlockThread *) arg;
+    thread->pack->DecompressBlocks(thread->entry, thread->firstBlock, thread->endBlock,
+                                   thread->output);
+    return NULL;
+}
+
+/**
+ * Decompress one entry with its blocks split over threads, as the app's workers do
+ */
+static double MeasureBlocks(const MyAssetPack & pack, int entry, int threadCount) {
+
+    std::vector<uint8_t> output(pack.GetEntry(entry).size);
+    int blockCount = pack.GetBlockCount(entry);
+    std::vector<BlockThread> threads(threadCount);
+    std::vector<pthread_t> handles(threadCount);
+    int runs = 0;
+    double startMs = GetTimeMs();
+    do {
+        for (int i = 0; i < threadCount; i++) {
+            BlockThread thread = {&pack, entry, blockCount * i / threadCount,
+                                  blockCount * (i + 1) / threadCount, &output[0]};
+            threads[i] = thread;
+            pthread_create(&handles[i], NULL, DecompressBlocks, &threads[i]);
+        }
+        for (int i = 0; i < threadCount; i++) {
+            pthread_join(handles[i], NULL);
+        }
+        runs++;
+    } while (GetTimeMs() - startMs < MIN_MEASURE_MS);
+    return (GetTimeMs() - startMs) / runs;
+}
+
+static void MakeShader(uint32_t & seed, std::vector<uint8_t> & data) {
+
+    const char * lines[] = {
+            "uniform mat4 MVP;\n", "attribute vec3 vertexPosition;\n", "varying vec4 color;\n",
+            "    gl_Position = MVP * vec4(vertexPosition, 1.0);\n",
+            "    vec3 lightDirection = normalize(lightPosition - worldPosition);\n",
+            "    float diffuse = max(dot(normal, lightDirection), 0.0);\n",
+            "#ifdef LIGHTING\n", "#endif\n", "void main() {\n", "}\n",
+            "    gl_FragColor = vec4(color.rgb * (ambient + diffuse), color.a);\n"
+    };
+    std::string code;
+    int lineCount = 40 + NextRandom(seed) % 400;
+    for (int i = 0; i < lineCount; i++) {
+        code += lines[NextRandom(seed) % (sizeof(lines) / sizeof(lines[0]))];
+    }
+    data.assign(code.begin(), code.end());
+}
+
+// a grid of vertices with positions, normals and UVs, and its triangles
+static void MakeMesh(uint32_t & seed, size_t size, std::vector<uint8_t> & data) {
+
+    data.resize(size / 4 * 4);
+    float * values = (float *) &data[0];
+    size_t count = data.size() / 4;
+    int side = 64 + NextRandom(seed) % 64;
+    for (size_t i = 0; i + 8 <= count; i += 8) {
+        int vertex = (int) (i / 8);
+        float x = (float) (vertex % side), y = (float) (vertex / side % side);
+        float values8[] = {x, y, (float) (NextRandom(seed) % 16) * 0.25f, 0, 0, 1,
+                           x / side, y / side};
+        memcpy(values + i, values8, sizeof(values8));
+    }
+}
+
+static void MakeTexture(uint32_t & seed, size_t size, std::vector<uint8_t> & data) {
+
+    data.resize(size);
+    for (size_t i = 0; i + 4 <= size; i += 4) {
+        uint32_t value = NextRandom(seed);
+        memcpy(&data[i], &value, 4);
+    }
+}
+
+static void MakeBenchAssets(std::vector<PackInput> & inputs) {
+
+    uint32_t seed = 12345;
+    char name[64];
+    for (int i = 0; i < BENCH_SHADERS; i++) {
+        PackInput input;
+        snprintf(name, sizeof(name), "shaders/shader%d.%s", i / 2, i % 2 ? "fsh" : "vsh");
+        input.name = name;
+        MakeShader(seed, input.data);
+        inputs.push_back(input);
+    }
+    for (int i = 0; i < BENCH_MESHES; i++) {
+        PackInput input;
+        snprintf(name, sizeof(name), "meshes/mesh%d.bin", i);
+        input.name = name;
+        MakeMesh(seed, 16 * 1024 + NextRandom(seed) % (256 * 1024), input.data);
+        inputs.push_back(input);
+    }
+    for (int i = 0; i < BENCH_TEXTURES; i++) {
+        PackInput input;
+        snprintf(name, sizeof(name), "textures/texture%d.ktx", i);
+        input.name = name;
+        MakeTexture(seed, 64 * 1024 + NextRandom(seed) % (512 * 1024), input.data);
+        inputs.push_back(input);
+    }
+    for (int i = 0; i < BENCH_DUPLICATES; i++) {
+        PackInput input = inputs[NextRandom(seed) % inputs.size()];
+        snprintf(name, sizeof(name), "copies/copy%d_%s", i,
+                 input.name.substr(input.name.find('/') + 1).c_str());
+        input.name = name;
+        inputs.push_back(input);
+    }
+    PackInput input;
+    input.name = "meshes/large.bin";
+    MakeMesh(seed, BENCH_LARGE_MESH, input.data);
+    inputs.push_back(input);
+}
+
+static bool WriteBenchAssets(const std::string & directory,
+                             const std::vector<PackInput> & inputs) {
+
+    const char * subdirectories[] = {"shaders", "meshes", "textures", "copies"};
+    for (unsigned int i = 0; i < sizeof(subdirectories) / sizeof(subdirectories[0]); i++) {
+        mkdir((directory + "/" + subdirectories[i]).c_str(), 0700);
+    }
+    for (unsigned int i = 0; i < inputs.size(); i++) {
+        if (!WriteFile(directory + "/" + inputs[i].name, inputs[i].data)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void RemoveBenchAssets(const std::string & directory,
+                              const std::vector<PackInput> & inputs) {
+
+    for (unsigned int i = 0; i < inputs.size(); i++) {
+        unlink((directory + "/" + inputs[i].name).c_str());
+    }
+    const char * subdirectories[] = {"shaders", "meshes", "textures", "copies"};
+    for (unsigned int i = 0; i < sizeof(subdirectories) / sizeof(subdirectories[0]); i++) {
+        rmdir((directory + "/" + subdirectories[i]).c_str());
+    }
+    unlink((directory + "/bench.pack").c_str());
+    rmdir(directory.c_str());
+}
+
+static int Bench(const char * assetDirectory, int threadCount) {
+
+    std::vector<PackInput> inputs;
+    std::string directory;
+    if (assetDirectory) {
+        directory = assetDirectory;
+        if (!ReadInputs(directory, inputs) || inputs.empty()) {
+            fprintf(stderr, "no assets in %s\n", assetDirectory);
+            return 1;
+        }
+    } else {
+        char temporary[] = "/tmp/assetPackerXXXXXX";
+        if (!mkdtemp(temporary)) {
+            fprintf(stderr, "cannot create a temporary directory\n");
+            return 1;
+        }
+        directory = temporary;
+        MakeBenchAssets(inputs);
+        if (!WriteBenchAssets(directory, inputs)) {
+            fprintf(stderr, "cannot write to %s\n", temporary);
+            RemoveBenchAssets(directory, inputs);
+            return 1;
+        }
+    }
+
+    std::vector<uint8_t> packData;
+    int uniqueContents;
+    double startMs = GetTimeMs();
+    bool built = BuildPack(inputs, packData, uniqueContents);
+    double buildMs = GetTimeMs() - startMs;
+    std::string packName = directory + "/bench.pack";
+    const uint8_t * data = NULL;
+    size_t size = 0;
+    MyAssetPack pack;
+    std::string error;
+    if (!built || !WriteFile(packName, packData) || !MapFile(packName.c_str(), &data, &size)) {
+        fprintf(stderr, "cannot build %s\n", packName.c_str());
+        return 1;
+    }
+    PrintPackSize(inputs, packData, uniqueContents);
+    startMs = GetTimeMs();
+    bool opened = pack.Open(data, size, error);
+    double openMs = GetTimeMs() - startMs;
+    if (!opened) {
+        fprintf(stderr, "cannot open the pack: %s\n", error.c_str());
+        return 1;
+    }
+
+    // everything reads back as it went in
+    int mismatches = 0;
+    std::vector<uint8_t> buffer;
+    for (unsigned int i = 0; i < inputs.size(); i++) {
+        int entry = pack.FindEntry(inputs[i].name.c_str());
+        mismatches += entry == ASSET_PACK_NO_ENTRY || !pack.ReadEntry(entry, buffer) ||
+                      buffer != inputs[i].data;
+    }
+    printf("built in %.1f ms, opened and validated in %.3f ms, %d mismatches\n", buildMs,
+           openMs, mismatches);
+
+    int runs = 0;
+    int found = 0;
+    startMs = GetTimeMs();
+    do {
+        for (unsigned int i = 0; i < inputs.size(); i++) {
+            found += pack.FindEntry(inputs[i].name.c_str()) != ASSET_PACK_NO_ENTRY;
+        }
+        runs++;
+    } while (GetTimeMs() - startMs < MIN_MEASURE_MS);
+    printf("lookup %.1f ns per name (%d found)\n",
+           (GetTimeMs() - startMs) * 1e6 / runs / inputs.size(), found / runs);
+
+    size_t totalBytes = 0;
+    for (unsigned int i = 0; i < inputs.size(); i++) {
+        totalBytes += inputs[i].data.size();
+    }
+    const char * modeNames[] = {"files", "pack copy", "pack in place"};
+    for (int mode = BENCH_FILES; mode <= BENCH_PACK_IN_PLACE; mode++) {
+        double oneThreadMs = MeasureRead((BenchMode) mode, inputs, directory, pack, 1);
+        double threadsMs = MeasureRead((BenchMode) mode, inputs, directory, pack, threadCount);
+        printf("%-14s %8.2f ms %7.1f us/asset %7.1f MB/s, %d threads %8.2f ms %7.1f MB/s\n",
+               modeNames[mode], oneThreadMs, oneThreadMs * 1000.0 / inputs.size(),
+               totalBytes / 1048576.0 / (oneThreadMs / 1000.0), threadCount, threadsMs,
+               totalBytes / 1048576.0 / (threadsMs / 1000.0));
+    }
+
+    // the largest compressed entry decompressed block-parallel
+    int largest = ASSET_PACK_NO_ENTRY;
+    for (int i = 0; i < pack.GetEntryCount(); i++) {
+        if (pack.GetBlockCount(i) > 1 && (largest == ASSET_PACK_NO_ENTRY ||
+                                          pack.GetEntry(i).size > pack.GetEntry(largest).size)) {
+            largest = i;
+        }
+    }
+    if (largest != ASSET_PACK_NO_ENTRY) {
+        double oneThreadMs = MeasureBlocks(pack, largest, 1);
+        double threadsMs = MeasureBlocks(pack, largest, threadCount);
+        double megabytes = pack.GetEntry(largest).size / 1048576.0;
+        printf("%s, %.1f KB in %d blocks: %.2f ms %.1f MB/s, %d threads %.2f ms %.1f MB/s\n",
+               pack.GetEntryName(largest), pack.GetEntry(largest).size / 1024.0,
+               pack.GetBlockCount(largest), oneThreadMs, megabytes / (oneThreadMs / 1000.0),
+               threadCount, threadsMs, megabytes / (threadsMs / 1000.0));
+    }
+
+    munmap((void *) data, size);
+    if (assetDirectory) {
+        unlink(packName.c_str());
+    } else {
+        RemoveBenchAssets(directory, inputs);
+    }
+    return mismatches != 0;
+}
+
+int main(int argc, char ** argv) {
+
+    if (argc == 4 && strcmp(argv[1], "pack") == 0) {
+        return Pack(argv[2], argv[3]);
+    }
+    if (argc == 3 && strcmp(argv[1], "list") == 0) {
+        return List(argv[2]);
+    }
+    if (argc >= 2 && argc <= 4 && strcmp(argv[1], "bench") == 0) {
+        int threadCount = argc > 3 ? atoi(argv[3]) : DEFAULT_THREADS;
+        if (threadCount > 0) {
+            return Bench(argc > 2 ? argv[2] : NULL, threadCount);
+        }
+    }
+    fprintf(stderr, "usage: %s pack directory out.pack | list file.pack | "
+            "bench [directory] [threads]\n", argv[0]);
+    return 1;
+}
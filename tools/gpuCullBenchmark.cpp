@@ -0,0 +1,260 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+
+/*
+ * Host-side benchmark of GPU meshlet culling on Mesa's GLES 3.1 driver against the CPU
+ * culling path: the GL thread's time to cull and issue the draws, and the time until the
+ * frame is finished. Both paths draw into a small framebuffer and must produce the same
+ * image, which checks the compute shader's results without reading them back.
+ *
+ * Build from the repository root:
+ *   C=app/src/main/jni/nativeCode/common
+ *   g++ -std=c++11 -O2 -DNDEBUG -Itools/include -I$C -Iapp/src/main/externals/glm-0.9.7.5 \
+ *       tools/gpuCullBenchmark.cpp tools/hostGL.cpp $C/myGPUCuller.cpp $C/myMeshlet.cpp \
+ *       $C/myMesh.cpp $C/myOcclusionCuller.cpp $C/myJobSystem.cpp $C/myTransform.cpp \
+ *       $C/myGPUResources.cpp $C/myShader.cpp $C/myGLFunctions.cpp $C/myGLES31.cpp \
+ *       $C/myAssetPack.cpp $C/myLZ4.cpp $C/misc.cpp -lEGL -lGLESv2 -lpthread \
+ *       -o gpuCullBenchmark
+ *
+ * Usage:
+ *   gpuCullBenchmark [segments]    a sphere of 2 x segments^2 triangles, 255 by default,
+ *                                  which is the most 16-bit indices can address
+ */
+
+#include "hostGL.h"
+#include "myGPUCuller.h"
+#include "myMeshlet.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// repeat short measurements until they take this long
+#define MIN_MEASURE_MS      200.0
+#define TARGET_SIZE         256
+
+struct View {
+    const char *    name;
+    glm::vec3       position, target;
+};
+
+static double GetTimeMs() {
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000.0 + now.tv_nsec / 1000000.0;
+}
+
+/**
+ * Unit sphere of segments rings with segments quads each, wound counter-clockwise seen
+ * from outside
+ */
+static void CreateSphere(MyMesh & mesh, int segments) {
+
+    for (int ring = 0; ring <= segments; ring++) {
+        float theta = glm::pi<float>() * ring / segments;
+        for (int segment = 0; segment <= segments; segment++) {
+            float phi = 2.0f * glm::pi<float>() * segment / segments;
+            glm::vec3 position(sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi));
+            mesh.positions.push_back(position);
+            mesh.colors.push_back(position * 0.5f + 0.5f);
+        }
+    }
+
+    mesh.lods.resize(1);
+    std::vector<uint32_t> & indices = mesh.lods[0].indices;
+    for (int ring = 0; ring < segments; ring++) {
+        for (int segment = 0; segment < segments; segment++) {
+            uint32_t a = ring * (segments + 1) + segment, b = a + segments + 1;
+            uint32_t triangles[6] = { a, a + 1, b, a + 1, b + 1, b };
+            indices.insert(indices.end(), triangles, triangles + 6);
+        }
+    }
+    mesh.lods[0].geometricError = 0;
+    mesh.ComputeBounds();
+}
+
+static GLuint CreateBuffer(MyGPUResources & resources, GLenum target, GLsizeiptr size,
+                           const void * data) {
+
+    GPUHandle buffer = resources.CreateBuffer(target, GL_STATIC_DRAW, false);
+    resources.BufferData(buffer, size, data);
+    return resources.GetName(buffer);
+}
+
+/**
+ * Hash of the image and how many of its pixels the sphere covers
+ */
+static uint64_t HashImage(int & coveredPixels) {
+
+    std::vector<unsigned char> pixels(TARGET_SIZE * TARGET_SIZE * 4);
+    glReadPixels(0, 0, TARGET_SIZE, TARGET_SIZE, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+    uint64_t hash = 0;
+    coveredPixels = 0;
+    for (size_t i = 0; i < pixels.size(); i += 4) {
+        hash = hash * 31 + (pixels[i] | pixels[i + 1] << 8 | pixels[i + 2] << 16);
+        coveredPixels += (pixels[i] | pixels[i + 1] | pixels[i + 2]) != 0;
+    }
+    return hash;
+}
+
+int main(int argc, char ** argv) {
+
+    int segments = argc > 1 ? atoi(argv[1]) : 255;
+    if (segments < 4 || (segments + 1) * (segments + 1) > 65536) {
+        fprintf(stderr, "usage: %s [segments], 4 to 255\n", argv[0]);
+        return 1;
+    }
+    if (!CreateHostGLContext()) {
+        return 1;
+    }
+    if (!IsGLES31Supported()) {
+        fprintf(stderr, "The driver has no GLES 3.1\n");
+        return 1;
+    }
+
+    MyMesh mesh;
+    CreateSphere(mesh, segments);
+    BuildMeshlets(mesh, mesh.lods[0]);
+    const std::vector<uint32_t> & indices = mesh.lods[0].indices;
+    std::vector<GLushort> shortIndices(indices.begin(), indices.end());
+    printf("%d triangles in %d meshlets\n", (int) indices.size() / 3,
+           (int) mesh.lods[0].meshlets.size());
+
+    MyGPUResources resources;
+    resources.CreateGLObjects();
+    GLuint vertexBuffer = CreateBuffer(resources, GL_ARRAY_BUFFER,
+                                       mesh.positions.size() * sizeof(glm::vec3),
+                                       &mesh.positions[0]);
+    GLuint colorBuffer = CreateBuffer(resources, GL_ARRAY_BUFFER,
+                                      mesh.colors.size() * sizeof(glm::vec3), &mesh.colors[0]);
+    GLuint indexBuffer = CreateBuffer(resources, GL_ELEMENT_ARRAY_BUFFER,
+                                      shortIndices.size() * sizeof(GLushort), &shortIndices[0]);
+    AttributeBindings attributes;
+    attributes.push_back(std::make_pair(std::string("vertexPosition"), 0u));
+    attributes.push_back(std::make_pair(std::string("vertexColor"), 1u));
+    GPUHandle program = resources.CreateProgram(
+            "attribute vec3 vertexPosition;\nattribute vec3 vertexColor;\n"
+            "uniform mat4 mvpMat;\nvarying vec3 fragmentColor;\n"
+            "void main() {\n    gl_Position = mvpMat * vec4(vertexPosition, 1.0);\n"
+            "    fragmentColor = vertexColor;\n}\n",
+            "precision mediump float;\nvarying vec3 fragmentColor;\n"
+            "void main() { gl_FragColor = vec4(fragmentColor, 1.0); }\n", attributes);
+    GLuint programID = resources.GetName(program);
+    GLint mvpLocation = glGetUniformLocation(programID, "mvpMat");
+
+    std::vector<GLint> lodFirstIndex(1, 0);
+    MyGPUCuller gpuCuller;
+    if (!gpuCuller.Init(&resources, "shaders/meshletCull.csh")) {
+        fprintf(stderr, "Cannot create the GPU culler\n");
+        return 1;
+    }
+    gpuCuller.SetGeometry(mesh, lodFirstIndex, vertexBuffer, 0, colorBuffer, 1, indexBuffer);
+    MyMeshletCuller cpuCuller;
+    cpuCuller.Prepare(mesh.lods[0].meshlets);
+    std::vector<MyDrawRange> drawRanges;
+
+    // the CPU path draws from the same buffers through its own vertex array
+    GLuint vertexArray;
+    glGenVertexArrays(1, &vertexArray);
+    glBindVertexArray(vertexArray);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
+    glBindBuffer(GL_ARRAY_BUFFER, colorBuffer);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+    glBindVertexArray(0);
+
+    GLuint framebuffer, renderbuffers[2];
+    glGenFramebuffers(1, &framebuffer);
+    glGenRenderbuffers(2, renderbuffers);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, TARGET_SIZE, TARGET_SIZE);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT16, TARGET_SIZE, TARGET_SIZE);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER,
+                              renderbuffers[0]);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER,
+                              renderbuffers[1]);
+    glViewport(0, 0, TARGET_SIZE, TARGET_SIZE);
+
+    const View views[] = {
+        { "whole sphere", glm::vec3(0, 0, 4), glm::vec3(0) },
+        { "close-up", glm::vec3(0, 0.3f, 1.6f), glm::vec3(0, 0.3f, 0.9f) },
+    };
+    MyTransform modelTransform;
+    bool imagesMatch = true;
+    for (size_t v = 0; v < sizeof(views) / sizeof(views[0]); v++) {
+        glm::mat4 mvpMat = glm::perspective(0.8f, 1.0f, 0.01f, 100.0f) *
+                           glm::lookAt(views[v].position, views[v].target, glm::vec3(0, 1, 0));
+
+        // path 0 culls on the CPU and draws the merged ranges, path 1 culls in the compute
+        // shader and draws one indirect command per meshlet
+        double issueMs[2], frameMs[2];
+        uint64_t imageHash[2];
+        int coveredPixels[2];
+        for (int path = 0; path < 2; path++) {
+            int frames = 0;
+            issueMs[path] = 0;
+            double startMs = GetTimeMs();
+            do {
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                double issueStartMs = GetTimeMs();
+                if (path == 0) {
+                    cpuCuller.Cull(NULL, mvpMat, views[v].position, true, drawRanges);
+                    glUseProgram(programID);
+                    glUniformMatrix4fv(mvpLocation, 1, GL_FALSE, (const GLfloat *) &mvpMat);
+                    glBindVertexArray(vertexArray);
+                    for (size_t i = 0; i < drawRanges.size(); i++) {
+                        glDrawElements(GL_TRIANGLES, drawRanges[i].indexCount, GL_UNSIGNED_SHORT,
+                                       (void *) (drawRanges[i].firstIndex * sizeof(GLushort)));
+                    }
+                    glBindVertexArray(0);
+                } else {
+                    gpuCuller.Cull(0, modelTransform, mvpMat, views[v].position, true);
+                    gpuCuller.Draw(0, programID, mvpLocation, mvpMat);
+                }
+                issueMs[path] += GetTimeMs() - issueStartMs;
+                glFinish();
+                frames++;
+            } while (GetTimeMs() - startMs < MIN_MEASURE_MS);
+            issueMs[path] /= frames;
+            frameMs[path] = (GetTimeMs() - startMs) / frames;
+            imageHash[path] = HashImage(coveredPixels[path]);
+        }
+        bool match = imageHash[0] == imageHash[1] && coveredPixels[0] == coveredPixels[1];
+        imagesMatch &= match;
+
+        const MeshletCullStats & stats = cpuCuller.GetStats();
+        printf("%s: %d of %d meshlets visible, images %s, %d pixels covered\n", views[v].name,
+               stats.visibleMeshlets, stats.totalMeshlets, match ? "match" : "DIFFER",
+               coveredPixels[0]);
+        printf("  CPU culling: %.3f ms to cull and issue %d draws, %.2f ms per frame\n",
+               issueMs[0], (int) drawRanges.size(), frameMs[0]);
+        printf("  GPU culling: %.3f ms to issue %d indirect draws, %.2f ms per frame\n",
+               issueMs[1], stats.totalMeshlets, frameMs[1]);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteRenderbuffers(2, renderbuffers);
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteVertexArrays(1, &vertexArray);
+    DestroyHostGLContext();
+    return imagesMatch ? 0 : 1;
+}
@@ -0,0 +1,125 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+
+/*
+ * Lets host tools run the native GL code against Mesa: a GLES 3.1 context without a window,
+ * and stand-ins for the parts of the Android layer that the GL modules call, gl3stub and
+ * the asset reads of MyJNIHelper. Link it with the native sources the tool measures and
+ * -Itools/include -lEGL -lGLESv2.
+ */
+
+#include "hostGL.h"
+#include "myGLFunctions.h"
+#include "myJNIHelper.h"
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <stdio.h>
+
+MyJNIHelper * gHelperObject = NULL;
+
+static EGLDisplay display = EGL_NO_DISPLAY;
+static EGLContext context = EGL_NO_CONTEXT;
+
+/**
+ * Make a GLES 3.1 context current on this thread and run the app's GL initializations,
+ * false if the driver has no surfaceless GLES 3.1
+ */
+bool CreateHostGLContext() {
+
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)
+            eglGetProcAddress("eglGetPlatformDisplayEXT");
+    display = getPlatformDisplay ?
+              getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL) :
+              eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL)) {
+        fprintf(stderr, "Cannot initialize EGL\n");
+        return false;
+    }
+    eglBindAPI(EGL_OPENGL_ES_API);
+
+    const EGLint configAttributes[] = { EGL_RENDERABLE_TYPE, EGL_OPENGL_ES3_BIT, EGL_NONE };
+    EGLConfig config;
+    EGLint configCount = 0;
+    eglChooseConfig(display, configAttributes, &config, 1, &configCount);
+    const EGLint contextAttributes[] = { EGL_CONTEXT_MAJOR_VERSION, 3,
+                                         EGL_CONTEXT_MINOR_VERSION, 1, EGL_NONE };
+    context = eglCreateContext(display, configCount ? config : EGL_NO_CONFIG_KHR,
+                               EGL_NO_CONTEXT, contextAttributes);
+    if (context == EGL_NO_CONTEXT ||
+        !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+        fprintf(stderr, "Cannot create a surfaceless GLES 3.1 context: 0x%x\n", eglGetError());
+        return false;
+    }
+
+    if (!gHelperObject) {
+        gHelperObject = new MyJNIHelper(NULL, NULL, NULL, NULL);
+    }
+    MyGLInits();
+    printf("%s, %s\n", glGetString(GL_VERSION), glGetString(GL_RENDERER));
+    return true;
+}
+
+void DestroyHostGLContext() {
+
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(display, context);
+    eglTerminate(display);
+    context = EGL_NO_CONTEXT;
+    display = EGL_NO_DISPLAY;
+}
+
+/**
+ * Mesa's libGLESv2 exports the GLES 3.0 functions, there is nothing to load
+ */
+GLboolean gl3stubInit() {
+
+    return GL_TRUE;
+}
+
+/*
+ * MyJNIHelper without Java: there is no asset pack and assets are the source tree's files
+ */
+MyJNIHelper::MyJNIHelper(JNIEnv *, jobject, jobject, jstring) {
+
+    apkAssetManager = NULL;
+    packAsset = NULL;
+    apkInternalPath = HOST_ASSET_DIR;
+    pthread_mutex_init(&threadMutex, NULL);
+}
+
+MyJNIHelper::~MyJNIHelper() {
+
+    pthread_mutex_destroy(&threadMutex);
+}
+
+bool MyJNIHelper::ExtractAssetReturnFilename(std::string assetName, std::string & filename,
+                                             bool) {
+
+    filename = apkInternalPath + "/" + assetName;
+    FILE * file = fopen(filename.c_str(), "rb");
+    if (!file) {
+        MyLOGE("Asset not found: %s", filename.c_str());
+        return false;
+    }
+    fclose(file);
+    return true;
+}
+
+bool MyJNIHelper::ReadPackedAsset(const char *, std::vector<uint8_t> &, MyJobSystem *) const {
+
+    return false;
+}
@@ -0,0 +1,27 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+
+#ifndef TOOLS_HOST_GL_H
+#define TOOLS_HOST_GL_H
+
+// tools are run from the repository root, assets are read from the source tree
+#define HOST_ASSET_DIR  "app/src/main/assets"
+
+bool CreateHostGLContext();
+void DestroyHostGLContext();
+
+#endif //TOOLS_HOST_GL_H
@@ -0,0 +1,29 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+
+/*
+ * Stand-in for the NDK's android/asset_manager.h in host builds of the tools. The types are
+ * only named, tools/hostGL.cpp reads assets from the source tree instead.
+ */
+
+#ifndef TOOLS_ANDROID_ASSET_MANAGER_H
+#define TOOLS_ANDROID_ASSET_MANAGER_H
+
+typedef struct AAssetManager AAssetManager;
+typedef struct AAsset AAsset;
+
+#endif //TOOLS_ANDROID_ASSET_MANAGER_H
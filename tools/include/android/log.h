@@ -0,0 +1,57 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+
+/*
+ * Stand-in for the NDK's android/log.h in host builds of the tools, so that native code
+ * which logs through myLogger.h builds unchanged. Warnings and errors go to stderr, the
+ * rest is dropped to keep benchmark output readable.
+ */
+
+#ifndef TOOLS_ANDROID_LOG_H
+#define TOOLS_ANDROID_LOG_H
+
+#include <stdarg.h>
+#include <stdio.h>
+
+enum {
+    ANDROID_LOG_UNKNOWN = 0,
+    ANDROID_LOG_DEFAULT,
+    ANDROID_LOG_VERBOSE,
+    ANDROID_LOG_DEBUG,
+    ANDROID_LOG_INFO,
+    ANDROID_LOG_WARN,
+    ANDROID_LOG_ERROR,
+    ANDROID_LOG_FATAL,
+    ANDROID_LOG_SILENT
+};
+
+static inline int __android_log_print(int priority, const char * tag, const char * format,
+                                      ...) {
+
+    if (priority < ANDROID_LOG_WARN) {
+        return 0;
+    }
+    va_list arguments;
+    va_start(arguments, format);
+    fprintf(stderr, "%s: ", tag);
+    int result = vfprintf(stderr, format, arguments);
+    fputc('\n', stderr);
+    va_end(arguments);
+    return result;
+}
+
+#endif //TOOLS_ANDROID_LOG_H
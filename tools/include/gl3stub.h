@@ -0,0 +1,33 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+
+/*
+ * Stand-in for gl3stub in host builds of the tools. Mesa's libGLESv2 exports the GLES 3.0
+ * functions, so they are declared by its headers instead of loaded at runtime. GLES 3.1 is
+ * left out so that myGLES31 fetches its functions as it does on a device.
+ */
+
+#ifndef TOOLS_GL3STUB_H
+#define TOOLS_GL3STUB_H
+
+#include <GLES3/gl3.h>
+// the NDK's headers bring this in and the native code relies on it
+#include <string.h>
+
+GLboolean gl3stubInit();
+
+#endif //TOOLS_GL3STUB_H
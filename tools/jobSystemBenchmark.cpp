@@ -0,0 +1,186 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+
+/*
+ * Host-side benchmark of the job system: the cost of a job, how a CPU-bound loop scales
+ * with workers, a ParallelFor of more jobs than a thread's pool holds, and submission from
+ * threads that are neither workers nor the main thread, which share one locked deque.
+ *
+ * Build from the repository root:
+ *   g++ -std=c++11 -O2 -Itools/include -Iapp/src/main/jni/nativeCode/common \
+ *       tools/jobSystemBenchmark.cpp app/src/main/jni/nativeCode/common/myJobSystem.cpp \
+ *       -lpthread -o jobSystemBenchmark
+ *
+ * Usage:
+ *   jobSystemBenchmark [workers]    up to one worker per core besides the caller by default
+ */
+
+#include "myJobSystem.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+// repeat short measurements until they take this long
+#define MIN_MEASURE_MS      200.0
+#define EMPTY_JOBS          4096
+#define WORK_ITEMS          (1 << 20)
+#define WORK_BATCH          4096
+#define EXTERNAL_THREADS    4
+#define EXTERNAL_JOBS       2000
+// more single-item jobs than a thread's pool holds
+#define OVERFLOW_ITEMS      10000
+
+struct WorkData {
+    std::vector<float>  values;
+    std::atomic<long>   visited;
+};
+
+static double GetTimeMs() {
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000.0 + now.tv_nsec / 1000000.0;
+}
+
+static void EmptyJob(void * data, int begin, int end) {
+
+    ((WorkData *) data)->visited.fetch_add(end - begin, std::memory_order_relaxed);
+}
+
+// a few hundred cycles per item, about what the per-frame culling jobs spend
+static void WorkJob(void * data, int begin, int end) {
+
+    WorkData * work = (WorkData *) data;
+    for (int i = begin; i < end; i++) {
+        float value = work->values[i];
+        for (int step = 0; step < 16; step++) {
+            value = sqrtf(value * value + 1.0f) * 0.999f;
+        }
+        work->values[i] = value;
+    }
+    work->visited.fetch_add(end - begin, std::memory_order_relaxed);
+}
+
+static double MeasureParallelFor(MyJobSystem * jobSystem, JobFunction function,
+                                 WorkData & work, int count, int batchSize) {
+
+    int runs = 0;
+    double startMs = GetTimeMs();
+    do {
+        if (jobSystem) {
+            jobSystem->ParallelFor(function, &work, count, batchSize);
+        } else {
+            function(&work, 0, count);
+        }
+        runs++;
+    } while (GetTimeMs() - startMs < MIN_MEASURE_MS);
+    return (GetTimeMs() - startMs) / runs;
+}
+
+// counts how many times each item ran, which must be exactly once
+static void CountItemsJob(void * data, int begin, int end) {
+
+    std::vector<std::atomic<int> > & runs = *(std::vector<std::atomic<int> > *) data;
+    for (int i = begin; i < end; i++) {
+        runs[i].fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+struct ExternalThread {
+    MyJobSystem *   jobSystem;
+    WorkData *      work;
+};
+
+// submits and waits like a loader thread would, through the shared external deque
+static void * SubmitFromOutside(void * arg) {
+
+    ExternalThread * thread = (ExternalThread *) arg;
+    for (int i = 0; i < EXTERNAL_JOBS; i += 16) {
+        JobCounter counter;
+        for (int job = 0; job < 16; job++) {
+            thread->jobSystem->Submit(EmptyJob, thread->work, 0, 1, &counter);
+        }
+        thread->jobSystem->Wait(&counter);
+    }
+    return NULL;
+}
+
+int main(int argc, char ** argv) {
+
+    int maxWorkers = argc > 1 ? atoi(argv[1]) : (int) sysconf(_SC_NPROCESSORS_ONLN) - 1;
+    if (maxWorkers < 0) {
+        fprintf(stderr, "usage: %s [workers]\n", argv[0]);
+        return 1;
+    }
+    printf("%ld cores online\n", sysconf(_SC_NPROCESSORS_ONLN));
+
+    WorkData work;
+    work.values.assign(WORK_ITEMS, 1.0f);
+    double serialMs = MeasureParallelFor(NULL, WorkJob, work, WORK_ITEMS, WORK_ITEMS);
+    printf("serial loop            %8.2f ms\n", serialMs);
+
+    bool correct = true;
+    for (int workers = 0; workers <= maxWorkers; workers++) {
+        MyJobSystem jobSystem(workers);
+        work.visited.store(0);
+        double emptyMs = MeasureParallelFor(&jobSystem, EmptyJob, work, EMPTY_JOBS, 1);
+        long runs = work.visited.load() / EMPTY_JOBS;
+        correct &= work.visited.load() == runs * EMPTY_JOBS;
+        work.visited.store(0);
+        double workMs = MeasureParallelFor(&jobSystem, WorkJob, work, WORK_ITEMS, WORK_BATCH);
+        correct &= work.visited.load() % WORK_ITEMS == 0;
+        printf("%d workers: %7.1f ns per empty job, loop %8.2f ms (%.2fx serial)\n", workers,
+               emptyMs * 1e6 / EMPTY_JOBS, workMs, serialMs / workMs);
+    }
+
+    // a ParallelFor larger than the job pool runs every item once
+    MyJobSystem jobSystem(maxWorkers);
+    std::vector<std::atomic<int> > itemRuns(OVERFLOW_ITEMS);
+    for (int i = 0; i < OVERFLOW_ITEMS; i++) {
+        itemRuns[i].store(0);
+    }
+    jobSystem.ParallelFor(CountItemsJob, &itemRuns, OVERFLOW_ITEMS, 1);
+    int wrongItems = 0;
+    for (int i = 0; i < OVERFLOW_ITEMS; i++) {
+        wrongItems += itemRuns[i].load() != 1 ? 1 : 0;
+    }
+    correct &= wrongItems == 0;
+    printf("%d jobs with a pool of %d: %d items not run exactly once\n", OVERFLOW_ITEMS,
+           JOB_POOL_SIZE, wrongItems);
+
+    // threads that were never registered still get all their jobs run
+    std::vector<ExternalThread> threads(EXTERNAL_THREADS);
+    std::vector<pthread_t> handles(EXTERNAL_THREADS);
+    work.visited.store(0);
+    double startMs = GetTimeMs();
+    for (int i = 0; i < EXTERNAL_THREADS; i++) {
+        threads[i].jobSystem = &jobSystem;
+        threads[i].work = &work;
+        pthread_create(&handles[i], NULL, SubmitFromOutside, &threads[i]);
+    }
+    for (int i = 0; i < EXTERNAL_THREADS; i++) {
+        pthread_join(handles[i], NULL);
+    }
+    double externalMs = GetTimeMs() - startMs;
+    long expected = (long) EXTERNAL_THREADS * EXTERNAL_JOBS;
+    correct &= work.visited.load() == expected;
+    printf("%d external threads: %ld of %ld jobs run, %.1f ns per job\n", EXTERNAL_THREADS,
+           work.visited.load(), expected, externalMs * 1e6 / expected);
+    return correct ? 0 : 1;
+}
@@ -0,0 +1,119 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+
+/*
+ * Host-side benchmark of clustered light assignment: how long AssignLights takes for 16, 256
+ * and 4096 point lights around the cube, seen from the app's default camera, serially and
+ * on the job system, and how many froxels and light list entries it produces. Assignment
+ * never touches GL, the GL sources are only linked for the lighting's texture code.
+ *
+ * Build from the repository root:
+ *   C=app/src/main/jni/nativeCode/common
+ *   g++ -std=c++11 -O2 -DNDEBUG -Itools/include -I$C -Iapp/src/main/externals/glm-0.9.7.5 \
+ *       tools/lightingBenchmark.cpp tools/hostGL.cpp $C/myClusteredLighting.cpp \
+ *       $C/myGLCamera.cpp $C/myTransform.cpp $C/myJobSystem.cpp $C/myGPUResources.cpp \
+ *       $C/myShader.cpp $C/myGLFunctions.cpp $C/myGLES31.cpp $C/myAssetPack.cpp $C/myLZ4.cpp \
+ *       $C/misc.cpp -lEGL -lGLESv2 -lpthread -o lightingBenchmark
+ *
+ * Usage:
+ *   lightingBenchmark [width height] [workers]    viewport of 1920 x 1080 by default
+ */
+
+#include "myClusteredLighting.h"
+#include "myGLCamera.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+// repeat short measurements until they take this long
+#define MIN_MEASURE_MS      200.0
+
+static double GetTimeMs() {
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000.0 + now.tv_nsec / 1000000.0;
+}
+
+/**
+ * Same lights as MyCube's scene: a golden-angle spiral on a shell around the cube, with
+ * radius and intensity shrinking as the count grows
+ */
+static std::vector<PointLight> CreatePointLights(int count) {
+
+    std::vector<PointLight> lights(count);
+    float scale = cbrtf(16.0f / count);
+    for (int i = 0; i < count; i++) {
+        float height = 1.0f - 2.0f * (i + 0.5f) / count;
+        float ringRadius = sqrtf(1.0f - height * height);
+        float angle = i * 2.39996323f;
+        float distance = 2.5f + 1.5f * ((i * 7) % 11) / 10.0f;
+
+        PointLight & light = lights[i];
+        light.position = distance * glm::vec3(ringRadius * cosf(angle), height,
+                                              ringRadius * sinf(angle));
+        light.radius = fmaxf(4.0f * scale, 0.5f);
+        light.color = glm::vec3(1);
+        light.intensity = 2.0f * scale;
+    }
+    return lights;
+}
+
+static double MeasureAssign(MyClusteredLighting & lighting, MyJobSystem * jobSystem,
+                            const glm::mat4 & viewMat) {
+
+    int runs = 0;
+    double startMs = GetTimeMs();
+    do {
+        lighting.AssignLights(jobSystem, viewMat);
+        runs++;
+    } while (GetTimeMs() - startMs < MIN_MEASURE_MS);
+    return (GetTimeMs() - startMs) / runs;
+}
+
+int main(int argc, char ** argv) {
+
+    int width = argc > 2 ? atoi(argv[1]) : 1920;
+    int height = argc > 2 ? atoi(argv[2]) : 1080;
+    int workers = argc > 3 ? atoi(argv[3]) : (int) sysconf(_SC_NPROCESSORS_ONLN) - 1;
+    if (argc == 2 || width <= 0 || height <= 0 || workers < 0) {
+        fprintf(stderr, "usage: %s [width height] [workers]\n", argv[0]);
+        return 1;
+    }
+
+    MyGLCamera camera;
+    camera.SetAspectRatio((float) width / height);
+    MyClusteredLighting lighting;
+    lighting.SetProjection(camera.GetProjection(), camera.GetNearPlaneDistance(),
+                           camera.GetFarPlaneDistance());
+    MyJobSystem jobSystem(workers);
+
+    const int lightCounts[] = {16, 256, 4096};
+    for (int i = 0; i < 3; i++) {
+        lighting.SetLights(CreatePointLights(lightCounts[i]));
+        double serialMs = MeasureAssign(lighting, NULL, camera.GetView());
+        double jobMs = MeasureAssign(lighting, &jobSystem, camera.GetView());
+        const ClusteredLightingStats & stats = lighting.GetStats();
+        printf("%5d lights: %.3f ms serial, %.3f ms with %d workers, %d froxels lit, "
+               "%d list entries, max %d per froxel, %d dropped\n", lightCounts[i], serialMs,
+               jobMs, workers, stats.nonEmptyClusters, stats.lightIndexCount,
+               stats.maxLightsPerCluster, stats.droppedLights);
+    }
+    return 0;
+}
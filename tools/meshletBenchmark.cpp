@@ -0,0 +1,141 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+
+/*
+ * Host-side benchmark of meshlet clustering and culling on a finely tessellated sphere:
+ * how long BuildMeshlets takes, and per view how long the culling pass takes serially and
+ * on the job system, and what fraction of the triangles it removes. Drawing the whole
+ * object whenever its bounds are visible, as per-object culling does, removes none of them.
+ *
+ * Build from the repository root:
+ *   C=app/src/main/jni/nativeCode/common
+ *   g++ -std=c++11 -O2 -Itools/include -I$C -Iapp/src/main/externals/glm-0.9.7.5 \
+ *       tools/meshletBenchmark.cpp $C/myMeshlet.cpp $C/myMesh.cpp $C/myOcclusionCuller.cpp \
+ *       $C/myJobSystem.cpp $C/misc.cpp -lpthread -o meshletBenchmark
+ *
+ * Usage:
+ *   meshletBenchmark [segments] [workers]    a sphere of 2 x segments^2 triangles,
+ *                                            1024 segments by default
+ */
+
+#include "myMeshlet.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+// repeat short measurements until they take this long
+#define MIN_MEASURE_MS      200.0
+
+struct View {
+    const char *    name;
+    glm::vec3       position, target;
+    float           FOV;
+};
+
+static double GetTimeMs() {
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000.0 + now.tv_nsec / 1000000.0;
+}
+
+/**
+ * Unit sphere of segments rings with segments quads each, wound counter-clockwise seen
+ * from outside
+ */
+static void CreateSphere(MyMesh & mesh, int segments) {
+
+    for (int ring = 0; ring <= segments; ring++) {
+        float theta = glm::pi<float>() * ring / segments;
+        for (int segment = 0; segment <= segments; segment++) {
+            float phi = 2.0f * glm::pi<float>() * segment / segments;
+            mesh.positions.push_back(glm::vec3(sinf(theta) * cosf(phi), cosf(theta),
+                                               sinf(theta) * sinf(phi)));
+        }
+    }
+    mesh.colors.assign(mesh.positions.size(), glm::vec3(1));
+
+    mesh.lods.resize(1);
+    std::vector<uint32_t> & indices = mesh.lods[0].indices;
+    for (int ring = 0; ring < segments; ring++) {
+        for (int segment = 0; segment < segments; segment++) {
+            uint32_t a = ring * (segments + 1) + segment, b = a + segments + 1;
+            uint32_t triangles[6] = { a, a + 1, b, a + 1, b + 1, b };
+            indices.insert(indices.end(), triangles, triangles + 6);
+        }
+    }
+    mesh.lods[0].geometricError = 0;
+    mesh.ComputeBounds();
+}
+
+static double MeasureCull(MyMeshletCuller & culler, MyJobSystem * jobSystem,
+                          const glm::mat4 & mvpMat, glm::vec3 cameraPosition,
+                          std::vector<MyDrawRange> & drawRanges) {
+
+    int runs = 0;
+    double startMs = GetTimeMs();
+    do {
+        culler.Cull(jobSystem, mvpMat, cameraPosition, true, drawRanges);
+        runs++;
+    } while (GetTimeMs() - startMs < MIN_MEASURE_MS);
+    return (GetTimeMs() - startMs) / runs;
+}
+
+int main(int argc, char ** argv) {
+
+    int segments = argc > 1 ? atoi(argv[1]) : 1024;
+    int workers = argc > 2 ? atoi(argv[2]) : (int) sysconf(_SC_NPROCESSORS_ONLN) - 1;
+    if (segments < 4 || workers < 0) {
+        fprintf(stderr, "usage: %s [segments] [workers]\n", argv[0]);
+        return 1;
+    }
+
+    MyMesh mesh;
+    CreateSphere(mesh, segments);
+    MyMeshLOD & lod = mesh.lods[0];
+    double startMs = GetTimeMs();
+    BuildMeshlets(mesh, lod);
+    double buildMs = GetTimeMs() - startMs;
+    printf("%d triangles in %d meshlets, built in %.1f ms\n", (int) lod.indices.size() / 3,
+           (int) lod.meshlets.size(), buildMs);
+
+    MyMeshletCuller culler;
+    culler.Prepare(lod.meshlets);
+    MyJobSystem jobSystem(workers);
+    std::vector<MyDrawRange> drawRanges;
+
+    const View views[] = {
+        { "whole sphere", glm::vec3(0, 0, 4), glm::vec3(0), 0.8f },
+        { "close-up", glm::vec3(0, 0.3f, 1.6f), glm::vec3(0, 0.3f, 0.9f), 0.8f },
+        { "grazing", glm::vec3(1.05f, 0, 0.2f), glm::vec3(1.05f, 0, -1), 1.0f },
+    };
+    for (size_t v = 0; v < sizeof(views) / sizeof(views[0]); v++) {
+        const View & view = views[v];
+        glm::mat4 mvpMat = glm::perspective(view.FOV, 1.5f, 0.01f, 100.0f) *
+                           glm::lookAt(view.position, view.target, glm::vec3(0, 1, 0));
+        double serialMs = MeasureCull(culler, NULL, mvpMat, view.position, drawRanges);
+        double jobMs = MeasureCull(culler, &jobSystem, mvpMat, view.position, drawRanges);
+        const MeshletCullStats & stats = culler.GetStats();
+        printf("%-12s %5.1f%% of triangles culled, %d of %d meshlets in %d draw ranges\n",
+               view.name, 100.0f * stats.GetCulledTriangleFraction(), stats.visibleMeshlets,
+               stats.totalMeshlets, (int) drawRanges.size());
+        printf("             cull %.3f ms serial, %.3f ms with %d workers\n", serialMs, jobMs,
+               workers);
+    }
+    return 0;
+}
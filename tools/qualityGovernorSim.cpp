@@ -0,0 +1,96 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+/*
+ * Host-side replay of frame-time traces through the quality governor, so that changes to
+ * its thresholds or ladder can be checked against recorded sessions without a device.
+ * Traces are saved by the app when RECORD_FRAME_TRACE is set in myCube.h.
+ *
+ * Build from the repository root:
+ *   g++ -std=c++11 -O2 -Iapp/src/main/jni/nativeCode/common tools/qualityGovernorSim.cpp \
+ *       app/src/main/jni/nativeCode/common/myQualityGovernor.cpp -o qualityGovernorSim
+ *
+ * Usage:
+ *   qualityGovernorSim <trace.txt> [frame budget ms] [refresh interval ms, 0 for GPU times]
+ *   qualityGovernorSim --synthetic   replays a generated trace of a device warming up
+ */
+
+#include "myQualityGovernor.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_FRAME_BUDGET_MS     14.17f
+#define SYNTHETIC_FRAMES            36000
+
+/**
+ * Ten minutes at 60 fps of GPU times recorded at the top level: the GPU slows down as the
+ * device warms up, thermal headroom rises past the throttling threshold, then cools again.
+ * Noise comes from a fixed-seed generator so the trace is the same on every run.
+ */
+static void MakeSyntheticTrace(std::vector<FrameSample> & trace) {
+
+    unsigned int seed = 1;
+    trace.resize(SYNTHETIC_FRAMES);
+    for (int i = 0; i < SYNTHETIC_FRAMES; i++) {
+        float t = (float) i / SYNTHETIC_FRAMES;
+        float warmth = t < 0.7f ? t / 0.7f : 1.0f - (t - 0.7f) / 0.3f;
+        seed = seed * 1103515245 + 12345;
+        float noise = ((seed >> 16) & 0x7fff) / 32767.0f;
+        trace[i].frameTimeMs = 11.0f + 9.0f * warmth + 3.0f * noise * noise * noise;
+        trace[i].thermalHeadroom = i % 60 == 0 ? 0.4f + 0.6f * warmth : -1;
+        trace[i].level = 0;
+    }
+}
+
+int main(int argc, char ** argv) {
+
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <trace.txt> [frame budget ms] [refresh interval ms]\n"
+                "       %s --synthetic\n", argv[0], argv[0]);
+        return 1;
+    }
+
+    std::vector<FrameSample> trace;
+    float frameBudgetMs = argc > 2 ? (float) atof(argv[2]) : DEFAULT_FRAME_BUDGET_MS;
+    float refreshIntervalMs = argc > 3 ? (float) atof(argv[3]) : 0;
+    if (strcmp(argv[1], "--synthetic") == 0) {
+        MakeSyntheticTrace(trace);
+    } else if (!LoadFrameTrace(argv[1], trace)) {
+        fprintf(stderr, "cannot read %s\n", argv[1]);
+        return 1;
+    }
+
+    std::vector<int> levels;
+    SimulateQualityGovernor(trace, frameBudgetMs, refreshIntervalMs, levels);
+
+    std::vector<int> framesAtLevel(qualityLevelCount, 0);
+    int changes = 0;
+    for (size_t i = 0; i < levels.size(); i++) {
+        framesAtLevel[levels[i]]++;
+        if (i > 0 && levels[i] != levels[i - 1]) {
+            changes++;
+            printf("frame %6d (%6.1f s): %s -> %s\n", (int) i, i / 60.0f,
+                   qualityLadder[levels[i - 1]].name, qualityLadder[levels[i]].name);
+        }
+    }
+    printf("%d frames, %d level changes\n", (int) levels.size(), changes);
+    for (int level = 0; level < qualityLevelCount; level++) {
+        printf("  %-10s %6d frames\n", qualityLadder[level].name, framesAtLevel[level]);
+    }
+    return 0;
+}
@@ -0,0 +1,282 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+
+/*
+ * Host-side benchmark of the render queue on Mesa: draws are recorded as packets by one or
+ * more threads, sorted by key and replayed with redundant state changes filtered out. The
+ * same draws issued in recording order with all their state, as MyCube used to draw, are
+ * the baseline. Draws are tiny triangles into a small framebuffer so that the CPU side
+ * dominates.
+ *
+ * Build from the repository root:
+ *   C=app/src/main/jni/nativeCode/common
+ *   g++ -std=c++11 -O2 -DNDEBUG -Itools/include -I$C -Iapp/src/main/externals/glm-0.9.7.5 \
+ *       tools/renderQueueBenchmark.cpp tools/hostGL.cpp $C/myRenderQueue.cpp \
+ *       $C/myUniformBuffers.cpp $C/myStreamBuffer.cpp $C/myGPUResources.cpp $C/myShader.cpp \
+ *       $C/myGLFunctions.cpp $C/myGLES31.cpp $C/myAssetPack.cpp $C/myLZ4.cpp $C/misc.cpp \
+ *       -lEGL -lGLESv2 -lpthread -o renderQueueBenchmark
+ *
+ * Usage:
+ *   renderQueueBenchmark [threads]    recording threads, 4 by default
+ */
+
+#include "hostGL.h"
+#include "myGPUResources.h"
+#include "myRenderQueue.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// repeat short measurements until they take this long
+#define MIN_MEASURE_MS      200.0
+#define NUM_PROGRAMS        8
+#define NUM_BUFFERS         64
+#define TARGET_SIZE         64
+#define MAX_THREADS         16
+
+struct Scene {
+    std::vector<GLuint>     programs, buffers;
+    std::vector<GLint>      mvpLocations;
+    std::vector<glm::mat4>  modelMats;
+    std::vector<int>        drawProgram, drawBuffer;
+    glm::mat4               projectionViewMat;
+};
+
+struct RecordThread {
+    const Scene *   scene;
+    MyRenderQueue * queue;
+    int             threadIndex, begin, end;
+};
+
+static double GetTimeMs() {
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000.0 + now.tv_nsec / 1000000.0;
+}
+
+static uint32_t NextRandom(uint32_t & state) {
+
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+static void CreateScene(MyGPUResources & resources, Scene & scene, int drawCount) {
+
+    AttributeBindings attributes(1, std::make_pair(std::string("vertexPosition"), 0u));
+    for (int i = 0; i < NUM_PROGRAMS; i++) {
+        char fragmentSource[128];
+        snprintf(fragmentSource, sizeof(fragmentSource), "precision mediump float;\n"
+                 "void main() { gl_FragColor = vec4(%.3f); }\n", (i + 1.0f) / NUM_PROGRAMS);
+        GPUHandle program = resources.CreateProgram(
+                "attribute vec3 vertexPosition;\nuniform mat4 mvpMat;\n"
+                "void main() { gl_Position = mvpMat * vec4(vertexPosition, 1.0); }\n",
+                fragmentSource, attributes);
+        scene.programs.push_back(resources.GetName(program));
+        scene.mvpLocations.push_back(glGetUniformLocation(scene.programs.back(), "mvpMat"));
+    }
+
+    uint32_t random = 12345;
+    for (int i = 0; i < NUM_BUFFERS; i++) {
+        float triangle[9];
+        for (int v = 0; v < 9; v++) {
+            triangle[v] = (NextRandom(random) % 1000) / 50000.0f;
+        }
+        GPUHandle buffer = resources.CreateBuffer(GL_ARRAY_BUFFER, GL_STATIC_DRAW, false);
+        resources.BufferData(buffer, sizeof(triangle), triangle);
+        scene.buffers.push_back(resources.GetName(buffer));
+    }
+
+    scene.projectionViewMat = glm::perspective(1.0f, 1.0f, 0.1f, 100.0f) *
+                              glm::lookAt(glm::vec3(0, 0, 10), glm::vec3(0), glm::vec3(0, 1, 0));
+    for (int i = 0; i < drawCount; i++) {
+        glm::vec3 position((NextRandom(random) % 2000) / 200.0f - 5.0f,
+                           (NextRandom(random) % 2000) / 200.0f - 5.0f,
+                           (NextRandom(random) % 2000) / 200.0f - 5.0f);
+        scene.modelMats.push_back(glm::translate(glm::mat4(1.0f), position));
+        scene.drawProgram.push_back(NextRandom(random) % NUM_PROGRAMS);
+        scene.drawBuffer.push_back(NextRandom(random) % NUM_BUFFERS);
+    }
+}
+
+static void MakePacket(const Scene & scene, int draw, DrawPacket & packet) {
+
+    int program = scene.drawProgram[draw];
+    packet = DrawPacket();
+    packet.programID = scene.programs[program];
+    packet.vertexBuffer = scene.buffers[scene.drawBuffer[draw]];
+    packet.vertexComponents = 3;
+    packet.mvpLocation = scene.mvpLocations[program];
+    packet.mvpMat = scene.projectionViewMat * scene.modelMats[draw];
+    packet.primitiveMode = GL_TRIANGLES;
+    packet.elementCount = 3;
+    float depth = packet.mvpMat[3][2] / packet.mvpMat[3][3] / 100.0f;
+    packet.sortKey = MyRenderQueue::MakeSortKey(0, packet.programID, packet.vertexBuffer, depth);
+}
+
+static void * RecordDraws(void * arg) {
+
+    RecordThread * thread = (RecordThread *) arg;
+    DrawPacket packet;
+    for (int i = thread->begin; i < thread->end; i++) {
+        MakePacket(*thread->scene, i, packet);
+        thread->queue->Record(thread->threadIndex, packet);
+    }
+    return NULL;
+}
+
+static void RecordFrame(const Scene & scene, MyRenderQueue & queue, int threadCount) {
+
+    int drawCount = (int) scene.modelMats.size();
+    RecordThread threads[MAX_THREADS];
+    pthread_t handles[MAX_THREADS];
+    queue.BeginFrame();
+    for (int t = 0; t < threadCount; t++) {
+        threads[t].scene = &scene;
+        threads[t].queue = &queue;
+        threads[t].threadIndex = t;
+        threads[t].begin = drawCount * t / threadCount;
+        threads[t].end = drawCount * (t + 1) / threadCount;
+        if (t > 0) {
+            pthread_create(&handles[t], NULL, RecordDraws, &threads[t]);
+        }
+    }
+    RecordDraws(&threads[0]);
+    for (int t = 1; t < threadCount; t++) {
+        pthread_join(handles[t], NULL);
+    }
+}
+
+/**
+ * What drawing without the queue costs: every draw sets all of its state
+ */
+static void IssueDirectly(const Scene & scene) {
+
+    DrawPacket packet;
+    for (size_t i = 0; i < scene.modelMats.size(); i++) {
+        MakePacket(scene, (int) i, packet);
+        glUseProgram(packet.programID);
+        glUniformMatrix4fv(packet.mvpLocation, 1, GL_FALSE, (const GLfloat *) &packet.mvpMat);
+        glBindBuffer(GL_ARRAY_BUFFER, packet.vertexBuffer);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, packet.vertexComponents, GL_FLOAT, GL_FALSE, 0, 0);
+        glDrawArrays(packet.primitiveMode, packet.firstElement, packet.elementCount);
+        glDisableVertexAttribArray(0);
+    }
+}
+
+int main(int argc, char ** argv) {
+
+    int threadCount = argc > 1 ? atoi(argv[1]) : 4;
+    if (threadCount < 1 || threadCount > MAX_THREADS) {
+        fprintf(stderr, "usage: %s [threads], at most %d\n", argv[0], MAX_THREADS);
+        return 1;
+    }
+    if (!CreateHostGLContext()) {
+        return 1;
+    }
+
+    // tiny offscreen target, draws are valid but rasterize next to nothing
+    GLuint framebuffer, renderbuffers[2];
+    glGenFramebuffers(1, &framebuffer);
+    glGenRenderbuffers(2, renderbuffers);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, TARGET_SIZE, TARGET_SIZE);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT16, TARGET_SIZE, TARGET_SIZE);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER,
+                              renderbuffers[0]);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER,
+                              renderbuffers[1]);
+    glViewport(0, 0, TARGET_SIZE, TARGET_SIZE);
+
+    const int drawCounts[] = { 10000, 100000 };
+    for (int c = 0; c < 2; c++) {
+        MyGPUResources resources;
+        resources.CreateGLObjects();
+        Scene scene;
+        CreateScene(resources, scene, drawCounts[c]);
+        MyRenderQueue queue(threadCount);
+
+        // warm-up frames size the packet lists and sort buffers and let the driver build
+        // its shader variants
+        RecordFrame(scene, queue, 1);
+        RecordFrame(scene, queue, threadCount);
+        queue.Submit();
+        IssueDirectly(scene);
+        glFinish();
+
+        int frames = 0;
+        double startMs = GetTimeMs();
+        do {
+            RecordFrame(scene, queue, 1);
+            frames++;
+        } while (GetTimeMs() - startMs < MIN_MEASURE_MS);
+        double oneThreadMs = (GetTimeMs() - startMs) / frames;
+
+        frames = 0;
+        startMs = GetTimeMs();
+        do {
+            RecordFrame(scene, queue, threadCount);
+            frames++;
+        } while (GetTimeMs() - startMs < MIN_MEASURE_MS);
+        double recordMs = (GetTimeMs() - startMs) / frames;
+
+        // the GPU's work is left out, only what the GL thread spends issuing is counted
+        frames = 0;
+        double submitMs = 0;
+        startMs = GetTimeMs();
+        do {
+            queue.Submit();
+            submitMs += queue.GetStats().submitTimeMs;
+            glFinish();
+            frames++;
+        } while (GetTimeMs() - startMs < MIN_MEASURE_MS);
+        submitMs /= frames;
+
+        frames = 0;
+        double directMs = 0;
+        startMs = GetTimeMs();
+        do {
+            double issueStartMs = GetTimeMs();
+            IssueDirectly(scene);
+            directMs += GetTimeMs() - issueStartMs;
+            glFinish();
+            frames++;
+        } while (GetTimeMs() - startMs < MIN_MEASURE_MS);
+        directMs /= frames;
+
+        const RenderQueueStats & stats = queue.GetStats();
+        printf("%d draws, %d programs, %d buffers:\n", drawCounts[c], NUM_PROGRAMS, NUM_BUFFERS);
+        printf("  record  %7.2f ms on 1 thread, %7.2f ms on %d\n", oneThreadMs, recordMs,
+               threadCount);
+        printf("  submit  %7.2f ms, %d program changes, %d buffer binds\n", submitMs,
+               stats.programChanges, stats.bufferBinds);
+        printf("  direct  %7.2f ms, %d program changes, %d buffer binds\n", directMs,
+               drawCounts[c], drawCounts[c]);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteRenderbuffers(2, renderbuffers);
+    glDeleteFramebuffers(1, &framebuffer);
+    DestroyHostGLContext();
+    return 0;
+}
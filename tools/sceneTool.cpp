@@ -0,0 +1,647 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+
+/*
+ * Host-side tool for scene files: converts the JSON form of a scene to the binary one
+ * MyScene maps, prints a binary scene as JSON, and compares opening a large scene in both
+ * forms. The JSON form is:
+ *
+ *   {"version": 1,
+ *    "meshes": [{"name": "cube"}],
+ *    "materials": [{"name": "colors", "texture": "", "color": [1, 1, 1, 1]}],
+ *    "nodes": [{"name": "cube", "parent": -1, "mesh": 0, "material": 0,
+ *               "translation": [0, 0, 0], "rotation": [0, 0, 0, 1], "scale": 1}]}
+ *
+ * with rotations as x, y, z, w quaternions, and parents, meshes and materials as indices
+ * or -1. A node's parent has to come before it.
+ *
+ * Build from the repository root:
+ *   g++ -std=c++11 -O2 -Iapp/src/main/jni/nativeCode/common \
+ *       -Iapp/src/main/externals/glm-0.9.7.5 tools/sceneTool.cpp \
+ *       app/src/main/jni/nativeCode/common/myScene.cpp \
+ *       app/src/main/jni/nativeCode/common/myTransform.cpp -o sceneTool
+ *
+ * Usage:
+ *   sceneTool convert tools/scenes/cube.json app/src/main/assets/scenes/cube.scene
+ *   sceneTool dump file.scene
+ *   sceneTool bench [nodes]          100000 nodes by default
+ */
+
+#include "myScene.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEFAULT_NODES       100000
+// repeat short measurements until they take this long
+#define MIN_MEASURE_MS      200.0
+#define BENCH_MESHES        64
+#define BENCH_MATERIALS     32
+// nodes of the benchmark have a parent among this many nodes before them
+#define BENCH_PARENT_RANGE  64
+
+static double GetTimeMs() {
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000.0 + now.tv_nsec / 1000000.0;
+}
+
+static uint32_t NextRandom(uint32_t & seed) {
+
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+static bool ReadFile(const char * fileName, std::string & data) {
+
+    FILE * file = fopen(fileName, "rb");
+    if (!file) {
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    data.resize(size > 0 ? (size_t) size : 0);
+    bool result = size >= 0 && (size == 0 || fread(&data[0], 1, data.size(), file) == data.size());
+    fclose(file);
+    return result;
+}
+
+static bool WriteFile(const char * fileName, const void * data, size_t size) {
+
+    FILE * file = fopen(fileName, "wb");
+    if (!file) {
+        return false;
+    }
+    bool result = size == 0 || fwrite(data, 1, size, file) == size;
+    return fclose(file) == 0 && result;
+}
+
+static bool MapFile(const char * fileName, const uint8_t ** data, size_t * size) {
+
+    int fd = open(fileName, O_RDONLY);
+    struct stat status;
+    if (fd < 0 || fstat(fd, &status) != 0 || status.st_size == 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return false;
+    }
+    void * mapped = mmap(NULL, (size_t) status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        return false;
+    }
+    *data = (const uint8_t *) mapped;
+    *size = (size_t) status.st_size;
+    return true;
+}
+
+/**
+ * Reads the JSON form of a scene straight into a builder, without building a document
+ * first. Keys it does not know are skipped.
+ */
+class JsonSceneReader {
+public:
+    JsonSceneReader(const std::string & text) {
+        position = text.c_str();
+        failed = false;
+    }
+    bool    Read(MySceneBuilder & builder, std::string & error);
+
+private:
+    void    SkipSpace();
+    bool    Accept(char c);
+    void    Expect(char c);
+    std::string ReadString();
+    double  ReadNumber();
+    void    ReadNumbers(float * values, int count);
+    void    SkipValue();
+    bool    NextMember(bool & first, std::string & key);
+    bool    NextItem(bool & first);
+    void    ReadMesh(MySceneBuilder & builder);
+    void    ReadMaterial(MySceneBuilder & builder);
+    void    ReadNode(MySceneBuilder & builder);
+
+    const char *    position;
+    bool            failed;
+};
+
+void JsonSceneReader::SkipSpace() {
+
+    while (*position == ' ' || *position == '\n' || *position == '\r' || *position == '\t') {
+        position++;
+    }
+}
+
+bool JsonSceneReader::Accept(char c) {
+
+    SkipSpace();
+    if (*position != c) {
+        return false;
+    }
+    position++;
+    return true;
+}
+
+void JsonSceneReader::Expect(char c) {
+
+    if (!Accept(c)) {
+        failed = true;
+    }
+}
+
+std::string JsonSceneReader::ReadString() {
+
+    std::string value;
+    Expect('"');
+    while (!failed && *position != '"') {
+        char c = *position++;
+        if (c == 0 || (uint8_t) c < 0x20) {
+            failed = true;
+        } else if (c != '\\') {
+            value += c;
+        } else {
+            c = *position++;
+            if (c == 'n') {
+                value += '\n';
+            } else if (c == 't') {
+                value += '\t';
+            } else if (c == 'u' && strspn(position, "0123456789abcdefABCDEF") >= 4 &&
+                       strtol(std::string(position, 4).c_str(), NULL, 16) < 0x80) {
+                // names are written with ASCII escapes only
+                value += (char) strtol(std::string(position, 4).c_str(), NULL, 16);
+                position += 4;
+            } else if (c == '"' || c == '\\' || c == '/') {
+                value += c;
+            } else {
+                failed = true;
+            }
+        }
+    }
+    if (!failed) {
+        position++;
+    }
+    return value;
+}
+
+double JsonSceneReader::ReadNumber() {
+
+    SkipSpace();
+    char * end;
+    double value = strtod(position, &end);
+    if (end == position) {
+        failed = true;
+    }
+    position = end;
+    return value;
+}
+
+void JsonSceneReader::ReadNumbers(float * values, int count) {
+
+    Expect('[');
+    for (int i = 0; i < count && !failed; i++) {
+        if (i > 0) {
+            Expect(',');
+        }
+        values[i] = (float) ReadNumber();
+    }
+    Expect(']');
+}
+
+void JsonSceneReader::SkipValue() {
+
+    SkipSpace();
+    if (*position == '"') {
+        ReadString();
+    } else if (Accept('[')) {
+        bool first = true;
+        while (NextItem(first)) {
+            SkipValue();
+        }
+    } else if (Accept('{')) {
+        bool first = true;
+        std::string key;
+        while (NextMember(first, key)) {
+            SkipValue();
+        }
+    } else if (strncmp(position, "true", 4) == 0 || strncmp(position, "null", 4) == 0) {
+        position += 4;
+    } else if (strncmp(position, "false", 5) == 0) {
+        position += 5;
+    } else {
+        ReadNumber();
+    }
+}
+
+// reads up to the value of the next member of an object, false at its end
+bool JsonSceneReader::NextMember(bool & first, std::string & key) {
+
+    if (failed || Accept('}')) {
+        return false;
+    }
+    if (!first) {
+        Expect(',');
+    }
+    first = false;
+    key = ReadString();
+    Expect(':');
+    return !failed;
+}
+
+// reads up to the next item of an array, false at its end
+bool JsonSceneReader::NextItem(bool & first) {
+
+    if (failed || Accept(']')) {
+        return false;
+    }
+    if (!first) {
+        Expect(',');
+    }
+    first = false;
+    return !failed;
+}
+
+void JsonSceneReader::ReadMesh(MySceneBuilder & builder) {
+
+    std::string key, name;
+    bool first = true;
+    Expect('{');
+    while (NextMember(first, key)) {
+        if (key == "name") {
+            name = ReadString();
+        } else {
+            SkipValue();
+        }
+    }
+    builder.AddMesh(name);
+}
+
+void JsonSceneReader::ReadMaterial(MySceneBuilder & builder) {
+
+    std::string key, name, texture;
+    float color[4] = {1, 1, 1, 1};
+    bool first = true;
+    Expect('{');
+    while (NextMember(first, key)) {
+        if (key == "name") {
+            name = ReadString();
+        } else if (key == "texture") {
+            texture = ReadString();
+        } else if (key == "color") {
+            ReadNumbers(color, 4);
+        } else {
+            SkipValue();
+        }
+    }
+    builder.AddMaterial(name, texture, color);
+}
+
+void JsonSceneReader::ReadNode(MySceneBuilder & builder) {
+
+    std::string key, name;
+    int parent = SCENE_NONE, mesh = SCENE_NONE, material = SCENE_NONE;
+    MyTransform transform;
+    float values[4];
+    bool first = true;
+    Expect('{');
+    while (NextMember(first, key)) {
+        if (key == "name") {
+            name = ReadString();
+        } else if (key == "parent") {
+            parent = (int) ReadNumber();
+        } else if (key == "mesh") {
+            mesh = (int) ReadNumber();
+        } else if (key == "material") {
+            material = (int) ReadNumber();
+        } else if (key == "translation") {
+            ReadNumbers(values, 3);
+            transform.translation = glm::vec3(values[0], values[1], values[2]);
+        } else if (key == "rotation") {
+            ReadNumbers(values, 4);
+            transform.rotation = glm::quat(values[3], values[0], values[1], values[2]);
+        } else if (key == "scale") {
+            transform.scale = (float) ReadNumber();
+        } else {
+            SkipValue();
+        }
+    }
+    if (!failed && builder.AddNode(name, parent, transform, mesh, material) == SCENE_NONE) {
+        failed = true;
+    }
+}
+
+/**
+ * Add the scene to builder, returns false with where it stopped in error if the text is not
+ * a valid scene
+ */
+bool JsonSceneReader::Read(MySceneBuilder & builder, std::string & error) {
+
+    const char * start = position;
+    std::string key;
+    bool first = true;
+    Expect('{');
+    while (NextMember(first, key)) {
+        bool firstItem = true;
+        if (key == "version") {
+            failed |= ReadNumber() != SCENE_VERSION;
+        } else if (key == "meshes") {
+            Expect('[');
+            while (NextItem(firstItem)) {
+                ReadMesh(builder);
+            }
+        } else if (key == "materials") {
+            Expect('[');
+            while (NextItem(firstItem)) {
+                ReadMaterial(builder);
+            }
+        } else if (key == "nodes") {
+            Expect('[');
+            while (NextItem(firstItem)) {
+                ReadNode(builder);
+            }
+        } else {
+            SkipValue();
+        }
+    }
+    if (failed) {
+        error = "invalid scene at byte " + std::to_string(position - start);
+    }
+    return !failed;
+}
+
+static void WriteJsonString(std::string & json, const char * value) {
+
+    json += '"';
+    for (; *value; value++) {
+        if (*value == '"' || *value == '\\') {
+            json += '\\';
+            json += *value;
+        } else if ((uint8_t) *value < 0x20) {
+            char escape[8];
+            snprintf(escape, sizeof(escape), "\\u%04x", *value);
+            json += escape;
+        } else {
+            json += *value;
+        }
+    }
+    json += '"';
+}
+
+// floats are written with enough digits to read back exactly
+static void WriteJsonNumbers(std::string & json, const float * values, int count) {
+
+    char number[32];
+    json += '[';
+    for (int i = 0; i < count; i++) {
+        snprintf(number, sizeof(number), i ? ", %.9g" : "%.9g", values[i]);
+        json += number;
+    }
+    json += ']';
+}
+
+static void WriteJson(const MyScene & scene, std::string & json) {
+
+    char number[64];
+    snprintf(number, sizeof(number), "{\"version\": %d,\n \"meshes\": [", SCENE_VERSION);
+    json = number;
+    for (int i = 0; i < scene.GetMeshCount(); i++) {
+        json += i ? ",\n  {\"name\": " : "\n  {\"name\": ";
+        WriteJsonString(json, scene.GetString(scene.GetMesh(i).name));
+        json += '}';
+    }
+    json += "],\n \"materials\": [";
+    for (int i = 0; i < scene.GetMaterialCount(); i++) {
+        const SceneMaterial & material = scene.GetMaterial(i);
+        json += i ? ",\n  {\"name\": " : "\n  {\"name\": ";
+        WriteJsonString(json, scene.GetString(material.name));
+        json += ", \"texture\": ";
+        WriteJsonString(json, scene.GetString(material.texture));
+        json += ", \"color\": ";
+        WriteJsonNumbers(json, material.color, 4);
+        json += '}';
+    }
+    json += "],\n \"nodes\": [";
+    for (int i = 0; i < scene.GetNodeCount(); i++) {
+        const SceneNode & node = scene.GetNode(i);
+        const MyTransform & t = node.transform;
+        json += i ? ",\n  {\"name\": " : "\n  {\"name\": ";
+        WriteJsonString(json, scene.GetString(node.name));
+        snprintf(number, sizeof(number), ", \"parent\": %d, \"mesh\": %d, \"material\": %d",
+                 node.parent, node.mesh, node.material);
+        json += number;
+        float translation[] = {t.translation.x, t.translation.y, t.translation.z};
+        float rotation[] = {t.rotation.x, t.rotation.y, t.rotation.z, t.rotation.w};
+        json += ", \"translation\": ";
+        WriteJsonNumbers(json, translation, 3);
+        json += ", \"rotation\": ";
+        WriteJsonNumbers(json, rotation, 4);
+        snprintf(number, sizeof(number), ", \"scale\": %.9g}", t.scale);
+        json += number;
+    }
+    json += "]}\n";
+}
+
+static int Convert(const char * jsonName, const char * sceneName) {
+
+    std::string json, error;
+    if (!ReadFile(jsonName, json)) {
+        fprintf(stderr, "cannot read %s\n", jsonName);
+        return 1;
+    }
+    MySceneBuilder builder;
+    JsonSceneReader reader(json);
+    if (!reader.Read(builder, error)) {
+        fprintf(stderr, "%s: %s\n", jsonName, error.c_str());
+        return 1;
+    }
+    std::vector<uint8_t> file;
+    builder.Write(file);
+    if (!WriteFile(sceneName, &file[0], file.size())) {
+        fprintf(stderr, "cannot write %s\n", sceneName);
+        return 1;
+    }
+    printf("%d nodes, %d bytes\n", builder.GetNodeCount(), (int) file.size());
+    return 0;
+}
+
+static int Dump(const char * sceneName) {
+
+    const uint8_t * data;
+    size_t size;
+    if (!MapFile(sceneName, &data, &size)) {
+        fprintf(stderr, "cannot read %s\n", sceneName);
+        return 1;
+    }
+    MyScene scene;
+    std::string error, json;
+    if (!scene.Open(data, size, error)) {
+        fprintf(stderr, "%s: %s\n", sceneName, error.c_str());
+        return 1;
+    }
+    WriteJson(scene, json);
+    fputs(json.c_str(), stdout);
+    munmap((void *) data, size);
+    return 0;
+}
+
+static void MakeBenchScene(int nodeCount, MySceneBuilder & builder) {
+
+    uint32_t seed = 12345;
+    char name[64];
+    for (int i = 0; i < BENCH_MESHES; i++) {
+        snprintf(name, sizeof(name), "meshes/mesh%d.bin", i);
+        builder.AddMesh(name);
+    }
+    for (int i = 0; i < BENCH_MATERIALS; i++) {
+        float color[] = {(NextRandom(seed) % 256) / 255.0f, (NextRandom(seed) % 256) / 255.0f,
+                         (NextRandom(seed) % 256) / 255.0f, 1};
+        snprintf(name, sizeof(name), "textures/texture%d.ktx", i);
+        std::string texture = name;
+        snprintf(name, sizeof(name), "material%d", i);
+        builder.AddMaterial(name, texture, color);
+    }
+    for (int i = 0; i < nodeCount; i++) {
+        MyTransform transform;
+        transform.translation = glm::vec3((NextRandom(seed) % 2001) / 100.0f - 10,
+                                          (NextRandom(seed) % 2001) / 100.0f - 10,
+                                          (NextRandom(seed) % 2001) / 100.0f - 10);
+        glm::vec3 axis((NextRandom(seed) % 200) / 100.0f - 1, (NextRandom(seed) % 200) / 100.0f - 1,
+                       1);
+        transform.rotation = glm::angleAxis((NextRandom(seed) % 628) / 100.0f,
+                                            glm::normalize(axis));
+        transform.scale = 0.5f + (NextRandom(seed) % 100) / 100.0f;
+        int parent = SCENE_NONE;
+        if (i > 0 && NextRandom(seed) % 16 != 0) {
+            parent = i - 1 - (int) (NextRandom(seed) % glm::min(i, BENCH_PARENT_RANGE));
+        }
+        // group nodes have no mesh
+        bool group = NextRandom(seed) % 4 == 0;
+        snprintf(name, sizeof(name), "node%d", i);
+        builder.AddNode(name, parent, transform,
+                        group ? SCENE_NONE : (int) (NextRandom(seed) % BENCH_MESHES),
+                        group ? SCENE_NONE : (int) (NextRandom(seed) % BENCH_MATERIALS));
+    }
+}
+
+static int Bench(int nodeCount) {
+
+    MySceneBuilder builder;
+    MakeBenchScene(nodeCount, builder);
+    std::vector<uint8_t> file;
+    builder.Write(file);
+    MyScene scene;
+    std::string error, json;
+    if (!scene.Open(&file[0], file.size(), error)) {
+        fprintf(stderr, "built an invalid scene: %s\n", error.c_str());
+        return 1;
+    }
+    WriteJson(scene, json);
+    char sceneName[] = "/tmp/sceneToolXXXXXX";
+    int fd = mkstemp(sceneName);
+    if (fd < 0) {
+        fprintf(stderr, "cannot create a temporary file\n");
+        return 1;
+    }
+    close(fd);
+    std::string jsonName = std::string(sceneName) + ".json";
+    if (!WriteFile(sceneName, &file[0], file.size()) ||
+        !WriteFile(jsonName.c_str(), json.c_str(), json.size())) {
+        fprintf(stderr, "cannot write %s\n", sceneName);
+        unlink(sceneName);
+        return 1;
+    }
+    printf("%d nodes: scene %.1f KB, JSON %.1f KB\n", nodeCount, file.size() / 1024.0,
+           json.size() / 1024.0);
+
+    // JSON: read the file and parse it into nodes, a builder's list is as usable as it gets
+    int runs = 0;
+    bool same = true;
+    double startMs = GetTimeMs();
+    do {
+        std::string text;
+        MySceneBuilder jsonBuilder;
+        ReadFile(jsonName.c_str(), text);
+        JsonSceneReader reader(text);
+        same &= reader.Read(jsonBuilder, error);
+        if (runs == 0) {
+            // the JSON has to hold the same scene, written back it matches byte for byte
+            std::vector<uint8_t> rewritten;
+            jsonBuilder.Write(rewritten);
+            same &= rewritten == file;
+        }
+        runs++;
+    } while (GetTimeMs() - startMs < MIN_MEASURE_MS);
+    double jsonMs = (GetTimeMs() - startMs) / runs;
+
+    // scene: map the file and check it, which touches every node once
+    runs = 0;
+    startMs = GetTimeMs();
+    do {
+        const uint8_t * data;
+        size_t size;
+        MyScene mapped;
+        same &= MapFile(sceneName, &data, &size) && mapped.Open(data, size, error) &&
+                mapped.GetNodeCount() == nodeCount;
+        munmap((void *) data, size);
+        runs++;
+    } while (GetTimeMs() - startMs < MIN_MEASURE_MS);
+    double sceneMs = (GetTimeMs() - startMs) / runs;
+
+    // the first use of the scene either way
+    std::vector<MyTransform> world;
+    runs = 0;
+    startMs = GetTimeMs();
+    do {
+        scene.ComputeWorldTransforms(world);
+        runs++;
+    } while (GetTimeMs() - startMs < MIN_MEASURE_MS);
+    double worldMs = (GetTimeMs() - startMs) / runs;
+
+    printf("open JSON %.2f ms, mapped scene %.3f ms (%.0fx), world transforms %.2f ms, "
+           "same content: %s\n", jsonMs, sceneMs, jsonMs / sceneMs, worldMs, same ? "yes" : "NO");
+    unlink(sceneName);
+    unlink(jsonName.c_str());
+    return same ? 0 : 1;
+}
+
+int main(int argc, char ** argv) {
+
+    if (argc == 4 && strcmp(argv[1], "convert") == 0) {
+        return Convert(argv[2], argv[3]);
+    }
+    if (argc == 3 && strcmp(argv[1], "dump") == 0) {
+        return Dump(argv[2]);
+    }
+    if ((argc == 2 || argc == 3) && strcmp(argv[1], "bench") == 0) {
+        int nodeCount = argc > 2 ? atoi(argv[2]) : DEFAULT_NODES;
+        if (nodeCount > 0) {
+            return Bench(nodeCount);
+        }
+    }
+    fprintf(stderr, "usage: %s convert scene.json out.scene | dump file.scene | "
+            "bench [nodes]\n", argv[0]);
+    return 1;
+}
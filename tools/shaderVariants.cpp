@@ -0,0 +1,216 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+
+/*
+ * Build-time check of the shader variants: preprocesses every variant the app uses, as
+ * listed in assets/shaders/variants.txt, and compiles and links it with the host's
+ * GLES driver through EGL, so that a broken permutation fails here and not on a device.
+ *
+ * Build from the repository root:
+ *   g++ -std=c++11 -O2 -Iapp/src/main/jni/nativeCode/common tools/shaderVariants.cpp \
+ *       app/src/main/jni/nativeCode/common/myShaderVariants.cpp -lEGL -lGLESv2 \
+ *       -o shaderVariants
+ *
+ * Usage:
+ *   shaderVariants [--all] [assets directory, default app/src/main/assets]
+ *   --all checks every valid combination of features instead of the listed ones.
+ *   Exits with 1 if any variant fails.
+ */
+
+#include "myShaderVariants.h"
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES3/gl3.h>
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+#include <string.h>
+
+static std::string assetDirectory = "app/src/main/assets";
+
+static bool ReadAsset(const std::string & fileName, std::string & code) {
+
+    std::ifstream file((assetDirectory + "/" + fileName).c_str());
+    if (!file.is_open()) {
+        return false;
+    }
+    std::stringstream contents;
+    contents << file.rdbuf();
+    code = contents.str();
+    return true;
+}
+
+/**
+ * Make a GLES 3 context current, it compiles GLSL ES 1.00 as well. Prefers Mesa's
+ * surfaceless platform so that no display is needed.
+ */
+static bool CreateContext() {
+
+    EGLDisplay display = EGL_NO_DISPLAY;
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+            (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+    if (getPlatformDisplay) {
+        display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    }
+#endif
+    EGLint major, minor;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+            return false;
+        }
+    }
+    eglBindAPI(EGL_OPENGL_ES_API);
+
+    EGLint configAttributes[] = {EGL_RENDERABLE_TYPE, EGL_OPENGL_ES3_BIT_KHR,
+                                 EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_NONE};
+    EGLConfig config;
+    EGLint configCount = 0;
+    if (!eglChooseConfig(display, configAttributes, &config, 1, &configCount) ||
+        configCount < 1) {
+        return false;
+    }
+    EGLint contextAttributes[] = {EGL_CONTEXT_CLIENT_VERSION, 3, EGL_NONE};
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+    if (context == EGL_NO_CONTEXT) {
+        return false;
+    }
+    EGLint surfaceAttributes[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+    EGLSurface surface = eglCreatePbufferSurface(display, config, surfaceAttributes);
+    return eglMakeCurrent(display, surface, surface, context) == EGL_TRUE;
+}
+
+static GLuint CompileStage(GLenum type, const std::string & source, std::string & log) {
+
+    GLuint shader = glCreateShader(type);
+    const char * sourcePointer = source.c_str();
+    glShaderSource(shader, 1, &sourcePointer, NULL);
+    glCompileShader(shader);
+    GLint status = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if (!status) {
+        char message[4096];
+        glGetShaderInfoLog(shader, sizeof(message), NULL, message);
+        log += message;
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+/**
+ * Preprocess, compile and link one variant. Returns false and prints why if any step fails.
+ */
+static bool CheckVariant(const ShaderVariant & variant) {
+
+    std::string name = GetShaderVariantName(variant), error;
+    if (!IsValidShaderVariant(variant, error)) {
+        printf("FAIL  %s: %s\n", name.c_str(), error.c_str());
+        return false;
+    }
+
+    const ShaderProgramDesc & desc = GetShaderProgramDesc(variant.program);
+    std::string vertexSource, fragmentSource;
+    std::vector<std::string> vertexFiles, fragmentFiles;
+    if (!PreprocessShader(ReadAsset, desc.vertexShader, SHADER_STAGE_VERTEX, variant.features,
+                          vertexSource, vertexFiles, error) ||
+        !PreprocessShader(ReadAsset, desc.fragmentShader, SHADER_STAGE_FRAGMENT,
+                          variant.features, fragmentSource, fragmentFiles, error)) {
+        printf("FAIL  %s: %s\n", name.c_str(), error.c_str());
+        return false;
+    }
+
+    std::string log;
+    GLuint vertexShader = CompileStage(GL_VERTEX_SHADER, vertexSource, log);
+    GLuint fragmentShader = CompileStage(GL_FRAGMENT_SHADER, fragmentSource, log);
+    GLint linked = GL_FALSE;
+    if (vertexShader && fragmentShader) {
+        GLuint program = glCreateProgram();
+        glAttachShader(program, vertexShader);
+        glAttachShader(program, fragmentShader);
+        glLinkProgram(program);
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (!linked) {
+            char message[4096];
+            glGetProgramInfoLog(program, sizeof(message), NULL, message);
+            log += message;
+        }
+        glDeleteProgram(program);
+    }
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+
+    if (!linked) {
+        printf("FAIL  %s\n%s", name.c_str(), log.c_str());
+        for (size_t i = 0; i < vertexFiles.size(); i++) {
+            printf("      vertex source %d: %s\n", (int) i, vertexFiles[i].c_str());
+        }
+        for (size_t i = 0; i < fragmentFiles.size(); i++) {
+            printf("      fragment source %d: %s\n", (int) i, fragmentFiles[i].c_str());
+        }
+        return false;
+    }
+    printf("ok    %s\n", name.c_str());
+    return true;
+}
+
+int main(int argc, char ** argv) {
+
+    bool all = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--all") == 0) {
+            all = true;
+        } else {
+            assetDirectory = argv[i];
+        }
+    }
+
+    std::vector<ShaderVariant> variants;
+    if (all) {
+        EnumerateShaderVariants(variants);
+    } else {
+        std::string listText, error;
+        if (!ReadAsset(SHADER_VARIANT_LIST, listText)) {
+            printf("Cannot read %s/%s\n", assetDirectory.c_str(), SHADER_VARIANT_LIST);
+            return 1;
+        }
+        if (!ParseShaderVariantList(listText, variants, error)) {
+            printf("%s: %s\n", SHADER_VARIANT_LIST, error.c_str());
+            return 1;
+        }
+    }
+
+    if (!CreateContext()) {
+        printf("Cannot create a GLES 3 context to compile with\n");
+        return 1;
+    }
+
+    int failed = 0;
+    for (size_t i = 0; i < variants.size(); i++) {
+        for (size_t j = 0; j < i; j++) {
+            if (variants[j].GetKey() == variants[i].GetKey()) {
+                printf("warning: %s is listed twice\n", GetShaderVariantName(variants[i]).c_str());
+            }
+        }
+        if (!CheckVariant(variants[i])) {
+            failed++;
+        }
+    }
+    printf("%d variants, %d failed\n", (int) variants.size(), failed);
+    return failed ? 1 : 0;
+}
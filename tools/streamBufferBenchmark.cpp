@@ -0,0 +1,173 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+
+/*
+ * Host-side benchmark of MyStreamBuffer on Mesa: sustained upload throughput when every
+ * frame rewrites a few megabytes of vertex data in chunks and draws from each chunk,
+ * against respecifying a buffer with glBufferData for every chunk. Frames are not waited
+ * for, so the ring's fences and waits are exercised as in the app. Each draw only reads a
+ * few points of its chunk, which keeps rasterization out of the numbers.
+ *
+ * Build from the repository root:
+ *   C=app/src/main/jni/nativeCode/common
+ *   g++ -std=c++11 -O2 -DNDEBUG -Itools/include -I$C -Iapp/src/main/externals/glm-0.9.7.5 \
+ *       tools/streamBufferBenchmark.cpp tools/hostGL.cpp $C/myStreamBuffer.cpp \
+ *       $C/myGPUResources.cpp $C/myShader.cpp $C/myGLFunctions.cpp $C/myGLES31.cpp \
+ *       $C/myAssetPack.cpp $C/myLZ4.cpp $C/misc.cpp -lEGL -lGLESv2 -lpthread \
+ *       -o streamBufferBenchmark
+ *
+ * Usage:
+ *   streamBufferBenchmark [frameKB]    data uploaded per frame, 4096 by default
+ */
+
+#include "hostGL.h"
+#include "myStreamBuffer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// each measurement runs for at least this long
+#define MIN_MEASURE_MS      1000.0
+// the ring holds this many frames of data
+#define FRAMES_IN_RING      3
+#define POINTS_PER_DRAW     3
+#define TARGET_SIZE         64
+
+static double GetTimeMs() {
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000.0 + now.tv_nsec / 1000000.0;
+}
+
+static void DrawPoints(GLuint buffer, GLintptr offset) {
+
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, (void *) offset);
+    glDrawArrays(GL_POINTS, 0, POINTS_PER_DRAW);
+}
+
+/**
+ * Upload frameBytes per frame in chunks of chunkBytes, through the ring or with glBufferData,
+ * and return the throughput in MB/s
+ */
+static double MeasureUploads(MyStreamBuffer * streamBuffer, GLuint naiveBuffer,
+                             const std::vector<char> & source, size_t chunkBytes) {
+
+    size_t chunkCount = source.size() / chunkBytes;
+    int frames = 0;
+    double startMs = GetTimeMs();
+    do {
+        for (size_t chunk = 0; chunk < chunkCount; chunk++) {
+            const char * data = &source[chunk * chunkBytes];
+            if (streamBuffer) {
+                GLintptr offset;
+                void * mapped = streamBuffer->Map(chunkBytes, offset);
+                if (!mapped) {
+                    continue;
+                }
+                memcpy(mapped, data, chunkBytes);
+                streamBuffer->Unmap();
+                DrawPoints(streamBuffer->GetBuffer(), offset);
+            } else {
+                glBindBuffer(GL_ARRAY_BUFFER, naiveBuffer);
+                glBufferData(GL_ARRAY_BUFFER, chunkBytes, data, GL_STREAM_DRAW);
+                DrawPoints(naiveBuffer, 0);
+            }
+        }
+        if (streamBuffer) {
+            streamBuffer->EndFrame();
+        }
+        frames++;
+    } while (GetTimeMs() - startMs < MIN_MEASURE_MS);
+    glFinish();
+    double elapsedMs = GetTimeMs() - startMs;
+    return (double) frames * chunkCount * chunkBytes / (1024.0 * 1024.0) / (elapsedMs / 1000.0);
+}
+
+int main(int argc, char ** argv) {
+
+    int frameKB = argc > 1 ? atoi(argv[1]) : 4096;
+    if (frameKB < 64) {
+        fprintf(stderr, "usage: %s [frameKB], at least 64\n", argv[0]);
+        return 1;
+    }
+    if (!CreateHostGLContext()) {
+        return 1;
+    }
+
+    // the draws need a complete framebuffer to run at all
+    GLuint framebuffer, renderbuffer;
+    glGenFramebuffers(1, &framebuffer);
+    glGenRenderbuffers(1, &renderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, TARGET_SIZE, TARGET_SIZE);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER,
+                              renderbuffer);
+    glViewport(0, 0, TARGET_SIZE, TARGET_SIZE);
+
+    MyGPUResources resources;
+    resources.CreateGLObjects();
+    AttributeBindings attributes(1, std::make_pair(std::string("vertexPosition"), 0u));
+    GPUHandle program = resources.CreateProgram(
+            "attribute vec4 vertexPosition;\n"
+            "void main() { gl_Position = vertexPosition; gl_PointSize = 1.0; }\n",
+            "precision mediump float;\nvoid main() { gl_FragColor = vec4(1.0); }\n",
+            attributes);
+    glUseProgram(resources.GetName(program));
+    glEnableVertexAttribArray(0);
+
+    // points inside the clip volume, so that the draws are not trivially rejected
+    std::vector<char> source((size_t) frameKB * 1024);
+    float * values = (float *) &source[0];
+    for (size_t i = 0; i < source.size() / sizeof(float); i++) {
+        values[i] = (i % 4 == 3) ? 1.0f : ((i * 7) % 100) / 100.0f - 0.5f;
+    }
+
+    GLuint naiveBuffer;
+    glGenBuffers(1, &naiveBuffer);
+    printf("%d KB per frame, ring of %d frames\n", frameKB, FRAMES_IN_RING);
+
+    const size_t chunkSizes[] = { 4 * 1024, 64 * 1024, 1024 * 1024 };
+    for (size_t c = 0; c < sizeof(chunkSizes) / sizeof(chunkSizes[0]); c++) {
+        size_t chunkBytes = chunkSizes[c];
+        if (chunkBytes > source.size()) {
+            continue;
+        }
+        MyStreamBuffer streamBuffer(GL_ARRAY_BUFFER, FRAMES_IN_RING * source.size());
+        streamBuffer.CreateGLBuffer(&resources);
+        double ringMBs = MeasureUploads(&streamBuffer, 0, source, chunkBytes);
+        const StreamBufferStats & stats = streamBuffer.GetStats();
+        double naiveMBs = MeasureUploads(NULL, naiveBuffer, source, chunkBytes);
+        printf("%5d KB chunks: ring %7.0f MB/s (%d fence waits, %d orphans, %d failed maps), "
+               "glBufferData %7.0f MB/s\n", (int) (chunkBytes / 1024), ringMBs,
+               stats.fenceWaits, stats.orphans, stats.failedMaps, naiveMBs);
+    }
+
+    GLenum error = glGetError();
+    if (error != GL_NO_ERROR) {
+        fprintf(stderr, "GL error 0x%x\n", error);
+    }
+    glDeleteBuffers(1, &naiveBuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteRenderbuffers(1, &renderbuffer);
+    glDeleteFramebuffers(1, &framebuffer);
+    DestroyHostGLContext();
+    return error == GL_NO_ERROR ? 0 : 1;
+}
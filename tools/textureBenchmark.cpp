@@ -0,0 +1,275 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+
+/*
+ * Host-side benchmark of texture loading: parsing KTX files and decoding them on the CPU,
+ * which the app falls back to when the GPU lacks a format. Synthetic KTX 2 files are
+ * generated for ETC2, EAC and ASTC, or the files given on the command line are mapped and
+ * measured.
+ *
+ * Build from the repository root:
+ *   g++ -std=c++11 -O2 -Iapp/src/main/jni/nativeCode/common tools/textureBenchmark.cpp \
+ *       app/src/main/jni/nativeCode/common/myKTX.cpp \
+ *       app/src/main/jni/nativeCode/common/myTextureDecoder.cpp -lpthread -o textureBenchmark
+ *
+ * Usage:
+ *   textureBenchmark [size] [threads]    synthetic textures of size x size, 1024 by default
+ *   textureBenchmark file.ktx2 ...       mapped files, KTX 1 or 2
+ */
+
+#include "myKTX.h"
+#include "myTextureDecoder.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEFAULT_SIZE        1024
+#define DEFAULT_THREADS     4
+// repeat short measurements until they take this long
+#define MIN_MEASURE_MS      200.0
+
+struct DecodeThread {
+    const KTXImage *        image;
+    std::vector<uint8_t> *  levels;
+    int                     index, count;
+};
+
+static double GetTimeMs() {
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000.0 + now.tv_nsec / 1000000.0;
+}
+
+static uint32_t NextRandom(uint32_t & seed) {
+
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+/**
+ * A valid ASTC block: a weight grid as large as the block, one or two partitions of RGBA
+ * or RGB endpoints and random colors and weights. Modes: 4x4 grid of 3-bit weights, 8x8
+ * grid of 1-bit weights.
+ */
+static void MakeASTCBlock(const TextureFormatInfo & format, uint32_t & seed, uint8_t * block) {
+
+    for (int i = 0; i < 16; i += 4) {
+        uint32_t value = NextRandom(seed);
+        memcpy(block + i, &value, 4);
+    }
+    bool small = format.blockWidth == 4;
+    uint32_t header = small ? 0x53 : 0x544;
+    bool twoPartitions = (NextRandom(seed) & 1) != 0;
+    if (!twoPartitions) {
+        header |= (small ? 12 : 8) << 13;
+    } else {
+        // the same endpoint mode for both, the partition pattern is random
+        header |= 1 << 11;
+        header |= (NextRandom(seed) & 0x3FF) << 13;
+        header |= ((small ? 12 : 8) << 2) << 23;
+    }
+    uint32_t low;
+    memcpy(&low, block, 4);
+    low = (low & ~((1u << (twoPartitions ? 29 : 17)) - 1)) | header;
+    memcpy(block, &low, 4);
+}
+
+/**
+ * A KTX 2 file with a full mip chain of random blocks, levels stored smallest first
+ */
+static void MakeKTX2(const TextureFormatInfo & format, int size, std::vector<uint8_t> & file) {
+
+    int levelCount = 1;
+    while ((size >> levelCount) > 0) {
+        levelCount++;
+    }
+    size_t offset = 80 + 24 * levelCount;
+    std::vector<uint64_t> levelOffsets(levelCount), levelSizes(levelCount);
+    for (int level = levelCount - 1; level >= 0; level--) {
+        int levelSize = size >> level > 1 ? size >> level : 1;
+        levelOffsets[level] = offset;
+        levelSizes[level] = GetLevelSize(format, levelSize, levelSize);
+        offset += (size_t) levelSizes[level];
+    }
+    file.assign(offset, 0);
+
+    static const uint8_t identifier[12] = {
+            0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'
+    };
+    uint32_t header[17] = {format.vkFormat, 1, (uint32_t) size, (uint32_t) size, 0, 0, 1,
+                           (uint32_t) levelCount, 0};
+    memcpy(&file[0], identifier, 12);
+    memcpy(&file[12], header, sizeof(header));
+    for (int level = 0; level < levelCount; level++) {
+        uint64_t index[3] = {levelOffsets[level], levelSizes[level], levelSizes[level]};
+        memcpy(&file[80 + 24 * level], index, sizeof(index));
+    }
+
+    uint32_t seed = 12345;
+    for (size_t i = 80 + 24 * levelCount; i < file.size(); i += format.blockBytes) {
+        if (format.codec == TEXTURE_CODEC_ASTC) {
+            MakeASTCBlock(format, seed, &file[i]);
+            continue;
+        }
+        for (int j = 0; j < format.blockBytes; j += 4) {
+            uint32_t value = NextRandom(seed);
+            memcpy(&file[i + j], &value, 4);
+        }
+    }
+}
+
+static void * DecodeLevels(void * arg) {
+
+    DecodeThread * thread = (DecodeThread *) arg;
+    const KTXImage & image = *thread->image;
+    for (unsigned int level = 0; level < image.levels.size(); level++) {
+        const KTXLevel & source = image.levels[level];
+        int rows = GetBlockRowCount(*image.format, source.height);
+        int firstRow = rows * thread->index / thread->count;
+        int endRow = rows * (thread->index + 1) / thread->count;
+        DecodeBlockRows(*image.format, source.data, source.width, source.height, firstRow,
+                        endRow, &thread->levels[level][0]);
+    }
+    return NULL;
+}
+
+/**
+ * Decode all levels with the block rows split over threads, returns the time of one decode
+ */
+static double MeasureDecode(const KTXImage & image, int threadCount) {
+
+    std::vector<std::vector<uint8_t> > levels(image.levels.size());
+    for (unsigned int level = 0; level < image.levels.size(); level++) {
+        levels[level].resize((size_t) image.levels[level].width * image.levels[level].height * 4);
+    }
+    std::vector<DecodeThread> threads(threadCount);
+    std::vector<pthread_t> handles(threadCount);
+    int runs = 0;
+    double startMs = GetTimeMs();
+    do {
+        for (int i = 0; i < threadCount; i++) {
+            DecodeThread thread = {&image, &levels[0], i, threadCount};
+            threads[i] = thread;
+            pthread_create(&handles[i], NULL, DecodeLevels, &threads[i]);
+        }
+        for (int i = 0; i < threadCount; i++) {
+            pthread_join(handles[i], NULL);
+        }
+        runs++;
+    } while (GetTimeMs() - startMs < MIN_MEASURE_MS);
+    return (GetTimeMs() - startMs) / runs;
+}
+
+static double MeasureParse(const uint8_t * data, size_t size, KTXImage & image) {
+
+    std::string error;
+    int runs = 0;
+    double startMs = GetTimeMs();
+    do {
+        if (!ParseKTX(data, size, image, error)) {
+            printf("  parse error: %s\n", error.c_str());
+            return -1;
+        }
+        runs++;
+    } while (GetTimeMs() - startMs < MIN_MEASURE_MS);
+    return (GetTimeMs() - startMs) / runs;
+}
+
+static void Benchmark(const char * name, const uint8_t * data, size_t size, int threadCount) {
+
+    KTXImage image;
+    double parseMs = MeasureParse(data, size, image);
+    if (parseMs < 0) {
+        return;
+    }
+    size_t compressedBytes = 0, pixels = 0;
+    for (unsigned int level = 0; level < image.levels.size(); level++) {
+        compressedBytes += image.levels[level].size;
+        pixels += (size_t) image.levels[level].width * image.levels[level].height;
+    }
+    double oneThreadMs = MeasureDecode(image, 1);
+    double threadsMs = MeasureDecode(image, threadCount);
+    printf("%-24s %5dx%-5d %2d levels %7.1f KB  parse %6.2f us  decode %7.2f ms "
+           "%6.1f MB/s %6.1f Mpixel/s, %d threads %6.2f ms %6.1f Mpixel/s\n",
+           name, image.width, image.height, (int) image.levels.size(), compressedBytes / 1024.0,
+           parseMs * 1000.0, oneThreadMs, compressedBytes / 1048576.0 / (oneThreadMs / 1000.0),
+           pixels / 1e6 / (oneThreadMs / 1000.0), threadCount, threadsMs,
+           pixels / 1e6 / (threadsMs / 1000.0));
+}
+
+static void BenchmarkFile(const char * fileName, int threadCount) {
+
+    int fd = open(fileName, O_RDONLY);
+    struct stat status;
+    if (fd < 0 || fstat(fd, &status) != 0 || status.st_size == 0) {
+        fprintf(stderr, "cannot read %s\n", fileName);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return;
+    }
+    // mapped like the app maps assets, the parse reads only the header and level index
+    void * data = mmap(NULL, (size_t) status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "cannot map %s\n", fileName);
+        return;
+    }
+    Benchmark(fileName, (const uint8_t *) data, (size_t) status.st_size, threadCount);
+    munmap(data, (size_t) status.st_size);
+}
+
+int main(int argc, char ** argv) {
+
+    if (argc > 1 && atoi(argv[1]) == 0) {
+        for (int i = 1; i < argc; i++) {
+            BenchmarkFile(argv[i], DEFAULT_THREADS);
+        }
+        return 0;
+    }
+
+    int size = argc > 1 ? atoi(argv[1]) : DEFAULT_SIZE;
+    int threadCount = argc > 2 ? atoi(argv[2]) : DEFAULT_THREADS;
+    if (size <= 0 || threadCount <= 0) {
+        fprintf(stderr, "usage: %s [size] [threads] | %s file.ktx2 ...\n", argv[0], argv[0]);
+        return 1;
+    }
+    const GLenum formats[] = {
+            GL_COMPRESSED_RGB8_ETC2, GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2,
+            GL_COMPRESSED_RGBA8_ETC2_EAC, GL_COMPRESSED_R11_EAC, GL_COMPRESSED_RG11_EAC,
+            GL_COMPRESSED_RGBA_ASTC_4x4_KHR, GL_COMPRESSED_RGBA_ASTC_4x4_KHR + 7
+    };
+    const char * names[] = {
+            "ETC2 RGB8", "ETC2 RGB8 A1", "ETC2 RGBA8", "EAC R11", "EAC RG11", "ASTC 4x4",
+            "ASTC 8x8"
+    };
+    for (unsigned int i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+        std::vector<uint8_t> file;
+        MakeKTX2(*FindTextureFormat(formats[i]), size, file);
+        Benchmark(names[i], &file[0], file.size(), threadCount);
+    }
+    return 0;
+}
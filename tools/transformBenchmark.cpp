@@ -0,0 +1,212 @@
+/*
+ *    Copyright 2016 Anand Muralidhar
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+
+/*
+ * Host-side benchmark of MyTransform against the 4x4 matrices MyGLCamera used to keep per
+ * object: memory per object, the cost of a per-frame rotate and MVP update, composing a
+ * child with its parent, and how far each drifts from a rotation after many small rotations.
+ *
+ * Build from the repository root:
+ *   g++ -std=c++11 -O2 -Iapp/src/main/jni/nativeCode/common \
+ *       -Iapp/src/main/externals/glm-0.9.7.5 tools/transformBenchmark.cpp \
+ *       app/src/main/jni/nativeCode/common/myTransform.cpp -o transformBenchmark
+ *
+ * Usage:
+ *   transformBenchmark [objects]    100000 by default
+ */
+
+#include "myTransform.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <vector>
+
+// repeat short measurements until they take this long
+#define MIN_MEASURE_MS      200.0
+#define DRIFT_ROTATIONS     1000000
+
+// what MyGLCamera stored for its model before MyTransform
+struct MatrixObject {
+    glm::mat4   rotateMat, translateMat, modelMat, mvpMat;
+};
+
+struct CompactObject {
+    MyTransform transform;
+    glm::mat4   mvpMat;
+};
+
+static double GetTimeMs() {
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000.0 + now.tv_nsec / 1000000.0;
+}
+
+static uint32_t NextRandom(uint32_t & state) {
+
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+static float RandomFloat(uint32_t & state) {
+
+    return (NextRandom(state) % 20001) / 10000.0f - 1.0f;
+}
+
+static void UpdateMatrices(std::vector<MatrixObject> & objects, const glm::mat4 & deltaMat,
+                           const glm::mat4 & projectionViewMat) {
+
+    for (size_t i = 0; i < objects.size(); i++) {
+        MatrixObject & object = objects[i];
+        object.rotateMat = deltaMat * object.rotateMat;
+        object.modelMat = object.translateMat * object.rotateMat;
+        object.mvpMat = projectionViewMat * object.modelMat;
+    }
+}
+
+static void UpdateCompact(std::vector<CompactObject> & objects, const glm::quat & delta,
+                          const glm::mat4 & projectionViewMat) {
+
+    for (size_t i = 0; i < objects.size(); i++) {
+        CompactObject & object = objects[i];
+        object.transform.Rotate(delta);
+        object.mvpMat = MultiplyAffine(projectionViewMat, object.transform.ToAffine());
+    }
+}
+
+/**
+ * Largest deviation of the upper 3x3 from an orthonormal matrix, and of its determinant from 1
+ */
+static void MeasureDrift(const glm::mat3 & rotation, float & orthogonality, float & determinant) {
+
+    glm::mat3 product = glm::transpose(rotation) * rotation;
+    orthogonality = 0;
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            orthogonality = fmaxf(orthogonality, fabsf(product[i][j] - (i == j ? 1.0f : 0.0f)));
+        }
+    }
+    determinant = fabsf(glm::determinant(rotation) - 1.0f);
+}
+
+int main(int argc, char ** argv) {
+
+    int objectCount = argc > 1 ? atoi(argv[1]) : 100000;
+    if (objectCount < 1) {
+        fprintf(stderr, "usage: %s [objects]\n", argv[0]);
+        return 1;
+    }
+
+    uint32_t random = 12345;
+    std::vector<MatrixObject> matrixObjects(objectCount);
+    std::vector<CompactObject> compactObjects(objectCount);
+    std::vector<MyTransform> parents(objectCount);
+    for (int i = 0; i < objectCount; i++) {
+        glm::vec3 position(RandomFloat(random), RandomFloat(random), RandomFloat(random));
+        glm::quat rotation = glm::normalize(glm::quat(RandomFloat(random), RandomFloat(random),
+                                                      RandomFloat(random), RandomFloat(random)));
+        matrixObjects[i].rotateMat = glm::toMat4(rotation);
+        matrixObjects[i].translateMat = glm::translate(glm::mat4(1.0f), position);
+        compactObjects[i].transform.rotation = rotation;
+        compactObjects[i].transform.translation = position;
+        parents[i].rotation = glm::normalize(glm::quat(RandomFloat(random), RandomFloat(random),
+                                                       RandomFloat(random), RandomFloat(random)));
+        parents[i].translation = glm::vec3(RandomFloat(random), 0, 0);
+    }
+    glm::mat4 projectionViewMat = glm::perspective(1.0f, 1.5f, 0.1f, 100.0f) *
+            glm::lookAt(glm::vec3(0, 0, 5), glm::vec3(0), glm::vec3(0, 1, 0));
+    glm::quat delta = glm::angleAxis(0.01f, glm::normalize(glm::vec3(1, 2, 3)));
+    glm::mat4 deltaMat = glm::toMat4(delta);
+
+    printf("%d objects\n", objectCount);
+    printf("state per object: mat4s %d bytes, MyTransform %d bytes (+64 for its MVP)\n",
+           (int) (sizeof(MatrixObject) - sizeof(glm::mat4)), (int) sizeof(MyTransform));
+
+    int runs = 0;
+    double startMs = GetTimeMs();
+    do {
+        UpdateMatrices(matrixObjects, deltaMat, projectionViewMat);
+        runs++;
+    } while (GetTimeMs() - startMs < MIN_MEASURE_MS);
+    double matrixNs = (GetTimeMs() - startMs) * 1e6 / runs / objectCount;
+
+    runs = 0;
+    startMs = GetTimeMs();
+    do {
+        UpdateCompact(compactObjects, delta, projectionViewMat);
+        runs++;
+    } while (GetTimeMs() - startMs < MIN_MEASURE_MS);
+    double compactNs = (GetTimeMs() - startMs) * 1e6 / runs / objectCount;
+    printf("rotate and MVP update: mat4s %.1f ns, MyTransform %.1f ns per object\n",
+           matrixNs, compactNs);
+
+    // child in its parent's space, each way
+    std::vector<glm::mat4> composedMats(objectCount);
+    std::vector<MyAffine3x4> composedAffines(objectCount);
+    std::vector<MyTransform> composedTransforms(objectCount);
+    std::vector<glm::mat4> parentMats(objectCount);
+    std::vector<MyAffine3x4> parentAffines(objectCount), childAffines(objectCount);
+    for (int i = 0; i < objectCount; i++) {
+        parentAffines[i] = parents[i].ToAffine();
+        childAffines[i] = compactObjects[i].transform.ToAffine();
+        parentMats[i] = MultiplyAffine(glm::mat4(1.0f), parentAffines[i]);
+    }
+    double composeNs[3];
+    for (int method = 0; method < 3; method++) {
+        runs = 0;
+        startMs = GetTimeMs();
+        do {
+            for (int i = 0; i < objectCount; i++) {
+                if (method == 0) {
+                    composedMats[i] = parentMats[i] * matrixObjects[i].modelMat;
+                } else if (method == 1) {
+                    composedAffines[i] = ComposeAffine(parentAffines[i], childAffines[i]);
+                } else {
+                    composedTransforms[i] = ComposeTransforms(parents[i],
+                                                              compactObjects[i].transform);
+                }
+            }
+            runs++;
+        } while (GetTimeMs() - startMs < MIN_MEASURE_MS);
+        composeNs[method] = (GetTimeMs() - startMs) * 1e6 / runs / objectCount;
+    }
+    printf("compose with parent: mat4 %.1f ns, 3x4 affine %.1f ns, MyTransform %.1f ns\n",
+           composeNs[0], composeNs[1], composeNs[2]);
+
+    // accumulate many small rotations on one object as RotateModel does on every drag event
+    glm::mat4 rotateMat(1.0f);
+    MyTransform transform;
+    for (int i = 0; i < DRIFT_ROTATIONS; i++) {
+        rotateMat = deltaMat * rotateMat;
+        transform.Rotate(delta);
+    }
+    float orthogonality, determinant;
+    MeasureDrift(glm::mat3(rotateMat), orthogonality, determinant);
+    printf("after %d rotations: mat4 off by %.2e from orthonormal, determinant by %.2e\n",
+           DRIFT_ROTATIONS, orthogonality, determinant);
+    MyAffine3x4 affine = transform.ToAffine();
+    glm::mat3 transformRotation(glm::vec3(affine.rows[0][0], affine.rows[1][0], affine.rows[2][0]),
+                                glm::vec3(affine.rows[0][1], affine.rows[1][1], affine.rows[2][1]),
+                                glm::vec3(affine.rows[0][2], affine.rows[1][2], affine.rows[2][2]));
+    MeasureDrift(transformRotation, orthogonality, determinant);
+    printf("after %d rotations: MyTransform off by %.2e from orthonormal, determinant by %.2e\n",
+           DRIFT_ROTATIONS, orthogonality, determinant);
+    return 0;
+}